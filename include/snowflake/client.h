@@ -61,6 +61,37 @@ extern "C" {
  */
 #define SF_LOGIN_TIMEOUT 120
 
+/**
+ * Default upper bound of chunk downloader threads per statement
+ */
+#define SF_DEFAULT_MAX_CHUNK_DOWNLOAD_THREADS 8
+
+/**
+ * Default memory budget of result chunks prefetched per statement
+ */
+#define SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES (256 * 1024 * 1024)
+
+/**
+ * Default number of times a result chunk is retried before the result set fails
+ */
+#define SF_DEFAULT_MAX_CHUNK_RETRIES 7
+
+/**
+ * Format version of the blobs written by snowflake_serialize_result
+ */
+#define SF_RESULT_BLOB_VERSION 1
+
+/**
+ * Default disk budget of result chunks spilled per statement
+ */
+#define SF_DEFAULT_MAX_CHUNK_SPILL_BYTES (1024 * 1024 * 1024)
+
+/**
+ * Default size from which the result chunk the application waits for is fetched in parallel byte ranges.
+ * 0, i.e. off, since the ranges take connections other chunks may need. 16 MB is a good size to turn it on with.
+ */
+#define SF_DEFAULT_CHUNK_RANGE_SPLIT_BYTES 0
+
 /**
  * Snowflake Data types
  *
@@ -210,7 +241,18 @@ typedef enum SF_ATTRIBUTE {
     SF_CON_AUTOCOMMIT,
     SF_DIR_QUERY_URL,
     SF_DIR_QUERY_URL_PARAM,
-    SF_DIR_QUERY_TOKEN
+    SF_DIR_QUERY_TOKEN,
+    SF_CON_MAX_CHUNK_DOWNLOAD_THREADS,
+    SF_CON_MAX_CHUNK_PREFETCH_BYTES,
+    SF_CON_MAX_CHUNK_MEMORY_BYTES,
+    SF_CON_ARROW_RESULTS,
+    SF_CON_CHUNK_HEDGING,
+    SF_CON_MAX_CHUNK_RETRIES,
+    SF_CON_CHUNK_SPILL_DIR,
+    SF_CON_MAX_CHUNK_SPILL_BYTES,
+    SF_CON_CHUNK_RANGE_SPLIT_BYTES,
+    SF_CON_EAGER_CHUNK_DECODING,
+    SF_CON_SESSION_OUTPUT_FORMATS
 } SF_ATTRIBUTE;
 
 /**
@@ -228,7 +270,13 @@ typedef enum SF_GLOBAL_ATTRIBUTE {
  * Attributes for Snowflake statement context.
  */
 typedef enum SF_STMT_ATTRIBUTE {
-    SF_STMT_USER_REALLOC_FUNC
+    SF_STMT_USER_REALLOC_FUNC,
+    SF_STMT_MAX_CHUNK_PREFETCH_BYTES,
+    // Read only. SF_CHUNK_STATS of the last query
+    SF_STMT_CHUNK_STATS,
+    // sf_bool. Set before the query to keep the result chunks around for snowflake_fetch_absolute and
+    // snowflake_rewind. Off by default
+    SF_STMT_SCROLLABLE
 } SF_STMT_ATTRIBUTE;
 
 /**
@@ -244,6 +292,21 @@ typedef struct SF_ERROR_STRUCT {
     int line;
 } SF_ERROR_STRUCT;
 
+/**
+ * Result chunk memory budget shared by the statements of a connection
+ */
+typedef struct SF_CHUNK_MEMORY_BUDGET SF_CHUNK_MEMORY_BUDGET;
+
+/**
+ * TLS sessions and DNS cache of the result chunk downloads shared by the statements of a connection
+ */
+typedef struct SF_CHUNK_SHARE SF_CHUNK_SHARE;
+
+/**
+ * Compiled TIMESTAMP_*_OUTPUT_FORMAT, TIME_OUTPUT_FORMAT and DATE_OUTPUT_FORMAT session parameters
+ */
+typedef struct SF_OUTPUT_FORMATS SF_OUTPUT_FORMATS;
+
 /**
  * Snowflake database session context.
  */
@@ -283,6 +346,44 @@ typedef struct SF_CONNECT {
     int64 login_timeout;
     int64 network_timeout;
 
+    // Hard caps for the chunk downloader scheduler
+    int64 max_chunk_download_threads;
+    int64 max_chunk_prefetch_bytes;
+
+    // Memory used by result chunks across all statements. 0 means unlimited
+    int64 max_chunk_memory_bytes;
+    SF_CHUNK_MEMORY_BUDGET *chunk_memory_budget;
+    SF_CHUNK_SHARE *chunk_share;
+
+    // Ask for results in the Arrow format instead of JSON. Off by default, since a result with a type the
+    // Arrow reader doesn't support fails instead of being read as JSON
+    sf_bool arrow_results;
+
+    // Request a result chunk a second time when it takes much longer than the others. Off by default, since
+    // the second request doubles the traffic of the chunks it is made for
+    sf_bool chunk_hedging;
+
+    // Retries of a failed result chunk download before the result set fails. 0 means no retries
+    int64 max_chunk_retries;
+
+    // Scratch directory result chunks are written to while the application is busy with the ones before
+    // them. NULL means chunks are only prefetched into memory
+    char *chunk_spill_dir;
+    int64 max_chunk_spill_bytes;
+
+    // Result chunks of at least this many bytes are fetched in parallel byte ranges when the application
+    // waits for them and download threads are idle. 0 means chunks are always fetched whole
+    int64 chunk_range_split_bytes;
+
+    // Convert the numbers and booleans of result chunks to their C types on the download threads, so the
+    // snowflake_column_as_* functions of the matching type only load them
+    sf_bool eager_chunk_decoding;
+
+    // Format DATE, TIME and TIMESTAMP strings with the session's output format parameters instead of the fixed
+    // YYYY-MM-DD HH24:MI:SS.<scale digits> layout
+    sf_bool session_output_formats;
+    SF_OUTPUT_FORMATS *output_formats;
+
     // Session specific fields
     int64 sequence_counter;
     SF_MUTEX_HANDLE mutex_sequence_counter;
@@ -313,6 +414,22 @@ typedef struct SF_COLUMN_DESC {
     sf_bool null_ok;
 } SF_COLUMN_DESC;
 
+/**
+ * Length or indicator value of a NULL column fetched by snowflake_fetch_rows
+ */
+#define SF_NULL_DATA (-1)
+
+/**
+ * Bound output column context for snowflake_fetch_rows
+ */
+typedef struct SF_BIND_OUTPUT {
+    size_t idx; /* One based index of the column */
+    SF_C_TYPE c_type; /* output data type in C */
+    void *value; /* output value array */
+    size_t element_size; /* distance between two values in bytes. The size of each string for SF_C_TYPE_STRING */
+    int64 *len_or_ind; /* (optional) output length array. SF_NULL_DATA for NULL */
+} SF_BIND_OUTPUT;
+
 /**
  * Chunk downloader context
  */
@@ -323,6 +440,34 @@ typedef struct SF_CHUNK_DOWNLOADER SF_CHUNK_DOWNLOADER;
  */
 typedef struct SF_PUT_GET_RESPONSE SF_PUT_GET_RESPONSE;
 
+/**
+ * Result chunk download statistics of a query
+ */
+typedef struct SF_CHUNK_STATS {
+    // Number of result chunks downloaded
+    uint64 chunk_count;
+    // Number of hedged chunks, i.e. chunks requested a second time because they took longer than the
+    // hedge deadline, and how many of the second requests finished first
+    uint64 hedged_count;
+    uint64 hedge_won_count;
+    // Download time beyond which the chunk the application waits for is hedged. A percentile of the download
+    // times so far, 0 until enough chunks were downloaded
+    uint64 hedge_deadline_usec;
+    // Number of retried chunk downloads, and how many of them resumed the body where the failed one stopped
+    uint64 retry_count;
+    uint64 resumed_count;
+    // Number of chunks written to the spill directory instead of memory
+    uint64 spilled_count;
+    // Number of chunks of a scrollable result downloaded again because they were evicted
+    uint64 refetched_count;
+    // Number of chunks parsed into the memory of a chunk the application was done with
+    uint64 recycled_count;
+    // Number of chunks fetched in parallel byte ranges
+    uint64 split_count;
+    // Number of times the chunk URLs expired and were fetched again
+    uint64 url_refresh_count;
+} SF_CHUNK_STATS;
+
 /**
  * Statement context
  */
@@ -342,6 +487,8 @@ typedef struct SF_STMT {
     void *params;
     void *name_list;
     unsigned int params_len;
+    SF_BIND_OUTPUT *bound_columns;
+    size_t bound_columns_len;
     SF_COLUMN_DESC *desc;
     void *stmt_attrs;
     sf_bool is_dml;
@@ -351,6 +498,29 @@ typedef struct SF_STMT {
      */
     void *(*user_realloc_func)(void*, size_t);
 
+    /**
+     * Memory budget of prefetched result chunks. 0 means the connection default
+     */
+    int64 max_chunk_prefetch_bytes;
+
+    /**
+     * Result chunk download statistics, see SF_STMT_CHUNK_STATS
+     */
+    SF_CHUNK_STATS chunk_stats;
+
+    /**
+     * Scrollable result, see SF_STMT_SCROLLABLE. raw_results holds the rows of chunk_index, -1 being
+     * the rows of the query response, which are kept in first_results while another chunk is current.
+     */
+    sf_bool scrollable;
+    int64 chunk_index;
+    void *first_results;
+
+    /**
+     * Strings snowflake_column_as_strview formatted from the values of the current row
+     */
+    void *row_scratch;
+
     SF_CHUNK_DOWNLOADER *chunk_downloader;
     SF_PUT_GET_RESPONSE *put_get_response;
 } SF_STMT;
@@ -635,6 +805,114 @@ SF_STATUS STDCALL snowflake_execute(SF_STMT *sfstmt);
  */
 SF_STATUS STDCALL snowflake_fetch(SF_STMT *sfstmt);
 
+/**
+ * Binds an output array to a result column for snowflake_fetch_rows.
+ * The binding is kept until the statement is prepared again.
+ *
+ * Supported C types are SF_C_TYPE_INT64, SF_C_TYPE_UINT64, SF_C_TYPE_FLOAT64,
+ * SF_C_TYPE_BOOLEAN, SF_C_TYPE_STRING and SF_C_TYPE_BINARY for BINARY columns.
+ * Strings longer than element_size - 1 bytes and binary values longer than
+ * element_size bytes are truncated, len_or_ind still gets their full length.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @param idx one based index of the column.
+ * @param c_type output data type in C.
+ * @param value output array with room for the max_rows of snowflake_fetch_rows, NULL to unbind the column.
+ * @param element_size distance between two values in bytes, 0 for the size of c_type.
+ * The size of each string including the NUL terminator for SF_C_TYPE_STRING,
+ * of each binary value for SF_C_TYPE_BINARY.
+ * @param len_or_ind (optional) array that receives the length of each value or SF_NULL_DATA.
+ * @return 0 if success, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_bind_column(SF_STMT *sfstmt, size_t idx, SF_C_TYPE c_type, void *value,
+                                        size_t element_size, int64 *len_or_ind);
+
+/**
+ * Fetches up to max_rows rows into the arrays bound with snowflake_bind_column,
+ * converting one column at a time. The last fetched row becomes the current row.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @param max_rows maximum number of rows to fetch.
+ * @param rows_fetched receives the number of rows fetched. On a conversion error
+ * it includes the rows of the failing block, whose values are incomplete.
+ * @return 0 if success, SF_STATUS_EOF if there are no more rows, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_fetch_rows(SF_STMT *sfstmt, int64 max_rows, int64 *rows_fetched);
+
+/**
+ * Makes a row of a scrollable result the current row, see SF_STMT_SCROLLABLE.
+ * The next snowflake_fetch continues with the row after it.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @param row zero based index of the row.
+ * @return 0 if success, SF_STATUS_EOF if the result has fewer rows, in which case
+ * the current row doesn't change, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_fetch_absolute(SF_STMT *sfstmt, int64 row);
+
+/**
+ * Goes back to the start of a scrollable result, so the next snowflake_fetch
+ * returns the first row again.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @return 0 if success, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_rewind(SF_STMT *sfstmt);
+
+/**
+ * Splits the result of an executed statement into partition_count statements
+ * that each own a contiguous range of the result chunks with about the same
+ * number of rows, so as many threads can download, fetch and read the rows in
+ * parallel. The first partition also gets the rows of the query response.
+ *
+ * Must be called before the first fetch. sfstmt has no rows left afterwards.
+ * Each partition is freed with snowflake_stmt_term.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @param partition_count number of partitions.
+ * @param partitions array that receives partition_count statements.
+ * @return 0 if success, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_partition_result(SF_STMT *sfstmt, int64 partition_count, SF_STMT **partitions);
+
+/**
+ * Serializes the result of an executed statement into a portable blob: the
+ * column description, the rows of the query response, the chunk list and the
+ * qrmk and chunkHeaders needed to download the chunks. Another process can read
+ * the result from the blob with snowflake_stmt_from_result until the chunk URLs
+ * expire.
+ *
+ * Must be called before the first fetch. The statement is left as it was.
+ *
+ * @param sfstmt SNOWFLAKE_STMT context.
+ * @param blob receives the NUL terminated blob. Free it with snowflake_result_blob_free.
+ * @param len (optional) receives the length of the blob.
+ * @return 0 if success, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_serialize_result(SF_STMT *sfstmt, char **blob, size_t *len);
+
+/**
+ * Frees a blob written by snowflake_serialize_result.
+ */
+void STDCALL snowflake_result_blob_free(char *blob);
+
+/**
+ * Creates a fetch-only statement over chunk_count chunks of a serialized result,
+ * starting at first_chunk. The statement that starts at chunk 0 also gets the rows
+ * of the query response, so cursors over disjoint ranges read every row once.
+ * The connection only provides the chunk download settings, it doesn't need to
+ * be logged in.
+ *
+ * @param sf SNOWFLAKE_CONNECT context. Receives the error if one occurs.
+ * @param blob NUL terminated blob written by snowflake_serialize_result.
+ * @param first_chunk index of the first chunk.
+ * @param chunk_count number of chunks, or -1 for all the chunks from first_chunk on.
+ * @param sfstmt receives the statement. Free it with snowflake_stmt_term.
+ * @return 0 if success, otherwise an errno is returned.
+ */
+SF_STATUS STDCALL snowflake_stmt_from_result(SF_CONNECT *sf, const char *blob, int64 first_chunk,
+                                             int64 chunk_count, SF_STMT **sfstmt);
+
 /**
  * Returns the number of binding parameters in the statement.
  *
@@ -836,6 +1114,34 @@ SF_STATUS STDCALL snowflake_column_as_timestamp(SF_STMT *sfstmt, int idx, SF_TIM
  */
 SF_STATUS STDCALL snowflake_column_as_const_str(SF_STMT *sfstmt, int idx, const char **value_ptr);
 
+/**
+ * Returns the column as a string without copying it. Text is the raw column data, while booleans, dates and
+ * timestamps are formatted like snowflake_column_as_str does into memory of the statement that is reused row
+ * after row. The string is NUL terminated and valid until the next fetch. A NULL column returns a NULL pointer.
+ *
+ * @param sfstmt SF_STMT context
+ * @param idx Column index
+ * @param value_ptr The string is stored in this pointer
+ * @param value_len_ptr The length of the string, if not NULL
+ * @return 0 if success, otherwise an errno is returned
+ */
+SF_STATUS STDCALL snowflake_column_as_strview(SF_STMT *sfstmt, int idx, const char **value_ptr,
+                                              size_t *value_len_ptr);
+
+/**
+ * Decodes a BINARY column into the buffer provided. A NULL column has a length of 0. Pass a NULL buffer to only
+ * get the length.
+ *
+ * @param sfstmt SF_STMT context
+ * @param idx Column index
+ * @param buffer Buffer the bytes are decoded into
+ * @param capacity Size of the buffer
+ * @param len_ptr Number of bytes of the value, also when the buffer is too small
+ * @return 0 if success, SF_STATUS_ERROR_BUFFER_TOO_SMALL if the value doesn't fit, otherwise an errno is returned
+ */
+SF_STATUS STDCALL snowflake_column_as_binary(SF_STMT *sfstmt, int idx, void *buffer, size_t capacity,
+                                             size_t *len_ptr);
+
 /**
  * Converts a column into a string, copies to the buffer provided and stores that buffer address in value_ptr. If
  * *value_ptr is not NULL and max_value_size_ptr is not NULL and greater than 0, then the library will copy the string
@@ -914,14 +1220,17 @@ SF_STATUS STDCALL snowflake_timestamp_from_epoch_seconds(SF_TIMESTAMP *ts, const
                                                          int32 scale, SF_DB_TYPE ts_type);
 
 /**
+ * Formats a timestamp as a string.
  *
- * @param ts
- * @param fmt
- * @param buffer_ptr
- * @param buf_size
- * @param bytes_written
- * @param reallocate
- * @return
+ * @param ts Timestamp to format
+ * @param fmt Snowflake output format, e.g. YYYY-MM-DD HH24:MI:SS.FF3 TZH:TZM, or an empty string for
+ *            YYYY-MM-DD HH24:MI:SS, or HH24:MI:SS for TIME, with the digits of the scale and the offset of
+ *            TIMESTAMP_TZ values
+ * @param buffer_ptr Buffer to write the string to, allocated if NULL
+ * @param buf_size Size of the buffer
+ * @param bytes_written Set to the length of the string
+ * @param reallocate Whether a buffer too small for the format may be reallocated
+ * @return 0 if successful, SF_STATUS_ERROR_STRING_FORMATTING for an unsupported format
  */
 SF_STATUS STDCALL snowflake_timestamp_to_string(SF_TIMESTAMP *ts, const char *fmt, char **buffer_ptr,
                                                 size_t buf_size, size_t *bytes_written,
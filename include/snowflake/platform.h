@@ -22,6 +22,8 @@ typedef CONDITION_VARIABLE SF_CONDITION_HANDLE;
 typedef CRITICAL_SECTION SF_CRITICAL_SECTION_HANDLE;
 typedef SRWLOCK SF_RWLOCK_HANDLE;
 typedef HANDLE SF_MUTEX_HANDLE;
+typedef volatile LONG64 SF_ATOMIC_INT64;
+typedef DWORD SF_THREAD_LOCAL_KEY;
 
 #define PATH_SEP '\\'
 //On windows MAX_PATH is defined as 255
@@ -39,6 +41,8 @@ typedef pthread_cond_t SF_CONDITION_HANDLE;
 typedef pthread_mutex_t SF_CRITICAL_SECTION_HANDLE;
 typedef pthread_rwlock_t SF_RWLOCK_HANDLE;
 typedef pthread_mutex_t SF_MUTEX_HANDLE;
+typedef volatile long long SF_ATOMIC_INT64;
+typedef pthread_key_t SF_THREAD_LOCAL_KEY;
 
 #define PATH_SEP '/'
 #define MAX_PATH PATH_MAX
@@ -47,6 +51,19 @@ typedef pthread_mutex_t SF_MUTEX_HANDLE;
 
 #include "Simba_CRTFunctionSafe.h"
 
+/**
+ * Read only view of a whole file
+ */
+typedef struct SF_MAPPED_FILE {
+    // NULL if the file is empty
+    const char *data;
+    size_t len;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} SF_MAPPED_FILE;
+
 struct tm *STDCALL sf_gmtime(const time_t *timep, struct tm *result);
 
 struct tm *STDCALL sf_localtime(const time_t *timep, struct tm *result);
@@ -78,6 +95,14 @@ int STDCALL _cond_signal(SF_CONDITION_HANDLE *cond);
 int STDCALL
 _cond_wait(SF_CONDITION_HANDLE *cond, SF_CRITICAL_SECTION_HANDLE *lock);
 
+/**
+ * Same as _cond_wait, but gives up after msec milliseconds.
+ *
+ * @return 0 if woken up, non-zero if timed out or failed
+ */
+int STDCALL
+_cond_timed_wait(SF_CONDITION_HANDLE *cond, SF_CRITICAL_SECTION_HANDLE *lock, unsigned long msec);
+
 int STDCALL _cond_term(SF_CONDITION_HANDLE *cond);
 
 int STDCALL _critical_section_init(SF_CRITICAL_SECTION_HANDLE *lock);
@@ -108,6 +133,45 @@ int STDCALL _mutex_unlock(SF_MUTEX_HANDLE *lock);
 
 int STDCALL _mutex_term(SF_MUTEX_HANDLE *lock);
 
+/**
+ * Creates a key for a value of each thread. The destructor is called with the value, if not NULL, when a
+ * thread exits. Whether it is called for the values left once the key is deleted depends on the platform.
+ *
+ * @return 0 if successful
+ */
+int STDCALL _thread_local_init(SF_THREAD_LOCAL_KEY *key, void (STDCALL *destructor)(void *));
+
+/**
+ * @return the value of the calling thread, NULL if it didn't set one
+ */
+void *STDCALL _thread_local_get(SF_THREAD_LOCAL_KEY *key);
+
+int STDCALL _thread_local_set(SF_THREAD_LOCAL_KEY *key, void *value);
+
+int STDCALL _thread_local_term(SF_THREAD_LOCAL_KEY *key);
+
+/**
+ * Atomic operations on a 64 bit integer. They are sequentially consistent, so a store followed by a load
+ * of another atomic is never reordered.
+ */
+long long STDCALL _atomic_load(SF_ATOMIC_INT64 *value);
+
+void STDCALL _atomic_store(SF_ATOMIC_INT64 *value, long long new_value);
+
+/**
+ * @return the new value
+ */
+long long STDCALL _atomic_add(SF_ATOMIC_INT64 *value, long long delta);
+
+/**
+ * Maps a file into memory for reading.
+ *
+ * @return 0 if successful
+ */
+int STDCALL sf_map_file(const char *path, SF_MAPPED_FILE *mapped);
+
+int STDCALL sf_unmap_file(SF_MAPPED_FILE *mapped);
+
 const char *STDCALL sf_os_name();
 
 void STDCALL sf_os_version(char *ret, size_t size);
@@ -118,6 +182,8 @@ char *STDCALL sf_filename_from_path(const char *path);
 
 void STDCALL sf_log_timestamp(char* tsbuf, size_t tsbufsize);
 
+unsigned long long STDCALL sf_get_monotonic_time_usec(void);
+
 int STDCALL sf_create_directory_if_not_exists(const char * directoryName);
 
 int STDCALL sf_delete_directory_if_exists(const char * directoryName);
@@ -0,0 +1,1245 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arrow_reader.h"
+#include "base64.h"
+#include "memory.h"
+#include "number_parser.h"
+
+// Arrow messages start with this marker, followed by the length of the metadata
+#define ARROW_CONTINUATION 0xFFFFFFFF
+#define ARROW_MAX_METADATA_LEN (64 * 1024 * 1024)
+#define ARROW_MAX_BODY_LEN ((uint64) SF_INT32_MAX)
+
+#define ARROW_MIN_BUFFER_SIZE 4096
+// Room for a rendered number, e.g. a 38 digit decimal with a sign and a decimal point
+#define ARROW_MIN_VALUE_SIZE 128
+
+// Message header types
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+
+// Field types
+#define ARROW_TYPE_NULL 1
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_BOOL 6
+#define ARROW_TYPE_DECIMAL 7
+#define ARROW_TYPE_DATE 8
+#define ARROW_TYPE_TIME 9
+#define ARROW_TYPE_TIMESTAMP 10
+#define ARROW_TYPE_STRUCT 13
+
+// Size of the FieldNode and Buffer structs of a record batch
+#define ARROW_FIELD_NODE_SIZE 16
+#define ARROW_BUFFER_SIZE 16
+
+static const uint64 pow10_uint64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL
+};
+
+/**
+ * Table of a flatbuffer, the encoding of the metadata of Arrow messages. A table without a vtable
+ * stands for an absent table, all its fields have their default value.
+ */
+typedef struct FB_TABLE {
+    const uint8 *buf;
+    size_t len;
+    size_t pos;
+    size_t table_len;
+    const uint8 *vtable;
+    size_t vtable_len;
+} FB_TABLE;
+
+typedef struct SF_ARROW_MESSAGE {
+    // Size of the whole message, or the number of bytes needed to know it
+    size_t size;
+    const uint8 *metadata;
+    size_t metadata_len;
+    uint64 body_len;
+} SF_ARROW_MESSAGE;
+
+// The stream is little endian, which every platform we build for is as well
+static uint16_t read_uint16(const uint8 *p) {
+    uint16_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32 read_uint32(const uint8 *p) {
+    uint32 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static int64 read_int64(const uint8 *p) {
+    int64 value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static sf_bool STDCALL fb_table_at(const uint8 *buf, size_t len, size_t pos, FB_TABLE *table) {
+    int64 vtable_pos;
+    size_t vtable_len;
+    size_t table_len;
+
+    if (pos > len || len - pos < 4) {
+        return SF_BOOLEAN_FALSE;
+    }
+    vtable_pos = (int64) pos - (int32) read_uint32(buf + pos);
+    if (vtable_pos < 0 || (uint64) vtable_pos > len - 4) {
+        return SF_BOOLEAN_FALSE;
+    }
+    vtable_len = read_uint16(buf + vtable_pos);
+    table_len = read_uint16(buf + vtable_pos + 2);
+    if (vtable_len < 4 || vtable_len > len - (size_t) vtable_pos || table_len < 4 || table_len > len - pos) {
+        return SF_BOOLEAN_FALSE;
+    }
+    table->buf = buf;
+    table->len = len;
+    table->pos = pos;
+    table->table_len = table_len;
+    table->vtable = buf + vtable_pos;
+    table->vtable_len = vtable_len;
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL fb_root(const uint8 *buf, size_t len, FB_TABLE *table) {
+    return len >= 4 && fb_table_at(buf, len, read_uint32(buf), table);
+}
+
+/**
+ * Position of a field of size bytes, or 0 if the field is absent
+ */
+static size_t STDCALL fb_field(const FB_TABLE *table, int id, size_t size) {
+    size_t entry = 4 + 2 * (size_t) id;
+    size_t offset;
+
+    if (!table->vtable || entry + 2 > table->vtable_len) {
+        return 0;
+    }
+    offset = read_uint16(table->vtable + entry);
+    if (offset == 0 || offset + size > table->table_len) {
+        return 0;
+    }
+    return table->pos + offset;
+}
+
+static int64 STDCALL fb_int(const FB_TABLE *table, int id, size_t size, int64 default_value) {
+    size_t pos = fb_field(table, id, size);
+    const uint8 *p = table->buf + pos;
+
+    if (pos == 0) {
+        return default_value;
+    }
+    switch (size) {
+        case 1:
+            return *p;
+        case 2:
+            return (int16_t) read_uint16(p);
+        case 4:
+            return (int32) read_uint32(p);
+        default:
+            return read_int64(p);
+    }
+}
+
+/**
+ * Follows the offset stored in a field. target is 0 if the field is absent.
+ *
+ * @return SF_BOOLEAN_FALSE if the offset points out of the buffer
+ */
+static sf_bool STDCALL fb_deref(const FB_TABLE *table, int id, size_t *target) {
+    size_t pos = fb_field(table, id, 4);
+    uint32 offset;
+
+    *target = 0;
+    if (pos == 0) {
+        return SF_BOOLEAN_TRUE;
+    }
+    offset = read_uint32(table->buf + pos);
+    if (offset == 0 || offset > table->len - pos) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *target = pos + offset;
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL fb_sub_table(const FB_TABLE *table, int id, FB_TABLE *sub_table) {
+    size_t target;
+
+    if (!fb_deref(table, id, &target)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (target == 0) {
+        memset(sub_table, 0, sizeof(FB_TABLE));
+        sub_table->buf = table->buf;
+        return SF_BOOLEAN_TRUE;
+    }
+    return fb_table_at(table->buf, table->len, target, sub_table);
+}
+
+/**
+ * Vector of elements of element_size bytes. An absent vector is empty.
+ */
+static sf_bool STDCALL fb_vector(const FB_TABLE *table, int id, size_t element_size,
+                                 const uint8 **elements, size_t *count) {
+    size_t target;
+    uint32 length;
+
+    *elements = NULL;
+    *count = 0;
+    if (!fb_deref(table, id, &target)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (target == 0) {
+        return SF_BOOLEAN_TRUE;
+    }
+    if (table->len - target < 4) {
+        return SF_BOOLEAN_FALSE;
+    }
+    length = read_uint32(table->buf + target);
+    if (length > (table->len - target - 4) / element_size) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *elements = table->buf + target + 4;
+    *count = length;
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL fb_vector_table(const FB_TABLE *table, const uint8 *elements, size_t index,
+                                       FB_TABLE *element) {
+    size_t pos = (size_t) (elements - table->buf) + index * 4;
+    uint32 offset = read_uint32(elements + index * 4);
+
+    return offset <= table->len - pos && fb_table_at(table->buf, table->len, pos + offset, element);
+}
+
+static sf_bool STDCALL reader_error(SF_ARROW_READER *reader, const char *msg) {
+    if (!reader->error_msg) {
+        reader->error_msg = msg;
+    }
+    return SF_BOOLEAN_FALSE;
+}
+
+static sf_bool STDCALL reserve_value(SF_ARROW_READER *reader, size_t size) {
+    size_t new_size = reader->value_size < ARROW_MIN_VALUE_SIZE ? ARROW_MIN_VALUE_SIZE : reader->value_size;
+    char *value;
+
+    if (size <= reader->value_size) {
+        return SF_BOOLEAN_TRUE;
+    }
+    while (new_size < size) {
+        new_size *= 2;
+    }
+    value = (char *) SF_REALLOC(reader->value, new_size);
+    if (!value) {
+        return reader_error(reader, "Out of memory reading Arrow stream");
+    }
+    reader->value = value;
+    reader->value_size = new_size;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Reads the length of the message at the start of data and the message table if it is complete.
+ *
+ * @return 1 if the whole message is in data, 0 if more data is needed and -1 if the message is malformed
+ */
+static int STDCALL read_message_header(SF_ARROW_READER *reader, const uint8 *data, size_t len,
+                                       SF_ARROW_MESSAGE *message) {
+    size_t prefix_len = 4;
+    uint32 metadata_len;
+    int64 body_len;
+    FB_TABLE table;
+
+    memset(message, 0, sizeof(SF_ARROW_MESSAGE));
+    message->size = prefix_len;
+    if (len < prefix_len) {
+        return 0;
+    }
+    metadata_len = read_uint32(data);
+    // Streams written before the continuation marker was added start with the length
+    if (metadata_len == ARROW_CONTINUATION) {
+        prefix_len = 8;
+        message->size = prefix_len;
+        if (len < prefix_len) {
+            return 0;
+        }
+        metadata_len = read_uint32(data + 4);
+    }
+    if (metadata_len > ARROW_MAX_METADATA_LEN) {
+        reader_error(reader, "Invalid Arrow message length");
+        return -1;
+    }
+    // A zero length marks the end of the stream
+    message->size = prefix_len + metadata_len;
+    if (metadata_len == 0) {
+        return 1;
+    }
+    if (len < message->size) {
+        return 0;
+    }
+
+    message->metadata = data + prefix_len;
+    message->metadata_len = metadata_len;
+    if (!fb_root(message->metadata, metadata_len, &table)) {
+        reader_error(reader, "Invalid Arrow message");
+        return -1;
+    }
+    body_len = fb_int(&table, 3, 8, 0);
+    if (body_len < 0 || (uint64) body_len > ARROW_MAX_BODY_LEN) {
+        reader_error(reader, "Invalid Arrow message body length");
+        return -1;
+    }
+    message->body_len = (uint64) body_len;
+    message->size += (size_t) body_len;
+    return len >= message->size ? 1 : 0;
+}
+
+/**
+ * Reads the logicalType and the scale Snowflake adds to the metadata of each field
+ */
+static sf_bool STDCALL read_field_metadata(const FB_TABLE *field, char *logical_type, size_t logical_type_size,
+                                           int32 *scale) {
+    const uint8 *elements;
+    const uint8 *key;
+    const uint8 *value;
+    size_t count;
+    size_t key_len;
+    size_t value_len;
+    size_t i;
+    FB_TABLE key_value;
+    char scale_str[16];
+
+    logical_type[0] = '\0';
+    if (!fb_vector(field, 6, 4, &elements, &count)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    for (i = 0; i < count; i++) {
+        if (!fb_vector_table(field, elements, i, &key_value) ||
+            !fb_vector(&key_value, 0, 1, &key, &key_len) ||
+            !fb_vector(&key_value, 1, 1, &value, &value_len)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        if (key_len == 11 && memcmp(key, "logicalType", 11) == 0 && value_len < logical_type_size) {
+            memcpy(logical_type, value, value_len);
+            logical_type[value_len] = '\0';
+        } else if (key_len == 5 && memcmp(key, "scale", 5) == 0 && value_len < sizeof(scale_str)) {
+            memcpy(scale_str, value, value_len);
+            scale_str[value_len] = '\0';
+            *scale = (int32) strtol(scale_str, NULL, 10);
+        }
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static int32 STDCALL time_unit_scale(int64 unit) {
+    switch (unit) {
+        case 0:
+            return 0;
+        case 1:
+            return 3;
+        case 2:
+            return 6;
+        case 3:
+            return 9;
+        default:
+            return -1;
+    }
+}
+
+static sf_bool STDCALL is_timestamp_type(const char *logical_type) {
+    return strcmp(logical_type, "TIME") == 0 || strncmp(logical_type, "TIMESTAMP", 9) == 0;
+}
+
+static sf_bool STDCALL is_timestamp_render(SF_ARROW_RENDER render) {
+    return render == ARROW_RENDER_TIMESTAMP || render == ARROW_RENDER_TIMESTAMP_STRUCT ||
+           render == ARROW_RENDER_TIMESTAMP_TZ || render == ARROW_RENDER_TIMESTAMP_TZ_STRUCT;
+}
+
+/**
+ * Picks how to render a field that is not a struct, based on the Snowflake type if there is one and the
+ * Arrow type otherwise
+ */
+static sf_bool STDCALL read_field_type(SF_ARROW_READER *reader, SF_ARROW_COLUMN *column, const FB_TABLE *type,
+                                       const char *logical_type) {
+    int64 bit_width;
+    int64 unit;
+
+    column->array.width = 0;
+    column->array.is_signed = SF_BOOLEAN_TRUE;
+    switch (column->type) {
+        case ARROW_TYPE_NULL:
+            column->render = ARROW_RENDER_NULL;
+            break;
+        case ARROW_TYPE_INT:
+            bit_width = fb_int(type, 0, 4, 0);
+            if (bit_width != 8 && bit_width != 16 && bit_width != 32 && bit_width != 64) {
+                return reader_error(reader, "Unsupported Arrow integer width");
+            }
+            column->array.width = (uint32) bit_width / 8;
+            column->array.is_signed = fb_int(type, 1, 1, 0) != 0;
+            if (strcmp(logical_type, "DATE") == 0) {
+                column->render = ARROW_RENDER_DATE;
+            } else if (is_timestamp_type(logical_type)) {
+                column->render = ARROW_RENDER_TIMESTAMP;
+            } else {
+                column->render = ARROW_RENDER_FIXED;
+            }
+            break;
+        case ARROW_TYPE_DECIMAL:
+            if (fb_int(type, 2, 4, 128) != 128) {
+                return reader_error(reader, "Unsupported Arrow decimal width");
+            }
+            column->array.width = 16;
+            column->scale = (int32) fb_int(type, 1, 4, 0);
+            column->render = ARROW_RENDER_DECIMAL;
+            break;
+        case ARROW_TYPE_FLOATING_POINT:
+            switch (fb_int(type, 0, 2, 0)) {
+                case 1:
+                    column->array.width = 4;
+                    break;
+                case 2:
+                    column->array.width = 8;
+                    break;
+                default:
+                    return reader_error(reader, "Unsupported Arrow floating point precision");
+            }
+            column->render = ARROW_RENDER_REAL;
+            break;
+        case ARROW_TYPE_UTF8:
+            column->render = ARROW_RENDER_TEXT;
+            break;
+        case ARROW_TYPE_BINARY:
+            column->render = ARROW_RENDER_BINARY;
+            break;
+        case ARROW_TYPE_BOOL:
+            column->render = ARROW_RENDER_BOOLEAN;
+            break;
+        case ARROW_TYPE_DATE:
+            // DAY or MILLISECOND
+            if (fb_int(type, 0, 2, 1) == 0) {
+                column->array.width = 4;
+                column->render = ARROW_RENDER_DATE;
+            } else {
+                column->array.width = 8;
+                column->render = ARROW_RENDER_DATE_MILLIS;
+            }
+            break;
+        case ARROW_TYPE_TIME:
+        case ARROW_TYPE_TIMESTAMP:
+            unit = fb_int(type, 0, 2, column->type == ARROW_TYPE_TIME ? 1 : 0);
+            bit_width = column->type == ARROW_TYPE_TIME ? fb_int(type, 1, 4, 32) : 64;
+            if (time_unit_scale(unit) < 0 || (bit_width != 32 && bit_width != 64)) {
+                return reader_error(reader, "Unsupported Arrow time type");
+            }
+            column->array.width = (uint32) bit_width / 8;
+            column->scale = time_unit_scale(unit);
+            column->render = ARROW_RENDER_TIMESTAMP;
+            break;
+        default:
+            return reader_error(reader, "Unsupported Arrow type");
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Reads a struct field, which Snowflake uses for timestamps that don't fit a 64 bit integer and for
+ * timestamps with a timezone
+ */
+static sf_bool STDCALL read_struct_field(SF_ARROW_READER *reader, SF_ARROW_COLUMN *column, const FB_TABLE *field,
+                                         const uint8 *children, size_t child_count, const char *logical_type) {
+    FB_TABLE child;
+    FB_TABLE child_type;
+    const uint8 *grand_children;
+    size_t grand_child_count;
+    int64 bit_width;
+    size_t i;
+
+    if (strcmp(logical_type, "TIMESTAMP_TZ") == 0 && (child_count == 2 || child_count == 3)) {
+        column->render = child_count == 2 ? ARROW_RENDER_TIMESTAMP_TZ : ARROW_RENDER_TIMESTAMP_TZ_STRUCT;
+    } else if (strncmp(logical_type, "TIMESTAMP", 9) == 0 && child_count == 2) {
+        column->render = ARROW_RENDER_TIMESTAMP_STRUCT;
+    } else {
+        return reader_error(reader, "Unsupported Arrow struct");
+    }
+
+    column->child_count = (int) child_count;
+    for (i = 0; i < child_count; i++) {
+        if (!fb_vector_table(field, children, i, &child) ||
+            !fb_sub_table(&child, 3, &child_type) ||
+            !fb_vector(&child, 5, 4, &grand_children, &grand_child_count)) {
+            return reader_error(reader, "Invalid Arrow schema");
+        }
+        bit_width = fb_int(&child_type, 0, 4, 0);
+        // The epoch is 64 bits, the fraction and the timezone are 32 bits
+        if (fb_int(&child, 2, 1, 0) != ARROW_TYPE_INT || grand_child_count != 0 ||
+            bit_width != (i == 0 ? 64 : 32)) {
+            return reader_error(reader, "Unsupported Arrow struct");
+        }
+        column->children[i].width = (uint32) bit_width / 8;
+        column->children[i].is_signed = SF_BOOLEAN_TRUE;
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * The C type rowset_decode would decode the column as, for the columns whose values are read as is
+ */
+static SF_C_TYPE STDCALL decoded_type(const SF_ARROW_COLUMN *column) {
+    switch (column->render) {
+        case ARROW_RENDER_FIXED:
+            return column->scale == 0 ? SF_C_TYPE_INT64 : SF_C_TYPE_FLOAT64;
+        case ARROW_RENDER_REAL:
+            return SF_C_TYPE_FLOAT64;
+        case ARROW_RENDER_BOOLEAN:
+            return SF_C_TYPE_BOOLEAN;
+        default:
+            return SF_C_TYPE_NULL;
+    }
+}
+
+static sf_bool STDCALL read_schema(SF_ARROW_READER *reader, const FB_TABLE *schema) {
+    const uint8 *fields;
+    const uint8 *children;
+    size_t field_count;
+    size_t child_count;
+    size_t i;
+    FB_TABLE field;
+    FB_TABLE type;
+    SF_ARROW_COLUMN *column;
+    char logical_type[32];
+
+    if (reader->columns) {
+        return reader_error(reader, "Arrow stream has more than one schema");
+    }
+    if (fb_int(schema, 0, 2, 0) != 0) {
+        return reader_error(reader, "Big endian Arrow streams are not supported");
+    }
+    if (!fb_vector(schema, 1, 4, &fields, &field_count)) {
+        return reader_error(reader, "Invalid Arrow schema");
+    }
+    reader->columns = (SF_ARROW_COLUMN *) SF_CALLOC(field_count > 0 ? field_count : 1, sizeof(SF_ARROW_COLUMN));
+    if (!reader->columns || !reserve_value(reader, ARROW_MIN_VALUE_SIZE)) {
+        return reader_error(reader, "Out of memory reading Arrow stream");
+    }
+    reader->column_count = field_count;
+
+    for (i = 0; i < field_count; i++) {
+        column = &reader->columns[i];
+        if (!fb_vector_table(schema, fields, i, &field) ||
+            !fb_sub_table(&field, 3, &type) ||
+            !fb_vector(&field, 5, 4, &children, &child_count) ||
+            !read_field_metadata(&field, logical_type, sizeof(logical_type), &column->scale)) {
+            return reader_error(reader, "Invalid Arrow schema");
+        }
+        if (fb_field(&field, 4, 4) != 0) {
+            return reader_error(reader, "Dictionary encoded Arrow columns are not supported");
+        }
+        column->type = (uint8) fb_int(&field, 2, 1, 0);
+        if (column->type == ARROW_TYPE_STRUCT) {
+            if (!read_struct_field(reader, column, &field, children, child_count, logical_type)) {
+                return SF_BOOLEAN_FALSE;
+            }
+        } else if (child_count != 0 || !read_field_type(reader, column, &type, logical_type)) {
+            return reader_error(reader, "Unsupported Arrow type");
+        }
+        // Timestamps have at most nanoseconds and a decimal has at most 38 digits
+        if (column->scale < 0 || column->scale > (is_timestamp_render(column->render) ? 9 : 38)) {
+            return reader_error(reader, "Invalid scale in Arrow schema");
+        }
+        column->c_type = decoded_type(column);
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Points an array at its buffers in the body of a record batch and checks that they fit.
+ *
+ * @param buffer_count number of buffers of the array: 0 for null, 1 for a struct, 2 for fixed width
+ *        values and booleans and 3 for variable width values
+ */
+static sf_bool STDCALL bind_array(SF_ARROW_READER *reader, SF_ARROW_ARRAY *array, size_t buffer_count,
+                                  int64 length, const uint8 *nodes, size_t node_count, size_t *node_index,
+                                  const uint8 *buffers, size_t total_buffer_count, size_t *buffer_index,
+                                  const uint8 *body, uint64 body_len) {
+    const uint8 *data[3] = {NULL, NULL, NULL};
+    uint64 data_len[3] = {0, 0, 0};
+    const uint8 *node;
+    const uint8 *buffer;
+    int64 offset;
+    int64 len;
+    int64 value_offset;
+    int64 prev_offset = 0;
+    int64 i;
+    size_t b;
+
+    if (*node_index >= node_count || total_buffer_count - *buffer_index < buffer_count) {
+        return reader_error(reader, "Arrow record batch doesn't match the schema");
+    }
+    node = nodes + *node_index * ARROW_FIELD_NODE_SIZE;
+    (*node_index)++;
+    if (read_int64(node) != length) {
+        return reader_error(reader, "Arrow record batch doesn't match the schema");
+    }
+    array->null_count = read_int64(node + 8);
+    if (array->null_count < 0 || array->null_count > length) {
+        return reader_error(reader, "Invalid Arrow null count");
+    }
+
+    for (b = 0; b < buffer_count; b++) {
+        buffer = buffers + *buffer_index * ARROW_BUFFER_SIZE;
+        (*buffer_index)++;
+        offset = read_int64(buffer);
+        len = read_int64(buffer + 8);
+        if (offset < 0 || len < 0 || (uint64) offset > body_len || (uint64) len > body_len - (uint64) offset) {
+            return reader_error(reader, "Arrow buffer out of the message");
+        }
+        data[b] = body + offset;
+        data_len[b] = (uint64) len;
+    }
+
+    // A validity buffer may be left out when there are no nulls
+    array->validity = NULL;
+    if (buffer_count > 0 && array->null_count > 0) {
+        if (data_len[0] < (uint64) (length + 7) / 8) {
+            return reader_error(reader, "Arrow validity buffer too short");
+        }
+        array->validity = data[0];
+    }
+
+    array->offsets = NULL;
+    array->data = NULL;
+    array->data_len = 0;
+    if (buffer_count == 2) {
+        array->data = data[1];
+        array->data_len = data_len[1];
+        if (array->width > 0 ? data_len[1] / array->width < (uint64) length : data_len[1] < (uint64) (length + 7) / 8) {
+            return reader_error(reader, "Arrow data buffer too short");
+        }
+    } else if (buffer_count == 3) {
+        array->offsets = data[1];
+        array->data = data[2];
+        array->data_len = data_len[2];
+        if (length > 0 && data_len[1] / 4 < (uint64) length + 1) {
+            return reader_error(reader, "Arrow offsets buffer too short");
+        }
+        // Checked once here so the values can be read without checks
+        for (i = 0; i <= length && length > 0; i++) {
+            value_offset = (int32) read_uint32(array->offsets + i * 4);
+            if (value_offset < prev_offset || (uint64) value_offset > array->data_len) {
+                return reader_error(reader, "Invalid Arrow offsets");
+            }
+            prev_offset = value_offset;
+        }
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static size_t STDCALL column_buffer_count(const SF_ARROW_COLUMN *column) {
+    switch (column->render) {
+        case ARROW_RENDER_NULL:
+            return 0;
+        case ARROW_RENDER_TEXT:
+        case ARROW_RENDER_BINARY:
+            return 3;
+        case ARROW_RENDER_TIMESTAMP_STRUCT:
+        case ARROW_RENDER_TIMESTAMP_TZ:
+        case ARROW_RENDER_TIMESTAMP_TZ_STRUCT:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+static sf_bool is_null(const SF_ARROW_ARRAY *array, int64 row) {
+    return array->validity && !((array->validity[row >> 3] >> (row & 7)) & 1);
+}
+
+/**
+ * Magnitude and sign of an integer value
+ */
+static uint64 read_integer(const SF_ARROW_ARRAY *array, int64 row, sf_bool *negative) {
+    const uint8 *p = array->data + row * array->width;
+    int64 value;
+
+    switch (array->width) {
+        case 1:
+            value = array->is_signed ? (int64) (int8_t) *p : (int64) *p;
+            break;
+        case 2:
+            value = array->is_signed ? (int64) (int16_t) read_uint16(p) : (int64) read_uint16(p);
+            break;
+        case 4:
+            value = array->is_signed ? (int64) (int32) read_uint32(p) : (int64) read_uint32(p);
+            break;
+        default:
+            value = read_int64(p);
+            if (!array->is_signed) {
+                *negative = SF_BOOLEAN_FALSE;
+                return (uint64) value;
+            }
+            break;
+    }
+    *negative = value < 0;
+    // Negating in unsigned arithmetic also works for the smallest int64
+    return value < 0 ? 0 - (uint64) value : (uint64) value;
+}
+
+static int64 read_signed(const SF_ARROW_ARRAY *array, int64 row) {
+    sf_bool negative;
+    uint64 magnitude = read_integer(array, row, &negative);
+    return negative ? (int64) (0 - magnitude) : (int64) magnitude;
+}
+
+/**
+ * Writes the digits of a number with the decimal point scale digits from the right, e.g. 12345 with a
+ * scale of 3 is 12.345 and 5 with a scale of 2 is 0.05.
+ *
+ * @param digits digits from the least significant one
+ * @param force_point add ".0" if the scale is 0, for the timestamp types that always have a decimal point
+ * @return length of the text
+ */
+static size_t format_digits(char *out, const char *digits, int digit_count, sf_bool negative, int32 scale,
+                            sf_bool force_point) {
+    char *p = out;
+    int i;
+
+    if (negative) {
+        *p++ = '-';
+    }
+    if (digit_count <= scale) {
+        *p++ = '0';
+    }
+    for (i = digit_count - 1; i >= scale; i--) {
+        *p++ = digits[i];
+    }
+    if (scale > 0) {
+        *p++ = '.';
+        for (i = scale - 1; i >= 0; i--) {
+            *p++ = i < digit_count ? digits[i] : '0';
+        }
+    } else if (force_point) {
+        *p++ = '.';
+        *p++ = '0';
+    }
+    *p = '\0';
+    return (size_t) (p - out);
+}
+
+static size_t format_scaled(char *out, uint64 magnitude, sf_bool negative, int32 scale, sf_bool force_point) {
+    char digits[24];
+    int digit_count = 0;
+
+    do {
+        digits[digit_count++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    return format_digits(out, digits, digit_count, negative, scale, force_point);
+}
+
+static size_t format_decimal128(char *out, const uint8 *p, int32 scale) {
+    uint32 limbs[4];
+    uint64 remainder;
+    char digits[48];
+    int digit_count = 0;
+    sf_bool negative;
+    sf_bool is_zero;
+    int i;
+
+    // Least significant limb first
+    for (i = 0; i < 4; i++) {
+        limbs[i] = read_uint32(p + i * 4);
+    }
+    negative = (limbs[3] & 0x80000000) != 0;
+    if (negative) {
+        // Two's complement
+        for (i = 0; i < 4; i++) {
+            limbs[i] = ~limbs[i];
+        }
+        for (i = 0; i < 4 && ++limbs[i] == 0; i++) {
+        }
+    }
+
+    do {
+        remainder = 0;
+        is_zero = SF_BOOLEAN_TRUE;
+        for (i = 3; i >= 0; i--) {
+            remainder = (remainder << 32) | limbs[i];
+            limbs[i] = (uint32) (remainder / 10);
+            remainder %= 10;
+            is_zero = is_zero && limbs[i] == 0;
+        }
+        digits[digit_count++] = (char) ('0' + remainder);
+    } while (!is_zero);
+    return format_digits(out, digits, digit_count, negative, scale, SF_BOOLEAN_FALSE);
+}
+
+/**
+ * Seconds since the epoch and nanoseconds as a decimal number with scale digits, the way the JSON rowset
+ * has it. The nanoseconds are always positive, so 1.9 seconds before the epoch is -2 seconds and 0.1.
+ */
+static size_t format_epoch_fraction(char *out, int64 epoch, int64 fraction, int32 scale) {
+    uint64 seconds;
+    uint64 units;
+    char *p = out;
+    int32 i;
+
+    if (epoch < 0 && fraction > 0) {
+        seconds = 0 - (uint64) (epoch + 1);
+        fraction = 1000000000 - fraction;
+    } else {
+        seconds = epoch < 0 ? 0 - (uint64) epoch : (uint64) epoch;
+    }
+    units = (uint64) fraction / pow10_uint64[9 - scale];
+    if (epoch < 0) {
+        *p++ = '-';
+    }
+    p += format_scaled(p, seconds, SF_BOOLEAN_FALSE, 0, SF_BOOLEAN_FALSE);
+    *p++ = '.';
+    if (scale == 0) {
+        *p++ = '0';
+    }
+    for (i = scale - 1; i >= 0; i--) {
+        p[i] = (char) ('0' + units % 10);
+        units /= 10;
+    }
+    p += scale;
+    *p = '\0';
+    return (size_t) (p - out);
+}
+
+static size_t format_real(char *out, size_t size, double value) {
+    int precision;
+    int len = 0;
+
+    if (isnan(value)) {
+        return (size_t) sb_sprintf(out, size, "NaN");
+    }
+    if (isinf(value)) {
+        return (size_t) sb_sprintf(out, size, value > 0 ? "inf" : "-inf");
+    }
+    // Shortest text that reads back as the same value
+    for (precision = 15; precision <= 17; precision++) {
+        len = sb_sprintf(out, size, "%.*g", precision, value);
+        if (strtod(out, NULL) == value) {
+            break;
+        }
+    }
+    return (size_t) len;
+}
+
+static sf_bool STDCALL add_cell(SF_ARROW_READER *reader, SF_ROWSET_CELL_TYPE type, const char *value, size_t len) {
+    if (!reader->sink.add_cell(reader->sink.ctx, type, value, len)) {
+        return reader_error(reader, "Unable to add cell");
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL render_cell(SF_ARROW_READER *reader, const SF_ARROW_COLUMN *column, int64 row) {
+    const SF_ARROW_ARRAY *array = &column->array;
+    static const char hex_digits[] = "0123456789ABCDEF";
+    char *out = reader->value;
+    size_t len = 0;
+    uint64 magnitude;
+    sf_bool negative;
+    int64 start;
+    int64 end;
+    int64 value;
+    int64 i;
+    int c;
+    double real;
+    float real32;
+
+    if (column->render == ARROW_RENDER_NULL || is_null(array, row)) {
+        return add_cell(reader, SF_ROWSET_CELL_NULL, "", 0);
+    }
+    for (c = 0; c < column->child_count; c++) {
+        if (is_null(&column->children[c], row)) {
+            return add_cell(reader, SF_ROWSET_CELL_NULL, "", 0);
+        }
+    }
+
+    switch (column->render) {
+        case ARROW_RENDER_FIXED:
+            magnitude = read_integer(array, row, &negative);
+            len = format_scaled(out, magnitude, negative, column->scale, SF_BOOLEAN_FALSE);
+            break;
+        case ARROW_RENDER_TIMESTAMP:
+            magnitude = read_integer(array, row, &negative);
+            len = format_scaled(out, magnitude, negative, column->scale, SF_BOOLEAN_TRUE);
+            break;
+        case ARROW_RENDER_DECIMAL:
+            len = format_decimal128(out, array->data + row * 16, column->scale);
+            break;
+        case ARROW_RENDER_REAL:
+            if (array->width == 4) {
+                memcpy(&real32, array->data + row * 4, sizeof(real32));
+                real = real32;
+            } else {
+                memcpy(&real, array->data + row * 8, sizeof(real));
+            }
+            len = format_real(out, reader->value_size, real);
+            break;
+        case ARROW_RENDER_TEXT:
+            // Read in place
+            start = (int32) read_uint32(array->offsets + row * 4);
+            end = (int32) read_uint32(array->offsets + (row + 1) * 4);
+            return add_cell(reader, SF_ROWSET_CELL_STRING, (const char *) array->data + start, (size_t) (end - start));
+        case ARROW_RENDER_BINARY:
+            start = (int32) read_uint32(array->offsets + row * 4);
+            end = (int32) read_uint32(array->offsets + (row + 1) * 4);
+            if (!reserve_value(reader, (size_t) (end - start) * 2 + 1)) {
+                return SF_BOOLEAN_FALSE;
+            }
+            out = reader->value;
+            for (i = start; i < end; i++) {
+                out[len++] = hex_digits[array->data[i] >> 4];
+                out[len++] = hex_digits[array->data[i] & 0x0F];
+            }
+            out[len] = '\0';
+            break;
+        case ARROW_RENDER_BOOLEAN:
+            out[0] = (array->data[row >> 3] >> (row & 7)) & 1 ? '1' : '0';
+            out[1] = '\0';
+            len = 1;
+            break;
+        case ARROW_RENDER_DATE:
+            magnitude = read_integer(array, row, &negative);
+            len = format_scaled(out, magnitude, negative, 0, SF_BOOLEAN_FALSE);
+            break;
+        case ARROW_RENDER_DATE_MILLIS:
+            value = read_signed(array, row);
+            // Round down to the day
+            value = value / 86400000 - (value % 86400000 < 0 ? 1 : 0);
+            len = format_scaled(out, value < 0 ? 0 - (uint64) value : (uint64) value, value < 0, 0, SF_BOOLEAN_FALSE);
+            break;
+        case ARROW_RENDER_TIMESTAMP_STRUCT:
+        case ARROW_RENDER_TIMESTAMP_TZ_STRUCT:
+            value = read_signed(&column->children[1], row);
+            if (value < 0 || value > 999999999) {
+                return reader_error(reader, "Invalid fraction of a second in Arrow timestamp");
+            }
+            len = format_epoch_fraction(out, read_signed(&column->children[0], row), value, column->scale);
+            break;
+        case ARROW_RENDER_TIMESTAMP_TZ:
+            magnitude = read_integer(&column->children[0], row, &negative);
+            len = format_scaled(out, magnitude, negative, column->scale, SF_BOOLEAN_TRUE);
+            break;
+        default:
+            return reader_error(reader, "Unsupported Arrow type");
+    }
+
+    // The timezone follows the timestamp, as the offset in minutes plus 1440
+    if (column->render == ARROW_RENDER_TIMESTAMP_TZ || column->render == ARROW_RENDER_TIMESTAMP_TZ_STRUCT) {
+        out[len++] = ' ';
+        magnitude = read_integer(&column->children[column->child_count - 1], row, &negative);
+        len += format_scaled(out + len, magnitude, negative, 0, SF_BOOLEAN_FALSE);
+    }
+    return add_cell(reader, SF_ROWSET_CELL_STRING, out, len);
+}
+
+/**
+ * Native value of a cell of a column with a c_type, the same rowset_decode parses from the rendered text
+ *
+ * @return SF_BOOLEAN_FALSE for a null cell or a value that only the text has, e.g. an integer beyond int64
+ */
+static sf_bool STDCALL decode_cell(const SF_ARROW_COLUMN *column, int64 row, SF_ROWSET_VALUE *value) {
+    const SF_ARROW_ARRAY *array = &column->array;
+    uint64 magnitude;
+    sf_bool negative;
+    float real32;
+
+    if (is_null(array, row)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    switch (column->render) {
+        case ARROW_RENDER_FIXED:
+            magnitude = read_integer(array, row, &negative);
+            if (column->scale > 0) {
+                return sf_scaled_to_float64(magnitude, negative, column->scale, &value->float64_value);
+            }
+            if (magnitude > (uint64) SF_INT64_MAX + (negative ? 1 : 0)) {
+                return SF_BOOLEAN_FALSE;
+            }
+            value->int64_value = negative ? (int64) (0 - magnitude) : (int64) magnitude;
+            return SF_BOOLEAN_TRUE;
+        case ARROW_RENDER_REAL:
+            if (array->width == 4) {
+                memcpy(&real32, array->data + row * 4, sizeof(real32));
+                value->float64_value = real32;
+            } else {
+                memcpy(&value->float64_value, array->data + row * 8, sizeof(value->float64_value));
+            }
+            // Infinity is out of range for the accessors
+            return !isinf(value->float64_value);
+        case ARROW_RENDER_BOOLEAN:
+            value->int64_value = (array->data[row >> 3] >> (row & 7)) & 1;
+            return SF_BOOLEAN_TRUE;
+        default:
+            return SF_BOOLEAN_FALSE;
+    }
+}
+
+static sf_bool STDCALL read_record_batch(SF_ARROW_READER *reader, const FB_TABLE *batch, const uint8 *body,
+                                         uint64 body_len) {
+    const uint8 *nodes;
+    const uint8 *buffers;
+    size_t node_count;
+    size_t buffer_count;
+    size_t node_index = 0;
+    size_t buffer_index = 0;
+    SF_ARROW_COLUMN *column;
+    SF_ROWSET_VALUE value;
+    int64 length;
+    int64 row;
+    size_t i;
+    int c;
+
+    if (!reader->columns) {
+        return reader_error(reader, "Arrow record batch before the schema");
+    }
+    length = fb_int(batch, 0, 8, 0);
+    if (length < 0 ||
+        !fb_vector(batch, 1, ARROW_FIELD_NODE_SIZE, &nodes, &node_count) ||
+        !fb_vector(batch, 2, ARROW_BUFFER_SIZE, &buffers, &buffer_count)) {
+        return reader_error(reader, "Invalid Arrow record batch");
+    }
+    if (fb_field(batch, 3, 4) != 0) {
+        return reader_error(reader, "Compressed Arrow record batches are not supported");
+    }
+
+    // The arrays of the columns and their children are in depth first order
+    for (i = 0; i < reader->column_count; i++) {
+        column = &reader->columns[i];
+        if (!bind_array(reader, &column->array, column_buffer_count(column), length, nodes, node_count,
+                        &node_index, buffers, buffer_count, &buffer_index, body, body_len)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        for (c = 0; c < column->child_count; c++) {
+            if (!bind_array(reader, &column->children[c], 2, length, nodes, node_count, &node_index,
+                            buffers, buffer_count, &buffer_index, body, body_len)) {
+                return SF_BOOLEAN_FALSE;
+            }
+        }
+    }
+    if (node_index != node_count || buffer_index != buffer_count) {
+        return reader_error(reader, "Arrow record batch doesn't match the schema");
+    }
+
+    for (row = 0; row < length; row++) {
+        if (!reader->sink.begin_row(reader->sink.ctx)) {
+            return reader_error(reader, "Unable to add row");
+        }
+        for (i = 0; i < reader->column_count; i++) {
+            column = &reader->columns[i];
+            if (!render_cell(reader, column, row)) {
+                return SF_BOOLEAN_FALSE;
+            }
+            if (reader->sink.add_decoded && column->c_type != SF_C_TYPE_NULL) {
+                reader->sink.add_decoded(reader->sink.ctx, i, column->c_type,
+                                         decode_cell(column, row, &value) ? &value : NULL);
+            }
+        }
+        if (!reader->sink.end_row(reader->sink.ctx)) {
+            return reader_error(reader, "Unable to add row");
+        }
+        reader->row_count++;
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL read_message(SF_ARROW_READER *reader, const uint8 *data, const SF_ARROW_MESSAGE *message) {
+    FB_TABLE table;
+    FB_TABLE header;
+
+    if (message->metadata_len == 0) {
+        reader->is_ended = SF_BOOLEAN_TRUE;
+        return SF_BOOLEAN_TRUE;
+    }
+    if (!fb_root(message->metadata, message->metadata_len, &table) || !fb_sub_table(&table, 2, &header)) {
+        return reader_error(reader, "Invalid Arrow message");
+    }
+    switch (fb_int(&table, 1, 1, 0)) {
+        case ARROW_HEADER_SCHEMA:
+            return read_schema(reader, &header);
+        case ARROW_HEADER_RECORD_BATCH:
+            return read_record_batch(reader, &header, data + message->size - message->body_len, message->body_len);
+        case ARROW_HEADER_DICTIONARY_BATCH:
+            return reader_error(reader, "Dictionary encoded Arrow columns are not supported");
+        default:
+            return reader_error(reader, "Unsupported Arrow message");
+    }
+}
+
+static sf_bool STDCALL buffer_append(SF_ARROW_READER *reader, const uint8 *data, size_t len) {
+    size_t size = reader->buffer_size < ARROW_MIN_BUFFER_SIZE ? ARROW_MIN_BUFFER_SIZE : reader->buffer_size;
+    char *buffer;
+
+    if (reader->buffer_len + len > reader->buffer_size) {
+        while (size < reader->buffer_len + len) {
+            size *= 2;
+        }
+        buffer = (char *) SF_REALLOC(reader->buffer, size);
+        if (!buffer) {
+            return reader_error(reader, "Out of memory reading Arrow stream");
+        }
+        reader->buffer = buffer;
+        reader->buffer_size = size;
+    }
+    memcpy(reader->buffer + reader->buffer_len, data, len);
+    reader->buffer_len += len;
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL arrow_reader_init(SF_ARROW_READER *reader, const SF_ROWSET_SINK *sink) {
+    memset(reader, 0, sizeof(SF_ARROW_READER));
+    reader->sink = *sink;
+}
+
+sf_bool STDCALL arrow_reader_feed(SF_ARROW_READER *reader, const char *data, size_t len) {
+    const uint8 *input = (const uint8 *) data;
+    SF_ARROW_MESSAGE message;
+    size_t needed;
+    int status;
+
+    if (reader->error_msg) {
+        return SF_BOOLEAN_FALSE;
+    }
+    reader->bytes_read += len;
+
+    while (1) {
+        if (reader->buffer_len > 0) {
+            // Complete the buffered message. message.size never goes past its end
+            status = read_message_header(reader, (const uint8 *) reader->buffer, reader->buffer_len, &message);
+            if (status < 0) {
+                return SF_BOOLEAN_FALSE;
+            }
+            if (status > 0) {
+                if (!read_message(reader, (const uint8 *) reader->buffer, &message)) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                reader->buffer_len = 0;
+                continue;
+            }
+            if (len == 0) {
+                break;
+            }
+            needed = message.size - reader->buffer_len;
+            if (needed > len) {
+                needed = len;
+            }
+            if (!buffer_append(reader, input, needed)) {
+                return SF_BOOLEAN_FALSE;
+            }
+            input += needed;
+            len -= needed;
+            continue;
+        }
+
+        if (len == 0) {
+            break;
+        }
+        if (reader->is_ended) {
+            return reader_error(reader, "Data after the end of the Arrow stream");
+        }
+        // Read whole messages in place and only buffer a message split across calls
+        status = read_message_header(reader, input, len, &message);
+        if (status < 0) {
+            return SF_BOOLEAN_FALSE;
+        }
+        if (status == 0) {
+            if (!buffer_append(reader, input, len)) {
+                return SF_BOOLEAN_FALSE;
+            }
+            break;
+        }
+        if (!read_message(reader, input, &message)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        input += message.size;
+        len -= message.size;
+    }
+
+    return SF_BOOLEAN_TRUE;
+}
+
+sf_bool STDCALL arrow_reader_finish(SF_ARROW_READER *reader) {
+    if (reader->error_msg) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (reader->buffer_len > 0) {
+        return reader_error(reader, "Unexpected end of Arrow stream");
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL arrow_reader_reset(SF_ARROW_READER *reader) {
+    reader->buffer_len = 0;
+    SF_FREE(reader->columns);
+    reader->column_count = 0;
+    reader->is_ended = SF_BOOLEAN_FALSE;
+    reader->row_count = 0;
+    reader->bytes_read = 0;
+    reader->error_msg = NULL;
+    if (reader->sink.reset) {
+        reader->sink.reset(reader->sink.ctx);
+    }
+}
+
+void STDCALL arrow_reader_term(SF_ARROW_READER *reader) {
+    SF_FREE(reader->buffer);
+    SF_FREE(reader->columns);
+    SF_FREE(reader->value);
+    reader->buffer_len = 0;
+    reader->buffer_size = 0;
+    reader->column_count = 0;
+    reader->value_size = 0;
+}
+
+SF_ROWSET *STDCALL rowset_from_arrow_base64(const char *text, size_t len, const char **error_msg) {
+    SF_ROWSET *rowset = rowset_init();
+    SF_ROWSET_SINK sink;
+    SF_ARROW_READER reader;
+    char *data = (char *) SF_MALLOC(sf_base64_decoded_size(len) + 1);
+    size_t data_len = 0;
+    const char *msg = NULL;
+
+    if (!rowset || !data) {
+        goto error;
+    }
+    if (!sf_base64_decode(text, len, data, &data_len)) {
+        msg = "Invalid base64 in Arrow rowset";
+        goto error;
+    }
+
+    rowset_init_sink(rowset, &sink);
+    arrow_reader_init(&reader, &sink);
+    if (!arrow_reader_feed(&reader, data, data_len) || !arrow_reader_finish(&reader)) {
+        msg = reader.error_msg;
+        arrow_reader_term(&reader);
+        goto error;
+    }
+    arrow_reader_term(&reader);
+    SF_FREE(data);
+    rowset_trim(rowset);
+    return rowset;
+
+error:
+    SF_FREE(data);
+    rowset_term(rowset);
+    if (error_msg) {
+        *error_msg = msg;
+    }
+    return NULL;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_ARROW_READER_H
+#define SNOWFLAKE_ARROW_READER_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+#include "rowset_parser.h"
+#include "rowset.h"
+
+// Struct columns have at most this many children, e.g. epoch, fraction and timezone
+#define SF_ARROW_MAX_CHILDREN 3
+
+/**
+ * How the values of a column are turned into the same text the JSON rowset has
+ */
+typedef enum SF_ARROW_RENDER {
+    // Integer with the decimal point scale digits from the right
+    ARROW_RENDER_FIXED,
+    // 128 bit decimal with the decimal point scale digits from the right
+    ARROW_RENDER_DECIMAL,
+    ARROW_RENDER_REAL,
+    ARROW_RENDER_TEXT,
+    // Upper case hex
+    ARROW_RENDER_BINARY,
+    // 1 or 0
+    ARROW_RENDER_BOOLEAN,
+    // Days since the epoch
+    ARROW_RENDER_DATE,
+    ARROW_RENDER_DATE_MILLIS,
+    // Scaled seconds since the epoch or midnight. Always has a decimal point.
+    ARROW_RENDER_TIMESTAMP,
+    // Struct of the seconds since the epoch and the nanoseconds
+    ARROW_RENDER_TIMESTAMP_STRUCT,
+    // Struct of the scaled seconds since the epoch and the timezone
+    ARROW_RENDER_TIMESTAMP_TZ,
+    // Struct of the seconds since the epoch, the nanoseconds and the timezone
+    ARROW_RENDER_TIMESTAMP_TZ_STRUCT,
+    ARROW_RENDER_NULL
+} SF_ARROW_RENDER;
+
+/**
+ * Array of a record batch. The buffers point into the message being read.
+ */
+typedef struct SF_ARROW_ARRAY {
+    // Bytes per value of fixed width types, 0 otherwise
+    uint32 width;
+    sf_bool is_signed;
+    int64 null_count;
+    // NULL if the array has no nulls
+    const uint8 *validity;
+    // Offsets of the values of variable width types
+    const uint8 *offsets;
+    const uint8 *data;
+    uint64 data_len;
+} SF_ARROW_ARRAY;
+
+typedef struct SF_ARROW_COLUMN {
+    SF_ARROW_RENDER render;
+    // Native type the values are passed to the sink as besides the text, SF_C_TYPE_NULL if none
+    SF_C_TYPE c_type;
+    int32 scale;
+    // Arrow type of the field
+    uint8 type;
+    SF_ARROW_ARRAY array;
+    SF_ARROW_ARRAY children[SF_ARROW_MAX_CHILDREN];
+    int child_count;
+} SF_ARROW_COLUMN;
+
+/**
+ * Incremental reader of an Arrow IPC stream, e.g. a result chunk in the Arrow format. The record batches
+ * are passed to the sink row by row, with each value rendered as the text the JSON rowset would have, so
+ * the rows of both formats are read the same way. Numbers and booleans are also passed as native values
+ * if the sink takes them, so they aren't parsed back from the text. The input can be split at any byte.
+ */
+typedef struct SF_ARROW_READER {
+    SF_ROWSET_SINK sink;
+
+    // Part of a message received so far. Whole messages are read in place when the input has them.
+    char *buffer;
+    size_t buffer_len;
+    size_t buffer_size;
+
+    // Columns of the schema. NULL until the schema message was read
+    SF_ARROW_COLUMN *columns;
+    size_t column_count;
+    sf_bool is_ended;
+
+    // Rendered value of the current cell. Reused from cell to cell
+    char *value;
+    size_t value_size;
+
+    int64 row_count;
+    uint64 bytes_read;
+    // Static message, NULL unless reading failed
+    const char *error_msg;
+} SF_ARROW_READER;
+
+void STDCALL arrow_reader_init(SF_ARROW_READER *reader, const SF_ROWSET_SINK *sink);
+
+/**
+ * Reads the next part of the stream and passes the rows of all the completed record batches to the sink.
+ *
+ * @return SF_BOOLEAN_FALSE if the stream is malformed, uses an unsupported type or the sink failed.
+ *         See error_msg.
+ */
+sf_bool STDCALL arrow_reader_feed(SF_ARROW_READER *reader, const char *data, size_t len);
+
+/**
+ * Checks that the stream ended after a complete message.
+ */
+sf_bool STDCALL arrow_reader_finish(SF_ARROW_READER *reader);
+
+/**
+ * Starts over with a new stream and resets the sink.
+ */
+void STDCALL arrow_reader_reset(SF_ARROW_READER *reader);
+
+void STDCALL arrow_reader_term(SF_ARROW_READER *reader);
+
+/**
+ * Decodes a base64 encoded Arrow stream, e.g. the rowsetBase64 of a query response
+ *
+ * @param text base64 text
+ * @param len length of the text
+ * @param error_msg static message if the stream couldn't be read, NULL if we ran out of memory. Optional
+ * @return rowset or NULL if the stream is malformed or out of memory
+ */
+SF_ROWSET *STDCALL rowset_from_arrow_base64(const char *text, size_t len, const char **error_msg);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_ARROW_READER_H
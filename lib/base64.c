@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include "base64.h"
+
+// Value of each base64 character, 0xFF for anything else including '='
+static const uint8 base64_values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 62,   0xFF, 0xFF, 0xFF, 63,
+    52,   53,   54,   55,   56,   57,   58,   59,   60,   61,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    10,   11,   12,   13,   14,
+    15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
+    41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+static const char base64_chars[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t STDCALL sf_base64_decoded_size(size_t src_len) {
+    return (src_len + 3) / 4 * 3;
+}
+
+sf_bool STDCALL sf_base64_decode(const char *src, size_t src_len, char *dst, size_t *dst_len) {
+    const uint8 *in = (const uint8 *) src;
+    uint8 *out = (uint8 *) dst;
+    size_t padding = 0;
+    size_t full_len;
+    size_t i;
+    uint32 a, b, c, d;
+
+    if (src_len % 4 != 0) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (src_len > 0 && in[src_len - 1] == '=') {
+        padding = in[src_len - 2] == '=' ? 2 : 1;
+    }
+    // Groups of four characters without padding
+    full_len = padding > 0 ? src_len - 4 : src_len;
+
+    for (i = 0; i < full_len; i += 4) {
+        a = base64_values[in[i]];
+        b = base64_values[in[i + 1]];
+        c = base64_values[in[i + 2]];
+        d = base64_values[in[i + 3]];
+        // Only valid characters are below 64
+        if (((a | b | c | d) & 0xC0) != 0) {
+            return SF_BOOLEAN_FALSE;
+        }
+        a = a << 18 | b << 12 | c << 6 | d;
+        *out++ = (uint8) (a >> 16);
+        *out++ = (uint8) (a >> 8);
+        *out++ = (uint8) a;
+    }
+
+    if (padding > 0) {
+        a = base64_values[in[i]];
+        b = base64_values[in[i + 1]];
+        c = padding == 1 ? base64_values[in[i + 2]] : 0;
+        if (((a | b | c) & 0xC0) != 0) {
+            return SF_BOOLEAN_FALSE;
+        }
+        a = a << 18 | b << 12 | c << 6;
+        *out++ = (uint8) (a >> 16);
+        if (padding == 1) {
+            *out++ = (uint8) (a >> 8);
+        }
+    }
+
+    *dst_len = (size_t) (out - (uint8 *) dst);
+    return SF_BOOLEAN_TRUE;
+}
+
+size_t STDCALL sf_base64_encoded_size(size_t src_len) {
+    return (src_len + 2) / 3 * 4;
+}
+
+size_t STDCALL sf_base64_encode(const char *src, size_t src_len, char *dst) {
+    const uint8 *in = (const uint8 *) src;
+    char *out = dst;
+    size_t i;
+    uint32 a;
+
+    for (i = 0; i + 3 <= src_len; i += 3) {
+        a = (uint32) in[i] << 16 | (uint32) in[i + 1] << 8 | in[i + 2];
+        *out++ = base64_chars[a >> 18];
+        *out++ = base64_chars[(a >> 12) & 0x3F];
+        *out++ = base64_chars[(a >> 6) & 0x3F];
+        *out++ = base64_chars[a & 0x3F];
+    }
+
+    // One or two bytes left, padded to four characters
+    if (i < src_len) {
+        a = (uint32) in[i] << 16 | (i + 1 < src_len ? (uint32) in[i + 1] << 8 : 0);
+        *out++ = base64_chars[a >> 18];
+        *out++ = base64_chars[(a >> 12) & 0x3F];
+        *out++ = i + 1 < src_len ? base64_chars[(a >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+
+    *out = '\0';
+    return (size_t) (out - dst);
+}
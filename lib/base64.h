@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_BASE64_H
+#define SNOWFLAKE_BASE64_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+
+/**
+ * Upper bound of the number of bytes decoded from src_len characters of base64
+ */
+size_t STDCALL sf_base64_decoded_size(size_t src_len);
+
+/**
+ * Decodes standard base64 with padding.
+ *
+ * @param src base64 text
+ * @param src_len length of the text
+ * @param dst buffer of at least sf_base64_decoded_size(src_len) bytes
+ * @param dst_len number of bytes decoded
+ * @return SF_BOOLEAN_FALSE if the text is not valid base64
+ */
+sf_bool STDCALL sf_base64_decode(const char *src, size_t src_len, char *dst, size_t *dst_len);
+
+/**
+ * Number of characters, without a NUL, that src_len bytes are encoded to
+ */
+size_t STDCALL sf_base64_encoded_size(size_t src_len);
+
+/**
+ * Encodes bytes as standard base64 with padding, followed by a NUL.
+ *
+ * @param src bytes to encode
+ * @param src_len number of bytes
+ * @param dst buffer of at least sf_base64_encoded_size(src_len) + 1 bytes
+ * @return length of the text
+ */
+size_t STDCALL sf_base64_encode(const char *src, size_t src_len, char *dst);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_BASE64_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <limits.h>
+#include <string.h>
+#include "calendar.h"
+
+// Days from 0000-03-01 to 1970-01-01. Years are counted from March, so that February 29 is the last day.
+#define CALENDAR_EPOCH_OFFSET 719468
+#define CALENDAR_DAYS_PER_ERA 146097
+
+const char SF_DIGIT_PAIRS[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static int64 STDCALL floor_div(int64 value, int64 divisor) {
+    int64 quotient = value / divisor;
+    return (value % divisor < 0) ? quotient - 1 : quotient;
+}
+
+int64 STDCALL sf_days_from_civil(int64 year, int32 month, int32 day) {
+    int64 era;
+    int64 year_of_era;
+    int64 day_of_year;
+    int64 day_of_era;
+
+    year -= month <= 2;
+    era = floor_div(year, 400);
+    year_of_era = year - era * 400;
+    day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    return era * CALENDAR_DAYS_PER_ERA + day_of_era - CALENDAR_EPOCH_OFFSET;
+}
+
+void STDCALL sf_civil_from_days(int64 days, int64 *year, int32 *month, int32 *day) {
+    int64 era;
+    int64 day_of_era;
+    int64 year_of_era;
+    int64 day_of_year;
+    int64 month_index;
+
+    days += CALENDAR_EPOCH_OFFSET;
+    era = floor_div(days, CALENDAR_DAYS_PER_ERA);
+    day_of_era = days - era * CALENDAR_DAYS_PER_ERA;
+    year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+    day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+    month_index = (5 * day_of_year + 2) / 153;
+    *day = (int32) (day_of_year - (153 * month_index + 2) / 5 + 1);
+    *month = (int32) (month_index < 10 ? month_index + 3 : month_index - 9);
+    // January and February belong to the next year
+    *year = year_of_era + era * 400 + (*month <= 2);
+}
+
+sf_bool STDCALL sf_is_leap_year(int64 year) {
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+int32 STDCALL sf_days_in_month(int64 year, int32 month) {
+    static const int32 DAYS[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return DAYS[month - 1] + (month == 2 && sf_is_leap_year(year));
+}
+
+int32 STDCALL sf_weekday_from_days(int64 days) {
+    // 1970-01-01 was a Thursday
+    return (int32) ((days % 7 + 11) % 7);
+}
+
+sf_bool STDCALL sf_seconds_to_tm(int64 seconds, struct tm *tm_obj) {
+    int64 days = floor_div(seconds, SF_SECONDS_PER_DAY);
+    int64 second_of_day = seconds - days * SF_SECONDS_PER_DAY;
+    int64 year;
+    int32 month;
+    int32 day;
+
+    sf_civil_from_days(days, &year, &month, &day);
+    if (year - 1900 > INT_MAX || year - 1900 < INT_MIN) {
+        return SF_BOOLEAN_FALSE;
+    }
+    tm_obj->tm_year = (int) (year - 1900);
+    tm_obj->tm_mon = month - 1;
+    tm_obj->tm_mday = day;
+    tm_obj->tm_hour = (int) (second_of_day / 3600);
+    tm_obj->tm_min = (int) (second_of_day / 60 % 60);
+    tm_obj->tm_sec = (int) (second_of_day % 60);
+    tm_obj->tm_wday = sf_weekday_from_days(days);
+    tm_obj->tm_yday = (int) (days - sf_days_from_civil(year, 1, 1));
+    tm_obj->tm_isdst = 0;
+    return SF_BOOLEAN_TRUE;
+}
+
+static void STDCALL write_pair(char *buffer, int value) {
+    memcpy(buffer, &SF_DIGIT_PAIRS[value * 2], 2);
+}
+
+/**
+ * Whether the fields print as the fixed width layout, i.e. strftime would pad them to the same digits
+ */
+static sf_bool STDCALL is_plain_date(const struct tm *tm_obj) {
+    return tm_obj->tm_year >= 1000 - 1900 && tm_obj->tm_year <= 9999 - 1900 &&
+           tm_obj->tm_mon >= 0 && tm_obj->tm_mon <= 98 && tm_obj->tm_mday >= 0 && tm_obj->tm_mday <= 99;
+}
+
+static sf_bool STDCALL is_plain_time(const struct tm *tm_obj) {
+    return tm_obj->tm_hour >= 0 && tm_obj->tm_hour <= 99 && tm_obj->tm_min >= 0 && tm_obj->tm_min <= 99 &&
+           tm_obj->tm_sec >= 0 && tm_obj->tm_sec <= 99;
+}
+
+static void STDCALL write_date(char *buffer, const struct tm *tm_obj) {
+    int year = tm_obj->tm_year + 1900;
+
+    write_pair(buffer, year / 100);
+    write_pair(buffer + 2, year % 100);
+    buffer[4] = '-';
+    write_pair(buffer + 5, tm_obj->tm_mon + 1);
+    buffer[7] = '-';
+    write_pair(buffer + 8, tm_obj->tm_mday);
+}
+
+static void STDCALL write_time(char *buffer, const struct tm *tm_obj) {
+    write_pair(buffer, tm_obj->tm_hour);
+    buffer[2] = ':';
+    write_pair(buffer + 3, tm_obj->tm_min);
+    buffer[5] = ':';
+    write_pair(buffer + 6, tm_obj->tm_sec);
+}
+
+size_t STDCALL sf_format_date(char *buffer, size_t size, const struct tm *tm_obj) {
+    if (!is_plain_date(tm_obj)) {
+        return strftime(buffer, size, "%Y-%m-%d", tm_obj);
+    }
+    if (size < 11) {
+        return 0;
+    }
+    write_date(buffer, tm_obj);
+    buffer[10] = '\0';
+    return 10;
+}
+
+size_t STDCALL sf_format_time(char *buffer, size_t size, const struct tm *tm_obj) {
+    if (!is_plain_time(tm_obj)) {
+        return strftime(buffer, size, "%H:%M:%S", tm_obj);
+    }
+    if (size < 9) {
+        return 0;
+    }
+    write_time(buffer, tm_obj);
+    buffer[8] = '\0';
+    return 8;
+}
+
+size_t STDCALL sf_format_date_time(char *buffer, size_t size, const struct tm *tm_obj) {
+    if (!is_plain_date(tm_obj) || !is_plain_time(tm_obj)) {
+        return strftime(buffer, size, "%Y-%m-%d %H:%M:%S", tm_obj);
+    }
+    if (size < 20) {
+        return 0;
+    }
+    write_date(buffer, tm_obj);
+    buffer[10] = ' ';
+    write_time(buffer + 11, tm_obj);
+    buffer[19] = '\0';
+    return 19;
+}
+
+size_t STDCALL sf_format_fraction(char *buffer, int64 value, int32 digits) {
+    int32 i = digits;
+
+    buffer[digits] = '\0';
+    // Two digits per division
+    while (i >= 2) {
+        i -= 2;
+        write_pair(buffer + i, (int) (value % 100));
+        value /= 100;
+    }
+    if (i == 1) {
+        buffer[0] = (char) ('0' + value % 10);
+    }
+    return (size_t) digits;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_CALENDAR_H
+#define SNOWFLAKE_CALENDAR_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <time.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+
+#define SF_SECONDS_PER_DAY 86400
+
+// "00" to "99" back to back, to write two digits at once
+extern const char SF_DIGIT_PAIRS[201];
+
+/*
+ * Dates in the proleptic Gregorian calendar as days since 1970-01-01, converted with integer arithmetic only,
+ * so unlike gmtime there is no libc call, lock or range limit of time_t in between.
+ */
+int64 STDCALL sf_days_from_civil(int64 year, int32 month, int32 day);
+
+void STDCALL sf_civil_from_days(int64 days, int64 *year, int32 *month, int32 *day);
+
+sf_bool STDCALL sf_is_leap_year(int64 year);
+
+int32 STDCALL sf_days_in_month(int64 year, int32 month);
+
+/**
+ * @return 0 for Sunday to 6 for Saturday
+ */
+int32 STDCALL sf_weekday_from_days(int64 days);
+
+/**
+ * Breaks seconds since the epoch down into a UTC struct tm like gmtime_r does, without the time zone fields
+ *
+ * @return SF_BOOLEAN_FALSE if the year doesn't fit into tm_year
+ */
+sf_bool STDCALL sf_seconds_to_tm(int64 seconds, struct tm *tm_obj);
+
+/*
+ * Format a struct tm the way strftime does with "%Y-%m-%d", "%H:%M:%S" and "%Y-%m-%d %H:%M:%S". Years of four
+ * digits and fields in their usual ranges are written from a table of digit pairs. Anything else goes to
+ * strftime, which formats it the way the platform does.
+ *
+ * @return number of characters written before the NUL, 0 if the buffer is too small
+ */
+size_t STDCALL sf_format_date(char *buffer, size_t size, const struct tm *tm_obj);
+size_t STDCALL sf_format_time(char *buffer, size_t size, const struct tm *tm_obj);
+size_t STDCALL sf_format_date_time(char *buffer, size_t size, const struct tm *tm_obj);
+
+/**
+ * Writes value with exactly digits digits, zero padded on the left, and a NUL. Value must be less than
+ * 10^digits.
+ *
+ * @return digits
+ */
+size_t STDCALL sf_format_fraction(char *buffer, int64 value, int32 digits);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_CALENDAR_H
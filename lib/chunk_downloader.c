@@ -3,16 +3,64 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <zlib.h>
 #include "chunk_downloader.h"
 #include "memory.h"
 #include "connection.h"
 #include "error.h"
 #include "client_int.h"
+#include "constants.h"
 
-static void* chunk_downloader_thread(void *downloader);
+static void* chunk_downloader_thread(void *worker);
 static void STDCALL set_shutdown(SF_CHUNK_DOWNLOADER *chunk_downloader, sf_bool value);
 static void STDCALL set_error(SF_CHUNK_DOWNLOADER *chunk_downloader, sf_bool value);
+static sf_bool STDCALL start_worker(SF_CHUNK_DOWNLOADER *chunk_downloader);
+static void STDCALL adjust_schedule(SF_CHUNK_DOWNLOADER *chunk_downloader);
+
+// Weight of a new sample in the scheduler moving averages is 1/4
+#define CHUNK_EWMA(avg, sample) ((avg) == 0 ? (sample) : ((avg) * 3 + (sample)) / 4)
+
+// Number of downloaded chunks after which the scheduler retries a thread count that did not pay off
+#define CHUNK_SCHEDULER_PROBE_INTERVAL 32
+
+// Footprint per byte of uncompressedSize assumed until the first chunk is parsed, in 1/256 units.
+// Short cells take more room in the rowset than in the JSON text because of their fixed size entries.
+#define CHUNK_DEFAULT_FOOTPRINT_RATIO (3 * 256)
+
+// Percentile of the recent download times a chunk may take before the consumer hedges it
+#define CHUNK_HEDGE_PERCENTILE 95
+// Number of download times needed before we hedge
+#define CHUNK_HEDGE_MIN_SAMPLES 4
+// Lower bound of the hedge deadline, so we don't hedge over the jitter of fast downloads
+#define CHUNK_HEDGE_MIN_DEADLINE_USEC 10000
+
+// Bounds of the decorrelated jitter between the retries of a chunk
+#define CHUNK_RETRY_BASE_MSEC 250
+#define CHUNK_RETRY_CAP_MSEC 16000
+
+// Size of a spilled chunk per byte of uncompressedSize assumed until the first one is written, in 1/256 units
+#define CHUNK_DEFAULT_SPILL_RATIO 256
+// Inflated bytes of a spilled chunk fed to the parser at a time
+#define CHUNK_INFLATE_BUFFER_SIZE (64 * 1024)
+
+// Upper bound of the first range of a split chunk, which tells the length of the rest
+#define CHUNK_RANGE_PROBE_BYTES (64 * 1024)
+
+// Fresh URLs a chunk may get before a 403 is taken for an answer
+#define CHUNK_MAX_URL_REFRESHES 3
+
+typedef enum CHUNK_TASK {
+    CHUNK_TASK_WAIT,
+    CHUNK_TASK_DOWNLOAD,
+    // Download to the spill directory, because the chunk doesn't fit in memory yet
+    CHUNK_TASK_SPILL,
+    // Second request for a chunk that is taking too long
+    CHUNK_TASK_HEDGE,
+    CHUNK_TASK_EXIT
+} CHUNK_TASK;
 
 #define PTHREAD_LOCK_INIT_ERROR_MSG(e, em) \
 switch(e) \
@@ -44,39 +92,216 @@ switch(e) \
 }
 
 sf_bool STDCALL get_shutdown_or_error(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
-    sf_bool ret;
-    _rwlock_rdlock(&chunk_downloader->attr_lock);
-    ret = chunk_downloader->is_shutdown || chunk_downloader->has_error;
-    _rwlock_rdunlock(&chunk_downloader->attr_lock);
-    return ret;
+    return _atomic_load(&chunk_downloader->is_shutdown) || _atomic_load(&chunk_downloader->has_error) ?
+           SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
 }
 
 sf_bool STDCALL get_shutdown(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
-    sf_bool ret;
-    _rwlock_rdlock(&chunk_downloader->attr_lock);
-    ret = chunk_downloader->is_shutdown;
-    _rwlock_rdunlock(&chunk_downloader->attr_lock);
-    return ret;
+    return _atomic_load(&chunk_downloader->is_shutdown) ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
 }
 
 static void STDCALL set_shutdown(struct SF_CHUNK_DOWNLOADER *chunk_downloader, sf_bool value) {
-    _rwlock_wrlock(&chunk_downloader->attr_lock);
-    chunk_downloader->is_shutdown = value;
-    _rwlock_wrunlock(&chunk_downloader->attr_lock);
+    _atomic_store(&chunk_downloader->is_shutdown, value);
 }
 
 sf_bool STDCALL get_error(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
-    sf_bool ret;
-    _rwlock_rdlock(&chunk_downloader->attr_lock);
-    ret = chunk_downloader->has_error;
-    _rwlock_rdunlock(&chunk_downloader->attr_lock);
-    return ret;
+    return _atomic_load(&chunk_downloader->has_error) ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
 }
 
 static void STDCALL set_error(struct SF_CHUNK_DOWNLOADER *chunk_downloader, sf_bool value) {
-    _rwlock_wrlock(&chunk_downloader->attr_lock);
-    chunk_downloader->has_error = value;
-    _rwlock_wrunlock(&chunk_downloader->attr_lock);
+    // The error is published after the message is set, so whoever sees the flag sees the message
+    _atomic_store(&chunk_downloader->has_error, value);
+}
+
+SF_CHUNK_MEMORY_BUDGET *STDCALL chunk_memory_budget_init(void) {
+    SF_CHUNK_MEMORY_BUDGET *memory_budget = (SF_CHUNK_MEMORY_BUDGET *) SF_CALLOC(1, sizeof(SF_CHUNK_MEMORY_BUDGET));
+    if (!memory_budget) {
+        return NULL;
+    }
+    if (_critical_section_init(&memory_budget->lock)) {
+        SF_FREE(memory_budget);
+        return NULL;
+    }
+    memory_budget->limit = 0;
+    memory_budget->used = 0;
+    memory_budget->downloaders = NULL;
+    return memory_budget;
+}
+
+/**
+ * Wakes up the producers of every chunk downloader using the budget. Must be called with the budget lock held.
+ * We don't hold the queue_lock of the other downloaders here, so a wakeup may be missed. That only delays
+ * prefetching since a downloader with nothing in memory never waits for the shared budget.
+ */
+static void STDCALL memory_budget_wake_all(SF_CHUNK_MEMORY_BUDGET *memory_budget) {
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    for (chunk_downloader = memory_budget->downloaders;
+         chunk_downloader;
+         chunk_downloader = chunk_downloader->next_in_budget) {
+        _cond_broadcast(&chunk_downloader->producer_cond);
+    }
+}
+
+void STDCALL chunk_memory_budget_set_limit(SF_CHUNK_MEMORY_BUDGET *memory_budget, uint64 limit) {
+    if (!memory_budget) {
+        return;
+    }
+    _critical_section_lock(&memory_budget->lock);
+    memory_budget->limit = limit;
+    memory_budget_wake_all(memory_budget);
+    _critical_section_unlock(&memory_budget->lock);
+}
+
+void STDCALL chunk_memory_budget_term(SF_CHUNK_MEMORY_BUDGET *memory_budget) {
+    if (!memory_budget) {
+        return;
+    }
+    _critical_section_term(&memory_budget->lock);
+    SF_FREE(memory_budget);
+}
+
+static void share_lock(CURL *curl, curl_lock_data data, curl_lock_access access, void *userptr) {
+    SF_CHUNK_SHARE *share = (SF_CHUNK_SHARE *) userptr;
+    (void) curl;
+    (void) access;
+    _critical_section_lock(&share->locks[data]);
+}
+
+static void share_unlock(CURL *curl, curl_lock_data data, void *userptr) {
+    SF_CHUNK_SHARE *share = (SF_CHUNK_SHARE *) userptr;
+    (void) curl;
+    _critical_section_unlock(&share->locks[data]);
+}
+
+SF_CHUNK_SHARE *STDCALL chunk_share_init(void) {
+    int i;
+    SF_CHUNK_SHARE *share = (SF_CHUNK_SHARE *) SF_CALLOC(1, sizeof(SF_CHUNK_SHARE));
+    if (!share) {
+        return NULL;
+    }
+    for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        _critical_section_init(&share->locks[i]);
+    }
+    // Not the connection cache, which curl doesn't support sharing between concurrent threads. Every worker
+    // keeps its connection open in its own handle instead.
+    share->share = curl_share_init();
+    if (!share->share ||
+        curl_share_setopt(share->share, CURLSHOPT_LOCKFUNC, share_lock) != CURLSHE_OK ||
+        curl_share_setopt(share->share, CURLSHOPT_UNLOCKFUNC, share_unlock) != CURLSHE_OK ||
+        curl_share_setopt(share->share, CURLSHOPT_USERDATA, share) != CURLSHE_OK ||
+        curl_share_setopt(share->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS) != CURLSHE_OK ||
+        curl_share_setopt(share->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK) {
+        log_warn("Unable to create curl share for chunk downloads");
+        chunk_share_term(share);
+        return NULL;
+    }
+    return share;
+}
+
+void STDCALL chunk_share_term(SF_CHUNK_SHARE *share) {
+    int i;
+    if (!share) {
+        return;
+    }
+    if (share->share && curl_share_cleanup(share->share) != CURLSHE_OK) {
+        // Handles still attached would lock freed memory, so the share is leaked instead
+        log_error("Unable to free curl share of chunk downloads, still in use");
+        return;
+    }
+    for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        _critical_section_term(&share->locks[i]);
+    }
+    SF_FREE(share);
+}
+
+static void STDCALL memory_budget_register(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    SF_CHUNK_MEMORY_BUDGET *memory_budget = chunk_downloader->memory_budget;
+    if (!memory_budget) {
+        return;
+    }
+    _critical_section_lock(&memory_budget->lock);
+    chunk_downloader->next_in_budget = memory_budget->downloaders;
+    memory_budget->downloaders = chunk_downloader;
+    _critical_section_unlock(&memory_budget->lock);
+}
+
+/**
+ * Removes the chunk downloader from the shared budget and gives back everything it still holds.
+ */
+static void STDCALL memory_budget_unregister(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    SF_CHUNK_MEMORY_BUDGET *memory_budget = chunk_downloader->memory_budget;
+    SF_CHUNK_DOWNLOADER **link;
+    if (!memory_budget) {
+        return;
+    }
+    _critical_section_lock(&memory_budget->lock);
+    for (link = &memory_budget->downloaders; *link; link = &(*link)->next_in_budget) {
+        if (*link == chunk_downloader) {
+            *link = chunk_downloader->next_in_budget;
+            break;
+        }
+    }
+    memory_budget->used -= chunk_downloader->budget_bytes;
+    chunk_downloader->budget_bytes = 0;
+    memory_budget_wake_all(memory_budget);
+    _critical_section_unlock(&memory_budget->lock);
+}
+
+/**
+ * Reserves memory from the budget shared with the other statements of the connection.
+ *
+ * @param force reserve even if it goes over the limit
+ * @return SF_BOOLEAN_TRUE if the memory was reserved
+ */
+static sf_bool STDCALL memory_budget_reserve(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 bytes, sf_bool force) {
+    SF_CHUNK_MEMORY_BUDGET *memory_budget = chunk_downloader->memory_budget;
+    if (!memory_budget) {
+        return SF_BOOLEAN_TRUE;
+    }
+    _critical_section_lock(&memory_budget->lock);
+    if (!force && memory_budget->limit > 0 && memory_budget->used + bytes > memory_budget->limit) {
+        _critical_section_unlock(&memory_budget->lock);
+        return SF_BOOLEAN_FALSE;
+    }
+    memory_budget->used += bytes;
+    chunk_downloader->budget_bytes += bytes;
+    _critical_section_unlock(&memory_budget->lock);
+    return SF_BOOLEAN_TRUE;
+}
+
+static void STDCALL memory_budget_release(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 bytes) {
+    SF_CHUNK_MEMORY_BUDGET *memory_budget = chunk_downloader->memory_budget;
+    if (!memory_budget || bytes == 0) {
+        return;
+    }
+    _critical_section_lock(&memory_budget->lock);
+    if (bytes > chunk_downloader->budget_bytes) {
+        bytes = chunk_downloader->budget_bytes;
+    }
+    memory_budget->used -= bytes;
+    chunk_downloader->budget_bytes -= bytes;
+    memory_budget_wake_all(memory_budget);
+    _critical_section_unlock(&memory_budget->lock);
+}
+
+/**
+ * Estimated memory footprint of a chunk that is not downloaded yet. Must be called with the queue_lock held.
+ */
+static uint64 STDCALL estimate_footprint(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_QUEUE_ITEM *item) {
+    if (item->uncompressed_size > 0) {
+        return item->uncompressed_size *
+               (chunk_downloader->footprint_ratio > 0 ? chunk_downloader->footprint_ratio : CHUNK_DEFAULT_FOOTPRINT_RATIO) /
+               256;
+    }
+    // Zero until we parsed a chunk, which means only the prefetch window limits the first downloads
+    return (uint64) item->row_count * chunk_downloader->row_footprint;
+}
+
+static void STDCALL term_locks(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    _critical_section_term(&chunk_downloader->queue_lock);
+    _cond_term(&chunk_downloader->producer_cond);
+    _cond_term(&chunk_downloader->consumer_cond);
+    _rwlock_term(&chunk_downloader->attr_lock);
 }
 
 sf_bool STDCALL init_locks(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
@@ -113,16 +338,15 @@ sf_bool STDCALL init_locks(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
 
 cleanup:
     // We may destroy some uninitialized locks/conds, but we don't care.
-    _critical_section_term(&chunk_downloader->queue_lock);
-    _cond_term(&chunk_downloader->producer_cond);
-    _cond_term(&chunk_downloader->consumer_cond);
-    _rwlock_term(&chunk_downloader->attr_lock);
+    term_locks(chunk_downloader);
     return ret;
 }
 
 sf_bool STDCALL fill_queue(struct SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *chunks, int chunk_count) {
     int i;
     cJSON *chunk = NULL;
+    int64 uncompressed_size;
+    int64 first_row = 0;
 
     // We want to detach each chunk object so that after we create the queue item,
     // we free the memory associated with the JSON blob
@@ -134,7 +358,11 @@ sf_bool STDCALL fill_queue(struct SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *
 
         chunk_downloader->queue[i].url = NULL;
         chunk_downloader->queue[i].row_count = 0;
+        chunk_downloader->queue[i].uncompressed_size = 0;
         chunk_downloader->queue[i].chunk = NULL;
+        chunk_downloader->queue[i].ready = 0;
+        chunk_downloader->queue[i].downloads = 0;
+        chunk_downloader->queue[i].is_hedged = SF_BOOLEAN_FALSE;
 
         if (json_copy_string(&chunk_downloader->queue[i].url, chunk, "url")) {
             goto cleanup;
@@ -148,6 +376,13 @@ sf_bool STDCALL fill_queue(struct SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *
         if (json_copy_int(&chunk_downloader->queue[i].row_count, chunk, "rowCount")) {
             goto cleanup;
         }
+        chunk_downloader->queue[i].first_row = first_row;
+        first_row += chunk_downloader->queue[i].row_count;
+
+        // The size is only used for scheduling, so it's fine if the server didn't send it
+        if (!json_copy_int(&uncompressed_size, chunk, "uncompressedSize") && uncompressed_size > 0) {
+            chunk_downloader->queue[i].uncompressed_size = (uint64) uncompressed_size;
+        }
 
         // Free detached chunk
       snowflake_cJSON_Delete(chunk);
@@ -157,6 +392,7 @@ sf_bool STDCALL fill_queue(struct SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *
     return SF_BOOLEAN_TRUE;
 
 cleanup:
+    snowflake_cJSON_Delete(chunk);
     for (i = 0; i < chunk_downloader->queue_size; i++) {
         SF_FREE(chunk_downloader->queue[i].url);
     }
@@ -201,167 +437,2104 @@ cleanup:
     return ret;
 }
 
-sf_bool STDCALL download_chunk(char *url, SF_HEADER *headers, cJSON **chunk, SF_ERROR_STRUCT *error, sf_bool insecure_mode) {
-    sf_bool ret = SF_BOOLEAN_FALSE;
-    CURL *curl = NULL;
-    curl = curl_easy_init();
+typedef struct CHUNK_WRITE_CONTEXT {
+    CURL *curl;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_QUEUE_ITEM *item;
+    // Exactly one of them is set
+    SF_ROWSET_PARSER *parser;
+    SF_ARROW_READER *arrow_reader;
+    // Instead of the parser, if the chunk is spilled
+    FILE *spill_file;
+    long int http_code;
+    // Bytes of the body fed so far, over all the attempts. A retry goes on from there.
+    uint64 fed_bytes;
+    // Bytes a full response repeats, i.e. the ones fed by the failed attempts
+    uint64 skip_bytes;
+    // First byte of a partial response and the length of the whole body, -1 if the response is not partial
+    int64 range_start;
+    int64 range_total;
+    // Content-Encoding of the response. A range of an encoded body is not a range of the decoded bytes.
+    SF_CHUNK_ENCODING encoding;
+    // Content-Encoding of the bytes spilled so far
+    SF_CHUNK_ENCODING spill_encoding;
+    // The partial response doesn't start where we asked it to
+    sf_bool is_range_mismatch;
+    // Give up once the chunk is ready, i.e. the other request for a hedged chunk got it
+    sf_bool abort_when_ready;
+} CHUNK_WRITE_CONTEXT;
+
+/**
+ * Feeds the response to the rowset parser or the Arrow reader as it arrives, so we never hold the whole
+ * chunk in memory, or writes it to the spill file as received. A retry continues where the failed attempt
+ * stopped, whether the server sends the rest of the body or all of it.
+ */
+static size_t chunk_write_cb(char *data, size_t size, size_t nmemb, void *userdata) {
+    CHUNK_WRITE_CONTEXT *context = (CHUNK_WRITE_CONTEXT *) userdata;
+    size_t data_size = size * nmemb;
+    size_t skip;
+    sf_bool ret;
 
-    if (!curl || !http_perform(curl, GET_REQUEST_TYPE, url, headers, NULL, chunk, DEFAULT_SNOWFLAKE_REQUEST_TIMEOUT, SF_BOOLEAN_TRUE, error, insecure_mode)) {
-        // Error set in perform function
-        goto cleanup;
+    if (context->http_code == 0) {
+        if (curl_easy_getinfo(context->curl, CURLINFO_RESPONSE_CODE, &context->http_code) != CURLE_OK) {
+            return 0;
+        }
+        if (context->spill_file && context->fed_bytes == 0) {
+            context->spill_encoding = context->encoding;
+        }
+        // The rest of a spilled chunk has to be encoded like the bytes on disk. The parser gets decoded
+        // bytes, so a range of an encoded body doesn't go on where it stopped.
+        if ((context->http_code == 200 || context->http_code == 206) &&
+            (context->spill_file ? context->encoding != context->spill_encoding :
+             context->http_code == 206 && context->encoding != CHUNK_ENCODING_IDENTITY)) {
+            context->is_range_mismatch = SF_BOOLEAN_TRUE;
+            return 0;
+        }
+        if (context->http_code == 200) {
+            context->skip_bytes = context->fed_bytes;
+        } else if (context->http_code == 206 && context->range_start != (int64) context->fed_bytes) {
+            context->is_range_mismatch = SF_BOOLEAN_TRUE;
+            return 0;
+        }
+    }
+    // The body of an error response is not a rowset
+    if (context->http_code != 200 && context->http_code != 206) {
+        return data_size;
+    }
+    skip = context->skip_bytes < data_size ? (size_t) context->skip_bytes : data_size;
+    context->skip_bytes -= skip;
+    if (skip == data_size) {
+        return data_size;
+    }
+    // Returning less than we got aborts the transfer
+    if (context->spill_file) {
+        ret = fwrite(data + skip, 1, data_size - skip, context->spill_file) == data_size - skip;
+    } else if (context->arrow_reader) {
+        ret = arrow_reader_feed(context->arrow_reader, data + skip, data_size - skip);
+    } else {
+        ret = rowset_parser_feed(context->parser, data + skip, data_size - skip);
     }
+    context->fed_bytes += data_size - skip;
+    return ret ? data_size : 0;
+}
 
-    ret = SF_BOOLEAN_TRUE;
+/**
+ * Looks for the headers that tell whether a retry can ask for the rest of the body only.
+ */
+static size_t chunk_header_cb(char *data, size_t size, size_t nitems, void *userdata) {
+    CHUNK_WRITE_CONTEXT *context = (CHUNK_WRITE_CONTEXT *) userdata;
+    size_t len = size * nitems;
+    size_t i;
 
-cleanup:
-    curl_easy_cleanup(curl);
+    if (len > 17 && sf_strncasecmp(data, "Content-Encoding:", 17) == 0) {
+        for (i = 17; i < len && data[i] == ' '; i++);
+        if (i == len || data[i] == '\r' || data[i] == '\n' ||
+            (len - i >= 8 && sf_strncasecmp(data + i, "identity", 8) == 0)) {
+            context->encoding = CHUNK_ENCODING_IDENTITY;
+        } else if ((len - i >= 4 && sf_strncasecmp(data + i, "gzip", 4) == 0) ||
+                   (len - i >= 6 && sf_strncasecmp(data + i, "x-gzip", 6) == 0) ||
+                   (len - i >= 7 && sf_strncasecmp(data + i, "deflate", 7) == 0)) {
+            context->encoding = CHUNK_ENCODING_ZLIB;
+        } else {
+            context->encoding = CHUNK_ENCODING_OTHER;
+        }
+    } else if (len > 20 && sf_strncasecmp(data, "Content-Range: bytes", 20) == 0) {
+        for (i = 20; i < len && data[i] == ' '; i++);
+        if (i < len && data[i] >= '0' && data[i] <= '9') {
+            context->range_start = 0;
+            for (; i < len && data[i] >= '0' && data[i] <= '9'; i++) {
+                context->range_start = context->range_start * 10 + (data[i] - '0');
+            }
+            // The length after the slash is "*" if the server doesn't know it
+            for (; i < len && data[i] != '/'; i++);
+            if (i + 1 < len && data[i + 1] >= '0' && data[i + 1] <= '9') {
+                context->range_total = 0;
+                for (i++; i < len && data[i] >= '0' && data[i] <= '9'; i++) {
+                    context->range_total = context->range_total * 10 + (data[i] - '0');
+                }
+            }
+        }
+    }
+    return len;
+}
 
-    return ret;
+/**
+ * Aborts the transfer once the other request for a hedged chunk got it, or the chunk downloader shuts down.
+ * curl calls this at least once a second, even while it waits for the response.
+ */
+static int chunk_progress_cb(void *userdata, curl_off_t dltotal, curl_off_t dlnow,
+                             curl_off_t ultotal, curl_off_t ulnow) {
+    CHUNK_WRITE_CONTEXT *context = (CHUNK_WRITE_CONTEXT *) userdata;
+    return (context->abort_when_ready && _atomic_load(&context->item->ready)) ||
+           get_shutdown(context->chunk_downloader) ? 1 : 0;
 }
 
-SF_CHUNK_DOWNLOADER *STDCALL chunk_downloader_init(const char *qrmk,
-                                                   cJSON *chunk_headers,
-                                                   cJSON *chunks,
-                                                   uint64 thread_count,
-                                                   uint64 fetch_slots,
-                                                   SF_ERROR_STRUCT *sf_error,
-                                                   sf_bool insecure_mode) {
-    struct SF_CHUNK_DOWNLOADER *chunk_downloader = NULL;
-    const char *error_msg = NULL;
-    int chunk_count;
-    int i;
-    int pthread_ret;
-    size_t qrmk_len = 1;
-    // We need thread_count, fetch_slots, chunks, and either qrmk or chunk_headers
-    if (thread_count <= 0 ||
-            fetch_slots <= 0 ||
-            !chunks ||
-            !snowflake_cJSON_IsArray(chunks) ||
-            strcmp(chunks->string, "chunks") != 0) {
+/**
+ * Creates a curl handle for chunk downloads. Everything that doesn't change from chunk to chunk is set
+ * once here.
+ *
+ * @return curl handle or NULL if it couldn't be set up
+ */
+static CURL *STDCALL create_chunk_curl(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    CURL *curl = curl_easy_init();
+
+    if (!curl) {
         return NULL;
     }
 
-    if ((chunk_downloader = (SF_CHUNK_DOWNLOADER *) SF_CALLOC(1, sizeof(SF_CHUNK_DOWNLOADER))) == NULL) {
+    if ((chunk_downloader->share &&
+         curl_easy_setopt(curl, CURLOPT_SHARE, chunk_downloader->share->share) != CURLE_OK) ||
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk_downloader->chunk_headers->header) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "") != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, chunk_write_cb) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, chunk_header_cb) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, chunk_progress_cb) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L) != CURLE_OK ||
+        !set_curl_tls_options(curl, chunk_downloader->insecure_mode)) {
+        curl_easy_cleanup(curl);
         return NULL;
     }
+    return curl;
+}
 
-    // Initialize default values
-    chunk_downloader->threads = NULL;
-    chunk_downloader->queue = NULL;
-    chunk_downloader->qrmk = NULL;
-    chunk_downloader->chunk_headers = sf_header_create();
-    chunk_downloader->thread_count = 0;
-    chunk_downloader->queue_size = 0;
-    chunk_downloader->producer_head = 0;
-    chunk_downloader->consumer_head = 0;
-    chunk_downloader->is_shutdown = SF_BOOLEAN_FALSE;
-    chunk_downloader->has_error = SF_BOOLEAN_FALSE;
-    chunk_downloader->sf_error = sf_error;
-    chunk_downloader->insecure_mode = insecure_mode;
+/**
+ * Creates the curl handle of a worker
+ */
+static sf_bool STDCALL init_worker_curl(SF_CHUNK_WORKER *worker, SF_ERROR_STRUCT *error) {
+    if ((worker->curl = create_chunk_curl(worker->chunk_downloader)) == NULL) {
+        SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, "Unable to create curl handle for chunk download",
+                            SF_SQLSTATE_UNABLE_TO_CONNECT);
+        return SF_BOOLEAN_FALSE;
+    }
+    return SF_BOOLEAN_TRUE;
+}
 
-    // Initialize chunk_headers or qrmk
-    if (chunk_headers) {
-        if(!create_chunk_headers(chunk_downloader, chunk_headers)) {
-            goto cleanup;
+/**
+ * Frees the curl handles of a worker and closes their connections.
+ */
+static void STDCALL term_worker_curl(SF_CHUNK_WORKER *worker) {
+    int i;
+
+    curl_easy_cleanup(worker->curl);
+    worker->curl = NULL;
+    for (i = 0; i < SF_CHUNK_MAX_RANGES; i++) {
+        curl_easy_cleanup(worker->range_curls[i]);
+        worker->range_curls[i] = NULL;
+    }
+    if (worker->range_multi) {
+        curl_multi_cleanup(worker->range_multi);
+        worker->range_multi = NULL;
+    }
+}
+
+/**
+ * Frees everything a worker keeps from chunk to chunk
+ */
+static void STDCALL term_worker(SF_CHUNK_WORKER *worker) {
+    term_worker_curl(worker);
+    SF_FREE(worker->url);
+    worker->url_size = 0;
+    rowset_parser_term(&worker->parser);
+    arrow_reader_term(&worker->arrow_reader);
+    rowset_term(worker->rowset);
+    worker->rowset = NULL;
+}
+
+/**
+ * Transfer errors worth another try. A bad setup won't get any better, and an aborted transfer was aborted
+ * on purpose.
+ */
+static sf_bool STDCALL is_retryable_curl_code(CURLcode res) {
+    switch (res) {
+        case CURLE_UNSUPPORTED_PROTOCOL:
+        case CURLE_URL_MALFORMAT:
+        case CURLE_NOT_BUILT_IN:
+        case CURLE_OUT_OF_MEMORY:
+        case CURLE_ABORTED_BY_CALLBACK:
+        case CURLE_PEER_FAILED_VERIFICATION:
+        case CURLE_SSL_CERTPROBLEM:
+        case CURLE_SSL_CACERT_BADFILE:
+            return SF_BOOLEAN_FALSE;
+        default:
+            return SF_BOOLEAN_TRUE;
+    }
+}
+
+/**
+ * Waits before the next try of a chunk.
+ *
+ * @return SF_BOOLEAN_FALSE if the wait was cut short because we shut down, failed or the other request
+ *         for the chunk got it, i.e. there is no point in trying again.
+ */
+static sf_bool STDCALL wait_for_retry(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_QUEUE_ITEM *item,
+                                      sf_bool abort_when_ready, uint32 msec) {
+    uint64 now = sf_get_monotonic_time_usec();
+    uint64 deadline = now + (uint64) msec * 1000;
+    sf_bool ret;
+
+    // Shutting down wakes up the producers, so we wait on their condition
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    while (!(get_shutdown_or_error(chunk_downloader) || (abort_when_ready && _atomic_load(&item->ready))) &&
+           now < deadline) {
+        _cond_timed_wait(&chunk_downloader->producer_cond, &chunk_downloader->queue_lock,
+                         (unsigned long) ((deadline - now + 999) / 1000));
+        now = sf_get_monotonic_time_usec();
+    }
+    ret = !(get_shutdown_or_error(chunk_downloader) || (abort_when_ready && _atomic_load(&item->ready)));
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+    return ret;
+}
+
+/**
+ * Copies the URL of a chunk for the worker, since the consumer may replace it with a fresh one
+ * while the chunk downloads.
+ */
+static sf_bool STDCALL take_chunk_url(SF_CHUNK_WORKER *worker, SF_QUEUE_ITEM *item, SF_ERROR_STRUCT *error) {
+    SF_CHUNK_DOWNLOADER *chunk_downloader = worker->chunk_downloader;
+    sf_bool ret = SF_BOOLEAN_TRUE;
+    size_t len;
+    char *url;
+
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    len = strlen(item->url) + 1;
+    if (len > worker->url_size) {
+        if ((url = (char *) SF_REALLOC(worker->url, len)) == NULL) {
+            ret = SF_BOOLEAN_FALSE;
+        } else {
+            worker->url = url;
+            worker->url_size = len;
         }
-    } else if (qrmk) {
-        qrmk_len += strlen(qrmk);
-        chunk_downloader->qrmk = (char *) SF_CALLOC(1, qrmk_len);
-        sb_strncpy(chunk_downloader->qrmk, qrmk_len, qrmk, qrmk_len);
     }
+    if (ret) {
+        sb_strcpy(worker->url, worker->url_size, item->url);
+        worker->url_generation = chunk_downloader->url_generation;
+    }
+    _critical_section_unlock(&chunk_downloader->queue_lock);
 
-    // Initialize mutexes and conditional variables
-    if (!init_locks(chunk_downloader)) {
-        goto cleanup;
+    if (!ret) {
+        SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_OUT_OF_MEMORY, "Unable to allocate chunk URL",
+                            SF_SQLSTATE_MEMORY_ALLOCATION_ERROR);
     }
+    return ret;
+}
 
-    // Initialize queue and thread memory
-    chunk_count = snowflake_cJSON_GetArraySize(chunks);
-    chunk_downloader->threads = (SF_THREAD_HANDLE *)SF_CALLOC((int)thread_count, sizeof(SF_THREAD_HANDLE));
-    chunk_downloader->queue = (SF_QUEUE_ITEM *) SF_CALLOC(chunk_count, sizeof(SF_QUEUE_ITEM));
-    if (!chunk_downloader->threads || !chunk_downloader->queue) {
+/**
+ * Replaces the URLs of the chunks with fresh ones from url_refresh and wakes up the workers waiting
+ * for them. Only the consumer calls this, since the refresh talks to the server with the session of
+ * the statement. The queue_lock isn't held while it does.
+ *
+ * @param generation url_generation of the expired URLs. Nothing to do if they were replaced since.
+ */
+static sf_bool STDCALL refresh_chunk_urls(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 generation) {
+    SF_ERROR_STRUCT err;
+    cJSON *chunks = NULL;
+    cJSON *chunk;
+    char *url;
+    uint64 index = 0;
+    uint64 end = chunk_downloader->first_chunk + chunk_downloader->queue_size;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+
+    if (generation != chunk_downloader->url_generation) {
+        return SF_BOOLEAN_TRUE;
+    }
+    memset(&err, 0, sizeof(err));
+    clear_snowflake_error(&err);
+    log_info("Chunk URLs expired, getting fresh ones");
+    if (!chunk_downloader->url_refresh(chunk_downloader->url_refresh_ctx, &chunks, &err)) {
         goto cleanup;
     }
-
-    // Fill up queue
-    if (!fill_queue(chunk_downloader, chunks, chunk_count)) {
+    if (!snowflake_cJSON_IsArray(chunks) || (uint64) snowflake_cJSON_GetArraySize(chunks) < end) {
+        SET_SNOWFLAKE_ERROR(&err, SF_STATUS_ERROR_BAD_RESPONSE, "Fresh chunk URLs don't match the result",
+                            SF_SQLSTATE_UNABLE_TO_CONNECT);
         goto cleanup;
     }
 
-    // Initialize threads
-    for (i = 0; i < thread_count; i++) {
-        // If non-zero exit code, terminate chunk downloader
-        if ((pthread_ret = _thread_init(
-              &chunk_downloader->threads[i],
-              chunk_downloader_thread,
-              (void *)chunk_downloader)) != 0) {
-            chunk_downloader_term(chunk_downloader);
-            PTHREAD_CREATE_ERROR_MSG(pthread_ret, error_msg);
-            SET_SNOWFLAKE_ERROR(sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
-            return NULL;
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    ret = SF_BOOLEAN_TRUE;
+    // A part of a split result only has some of the chunks
+    snowflake_cJSON_ArrayForEach(chunk, chunks) {
+        if (index >= end) {
+            break;
+        }
+        if (index >= chunk_downloader->first_chunk) {
+            url = NULL;
+            if (json_copy_string(&url, chunk, "url")) {
+                SET_SNOWFLAKE_ERROR(&err, SF_STATUS_ERROR_BAD_RESPONSE, "Fresh chunk URL is missing",
+                                    SF_SQLSTATE_UNABLE_TO_CONNECT);
+                ret = SF_BOOLEAN_FALSE;
+                break;
+            }
+            SF_FREE(chunk_downloader->queue[index - chunk_downloader->first_chunk].url);
+            chunk_downloader->queue[index - chunk_downloader->first_chunk].url = url;
         }
+        index++;
+    }
+    // The URLs replaced so far are fresh, whether or not the rest are
+    chunk_downloader->url_generation++;
+    _atomic_store(&chunk_downloader->is_url_expired, 0);
+    if (ret) {
+        chunk_downloader->stats.url_refresh_count++;
+    }
+    _cond_broadcast(&chunk_downloader->producer_cond);
+    _critical_section_unlock(&chunk_downloader->queue_lock);
 
-        chunk_downloader->thread_count++;
+cleanup:
+    snowflake_cJSON_Delete(chunks);
+    if (!ret) {
+        log_error("Unable to refresh chunk URLs: %s", err.msg);
+        _critical_section_lock(&chunk_downloader->queue_lock);
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            copy_snowflake_error(chunk_downloader->sf_error, &err);
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        // Workers waiting for fresh URLs give up
+        _cond_broadcast(&chunk_downloader->producer_cond);
+        _critical_section_unlock(&chunk_downloader->queue_lock);
+        clear_snowflake_error(&err);
     }
+    return ret;
+}
 
-    return chunk_downloader;
+/**
+ * Waits until the consumer replaced the expired URLs of the chunks, unless it did so since the worker
+ * took its URL. The refetch worker runs on the consumer thread, so it gets them itself.
+ *
+ * @return SF_BOOLEAN_FALSE if we shut down, failed or the other request for the chunk got it
+ */
+static sf_bool STDCALL wait_for_fresh_url(SF_CHUNK_WORKER *worker, SF_QUEUE_ITEM *item, sf_bool abort_when_ready) {
+    SF_CHUNK_DOWNLOADER *chunk_downloader = worker->chunk_downloader;
+    sf_bool ret;
 
-cleanup:
-    if (chunk_downloader) {
-        SF_FREE(chunk_downloader->qrmk);
-        sf_header_destroy(chunk_downloader->chunk_headers);
-        SF_FREE(chunk_downloader->queue);
-        SF_FREE(chunk_downloader->threads);
+    if (worker->is_refetch) {
+        return refresh_chunk_urls(chunk_downloader, worker->url_generation);
     }
-    SF_FREE(chunk_downloader);
 
-    return NULL;
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    if (chunk_downloader->url_generation == worker->url_generation) {
+        _atomic_store(&chunk_downloader->is_url_expired, 1);
+        // The consumer may be waiting for a chunk already
+        _cond_signal(&chunk_downloader->consumer_cond);
+    }
+    while (!(get_shutdown_or_error(chunk_downloader) || (abort_when_ready && _atomic_load(&item->ready))) &&
+           chunk_downloader->url_generation == worker->url_generation) {
+        _cond_wait(&chunk_downloader->producer_cond, &chunk_downloader->queue_lock);
+    }
+    ret = !(get_shutdown_or_error(chunk_downloader) || (abort_when_ready && _atomic_load(&item->ready)));
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+    return ret;
 }
 
+/**
+ * Path of the spill file of a chunk
+ */
+static void STDCALL spill_path(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index, char *path, size_t size) {
+    sb_sprintf(path, size, "%s%csfchunk_%s_%llu", chunk_downloader->spill_dir, PATH_SEP,
+               chunk_downloader->spill_prefix, (unsigned long long) index);
+}
 
-sf_bool STDCALL chunk_downloader_term(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
-    int pthread_ret;
+/**
+ * One byte range of a chunk fetched in ranges
+ */
+typedef struct CHUNK_RANGE {
+    // Headers, received bytes and the abort check of the request
+    CHUNK_WRITE_CONTEXT context;
+    struct CHUNK_RANGE_DOWNLOAD *download;
+    uint64 first;
+    uint64 len;
+    // Bytes of the range until the ranges before it are fed. NULL for the first range, which is fed as
+    // it arrives
+    char *buffer;
+    // The request is in the multi handle
+    sf_bool is_added;
+    sf_bool is_done;
+} CHUNK_RANGE;
+
+typedef struct CHUNK_RANGE_DOWNLOAD {
+    SF_CHUNK_WORKER *worker;
+    CHUNK_RANGE ranges[SF_CHUNK_MAX_RANGES];
+    uint64 range_count;
+    // Number of ranges fed to the parser so far. They are fed in order.
+    uint64 fed_count;
+    // Length and Content-Encoding of the body as received, told by the first response. 0 until then
+    uint64 total;
+    SF_CHUNK_ENCODING encoding;
+    z_stream stream;
+    sf_bool is_inflating;
+    sf_bool is_inflated;
+    // Static message, NULL unless the download failed
     const char *error_msg;
-    uint64 i;
-    if (!chunk_downloader) {
-        return SF_BOOLEAN_FALSE;
-    }
+} CHUNK_RANGE_DOWNLOAD;
 
-    if ((pthread_ret = _critical_section_lock(&chunk_downloader->queue_lock))) {
-        _rwlock_wrlock(&chunk_downloader->attr_lock);
-        if (!chunk_downloader->has_error) {
-            PTHREAD_LOCK_INIT_ERROR_MSG(pthread_ret, error_msg);
-            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
-            chunk_downloader->has_error = SF_BOOLEAN_TRUE;
-        }
-        _rwlock_wrunlock(&chunk_downloader->attr_lock);
-        return SF_BOOLEAN_FALSE;
+/**
+ * Passes the next bytes of a chunk fetched in ranges to the parser or the Arrow reader of the worker,
+ * inflated if the body is compressed.
+ */
+static sf_bool STDCALL feed_range(CHUNK_RANGE_DOWNLOAD *download, const char *data, size_t len) {
+    SF_CHUNK_WORKER *worker = download->worker;
+    sf_bool arrow_format = worker->chunk_downloader->arrow_format;
+    const char *parse_error;
+    char buffer[CHUNK_INFLATE_BUFFER_SIZE];
+    const char *out = data;
+    size_t out_len = len;
+    int zret = Z_OK;
+
+    if (download->encoding == CHUNK_ENCODING_ZLIB) {
+        download->stream.next_in = (Bytef *) data;
+        download->stream.avail_in = (uInt) len;
     }
-
     do {
-        // Already shutting down, just return false
-        if (get_shutdown(chunk_downloader)) {
+        if (download->encoding == CHUNK_ENCODING_ZLIB) {
+            if (download->is_inflated) {
+                if (download->stream.avail_in > 0) {
+                    download->error_msg = "Unexpected bytes after the end of the compressed chunk";
+                    return SF_BOOLEAN_FALSE;
+                }
+                return SF_BOOLEAN_TRUE;
+            }
+            download->stream.next_out = (Bytef *) buffer;
+            download->stream.avail_out = sizeof(buffer);
+            zret = inflate(&download->stream, Z_NO_FLUSH);
+            if (zret != Z_OK && zret != Z_STREAM_END && zret != Z_BUF_ERROR) {
+                download->error_msg = "Unable to inflate chunk";
+                return SF_BOOLEAN_FALSE;
+            }
+            download->is_inflated = zret == Z_STREAM_END;
+            out = buffer;
+            out_len = sizeof(buffer) - download->stream.avail_out;
+        }
+        if (out_len > 0 && !(arrow_format ? arrow_reader_feed(&worker->arrow_reader, out, out_len)
+                                          : rowset_parser_feed(&worker->parser, out, out_len))) {
+            parse_error = arrow_format ? worker->arrow_reader.error_msg : worker->parser.error_msg;
+            download->error_msg = parse_error ? parse_error : "Unable to parse chunk";
             return SF_BOOLEAN_FALSE;
         }
+        // A full buffer may leave more output behind, even once all the input is taken
+    } while (download->encoding == CHUNK_ENCODING_ZLIB && zret != Z_BUF_ERROR &&
+             (download->stream.avail_in > 0 || download->stream.avail_out == 0));
+    return SF_BOOLEAN_TRUE;
+}
 
-        set_shutdown(chunk_downloader, SF_BOOLEAN_TRUE);
-
-        if (_cond_broadcast(&chunk_downloader->consumer_cond) ||
-            _cond_broadcast(&chunk_downloader->producer_cond) ||
-                (_critical_section_unlock(&chunk_downloader->queue_lock))) {
-            // Something went wrong with either notifying the producer/consumer or releasing the queue lock
-            // Set and error and then try to continue with cleanup
-            _rwlock_wrlock(&chunk_downloader->attr_lock);
-            if (!chunk_downloader->has_error) {
-                SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, "Error during condition broadcast", "");
-                chunk_downloader->has_error = SF_BOOLEAN_TRUE;
-            }
-            _rwlock_wrunlock(&chunk_downloader->attr_lock);
+/**
+ * Receives a byte range of a chunk, once the response shows it is the range we asked for and it is
+ * encoded like the first one. The first range is fed as it arrives, the others are held until the
+ * ranges before them are fed.
+ */
+static size_t chunk_range_write_cb(char *data, size_t size, size_t nmemb, void *userdata) {
+    CHUNK_RANGE *range = (CHUNK_RANGE *) userdata;
+    CHUNK_RANGE_DOWNLOAD *download = range->download;
+    CHUNK_WRITE_CONTEXT *context = &range->context;
+    size_t data_size = size * nmemb;
+
+    if (context->http_code == 0) {
+        if (curl_easy_getinfo(context->curl, CURLINFO_RESPONSE_CODE, &context->http_code) != CURLE_OK) {
+            return 0;
         }
-
-        // Join all the threads
+        // The body of an error response is not a rowset. A whole body means the server doesn't do ranges.
+        if (context->http_code == 200) {
+            download->error_msg = "Server sent the whole chunk instead of a range";
+            return 0;
+        }
+        if (context->http_code != 206) {
+            return data_size;
+        }
+        if (context->range_start != (int64) range->first || context->range_total <= 0 ||
+            (range != download->ranges &&
+             (context->encoding != download->encoding || (uint64) context->range_total != download->total))) {
+            download->error_msg = "Received a different range of the chunk than requested";
+            return 0;
+        }
+        if (range == download->ranges) {
+            if (context->encoding == CHUNK_ENCODING_OTHER) {
+                download->error_msg = "Unsupported content encoding of chunk";
+                return 0;
+            }
+            if (context->encoding == CHUNK_ENCODING_ZLIB) {
+                // Inflates gzip and deflate alike
+                if (inflateInit2(&download->stream, 15 + 32) != Z_OK) {
+                    download->error_msg = "Unable to inflate chunk";
+                    return 0;
+                }
+                download->is_inflating = SF_BOOLEAN_TRUE;
+            }
+            download->encoding = context->encoding;
+            download->total = (uint64) context->range_total;
+            if (range->len > download->total) {
+                range->len = download->total;
+            }
+        }
+    }
+    if (context->http_code != 206) {
+        return data_size;
+    }
+    if (context->fed_bytes + data_size > range->len) {
+        download->error_msg = "Received a different range of the chunk than requested";
+        return 0;
+    }
+    if (range->buffer) {
+        memcpy(range->buffer + context->fed_bytes, data, data_size);
+    } else if (!feed_range(download, data, data_size)) {
+        return 0;
+    }
+    context->fed_bytes += data_size;
+    return data_size;
+}
+
+/**
+ * Sends the request for a byte range of a chunk with the curl handle of the range.
+ */
+static sf_bool STDCALL start_range(CHUNK_RANGE_DOWNLOAD *download, SF_QUEUE_ITEM *item, uint64 index,
+                                   uint64 first, uint64 len) {
+    SF_CHUNK_WORKER *worker = download->worker;
+    CHUNK_RANGE *range = &download->ranges[index];
+    CURL *curl = worker->range_curls[index];
+    char value[48];
+
+    range->download = download;
+    range->first = first;
+    range->len = len;
+    range->context.curl = curl;
+    range->context.chunk_downloader = worker->chunk_downloader;
+    range->context.item = item;
+    range->context.http_code = 0;
+    range->context.fed_bytes = 0;
+    range->context.range_start = -1;
+    range->context.range_total = -1;
+    range->context.encoding = CHUNK_ENCODING_IDENTITY;
+    range->context.abort_when_ready = SF_BOOLEAN_TRUE;
+    if (index > 0 && (range->buffer = (char *) SF_MALLOC((size_t) len)) == NULL) {
+        download->error_msg = "Unable to allocate chunk range";
+        return SF_BOOLEAN_FALSE;
+    }
+
+    sb_sprintf(value, sizeof(value), "%llu-%llu", (unsigned long long) first, (unsigned long long) (first + len - 1));
+    if (curl_easy_setopt(curl, CURLOPT_URL, worker->url) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_RANGE, value) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *) range) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void *) &range->context) != CURLE_OK ||
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, (void *) &range->context) != CURLE_OK ||
+        curl_multi_add_handle(worker->range_multi, curl) != CURLM_OK) {
+        download->error_msg = "Unable to set chunk range options";
+        return SF_BOOLEAN_FALSE;
+    }
+    range->is_added = SF_BOOLEAN_TRUE;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Fetches a chunk in worker->range_count byte ranges over connections of its own and feeds them to
+ * the parser of the worker in order. The first request asks for a small range, whose Content-Range tells
+ * the length of the body as received. The rest is split between the other requests as soon as that
+ * is known, while the first range is fed as it arrives. The other ranges are held in memory until the
+ * ranges before them are fed, so the chunk is parsed while they download. Compressed bodies are split
+ * as received and inflated in order.
+ *
+ * Nothing is retried here. If a range fails or the server doesn't send the ranges we asked for, the
+ * caller fetches the chunk whole.
+ *
+ * @param error_msg static message if the chunk has to be fetched whole
+ */
+static sf_bool STDCALL download_chunk_ranges(SF_CHUNK_WORKER *worker, SF_QUEUE_ITEM *item,
+                                             const char **error_msg) {
+    SF_CHUNK_DOWNLOADER *chunk_downloader = worker->chunk_downloader;
+    CHUNK_RANGE_DOWNLOAD download;
+    CHUNK_RANGE *range;
+    CURLMsg *info;
+    CURL *curl;
+    CURLcode res;
+    uint64 range_count = worker->range_count < SF_CHUNK_MAX_RANGES ? worker->range_count : SF_CHUNK_MAX_RANGES;
+    uint64 first_len;
+    uint64 rest;
+    uint64 split_count;
+    uint64 first;
+    uint64 next;
+    uint64 i;
+    int running = 0;
+    int queued;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+
+    memset(&download, 0, sizeof(download));
+    download.worker = worker;
+    download.encoding = CHUNK_ENCODING_IDENTITY;
+
+    if (!worker->range_multi && (worker->range_multi = curl_multi_init()) == NULL) {
+        download.error_msg = "Unable to create curl multi handle for chunk ranges";
+        goto cleanup;
+    }
+    for (i = 0; i < range_count; i++) {
+        if (worker->range_curls[i]) {
+            continue;
+        }
+        // The ranges are split as received, so the body is inflated here
+        if ((worker->range_curls[i] = create_chunk_curl(chunk_downloader)) == NULL ||
+            curl_easy_setopt(worker->range_curls[i], CURLOPT_WRITEFUNCTION, chunk_range_write_cb) != CURLE_OK ||
+            curl_easy_setopt(worker->range_curls[i], CURLOPT_HTTP_CONTENT_DECODING, 0L) != CURLE_OK ||
+            curl_easy_setopt(worker->range_curls[i], CURLOPT_ACCEPT_ENCODING, "gzip, deflate") != CURLE_OK) {
+            download.error_msg = "Unable to create curl handle for chunk ranges";
+            goto cleanup;
+        }
+    }
+
+    // The first range only has to tell the length of the body, so it is kept well below the share of a
+    // range even if the body is compressed
+    first_len = item->uncompressed_size / range_count / 16;
+    if (first_len > CHUNK_RANGE_PROBE_BYTES) {
+        first_len = CHUNK_RANGE_PROBE_BYTES;
+    }
+    if (!start_range(&download, item, 0, 0, first_len > 0 ? first_len : 1)) {
+        goto cleanup;
+    }
+    download.range_count = 1;
+
+    do {
+        if (curl_multi_perform(worker->range_multi, &running) != CURLM_OK) {
+            download.error_msg = "Unable to fetch chunk ranges";
+            goto cleanup;
+        }
+        while ((info = curl_multi_info_read(worker->range_multi, &queued)) != NULL) {
+            if (info->msg != CURLMSG_DONE) {
+                continue;
+            }
+            // The message is gone once the handle is removed
+            curl = info->easy_handle;
+            res = info->data.result;
+            for (i = 0; i < download.range_count && download.ranges[i].context.curl != curl; i++);
+            if (i == download.range_count) {
+                continue;
+            }
+            range = &download.ranges[i];
+            curl_multi_remove_handle(worker->range_multi, curl);
+            range->is_added = SF_BOOLEAN_FALSE;
+            if (res != CURLE_OK) {
+                if (!download.error_msg) {
+                    download.error_msg = curl_easy_strerror(res);
+                }
+                goto cleanup;
+            }
+            if (range->context.http_code == 0 &&
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &range->context.http_code) != CURLE_OK) {
+                download.error_msg = "Unable to get http response code";
+                goto cleanup;
+            }
+            if (range->context.http_code != 206 || range->context.fed_bytes != range->len) {
+                download.error_msg = "Received an incomplete range of the chunk";
+                goto cleanup;
+            }
+            range->is_done = SF_BOOLEAN_TRUE;
+        }
+
+        // Split the rest of the body between the other requests once the first response told its length
+        if (download.range_count == 1 && download.total > download.ranges[0].len) {
+            first = download.ranges[0].len;
+            rest = download.total - first;
+            split_count = range_count - 1 < rest ? range_count - 1 : rest;
+            for (i = 0; i < split_count; i++) {
+                next = download.ranges[0].len + rest * (i + 1) / split_count;
+                if (!start_range(&download, item, i + 1, first, next - first)) {
+                    goto cleanup;
+                }
+                download.range_count++;
+                first = next;
+            }
+        }
+
+        // Feed the ranges that arrived, in order
+        while (download.fed_count < download.range_count && download.ranges[download.fed_count].is_done) {
+            range = &download.ranges[download.fed_count];
+            if (range->buffer) {
+                if (!feed_range(&download, range->buffer, (size_t) range->len)) {
+                    goto cleanup;
+                }
+                SF_FREE(range->buffer);
+            }
+            download.fed_count++;
+        }
+
+        if (running > 0 && curl_multi_wait(worker->range_multi, NULL, 0, 100, NULL) != CURLM_OK) {
+            download.error_msg = "Unable to fetch chunk ranges";
+            goto cleanup;
+        }
+    } while (running > 0 || download.fed_count < download.range_count);
+
+    if (download.encoding == CHUNK_ENCODING_ZLIB && !download.is_inflated) {
+        download.error_msg = "Compressed chunk ended early";
+        goto cleanup;
+    }
+    if (chunk_downloader->arrow_format ? !arrow_reader_finish(&worker->arrow_reader)
+                                       : !rowset_parser_finish(&worker->parser)) {
+        download.error_msg = chunk_downloader->arrow_format ? worker->arrow_reader.error_msg : worker->parser.error_msg;
+        goto cleanup;
+    }
+    ret = SF_BOOLEAN_TRUE;
+
+cleanup:
+    for (i = 0; i < SF_CHUNK_MAX_RANGES; i++) {
+        if (download.ranges[i].is_added) {
+            curl_multi_remove_handle(worker->range_multi, download.ranges[i].context.curl);
+        }
+        SF_FREE(download.ranges[i].buffer);
+    }
+    if (download.is_inflating) {
+        inflateEnd(&download.stream);
+    }
+    if (!ret) {
+        *error_msg = download.error_msg ? download.error_msg : "Unable to fetch chunk ranges";
+    }
+    return ret;
+}
+
+/**
+ * Converts the values of a parsed chunk to the C types of their columns, on the thread that parsed it,
+ * so the consumer only loads them. If that runs out of memory the consumer converts them from the text.
+ */
+static void STDCALL decode_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_ROWSET *rowset) {
+    if (chunk_downloader->column_types &&
+        !rowset_decode(rowset, chunk_downloader->column_types, (size_t) chunk_downloader->column_count)) {
+        log_warn("Unable to allocate decoded columns, values are converted when they are read");
+    }
+}
+
+/**
+ * Downloads a chunk with the curl handle of the worker and parses the rows while they arrive. The handle
+ * is not reset between chunks, so its connection stays open for the next chunk.
+ *
+ * A spilled chunk is written to its spill file as received instead, still compressed, and parsed once the
+ * consumer gets there.
+ *
+ * Failed transfers and retryable http codes are retried up to max_retries times with decorrelated jitter
+ * in between. The rows parsed by a failed attempt are kept and a retry asks for the rest of the body only,
+ * unless the body is compressed in transfer. If the server sends the whole body anyway, we skip what we
+ * already have.
+ *
+ * If worker->range_count is set, the chunk is fetched in byte ranges first and whole if that fails.
+ */
+static sf_bool STDCALL download_chunk(SF_CHUNK_WORKER *worker, SF_QUEUE_ITEM *item, sf_bool spill,
+                                      SF_ROWSET **chunk, SF_ERROR_STRUCT *error) {
+    SF_CHUNK_DOWNLOADER *chunk_downloader = worker->chunk_downloader;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+    sf_bool retry;
+    sf_bool is_expired;
+    sf_bool resume = SF_BOOLEAN_TRUE;
+    uint64 url_refreshes = 0;
+    CURLcode res;
+    char msg[1024];
+    char range[32];
+    char path[MAX_PATH];
+    CHUNK_WRITE_CONTEXT context;
+    DECORRELATE_JITTER_BACKOFF djb = {CHUNK_RETRY_BASE_MSEC, CHUNK_RETRY_CAP_MSEC};
+    uint32 sleep_msec = CHUNK_RETRY_BASE_MSEC;
+    sf_bool arrow_format = chunk_downloader->arrow_format;
+    const char **parse_error = arrow_format ? &worker->arrow_reader.error_msg : &worker->parser.error_msg;
+    const char *range_error = NULL;
+
+    worker->retry_count = 0;
+    worker->resumed_count = 0;
+    worker->is_split = SF_BOOLEAN_FALSE;
+    if (!worker->curl && !init_worker_curl(worker, error)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!take_chunk_url(worker, item, error)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!worker->rowset && !spill && (worker->rowset = rowset_init()) == NULL) {
+        SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_OUT_OF_MEMORY, "Unable to allocate chunk",
+                            SF_SQLSTATE_MEMORY_ALLOCATION_ERROR);
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!spill) {
+        // The parser and the reader keep their buffers from chunk to chunk. The rowset may be a spare.
+        rowset_init_sink(worker->rowset, &worker->parser.sink);
+        rowset_init_sink(worker->rowset, &worker->arrow_reader.sink);
+    }
+    context.curl = worker->curl;
+    context.chunk_downloader = chunk_downloader;
+    context.item = item;
+    context.parser = NULL;
+    context.arrow_reader = NULL;
+    context.spill_file = NULL;
+    context.fed_bytes = 0;
+    context.encoding = CHUNK_ENCODING_IDENTITY;
+    context.spill_encoding = CHUNK_ENCODING_IDENTITY;
+    context.abort_when_ready = !worker->is_refetch;
+    if (spill) {
+        spill_path(chunk_downloader, (uint64) (item - chunk_downloader->queue), path, sizeof(path));
+        if ((context.spill_file = fopen(path, "wb")) == NULL) {
+            sb_sprintf(msg, sizeof(msg), "Unable to create spill file %s", path);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_GENERAL, msg, SF_SQLSTATE_GENERAL_ERROR);
+            return SF_BOOLEAN_FALSE;
+        }
+    } else if (arrow_format) {
+        // Drop the rows of a chunk that failed for good
+        arrow_reader_reset(&worker->arrow_reader);
+        context.arrow_reader = &worker->arrow_reader;
+    } else {
+        rowset_parser_reset(&worker->parser);
+        context.parser = &worker->parser;
+    }
+    if (!spill) {
+        // Size the rowset up front, like the last chunk or the body, so it doesn't grow value by value.
+        // It still grows if that wasn't enough.
+        if (worker->row_arena_bytes > 0) {
+            rowset_reserve(worker->rowset,
+                           (size_t) ((uint64) item->row_count * worker->row_arena_bytes * 9 / 8),
+                           (size_t) ((uint64) item->row_count * worker->row_cells),
+                           item->row_count);
+        } else {
+            rowset_reserve(worker->rowset, (size_t) item->uncompressed_size, 0, item->row_count);
+        }
+    }
+
+    if (!spill && worker->range_count > 1) {
+        if (download_chunk_ranges(worker, item, &range_error)) {
+            worker->is_split = SF_BOOLEAN_TRUE;
+            ret = SF_BOOLEAN_TRUE;
+            goto cleanup;
+        }
+        log_warn("Unable to fetch chunk %llu in ranges, fetching it whole: %s",
+                 (unsigned long long) (item - chunk_downloader->queue), range_error);
+        // Drop the rows of the ranges fed so far
+        if (arrow_format) {
+            arrow_reader_reset(&worker->arrow_reader);
+        } else {
+            rowset_parser_reset(&worker->parser);
+        }
+    }
+
+    // Spilled chunks are kept as received, in an encoding we can read back
+    if ((res = curl_easy_setopt(worker->curl, CURLOPT_HTTP_CONTENT_DECODING, spill ? 0L : 1L)) != CURLE_OK ||
+        (res = curl_easy_setopt(worker->curl, CURLOPT_ACCEPT_ENCODING, spill ? "gzip, deflate" : "")) != CURLE_OK) {
+        sb_sprintf(msg, sizeof(msg), "Unable to set chunk encoding: %s", curl_easy_strerror(res));
+        SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+        goto cleanup;
+    }
+
+    do {
+        retry = SF_BOOLEAN_FALSE;
+        is_expired = SF_BOOLEAN_FALSE;
+        // Ask for the rest of the body only if the byte offsets of the last response were ours
+        range[0] = '\0';
+        if (context.fed_bytes > 0 && resume && (spill || context.encoding == CHUNK_ENCODING_IDENTITY)) {
+            sb_sprintf(range, sizeof(range), "%llu-", (unsigned long long) context.fed_bytes);
+            worker->resumed_count++;
+        }
+        context.http_code = 0;
+        context.skip_bytes = 0;
+        context.range_start = -1;
+        context.range_total = -1;
+        context.encoding = CHUNK_ENCODING_IDENTITY;
+        context.is_range_mismatch = SF_BOOLEAN_FALSE;
+
+        if ((res = curl_easy_setopt(worker->curl, CURLOPT_URL, worker->url)) != CURLE_OK ||
+            (res = curl_easy_setopt(worker->curl, CURLOPT_RANGE, range[0] ? range : NULL)) != CURLE_OK ||
+            (res = curl_easy_setopt(worker->curl, CURLOPT_WRITEDATA, (void *) &context)) != CURLE_OK ||
+            (res = curl_easy_setopt(worker->curl, CURLOPT_HEADERDATA, (void *) &context)) != CURLE_OK ||
+            (res = curl_easy_setopt(worker->curl, CURLOPT_XFERINFODATA, (void *) &context)) != CURLE_OK) {
+            sb_sprintf(msg, sizeof(msg), "Unable to set chunk URL: %s", curl_easy_strerror(res));
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+            break;
+        }
+
+        res = curl_easy_perform(worker->curl);
+        if (res == CURLE_WRITE_ERROR && !spill && *parse_error) {
+            sb_sprintf(msg, sizeof(msg), "Unable to parse chunk: %s", *parse_error);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, arrow_format ? SF_STATUS_ERROR_BAD_RESPONSE : SF_STATUS_ERROR_BAD_JSON,
+                                msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (res == CURLE_WRITE_ERROR && context.is_range_mismatch) {
+            retry = SF_BOOLEAN_TRUE;
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, "Received partial chunk from the wrong offset",
+                                SF_SQLSTATE_UNABLE_TO_CONNECT);
+            if (!spill) {
+                // Start over from the first byte, skipping what we already have
+                resume = SF_BOOLEAN_FALSE;
+            } else if ((context.spill_file = freopen(path, "wb", context.spill_file)) != NULL) {
+                // The bytes on disk can't be skipped in another encoding, so they are written again
+                context.fed_bytes = 0;
+            } else {
+                retry = SF_BOOLEAN_FALSE;
+                SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_GENERAL, "Unable to rewrite spill file",
+                                    SF_SQLSTATE_GENERAL_ERROR);
+            }
+        } else if (res == CURLE_WRITE_ERROR && spill) {
+            sb_sprintf(msg, sizeof(msg), "Unable to write spill file %s", path);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_GENERAL, msg, SF_SQLSTATE_GENERAL_ERROR);
+        } else if (res != CURLE_OK) {
+            if (res == CURLE_SSL_CACERT_BADFILE) {
+                sb_sprintf(msg, sizeof(msg), "curl_easy_perform() failed. err: %s, CA Cert file: %s",
+                           curl_easy_strerror(res), CA_BUNDLE_FILE ? CA_BUNDLE_FILE : "Not Specified");
+            } else {
+                sb_sprintf(msg, sizeof(msg), "curl_easy_perform() failed: %s", curl_easy_strerror(res));
+            }
+            retry = is_retryable_curl_code(res);
+            if (!retry) {
+                log_error(msg);
+            }
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (context.http_code == 0 &&
+                   curl_easy_getinfo(worker->curl, CURLINFO_RESPONSE_CODE, &context.http_code) != CURLE_OK) {
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_CURL, "Unable to get http response code",
+                                SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (context.http_code == 416 && range[0]) {
+            // The failed attempt got the whole body after all. Start over to see where it ends.
+            resume = SF_BOOLEAN_FALSE;
+            retry = SF_BOOLEAN_TRUE;
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_RETRY, "Received http code 416 for the rest of the chunk",
+                                SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (context.http_code == 403 && chunk_downloader->url_refresh &&
+                   url_refreshes < CHUNK_MAX_URL_REFRESHES) {
+            // Presigned URLs expire. The chunk is fetched again with a fresh one, which isn't a retry.
+            is_expired = SF_BOOLEAN_TRUE;
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_RETRY, "Chunk URL expired", SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (context.http_code != 200 && context.http_code != 206) {
+            retry = is_retryable_http_code(context.http_code);
+            sb_sprintf(msg, sizeof(msg), "Received %s http code %ld",
+                       retry ? "retryable" : "unretryable", context.http_code);
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_RETRY, msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else if (spill) {
+            ret = SF_BOOLEAN_TRUE;
+        } else if (arrow_format ? !arrow_reader_finish(&worker->arrow_reader)
+                                : !rowset_parser_finish(&worker->parser)) {
+            sb_sprintf(msg, sizeof(msg), "Unable to parse chunk: %s", *parse_error);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, arrow_format ? SF_STATUS_ERROR_BAD_RESPONSE : SF_STATUS_ERROR_BAD_JSON,
+                                msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+        } else {
+            ret = SF_BOOLEAN_TRUE;
+        }
+
+        if (is_expired) {
+            url_refreshes++;
+            log_warn("URL of chunk %llu expired, waiting for a fresh one",
+                     (unsigned long long) (item - chunk_downloader->queue));
+            retry = wait_for_fresh_url(worker, item, context.abort_when_ready) &&
+                    take_chunk_url(worker, item, error);
+        } else if (retry && worker->retry_count >= chunk_downloader->max_retries) {
+            sb_sprintf(msg, sizeof(msg), "Giving up on chunk after %llu retries: %s",
+                       (unsigned long long) worker->retry_count, error->msg);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, error->error_code, msg, SF_SQLSTATE_UNABLE_TO_CONNECT);
+            retry = SF_BOOLEAN_FALSE;
+        } else if (retry) {
+            worker->retry_count++;
+            sleep_msec = decorrelate_jitter_next_sleep(&djb, sleep_msec);
+            log_warn("Retrying chunk in %u ms after %llu bytes: %s", sleep_msec,
+                     (unsigned long long) context.fed_bytes, error->msg);
+            retry = wait_for_retry(chunk_downloader, item, context.abort_when_ready, sleep_msec);
+        }
+    } while (retry);
+
+cleanup:
+    if (context.spill_file) {
+        if (fclose(context.spill_file) != 0 && ret) {
+            sb_sprintf(msg, sizeof(msg), "Unable to write spill file %s", path);
+            log_error(msg);
+            SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_GENERAL, msg, SF_SQLSTATE_GENERAL_ERROR);
+            ret = SF_BOOLEAN_FALSE;
+        }
+    }
+    if (spill && !ret) {
+        remove(path);
+    }
+
+    if (ret) {
+        // Forget the failed attempts
+        clear_snowflake_error(error);
+        if (spill) {
+            worker->spill_bytes = context.fed_bytes;
+            worker->spill_encoding = context.spill_encoding;
+        } else {
+            // Hand over the rowset, the next chunk gets a spare or a new one
+            if (worker->rowset->row_count > 0) {
+                worker->row_arena_bytes = (uint64) worker->rowset->arena_used / (uint64) worker->rowset->row_count;
+                worker->row_cells = (uint64) worker->rowset->cell_count / (uint64) worker->rowset->row_count;
+            }
+            rowset_trim(worker->rowset);
+            decode_chunk(chunk_downloader, worker->rowset);
+            *chunk = worker->rowset;
+            worker->rowset = NULL;
+        }
+    }
+
+    return ret;
+}
+
+/**
+ * Sets up the scheduler for the chunks in the queue and allocates the workers. Workers beyond the initial
+ * thread count are started by the scheduler.
+ */
+static sf_bool STDCALL alloc_workers(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                     uint64 thread_count,
+                                     uint64 fetch_slots,
+                                     uint64 max_thread_count) {
+    // There is no point in having more threads than chunks
+    if (max_thread_count < thread_count) {
+        max_thread_count = thread_count;
+    }
+    if (max_thread_count > chunk_downloader->queue_size) {
+        max_thread_count = chunk_downloader->queue_size > 0 ? chunk_downloader->queue_size : 1;
+    }
+    if (thread_count > max_thread_count) {
+        thread_count = max_thread_count;
+    }
+    chunk_downloader->max_thread_count = max_thread_count;
+    chunk_downloader->active_thread_count = thread_count;
+    chunk_downloader->min_prefetch_window = fetch_slots;
+    chunk_downloader->prefetch_window = fetch_slots > thread_count ? fetch_slots : thread_count;
+
+    chunk_downloader->workers = (SF_CHUNK_WORKER *) SF_CALLOC((size_t) max_thread_count, sizeof(SF_CHUNK_WORKER));
+    return chunk_downloader->workers != NULL;
+}
+
+/**
+ * Joins the memory budget and starts the initial worker threads.
+ */
+static sf_bool STDCALL start_workers(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    uint64 i;
+
+    memory_budget_register(chunk_downloader);
+
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    for (i = 0; i < chunk_downloader->active_thread_count; i++) {
+        if (!start_worker(chunk_downloader)) {
+            _critical_section_unlock(&chunk_downloader->queue_lock);
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+    return SF_BOOLEAN_TRUE;
+}
+
+SF_CHUNK_DOWNLOADER *STDCALL chunk_downloader_init(const char *qrmk,
+                                                   cJSON *chunk_headers,
+                                                   cJSON *chunks,
+                                                   const SF_CHUNK_DOWNLOADER_OPTIONS *options,
+                                                   SF_ERROR_STRUCT *sf_error) {
+    struct SF_CHUNK_DOWNLOADER *chunk_downloader = NULL;
+    SF_CHUNK_DOWNLOADER_OPTIONS defaults;
+    int chunk_count;
+    uint64 i;
+    size_t qrmk_len = 1;
+    SF_ROWSET_SINK sink;
+    sf_bool has_locks = SF_BOOLEAN_FALSE;
+    // We need chunks, and either qrmk or chunk_headers
+    if (!chunks ||
+            !snowflake_cJSON_IsArray(chunks) ||
+            strcmp(chunks->string, "chunks") != 0) {
+        return NULL;
+    }
+    if (!options) {
+        memset(&defaults, 0, sizeof(defaults));
+        options = &defaults;
+    }
+
+    if ((chunk_downloader = (SF_CHUNK_DOWNLOADER *) SF_CALLOC(1, sizeof(SF_CHUNK_DOWNLOADER))) == NULL) {
+        return NULL;
+    }
+
+    // Initialize default values
+    chunk_downloader->workers = NULL;
+    chunk_downloader->queue = NULL;
+    chunk_downloader->qrmk = NULL;
+    chunk_downloader->chunk_headers = sf_header_create();
+    chunk_downloader->thread_count = 0;
+    chunk_downloader->queue_size = 0;
+    chunk_downloader->producer_head = 0;
+    chunk_downloader->consumer_head = 0;
+    chunk_downloader->is_shutdown = SF_BOOLEAN_FALSE;
+    chunk_downloader->has_error = SF_BOOLEAN_FALSE;
+    chunk_downloader->sf_error = sf_error;
+    chunk_downloader->insecure_mode = options->insecure_mode;
+    chunk_downloader->arrow_format = options->arrow_format;
+    chunk_downloader->hedging = options->hedging;
+    chunk_downloader->hedge_index = -1;
+    chunk_downloader->max_retries = options->max_retries;
+    chunk_downloader->range_split_bytes = options->range_split_bytes;
+    chunk_downloader->url_refresh = options->url_refresh;
+    chunk_downloader->url_refresh_ctx = options->url_refresh_ctx;
+    chunk_downloader->first_chunk = options->first_chunk;
+    chunk_downloader->spill_ratio = CHUNK_DEFAULT_SPILL_RATIO;
+    // The sink is set up for each spilled chunk
+    memset(&sink, 0, sizeof(sink));
+    rowset_parser_init(&chunk_downloader->spill_parser, &sink);
+    arrow_reader_init(&chunk_downloader->spill_reader, &sink);
+    chunk_downloader->scrollable = options->scrollable;
+    chunk_downloader->refetch_worker.chunk_downloader = chunk_downloader;
+    chunk_downloader->refetch_worker.is_refetch = SF_BOOLEAN_TRUE;
+    rowset_parser_init(&chunk_downloader->refetch_worker.parser, &sink);
+    arrow_reader_init(&chunk_downloader->refetch_worker.arrow_reader, &sink);
+
+    if (options->spill_dir && *options->spill_dir && options->max_spill_bytes > 0) {
+        if (sf_create_directory_if_not_exists(options->spill_dir) != 0) {
+            log_warn("Unable to create chunk spill directory %s, chunks are only prefetched into memory",
+                     options->spill_dir);
+        } else {
+            chunk_downloader->spill_dir = (char *) SF_CALLOC(1, strlen(options->spill_dir) + 1);
+            if (!chunk_downloader->spill_dir) {
+                goto cleanup;
+            }
+            sb_strcpy(chunk_downloader->spill_dir, strlen(options->spill_dir) + 1, options->spill_dir);
+            uuid4_generate(chunk_downloader->spill_prefix);
+            chunk_downloader->max_spill_bytes = options->max_spill_bytes;
+        }
+    }
+
+    if (options->decode_columns && options->column_count > 0) {
+        chunk_downloader->column_types = (SF_C_TYPE *) SF_CALLOC((size_t) options->column_count, sizeof(SF_C_TYPE));
+        if (!chunk_downloader->column_types) {
+            goto cleanup;
+        }
+        for (i = 0; i < options->column_count; i++) {
+            chunk_downloader->column_types[i] = options->decode_columns[i].c_type;
+        }
+        chunk_downloader->column_count = options->column_count;
+    }
+
+    // Initialize chunk_headers or qrmk
+    if (chunk_headers) {
+        if(!create_chunk_headers(chunk_downloader, chunk_headers)) {
+            goto cleanup;
+        }
+    } else if (qrmk) {
+        qrmk_len += strlen(qrmk);
+        chunk_downloader->qrmk = (char *) SF_CALLOC(1, qrmk_len);
+        sb_strncpy(chunk_downloader->qrmk, qrmk_len, qrmk, qrmk_len);
+    }
+
+    // Initialize mutexes and conditional variables
+    if (!init_locks(chunk_downloader)) {
+        goto cleanup;
+    }
+    has_locks = SF_BOOLEAN_TRUE;
+
+    // Initialize queue memory
+    chunk_count = snowflake_cJSON_GetArraySize(chunks);
+    chunk_downloader->queue = (SF_QUEUE_ITEM *) SF_CALLOC(chunk_count, sizeof(SF_QUEUE_ITEM));
+    if (!chunk_downloader->queue) {
+        goto cleanup;
+    }
+
+    // Fill up queue
+    if (!fill_queue(chunk_downloader, chunks, chunk_count)) {
+        goto cleanup;
+    }
+
+    chunk_downloader->max_prefetch_bytes = options->max_prefetch_bytes;
+    chunk_downloader->memory_budget = options->memory_budget;
+
+    // Share DNS and TLS sessions between the workers even if the connection doesn't share them across statements
+    chunk_downloader->share = options->share;
+    chunk_downloader->owns_share = SF_BOOLEAN_FALSE;
+    if (!options->share) {
+        chunk_downloader->share = chunk_share_init();
+        chunk_downloader->owns_share = SF_BOOLEAN_TRUE;
+    }
+
+    if (!alloc_workers(chunk_downloader,
+                       options->thread_count > 0 ? options->thread_count : 1,
+                       options->fetch_slots > 0 ? options->fetch_slots : 1,
+                       options->max_thread_count)) {
+        goto cleanup;
+    }
+    // If we can't start a thread, terminate chunk downloader
+    if (!start_workers(chunk_downloader)) {
+        chunk_downloader_term(chunk_downloader);
+        return NULL;
+    }
+
+    return chunk_downloader;
+
+cleanup:
+    if (chunk_downloader) {
+        SF_FREE(chunk_downloader->qrmk);
+        sf_header_destroy(chunk_downloader->chunk_headers);
+        if (chunk_downloader->queue) {
+            for (i = 0; i < chunk_downloader->queue_size; i++) {
+                SF_FREE(chunk_downloader->queue[i].url);
+            }
+        }
+        SF_FREE(chunk_downloader->queue);
+        // No worker was started, but tear them down like the threads would
+        if (chunk_downloader->workers) {
+            for (i = 0; i < chunk_downloader->max_thread_count; i++) {
+                term_worker(&chunk_downloader->workers[i]);
+            }
+        }
+        SF_FREE(chunk_downloader->workers);
+        term_worker(&chunk_downloader->refetch_worker);
+        if (chunk_downloader->owns_share) {
+            chunk_share_term(chunk_downloader->share);
+        }
+        rowset_parser_term(&chunk_downloader->spill_parser);
+        arrow_reader_term(&chunk_downloader->spill_reader);
+        SF_FREE(chunk_downloader->spill_dir);
+        SF_FREE(chunk_downloader->column_types);
+        if (has_locks) {
+            term_locks(chunk_downloader);
+        }
+    }
+    SF_FREE(chunk_downloader);
+
+    return NULL;
+}
+
+/**
+ * Starts the next worker thread. Must be called with the queue_lock held.
+ */
+static sf_bool STDCALL start_worker(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    const char *error_msg = NULL;
+    int pthread_ret;
+    SF_CHUNK_WORKER *worker;
+    SF_ROWSET_SINK sink;
+
+    if (chunk_downloader->thread_count >= chunk_downloader->max_thread_count) {
+        return SF_BOOLEAN_TRUE;
+    }
+
+    worker = &chunk_downloader->workers[chunk_downloader->thread_count];
+    worker->chunk_downloader = chunk_downloader;
+    worker->index = chunk_downloader->thread_count;
+    worker->curl = NULL;
+    worker->rowset = NULL;
+    // The sink is set up for each chunk
+    memset(&sink, 0, sizeof(sink));
+    rowset_parser_init(&worker->parser, &sink);
+    arrow_reader_init(&worker->arrow_reader, &sink);
+    if ((pthread_ret = _thread_init(&worker->thread, chunk_downloader_thread, (void *) worker)) != 0) {
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            PTHREAD_CREATE_ERROR_MSG(pthread_ret, error_msg);
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        return SF_BOOLEAN_FALSE;
+    }
+    log_debug("Started chunk downloader thread %llu", worker->index);
+
+    chunk_downloader->thread_count++;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Aggregate download throughput in bytes per second with the current number of active threads.
+ */
+static uint64 STDCALL get_throughput(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    if (chunk_downloader->download_usec == 0 || chunk_downloader->downloaded_chunks == 0) {
+        return 0;
+    }
+    return chunk_downloader->downloaded_bytes / chunk_downloader->downloaded_chunks *
+           chunk_downloader->active_thread_count * 1000000 / chunk_downloader->download_usec;
+}
+
+/**
+ * Recomputes the number of active threads and the prefetch window from the measured time it takes to
+ * download a chunk versus the time the consumer spends on one. Threads are added one at a time and
+ * only kept if the aggregate throughput increases, so we don't keep adding threads on a saturated link.
+ * Must be called with the queue_lock held.
+ */
+static void STDCALL adjust_schedule(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    uint64 target;
+    uint64 budget;
+    uint64 budget_chunks;
+    uint64 throughput;
+    uint64 active_thread_count = chunk_downloader->active_thread_count;
+    uint64 consume_usec = (uint64) _atomic_load(&chunk_downloader->consume_usec);
+    uint64 prefetch_window;
+
+    // We need both rates before we can compare them
+    if (chunk_downloader->download_usec == 0 || consume_usec == 0 ||
+        get_shutdown_or_error(chunk_downloader)) {
+        return;
+    }
+
+    throughput = get_throughput(chunk_downloader);
+
+    // Check if the last thread we added paid off once every thread has downloaded a chunk or two
+    if (chunk_downloader->throughput_before_grow > 0) {
+        if (chunk_downloader->chunks_since_grow < 2 * active_thread_count) {
+            return;
+        }
+        if (throughput < chunk_downloader->throughput_before_grow + chunk_downloader->throughput_before_grow / 10) {
+            log_debug("Chunk download throughput didn't increase with %llu threads", active_thread_count);
+            active_thread_count--;
+            chunk_downloader->useful_thread_count = active_thread_count;
+            chunk_downloader->chunks_since_probe = 0;
+        }
+        chunk_downloader->throughput_before_grow = 0;
+    }
+
+    // Number of concurrent downloads needed to download chunks as fast as the consumer drains them
+    target = (chunk_downloader->download_usec + consume_usec - 1) / consume_usec;
+
+    // Stay below the thread count that didn't help last time, but probe again every so often
+    if (chunk_downloader->useful_thread_count > 0) {
+        if (chunk_downloader->chunks_since_probe >= CHUNK_SCHEDULER_PROBE_INTERVAL) {
+            chunk_downloader->useful_thread_count = 0;
+        } else if (target > chunk_downloader->useful_thread_count) {
+            target = chunk_downloader->useful_thread_count;
+        }
+    }
+
+    // Every download in flight will end up in memory, so don't plan for more than fits in the budget.
+    // One chunk of the budget is held by the consumer.
+    budget = chunk_downloader->max_prefetch_bytes;
+    if (chunk_downloader->memory_budget) {
+        _critical_section_lock(&chunk_downloader->memory_budget->lock);
+        if (chunk_downloader->memory_budget->limit > 0 &&
+            (budget == 0 || chunk_downloader->memory_budget->limit < budget)) {
+            budget = chunk_downloader->memory_budget->limit;
+        }
+        _critical_section_unlock(&chunk_downloader->memory_budget->lock);
+    }
+    if (chunk_downloader->avg_footprint > 0 && budget > 0) {
+        budget_chunks = budget / chunk_downloader->avg_footprint;
+        if (target + 1 > budget_chunks) {
+            target = budget_chunks > 1 ? budget_chunks - 1 : 1;
+        }
+    }
+
+    if (target < 1) {
+        target = 1;
+    }
+    if (target > chunk_downloader->max_thread_count) {
+        target = chunk_downloader->max_thread_count;
+    }
+
+    if (target > active_thread_count) {
+        // Grow one thread at a time so we can measure if it helped
+        chunk_downloader->throughput_before_grow = throughput > 0 ? throughput : 1;
+        chunk_downloader->chunks_since_grow = 0;
+        active_thread_count++;
+        while (chunk_downloader->thread_count < active_thread_count) {
+            if (!start_worker(chunk_downloader)) {
+                break;
+            }
+        }
+    } else if (target < active_thread_count) {
+        active_thread_count--;
+    }
+
+    if (active_thread_count != chunk_downloader->active_thread_count) {
+        log_debug("Chunk downloader using %llu threads", active_thread_count);
+    }
+    chunk_downloader->active_thread_count = active_thread_count;
+    // Enough slots for one chunk in flight and one waiting per thread
+    prefetch_window = 2 * active_thread_count;
+    if (prefetch_window < chunk_downloader->min_prefetch_window) {
+        prefetch_window = chunk_downloader->min_prefetch_window;
+    }
+    _atomic_store(&chunk_downloader->prefetch_window, (long long) prefetch_window);
+
+    // Parked threads might be allowed to run now
+    _cond_broadcast(&chunk_downloader->producer_cond);
+}
+
+/**
+ * Reserves memory for the chunk at producer_head if the scheduler allows this worker to download it.
+ * A chunk that doesn't fit in memory yet is spilled instead while there is disk space for it, so its URL
+ * doesn't expire while the consumer catches up.
+ * Must be called with the queue_lock held and producer_head < queue_size.
+ *
+ * @return CHUNK_TASK_DOWNLOAD or CHUNK_TASK_SPILL if the worker may download the chunk, CHUNK_TASK_WAIT if not
+ */
+static CHUNK_TASK STDCALL reserve_next_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_CHUNK_WORKER *worker) {
+    SF_QUEUE_ITEM *item;
+    uint64 footprint;
+    uint64 spill_bytes;
+    // The consumer only ever lowers these, so it's safe to decide on a stale value
+    uint64 prefetch_bytes = (uint64) _atomic_load(&chunk_downloader->prefetch_bytes);
+
+    if (worker->index >= chunk_downloader->active_thread_count) {
+        return CHUNK_TASK_WAIT;
+    }
+
+    item = &chunk_downloader->queue[chunk_downloader->producer_head];
+    if (chunk_downloader->producer_head - (uint64) _atomic_load(&chunk_downloader->consumer_head) <
+        (uint64) chunk_downloader->prefetch_window) {
+        footprint = estimate_footprint(chunk_downloader, item);
+
+        // A chunk is always downloaded once nothing else of this statement is in memory, or once the consumer
+        // waits for it, so a chunk larger than what is left of the budget doesn't stall the results. The
+        // chunks a scrollable result keeps count against the budget until they are evicted.
+        if (prefetch_bytes == 0 ||
+            chunk_downloader->producer_head == (uint64) _atomic_load(&chunk_downloader->consumer_head)) {
+            memory_budget_reserve(chunk_downloader, footprint, SF_BOOLEAN_TRUE);
+            item->footprint = footprint;
+            _atomic_add(&chunk_downloader->prefetch_bytes, (long long) footprint);
+            return CHUNK_TASK_DOWNLOAD;
+        }
+        if ((chunk_downloader->max_prefetch_bytes == 0 ||
+             prefetch_bytes + footprint <= chunk_downloader->max_prefetch_bytes) &&
+            memory_budget_reserve(chunk_downloader, footprint, SF_BOOLEAN_FALSE)) {
+            item->footprint = footprint;
+            _atomic_add(&chunk_downloader->prefetch_bytes, (long long) footprint);
+            return CHUNK_TASK_DOWNLOAD;
+        }
+    }
+
+    if (chunk_downloader->spill_dir) {
+        spill_bytes = item->uncompressed_size * chunk_downloader->spill_ratio / 256;
+        if ((uint64) _atomic_load(&chunk_downloader->spill_bytes) + spill_bytes <= chunk_downloader->max_spill_bytes) {
+            item->spill_bytes = spill_bytes;
+            _atomic_add(&chunk_downloader->spill_bytes, (long long) spill_bytes);
+            return CHUNK_TASK_SPILL;
+        }
+    }
+    return CHUNK_TASK_WAIT;
+}
+
+/**
+ * Deletes the spill file of a chunk and gives back its disk space.
+ */
+static void STDCALL discard_spill(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index) {
+    SF_QUEUE_ITEM *item = &chunk_downloader->queue[index];
+    char path[MAX_PATH];
+
+    spill_path(chunk_downloader, index, path, sizeof(path));
+    remove(path);
+    _atomic_add(&chunk_downloader->spill_bytes, -(long long) item->spill_bytes);
+    item->spill_bytes = 0;
+    item->is_spilled = SF_BOOLEAN_FALSE;
+}
+
+/**
+ * Replaces the estimated footprint of a downloaded chunk with the measured one and learns from the difference
+ * for the next estimates. Must be called with the queue_lock held.
+ */
+static void STDCALL update_footprint(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_QUEUE_ITEM *item, uint64 footprint) {
+    _atomic_add(&chunk_downloader->prefetch_bytes, (long long) footprint - (long long) item->footprint);
+    if (footprint > item->footprint) {
+        memory_budget_reserve(chunk_downloader, footprint - item->footprint, SF_BOOLEAN_TRUE);
+    } else {
+        memory_budget_release(chunk_downloader, item->footprint - footprint);
+    }
+    item->footprint = footprint;
+
+    if (item->uncompressed_size > 0) {
+        chunk_downloader->footprint_ratio = CHUNK_EWMA(chunk_downloader->footprint_ratio,
+                                                       footprint * 256 / item->uncompressed_size);
+    }
+    if (item->row_count > 0) {
+        chunk_downloader->row_footprint = CHUNK_EWMA(chunk_downloader->row_footprint,
+                                                     footprint / (uint64) item->row_count);
+    }
+    chunk_downloader->avg_footprint = CHUNK_EWMA(chunk_downloader->avg_footprint, footprint);
+}
+
+static int compare_usec(const void *a, const void *b) {
+    uint64 x = *(const uint64 *) a;
+    uint64 y = *(const uint64 *) b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Adds the download time of a chunk to the samples and recomputes the hedge deadline.
+ * Must be called with the queue_lock held.
+ */
+static void STDCALL record_latency(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 usec) {
+    uint64 sorted[SF_CHUNK_LATENCY_SAMPLES];
+    uint64 count;
+    uint64 deadline;
+
+    chunk_downloader->latency_samples[chunk_downloader->latency_sample_count++ % SF_CHUNK_LATENCY_SAMPLES] = usec;
+    count = chunk_downloader->latency_sample_count < SF_CHUNK_LATENCY_SAMPLES ?
+            chunk_downloader->latency_sample_count : SF_CHUNK_LATENCY_SAMPLES;
+    if (count < CHUNK_HEDGE_MIN_SAMPLES) {
+        return;
+    }
+
+    memcpy(sorted, chunk_downloader->latency_samples, (size_t) count * sizeof(uint64));
+    qsort(sorted, (size_t) count, sizeof(uint64), compare_usec);
+    deadline = sorted[(count - 1) * CHUNK_HEDGE_PERCENTILE / 100];
+    chunk_downloader->stats.hedge_deadline_usec = deadline > CHUNK_HEDGE_MIN_DEADLINE_USEC ?
+                                                  deadline : CHUNK_HEDGE_MIN_DEADLINE_USEC;
+}
+
+/**
+ * Picks the next thing for a worker to do. A second request for a straggling chunk goes first since the
+ * consumer is waiting for it. Must be called with the queue_lock held.
+ *
+ * @param index the chunk to download, unless the worker has to wait or exit
+ */
+static CHUNK_TASK STDCALL next_task(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_CHUNK_WORKER *worker,
+                                    uint64 *index) {
+    SF_QUEUE_ITEM *item;
+    CHUNK_TASK task;
+
+    worker->range_count = 0;
+    if (get_shutdown_or_error(chunk_downloader)) {
+        return CHUNK_TASK_EXIT;
+    }
+
+    if (chunk_downloader->hedge_index >= 0) {
+        *index = (uint64) chunk_downloader->hedge_index;
+        item = &chunk_downloader->queue[*index];
+        chunk_downloader->hedge_index = -1;
+        // Not needed if the first request finished in the meantime
+        if (!_atomic_load(&item->ready) && item->downloads > 0) {
+            item->downloads++;
+            chunk_downloader->stats.hedged_count++;
+            return CHUNK_TASK_HEDGE;
+        }
+    }
+
+    // Once everything was handed out, wait for the chunks still downloading in case they need a hedge
+    if (chunk_downloader->producer_head >= chunk_downloader->queue_size) {
+        return chunk_downloader->downloading_count > 0 ? CHUNK_TASK_WAIT : CHUNK_TASK_EXIT;
+    }
+    if ((task = reserve_next_chunk(chunk_downloader, worker)) == CHUNK_TASK_WAIT) {
+        return CHUNK_TASK_WAIT;
+    }
+
+    *index = chunk_downloader->producer_head++;
+    item = &chunk_downloader->queue[*index];
+    item->start_usec = sf_get_monotonic_time_usec();
+    item->downloads++;
+    chunk_downloader->downloading_count++;
+
+    // A consumer waiting for this chunk starts the hedge timer
+    if (chunk_downloader->hedging && chunk_downloader->is_consumer_waiting &&
+        *index == (uint64) _atomic_load(&chunk_downloader->consumer_head)) {
+        _cond_signal(&chunk_downloader->consumer_cond);
+    }
+
+    // Nothing else is ahead of a large chunk the consumer is about to wait for, so it gets the connections
+    // of the threads that are not downloading
+    if (task == CHUNK_TASK_DOWNLOAD && chunk_downloader->range_split_bytes > 0 &&
+        item->uncompressed_size >= chunk_downloader->range_split_bytes &&
+        *index == (uint64) _atomic_load(&chunk_downloader->consumer_head) &&
+        chunk_downloader->max_thread_count > chunk_downloader->downloading_count) {
+        worker->range_count = chunk_downloader->max_thread_count - chunk_downloader->downloading_count + 1;
+    }
+    return task;
+}
+
+/**
+ * Hedges the chunk the consumer waits for once it takes longer than the hedge deadline, i.e. lets the next
+ * free worker send a second request for it. Whichever request finishes first wins and the other one is
+ * aborted. Must be called with the queue_lock held.
+ *
+ * @return milliseconds until the chunk has to be checked again, 0 if it doesn't
+ */
+static unsigned long STDCALL hedge_straggler(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index) {
+    SF_QUEUE_ITEM *item = &chunk_downloader->queue[index];
+    uint64 deadline = chunk_downloader->stats.hedge_deadline_usec;
+    uint64 elapsed;
+
+    if (!chunk_downloader->hedging || item->is_hedged || item->downloads == 0 || deadline == 0) {
+        return 0;
+    }
+
+    elapsed = sf_get_monotonic_time_usec() - item->start_usec;
+    if (elapsed < deadline) {
+        return (unsigned long) ((deadline - elapsed) / 1000 + 1);
+    }
+
+    log_info("Chunk %llu is taking %llu ms, sending a second request for it", index, elapsed / 1000);
+    item->is_hedged = SF_BOOLEAN_TRUE;
+    chunk_downloader->hedge_index = (int64) index;
+    // Every worker is busy, so add one if we may
+    if (_atomic_load(&chunk_downloader->parked_thread_count) == 0) {
+        start_worker(chunk_downloader);
+    }
+    _cond_broadcast(&chunk_downloader->producer_cond);
+    return 0;
+}
+
+void STDCALL chunk_downloader_get_stats(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_CHUNK_STATS *stats) {
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    *stats = chunk_downloader->stats;
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+}
+
+/**
+ * Wakes up the workers parked because the prefetch window or the byte budget was full, and reschedules
+ * since the consumer rate changed. Must be called with the queue_lock held.
+ */
+static sf_bool STDCALL wake_parked_workers(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    chunk_downloader->handoffs_since_wake = 0;
+    adjust_schedule(chunk_downloader);
+    if (_cond_broadcast(&chunk_downloader->producer_cond)) {
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!get_error(chunk_downloader)) {
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD,
+                                "Unable to send signal using produce_cond", "");
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        return SF_BOOLEAN_FALSE;
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Passes part of a spilled chunk to the rowset parser or the Arrow reader of the consumer
+ */
+static sf_bool STDCALL feed_spilled_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, const char *data, size_t len) {
+    if (chunk_downloader->arrow_format) {
+        return arrow_reader_feed(&chunk_downloader->spill_reader, data, len);
+    }
+    return rowset_parser_feed(&chunk_downloader->spill_parser, data, len);
+}
+
+/**
+ * Parses a spilled chunk on the consumer thread and deletes its file, unless the result is scrollable and
+ * the chunk may be read again. The chunk counts against the memory budget from then on, like the chunks
+ * prefetched into memory.
+ */
+static sf_bool STDCALL load_spilled_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index) {
+    SF_QUEUE_ITEM *item = &chunk_downloader->queue[index];
+    SF_MAPPED_FILE mapped;
+    SF_ROWSET *rowset = NULL;
+    z_stream stream;
+    sf_bool is_inflating = SF_BOOLEAN_FALSE;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+    char path[MAX_PATH];
+    char msg[1024];
+    const char *error_msg = NULL;
+    char buffer[CHUNK_INFLATE_BUFFER_SIZE];
+    int zret;
+    uint64 footprint;
+    const char *parse_error;
+
+    spill_path(chunk_downloader, index, path, sizeof(path));
+    if (sf_map_file(path, &mapped) != 0) {
+        sb_sprintf(msg, sizeof(msg), "Unable to read spill file %s", path);
+        log_error(msg);
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_GENERAL, msg, SF_SQLSTATE_GENERAL_ERROR);
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        return SF_BOOLEAN_FALSE;
+    }
+
+    if ((rowset = rowset_init()) == NULL) {
+        error_msg = "Unable to allocate chunk";
+        goto cleanup;
+    }
+    if (chunk_downloader->arrow_format) {
+        rowset_init_sink(rowset, &chunk_downloader->spill_reader.sink);
+        arrow_reader_reset(&chunk_downloader->spill_reader);
+    } else {
+        rowset_init_sink(rowset, &chunk_downloader->spill_parser.sink);
+        rowset_parser_reset(&chunk_downloader->spill_parser);
+    }
+
+    if (item->encoding == CHUNK_ENCODING_IDENTITY) {
+        if (mapped.len > 0 && !feed_spilled_chunk(chunk_downloader, mapped.data, mapped.len)) {
+            goto cleanup;
+        }
+    } else if (item->encoding == CHUNK_ENCODING_ZLIB) {
+        // Inflates gzip and deflate alike
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+            error_msg = "Unable to inflate spilled chunk";
+            goto cleanup;
+        }
+        is_inflating = SF_BOOLEAN_TRUE;
+        stream.next_in = (Bytef *) mapped.data;
+        stream.avail_in = (uInt) mapped.len;
+        do {
+            stream.next_out = (Bytef *) buffer;
+            stream.avail_out = sizeof(buffer);
+            zret = inflate(&stream, Z_NO_FLUSH);
+            if (zret != Z_OK && zret != Z_STREAM_END) {
+                error_msg = "Unable to inflate spilled chunk";
+                goto cleanup;
+            }
+            if (!feed_spilled_chunk(chunk_downloader, buffer, sizeof(buffer) - stream.avail_out)) {
+                goto cleanup;
+            }
+        } while (zret != Z_STREAM_END);
+    } else {
+        error_msg = "Unsupported content encoding of spilled chunk";
+        goto cleanup;
+    }
+    if (chunk_downloader->arrow_format ? !arrow_reader_finish(&chunk_downloader->spill_reader)
+                                       : !rowset_parser_finish(&chunk_downloader->spill_parser)) {
+        goto cleanup;
+    }
+
+    rowset_trim(rowset);
+    decode_chunk(chunk_downloader, rowset);
+    footprint = rowset_footprint(rowset);
+    memory_budget_reserve(chunk_downloader, footprint, SF_BOOLEAN_TRUE);
+    _atomic_add(&chunk_downloader->prefetch_bytes, (long long) footprint);
+    item->footprint = footprint;
+    item->chunk = rowset;
+    rowset = NULL;
+    ret = SF_BOOLEAN_TRUE;
+
+cleanup:
+    if (is_inflating) {
+        inflateEnd(&stream);
+    }
+    sf_unmap_file(&mapped);
+    rowset_term(rowset);
+    if (ret) {
+        if (!chunk_downloader->scrollable) {
+            discard_spill(chunk_downloader, index);
+        }
+    } else {
+        if (error_msg) {
+            sb_sprintf(msg, sizeof(msg), "%s: %s", error_msg, path);
+        } else {
+            parse_error = chunk_downloader->arrow_format ? chunk_downloader->spill_reader.error_msg
+                                                         : chunk_downloader->spill_parser.error_msg;
+            sb_sprintf(msg, sizeof(msg), "Unable to parse spilled chunk: %s", parse_error ? parse_error : "");
+        }
+        log_error(msg);
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error,
+                                chunk_downloader->arrow_format ? SF_STATUS_ERROR_BAD_RESPONSE : SF_STATUS_ERROR_BAD_JSON,
+                                msg, SF_SQLSTATE_GENERAL_ERROR);
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+    }
+    return ret;
+}
+
+/**
+ * Keeps the rowset of a chunk as a spare for the next download, or frees it. Must be called with the
+ * queue_lock held.
+ */
+static void STDCALL recycle_rowset(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_ROWSET *rowset) {
+    uint64 footprint;
+
+    if (!rowset) {
+        return;
+    }
+    footprint = rowset_footprint(rowset);
+    if (chunk_downloader->spare_count < SF_CHUNK_MAX_SPARES &&
+        chunk_downloader->producer_head < chunk_downloader->queue_size &&
+        (chunk_downloader->max_prefetch_bytes == 0 ||
+         chunk_downloader->spare_bytes + footprint <= chunk_downloader->max_prefetch_bytes / 4)) {
+        rowset_clear(rowset);
+        chunk_downloader->spare_chunks[chunk_downloader->spare_count++] = rowset;
+        chunk_downloader->spare_bytes += footprint;
+        return;
+    }
+    rowset_term(rowset);
+}
+
+void STDCALL chunk_downloader_recycle_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_ROWSET *chunk) {
+    if (!chunk) {
+        return;
+    }
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    recycle_rowset(chunk_downloader, chunk);
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+}
+
+sf_bool STDCALL chunk_downloader_get_next_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                                SF_ROWSET **chunk,
+                                                int64 *row_count) {
+    sf_bool ret = SF_BOOLEAN_FALSE;
+    sf_bool is_locked = SF_BOOLEAN_FALSE;
+    sf_bool is_refreshed;
+    uint64 index;
+    uint64 wake_interval;
+    unsigned long wait_msec;
+    SF_QUEUE_ITEM *item;
+
+    *chunk = NULL;
+    *row_count = 0;
+
+    // The consumer is done with the previous chunk, so its memory no longer counts against the budget.
+    // Parked workers notice once they are woken up below.
+    if (chunk_downloader->consume_start_usec > 0) {
+        _atomic_add(&chunk_downloader->prefetch_bytes, -(long long) chunk_downloader->held_bytes);
+        memory_budget_release(chunk_downloader, chunk_downloader->held_bytes);
+        chunk_downloader->held_bytes = 0;
+        _atomic_store(&chunk_downloader->consume_usec,
+                      (long long) CHUNK_EWMA((uint64) _atomic_load(&chunk_downloader->consume_usec),
+                                             sf_get_monotonic_time_usec() -
+                                             chunk_downloader->consume_start_usec + 1));
+        chunk_downloader->consume_start_usec = 0;
+    }
+
+    index = (uint64) _atomic_load(&chunk_downloader->consumer_head);
+    if (index >= chunk_downloader->queue_size) {
+        // No more chunks
+        ret = SF_BOOLEAN_TRUE;
+        goto cleanup;
+    }
+    item = &chunk_downloader->queue[index];
+
+    // Workers whose URLs expired wait for us to get fresh ones
+    if (_atomic_load(&chunk_downloader->is_url_expired) &&
+        !refresh_chunk_urls(chunk_downloader, chunk_downloader->url_generation)) {
+        goto cleanup;
+    }
+
+    // A downloaded chunk is handed over without the queue_lock. We only take it to wait for the chunk, or to
+    // wake up parked workers once half of the prefetch window was drained since we last did, so a fast
+    // consumer doesn't bounce the lock with the workers on every chunk.
+    wake_interval = (uint64) _atomic_load(&chunk_downloader->prefetch_window) / 2;
+    if (!_atomic_load(&item->ready) || get_shutdown_or_error(chunk_downloader) ||
+        (_atomic_load(&chunk_downloader->parked_thread_count) > 0 &&
+         ++chunk_downloader->handoffs_since_wake >= wake_interval)) {
+        _critical_section_lock(&chunk_downloader->queue_lock);
+        is_locked = SF_BOOLEAN_TRUE;
+        chunk_downloader->handoff_lock_count++;
+
+        if (_atomic_load(&chunk_downloader->parked_thread_count) > 0 &&
+            !wake_parked_workers(chunk_downloader)) {
+            goto cleanup;
+        }
+        while (!_atomic_load(&item->ready) && !get_shutdown_or_error(chunk_downloader)) {
+            if (_atomic_load(&chunk_downloader->is_url_expired)) {
+                _critical_section_unlock(&chunk_downloader->queue_lock);
+                is_refreshed = refresh_chunk_urls(chunk_downloader, chunk_downloader->url_generation);
+                _critical_section_lock(&chunk_downloader->queue_lock);
+                if (!is_refreshed) {
+                    break;
+                }
+                continue;
+            }
+            chunk_downloader->is_consumer_waiting = SF_BOOLEAN_TRUE;
+            if ((wait_msec = hedge_straggler(chunk_downloader, index)) > 0) {
+                _cond_timed_wait(&chunk_downloader->consumer_cond, &chunk_downloader->queue_lock, wait_msec);
+            } else {
+                _cond_wait(&chunk_downloader->consumer_cond, &chunk_downloader->queue_lock);
+            }
+        }
+        chunk_downloader->is_consumer_waiting = SF_BOOLEAN_FALSE;
+    }
+
+    if (get_shutdown_or_error(chunk_downloader)) {
+        goto cleanup;
+    }
+    if (item->is_spilled && !load_spilled_chunk(chunk_downloader, index)) {
+        goto cleanup;
+    }
+
+    // Hand over the chunk and remove the chunk reference from the array
+    *chunk = item->chunk;
+    *row_count = item->row_count;
+    item->chunk = NULL;
+    chunk_downloader->held_bytes = item->footprint;
+    chunk_downloader->consume_start_usec = sf_get_monotonic_time_usec();
+    chunk_downloader->handoff_count++;
+    // Makes room in the prefetch window
+    _atomic_store(&chunk_downloader->consumer_head, (long long) index + 1);
+    log_debug("Acquired chunk %llu from chunk downloader", index);
+    ret = SF_BOOLEAN_TRUE;
+
+cleanup:
+    if (is_locked) {
+        _critical_section_unlock(&chunk_downloader->queue_lock);
+    }
+    return ret;
+}
+
+sf_bool STDCALL chunk_downloader_find_row(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                          int64 row,
+                                          uint64 *index,
+                                          int64 *row_in_chunk) {
+    SF_QUEUE_ITEM *queue = chunk_downloader->queue;
+    uint64 low = 0;
+    uint64 high = chunk_downloader->queue_size;
+    uint64 mid;
+
+    if (row < 0 || high == 0 || row >= queue[high - 1].first_row + queue[high - 1].row_count) {
+        return SF_BOOLEAN_FALSE;
+    }
+    // Last chunk that starts at or before the row. An empty chunk starts where the next one does,
+    // so we never land on it.
+    while (high - low > 1) {
+        mid = low + (high - low) / 2;
+        if (queue[mid].first_row <= row) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    *index = low;
+    *row_in_chunk = row - queue[low].first_row;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Downloads an evicted chunk of a scrollable result again, on the consumer thread.
+ */
+static sf_bool STDCALL refetch_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index) {
+    SF_QUEUE_ITEM *item = &chunk_downloader->queue[index];
+    SF_CHUNK_WORKER *worker = &chunk_downloader->refetch_worker;
+    SF_ROWSET *chunk = NULL;
+    SF_ERROR_STRUCT err;
+    uint64 footprint;
+    sf_bool ret;
+
+    memset(&err, 0, sizeof(err));
+    clear_snowflake_error(&err);
+    log_info("Downloading evicted chunk %llu again", index);
+    ret = download_chunk(worker, item, SF_BOOLEAN_FALSE, &chunk, &err);
+
+    _critical_section_lock(&chunk_downloader->queue_lock);
+    chunk_downloader->stats.retry_count += worker->retry_count;
+    chunk_downloader->stats.resumed_count += worker->resumed_count;
+    if (ret) {
+        chunk_downloader->stats.refetched_count++;
+    }
+    _critical_section_unlock(&chunk_downloader->queue_lock);
+
+    if (!ret) {
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            copy_snowflake_error(chunk_downloader->sf_error, &err);
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        clear_snowflake_error(&err);
+        return SF_BOOLEAN_FALSE;
+    }
+
+    footprint = rowset_footprint(chunk);
+    memory_budget_reserve(chunk_downloader, footprint, SF_BOOLEAN_TRUE);
+    _atomic_add(&chunk_downloader->prefetch_bytes, (long long) footprint);
+    item->footprint = footprint;
+    item->chunk = chunk;
+    return SF_BOOLEAN_TRUE;
+}
+
+sf_bool STDCALL chunk_downloader_get_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                           uint64 index,
+                                           SF_ROWSET **chunk,
+                                           int64 *row_count) {
+    SF_QUEUE_ITEM *item;
+    uint64 head;
+    sf_bool is_retained;
+
+    *chunk = NULL;
+    *row_count = 0;
+    if (index >= chunk_downloader->queue_size) {
+        return SF_BOOLEAN_TRUE;
+    }
+
+    // The chunks we didn't get to yet come in order
+    while ((head = (uint64) _atomic_load(&chunk_downloader->consumer_head)) <= index) {
+        if (!chunk_downloader_get_next_chunk(chunk_downloader, chunk, row_count)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        if (head == index) {
+            return SF_BOOLEAN_TRUE;
+        }
+        chunk_downloader_return_chunk(chunk_downloader, head, *chunk);
+        *chunk = NULL;
+        *row_count = 0;
+    }
+
+    if (get_shutdown_or_error(chunk_downloader)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    item = &chunk_downloader->queue[index];
+    is_retained = item->chunk != NULL;
+    if (!item->chunk && item->is_spilled && !load_spilled_chunk(chunk_downloader, index)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!item->chunk && !refetch_chunk(chunk_downloader, index)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (is_retained) {
+        chunk_downloader->retained_bytes -= item->footprint;
+    }
+
+    *chunk = item->chunk;
+    *row_count = item->row_count;
+    item->chunk = NULL;
+    chunk_downloader->held_bytes = item->footprint;
+    log_debug("Acquired chunk %llu again from chunk downloader", index);
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL chunk_downloader_return_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index, SF_ROWSET *chunk) {
+    SF_QUEUE_ITEM *item;
+    uint64 footprint = chunk_downloader->held_bytes;
+    uint64 limit = chunk_downloader->max_prefetch_bytes;
+
+    if (!chunk || index >= chunk_downloader->queue_size) {
+        return;
+    }
+    item = &chunk_downloader->queue[index];
+    chunk_downloader->held_bytes = 0;
+
+    // Keep the chunk while half of the budget has room, so prefetching goes on with the other half.
+    // A spilled chunk is parsed again from its file instead.
+    if (chunk_downloader->memory_budget) {
+        _critical_section_lock(&chunk_downloader->memory_budget->lock);
+        if (chunk_downloader->memory_budget->limit > 0 &&
+            (limit == 0 || chunk_downloader->memory_budget->limit < limit)) {
+            limit = chunk_downloader->memory_budget->limit;
+        }
+        _critical_section_unlock(&chunk_downloader->memory_budget->lock);
+    }
+    if (!item->is_spilled && (limit == 0 || chunk_downloader->retained_bytes + footprint <= limit / 2)) {
+        item->chunk = chunk;
+        item->footprint = footprint;
+        chunk_downloader->retained_bytes += footprint;
+        return;
+    }
+
+    log_debug("Evicted chunk %llu", index);
+    chunk_downloader_recycle_chunk(chunk_downloader, chunk);
+    _atomic_add(&chunk_downloader->prefetch_bytes, -(long long) footprint);
+    memory_budget_release(chunk_downloader, footprint);
+}
+
+/**
+ * Shuts down and joins the worker threads.
+ *
+ * @return SF_BOOLEAN_FALSE if the chunk downloader was already shut down or the queue_lock failed
+ */
+static sf_bool STDCALL stop_workers(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    int pthread_ret;
+    const char *error_msg;
+    uint64 i;
+
+    if ((pthread_ret = _critical_section_lock(&chunk_downloader->queue_lock))) {
+        _rwlock_wrlock(&chunk_downloader->attr_lock);
+        if (!chunk_downloader->has_error) {
+            PTHREAD_LOCK_INIT_ERROR_MSG(pthread_ret, error_msg);
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
+            set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+        }
+        _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        return SF_BOOLEAN_FALSE;
+    }
+
+    do {
+        // Already shutting down, just return false
+        if (get_shutdown(chunk_downloader)) {
+            return SF_BOOLEAN_FALSE;
+        }
+
+        set_shutdown(chunk_downloader, SF_BOOLEAN_TRUE);
+
+        if (_cond_broadcast(&chunk_downloader->consumer_cond) ||
+            _cond_broadcast(&chunk_downloader->producer_cond) ||
+                (_critical_section_unlock(&chunk_downloader->queue_lock))) {
+            // Something went wrong with either notifying the producer/consumer or releasing the queue lock
+            // Set and error and then try to continue with cleanup
+            _rwlock_wrlock(&chunk_downloader->attr_lock);
+            if (!chunk_downloader->has_error) {
+                SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, "Error during condition broadcast", "");
+                set_error(chunk_downloader, SF_BOOLEAN_TRUE);
+            }
+            _rwlock_wrunlock(&chunk_downloader->attr_lock);
+        }
+
+        // Join all the threads
         for (i = 0; i < chunk_downloader->thread_count; i++) {
-            if ((pthread_ret = _thread_join(chunk_downloader->threads[i])) != 0) {
+            if ((pthread_ret = _thread_join(chunk_downloader->workers[i].thread)) != 0) {
                 if (!get_error(chunk_downloader)) {
                     PTHREAD_JOIN_ERROR_MSG(pthread_ret, error_msg);
                     SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
@@ -370,36 +2543,369 @@ sf_bool STDCALL chunk_downloader_term(struct SF_CHUNK_DOWNLOADER *chunk_download
                 if (!chunk_downloader->has_error) {
                     PTHREAD_JOIN_ERROR_MSG(pthread_ret, error_msg);
                     SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD, error_msg, "");
-                    chunk_downloader->has_error = SF_BOOLEAN_TRUE;
+                    set_error(chunk_downloader, SF_BOOLEAN_TRUE);
                 }
                 _rwlock_wrunlock(&chunk_downloader->attr_lock);
             }
         }
     } while (0);
 
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Frees the chunk downloader once its workers are stopped.
+ */
+static void STDCALL free_chunk_downloader(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    uint64 i;
+
+    memory_budget_unregister(chunk_downloader);
+    term_worker(&chunk_downloader->refetch_worker);
+    // The workers cleaned up their curl handles, so nothing uses the share anymore
+    if (chunk_downloader->owns_share) {
+        chunk_share_term(chunk_downloader->share);
+    }
+
     // Free chunk downloader memory
-    SF_FREE(chunk_downloader->threads);
+    SF_FREE(chunk_downloader->workers);
     // Free all the memory of the items in the queue before freeing queue memory
     for (i = 0; i < chunk_downloader->queue_size; i++) {
         SF_FREE(chunk_downloader->queue[i].url);
-      snowflake_cJSON_Delete(chunk_downloader->queue[i].chunk);
+        rowset_term(chunk_downloader->queue[i].chunk);
+        // Spilled chunks the consumer didn't get to
+        if (chunk_downloader->queue[i].is_spilled) {
+            discard_spill(chunk_downloader, i);
+        }
     }
     SF_FREE(chunk_downloader->queue);
+    for (i = 0; i < chunk_downloader->spare_count; i++) {
+        rowset_term(chunk_downloader->spare_chunks[i]);
+    }
+    rowset_parser_term(&chunk_downloader->spill_parser);
+    arrow_reader_term(&chunk_downloader->spill_reader);
+    SF_FREE(chunk_downloader->spill_dir);
     SF_FREE(chunk_downloader->qrmk);
+    SF_FREE(chunk_downloader->column_types);
     sf_header_destroy(chunk_downloader->chunk_headers);
-    _critical_section_term(&chunk_downloader->queue_lock);
-    _cond_term(&chunk_downloader->producer_cond);
-    _cond_term(&chunk_downloader->consumer_cond);
-    _rwlock_term(&chunk_downloader->attr_lock);
+    term_locks(chunk_downloader);
     SF_FREE(chunk_downloader);
+}
 
+sf_bool STDCALL chunk_downloader_term(struct SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    if (!chunk_downloader || !stop_workers(chunk_downloader)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    free_chunk_downloader(chunk_downloader);
     return SF_BOOLEAN_TRUE;
 }
 
-static void * chunk_downloader_thread(void *downloader) {
-    struct SF_CHUNK_DOWNLOADER *chunk_downloader = (SF_CHUNK_DOWNLOADER *) downloader;
-    cJSON *chunk = NULL;
-    uint64 index;
+int64 STDCALL chunk_downloader_row_count(SF_CHUNK_DOWNLOADER *chunk_downloader) {
+    SF_QUEUE_ITEM *last;
+
+    if (chunk_downloader->queue_size == 0) {
+        return 0;
+    }
+    last = &chunk_downloader->queue[chunk_downloader->queue_size - 1];
+    return last->first_row + last->row_count;
+}
+
+sf_bool STDCALL chunk_downloader_to_cjson(SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *data) {
+    struct curl_slist *header;
+    const char *separator;
+    cJSON *chunks;
+    cJSON *chunk;
+    cJSON *headers;
+    char *key;
+    size_t key_len;
+    uint64 i;
+    SF_QUEUE_ITEM *item;
+
+    // The chunk list and the headers don't change once the chunk downloader is created
+    if ((chunks = snowflake_cJSON_AddArrayToObject(data, "chunks")) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    for (i = 0; i < chunk_downloader->queue_size; i++) {
+        item = &chunk_downloader->queue[i];
+        if ((chunk = snowflake_cJSON_CreateObject()) == NULL) {
+            return SF_BOOLEAN_FALSE;
+        }
+        snowflake_cJSON_AddItemToArray(chunks, chunk);
+        if (!snowflake_cJSON_AddStringToObject(chunk, "url", item->url) ||
+            !snowflake_cJSON_AddNumberToObject(chunk, "rowCount", (double) item->row_count) ||
+            !snowflake_cJSON_AddNumberToObject(chunk, "uncompressedSize", (double) item->uncompressed_size)) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+
+    if (chunk_downloader->qrmk && !snowflake_cJSON_AddStringToObject(data, "qrmk", chunk_downloader->qrmk)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!chunk_downloader->chunk_headers->header) {
+        return SF_BOOLEAN_TRUE;
+    }
+    if ((headers = snowflake_cJSON_AddObjectToObject(data, "chunkHeaders")) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    // create_chunk_headers wrote each header as "key: value"
+    for (header = chunk_downloader->chunk_headers->header; header; header = header->next) {
+        if ((separator = strstr(header->data, ": ")) == NULL) {
+            continue;
+        }
+        key_len = (size_t) (separator - header->data);
+        if ((key = (char *) SF_CALLOC(1, key_len + 1)) == NULL) {
+            return SF_BOOLEAN_FALSE;
+        }
+        sb_strncpy(key, key_len + 1, header->data, key_len);
+        chunk = snowflake_cJSON_AddStringToObject(headers, key, separator + 2);
+        SF_FREE(key);
+        if (!chunk) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Creates the chunk downloader of a part of a split result, with count chunks from first on and a share
+ * of the budgets. Its workers are not started yet.
+ */
+static SF_CHUNK_DOWNLOADER *STDCALL alloc_part(SF_CHUNK_DOWNLOADER *source,
+                                               uint64 first,
+                                               uint64 count,
+                                               uint64 part_count,
+                                               SF_ERROR_STRUCT *sf_error,
+                                               void *url_refresh_ctx) {
+    SF_CHUNK_DOWNLOADER *part;
+    SF_QUEUE_ITEM *item;
+    SF_ROWSET_SINK sink;
+    struct curl_slist *header;
+    struct curl_slist *headers;
+    uint64 thread_count;
+    uint64 max_thread_count;
+    size_t len;
+    uint64 i;
+
+    if ((part = (SF_CHUNK_DOWNLOADER *) SF_CALLOC(1, sizeof(SF_CHUNK_DOWNLOADER))) == NULL) {
+        return NULL;
+    }
+    part->sf_error = sf_error;
+    if (!init_locks(part)) {
+        SF_FREE(part);
+        return NULL;
+    }
+    // The sink is set up for each chunk
+    memset(&sink, 0, sizeof(sink));
+    rowset_parser_init(&part->spill_parser, &sink);
+    arrow_reader_init(&part->spill_reader, &sink);
+    part->refetch_worker.chunk_downloader = part;
+    part->refetch_worker.is_refetch = SF_BOOLEAN_TRUE;
+    rowset_parser_init(&part->refetch_worker.parser, &sink);
+    arrow_reader_init(&part->refetch_worker.arrow_reader, &sink);
+
+    part->insecure_mode = source->insecure_mode;
+    part->arrow_format = source->arrow_format;
+    part->hedging = source->hedging;
+    part->hedge_index = -1;
+    part->scrollable = source->scrollable;
+    part->max_retries = source->max_retries;
+    part->range_split_bytes = source->range_split_bytes;
+    part->url_refresh = source->url_refresh;
+    part->url_refresh_ctx = url_refresh_ctx;
+    part->first_chunk = source->first_chunk + first;
+    // What the source learned about the chunks holds for the parts. Its workers are still running.
+    _critical_section_lock(&source->queue_lock);
+    part->footprint_ratio = source->footprint_ratio;
+    part->row_footprint = source->row_footprint;
+    part->avg_footprint = source->avg_footprint;
+    part->download_usec = source->download_usec;
+    part->spill_ratio = source->spill_ratio;
+    thread_count = source->active_thread_count / part_count > 0 ? source->active_thread_count / part_count : 1;
+    max_thread_count = source->max_thread_count / part_count > 0 ? source->max_thread_count / part_count : 1;
+    _critical_section_unlock(&source->queue_lock);
+    part->memory_budget = source->memory_budget;
+    if (source->max_prefetch_bytes > 0) {
+        part->max_prefetch_bytes = source->max_prefetch_bytes / part_count > 0 ? source->max_prefetch_bytes / part_count : 1;
+    }
+    // The share of the source goes away with it, unless the connection owns it
+    part->owns_share = source->owns_share;
+    part->share = source->owns_share ? chunk_share_init() : source->share;
+
+    if ((part->chunk_headers = sf_header_create()) == NULL) {
+        goto cleanup;
+    }
+    for (header = source->chunk_headers->header; header; header = header->next) {
+        if ((headers = curl_slist_append(part->chunk_headers->header, header->data)) == NULL) {
+            goto cleanup;
+        }
+        part->chunk_headers->header = headers;
+    }
+    if (source->qrmk) {
+        len = strlen(source->qrmk) + 1;
+        if ((part->qrmk = (char *) SF_CALLOC(1, len)) == NULL) {
+            goto cleanup;
+        }
+        sb_strcpy(part->qrmk, len, source->qrmk);
+    }
+    if (source->spill_dir) {
+        len = strlen(source->spill_dir) + 1;
+        if ((part->spill_dir = (char *) SF_CALLOC(1, len)) == NULL) {
+            goto cleanup;
+        }
+        sb_strcpy(part->spill_dir, len, source->spill_dir);
+        uuid4_generate(part->spill_prefix);
+        part->max_spill_bytes = source->max_spill_bytes / part_count > 0 ? source->max_spill_bytes / part_count : 1;
+    }
+    if (source->column_types) {
+        if ((part->column_types = (SF_C_TYPE *) SF_CALLOC((size_t) source->column_count,
+                                                          sizeof(SF_C_TYPE))) == NULL) {
+            goto cleanup;
+        }
+        memcpy(part->column_types, source->column_types, (size_t) source->column_count * sizeof(SF_C_TYPE));
+        part->column_count = source->column_count;
+    }
+
+    if ((part->queue = (SF_QUEUE_ITEM *) SF_CALLOC((size_t) count, sizeof(SF_QUEUE_ITEM))) == NULL) {
+        goto cleanup;
+    }
+    for (i = 0; i < count; i++) {
+        item = &source->queue[first + i];
+        len = strlen(item->url) + 1;
+        if ((part->queue[i].url = (char *) SF_CALLOC(1, len)) == NULL) {
+            goto cleanup;
+        }
+        sb_strcpy(part->queue[i].url, len, item->url);
+        part->queue_size++;
+        part->queue[i].row_count = item->row_count;
+        part->queue[i].first_row = item->first_row - source->queue[first].first_row;
+        part->queue[i].uncompressed_size = item->uncompressed_size;
+    }
+
+    if (!alloc_workers(part, thread_count, source->min_prefetch_window, max_thread_count)) {
+        goto cleanup;
+    }
+    return part;
+
+cleanup:
+    free_chunk_downloader(part);
+    return NULL;
+}
+
+/**
+ * Moves the chunks the source downloaded at the start of a part over to it. The part downloads the rest.
+ * The workers of both must be stopped.
+ */
+static void STDCALL move_ready_chunks(SF_CHUNK_DOWNLOADER *source, uint64 first, SF_CHUNK_DOWNLOADER *part) {
+    SF_QUEUE_ITEM *item;
+    SF_QUEUE_ITEM *target;
+    char from[MAX_PATH];
+    char to[MAX_PATH];
+    uint64 i;
+
+    for (i = 0; i < part->queue_size; i++) {
+        item = &source->queue[first + i];
+        target = &part->queue[i];
+        if (!_atomic_load(&item->ready)) {
+            break;
+        }
+        if (item->is_spilled) {
+            spill_path(source, first + i, from, sizeof(from));
+            spill_path(part, i, to, sizeof(to));
+            if (rename(from, to) != 0) {
+                break;
+            }
+            target->is_spilled = SF_BOOLEAN_TRUE;
+            target->encoding = item->encoding;
+            target->spill_bytes = item->spill_bytes;
+            _atomic_add(&part->spill_bytes, (long long) item->spill_bytes);
+            _atomic_add(&source->spill_bytes, -(long long) item->spill_bytes);
+            item->spill_bytes = 0;
+            item->is_spilled = SF_BOOLEAN_FALSE;
+        } else {
+            target->chunk = item->chunk;
+            target->footprint = item->footprint;
+            item->chunk = NULL;
+            memory_budget_reserve(part, target->footprint, SF_BOOLEAN_TRUE);
+            _atomic_add(&part->prefetch_bytes, (long long) target->footprint);
+        }
+        _atomic_store(&target->ready, 1);
+        part->stats.chunk_count++;
+        part->producer_head = i + 1;
+    }
+}
+
+sf_bool STDCALL chunk_downloader_split(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                       uint64 part_count,
+                                       SF_CHUNK_DOWNLOADER **parts,
+                                       SF_ERROR_STRUCT **sf_errors,
+                                       void **url_refresh_ctxs) {
+    SF_QUEUE_ITEM *queue = chunk_downloader->queue;
+    uint64 queue_size = chunk_downloader->queue_size;
+    int64 total_rows = chunk_downloader_row_count(chunk_downloader);
+    uint64 start = 0;
+    uint64 end;
+    uint64 p;
+
+    if (part_count == 0 || _atomic_load(&chunk_downloader->consumer_head) > 0 || get_shutdown_or_error(chunk_downloader)) {
+        SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_GENERAL,
+                            "Unable to split a result that is being read", SF_SQLSTATE_FUNCTION_SEQUENCE_ERROR);
+        return SF_BOOLEAN_FALSE;
+    }
+
+    // Contiguous ranges of chunks with about the same number of rows. Parts may be empty if there are
+    // fewer chunks than parts.
+    for (p = 0; p < part_count; p++) {
+        end = start;
+        while (end < queue_size &&
+               (p == part_count - 1 ||
+                (total_rows > 0 ? (uint64) queue[end].first_row * part_count < (uint64) total_rows * (p + 1)
+                                : end * part_count < queue_size * (p + 1)))) {
+            end++;
+        }
+        parts[p] = NULL;
+        if (end > start &&
+            (parts[p] = alloc_part(chunk_downloader, start, end - start, part_count, sf_errors[p],
+                                   url_refresh_ctxs[p])) == NULL) {
+            while (p-- > 0) {
+                free_chunk_downloader(parts[p]);
+                parts[p] = NULL;
+            }
+            SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_OUT_OF_MEMORY,
+                                "Unable to allocate result partition", SF_SQLSTATE_MEMORY_ALLOCATION_ERROR);
+            return SF_BOOLEAN_FALSE;
+        }
+        start = end;
+    }
+
+    // The chunks downloaded so far change hands once nothing works on them anymore
+    stop_workers(chunk_downloader);
+    for (p = 0, start = 0; p < part_count; p++) {
+        if (parts[p]) {
+            move_ready_chunks(chunk_downloader, start, parts[p]);
+            start += parts[p]->queue_size;
+        }
+    }
+    free_chunk_downloader(chunk_downloader);
+
+    for (p = 0; p < part_count; p++) {
+        // A part that couldn't start a worker has the error set for its consumer
+        if (parts[p] && start_workers(parts[p])) {
+            log_debug("Started result partition %llu with %llu chunks", p, parts[p]->queue_size);
+        }
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static void * chunk_downloader_thread(void *worker_arg) {
+    SF_CHUNK_WORKER *worker = (SF_CHUNK_WORKER *) worker_arg;
+    struct SF_CHUNK_DOWNLOADER *chunk_downloader = worker->chunk_downloader;
+    SF_ROWSET *chunk = NULL;
+    SF_QUEUE_ITEM *item;
+    CHUNK_TASK task;
+    sf_bool is_downloaded;
+    uint64 index = 0;
+    uint64 chunk_bytes;
+    uint64 footprint;
+    uint64 start_usec;
     // Create err per thread so we don't have to lock the chunk downloader err
     SF_ERROR_STRUCT err;
     memset(&err, 0, sizeof(err));
@@ -411,55 +2917,133 @@ static void * chunk_downloader_thread(void *downloader) {
         chunk = NULL;
         _critical_section_lock(&chunk_downloader->queue_lock);
 
-        // If we've downloaded chunks == # of threads, wait until the consumer consumes a chunk.
-        // Ensure that the producer_head is less than the queue_size to ensure that we still have items to process
-        // If we're shutting down or an err has occurred, skip
-        while ((chunk_downloader->producer_head - chunk_downloader->consumer_head) >= chunk_downloader->thread_count &&
-                chunk_downloader->producer_head < chunk_downloader->queue_size &&
-                !get_shutdown_or_error(chunk_downloader)) {
+        // Wait while this thread is parked by the scheduler or the prefetch window/byte budget is used up,
+        // and there is no chunk to hedge.
+        // We count as parked before checking, so the consumer either sees us parked or we see its progress.
+        _atomic_add(&chunk_downloader->parked_thread_count, 1);
+        while ((task = next_task(chunk_downloader, worker, &index)) == CHUNK_TASK_WAIT) {
             _cond_wait(&chunk_downloader->producer_cond, &chunk_downloader->queue_lock);
         }
+        _atomic_add(&chunk_downloader->parked_thread_count, -1);
 
         // If we're shutting down, or we have reached the end of the results, then break
-        if (get_shutdown_or_error(chunk_downloader) || chunk_downloader->producer_head >= chunk_downloader->queue_size) {
+        if (task == CHUNK_TASK_EXIT) {
             break;
         }
 
-        // Get queue item and set it locally
-        index = chunk_downloader->producer_head++;
+        item = &chunk_downloader->queue[index];
+        chunk_bytes = item->uncompressed_size;
+        if (task != CHUNK_TASK_SPILL && !worker->rowset && chunk_downloader->spare_count > 0) {
+            worker->rowset = chunk_downloader->spare_chunks[--chunk_downloader->spare_count];
+            chunk_downloader->spare_bytes -= rowset_footprint(worker->rowset);
+            chunk_downloader->stats.recycled_count++;
+        }
 
         // Unlock since we have our queue item, and don't need the lock while we're processing the queue
         _critical_section_unlock(&chunk_downloader->queue_lock);
 
         // Download chunk
-        if (!download_chunk(chunk_downloader->queue[index].url, chunk_downloader->chunk_headers,
-                            &chunk, &err, chunk_downloader->insecure_mode)) {
+        start_usec = sf_get_monotonic_time_usec();
+        is_downloaded = download_chunk(worker, item, task == CHUNK_TASK_SPILL, &chunk, &err);
+        footprint = is_downloaded && chunk ? rowset_footprint(chunk) : 0;
+
+        // Gain back lock to set the chunk
+        _critical_section_lock(&chunk_downloader->queue_lock);
+        item->downloads--;
+        chunk_downloader->stats.retry_count += worker->retry_count;
+        chunk_downloader->stats.resumed_count += worker->resumed_count;
+        if (worker->is_split) {
+            chunk_downloader->stats.split_count++;
+        }
+        if (task != CHUNK_TASK_HEDGE) {
+            chunk_downloader->downloading_count--;
+            // Workers waiting for the last chunks may exit now
+            if (chunk_downloader->downloading_count == 0 &&
+                chunk_downloader->producer_head >= chunk_downloader->queue_size) {
+                _cond_broadcast(&chunk_downloader->producer_cond);
+            }
+        }
+
+        if (get_shutdown_or_error(chunk_downloader)) {
+            rowset_term(chunk);
+            if (task == CHUNK_TASK_SPILL) {
+                discard_spill(chunk_downloader, index);
+            }
+            break;
+        }
+        // The other request for the chunk was faster
+        if (_atomic_load(&item->ready)) {
+            recycle_rowset(chunk_downloader, chunk);
+            if (task == CHUNK_TASK_SPILL) {
+                discard_spill(chunk_downloader, index);
+            }
+            clear_snowflake_error(&err);
+            _critical_section_unlock(&chunk_downloader->queue_lock);
+            continue;
+        }
+
+        if (!is_downloaded) {
+            if (task == CHUNK_TASK_SPILL) {
+                discard_spill(chunk_downloader, index);
+            }
+            // The other request for the chunk may still get it
+            if (item->downloads > 0) {
+                log_warn("%s request for chunk %llu failed, waiting for the other one: %s",
+                         task == CHUNK_TASK_HEDGE ? "Second" : "First", index, err.msg);
+                clear_snowflake_error(&err);
+                _critical_section_unlock(&chunk_downloader->queue_lock);
+                continue;
+            }
             _rwlock_wrlock(&chunk_downloader->attr_lock);
             if (!chunk_downloader->has_error) {
                 copy_snowflake_error(chunk_downloader->sf_error, &err);
-                chunk_downloader->has_error = SF_BOOLEAN_TRUE;
+                set_error(chunk_downloader, SF_BOOLEAN_TRUE);
             }
             _rwlock_wrunlock(&chunk_downloader->attr_lock);
+            // Wake up the consumer so it sees the error
+            _cond_signal(&chunk_downloader->consumer_cond);
             break;
         }
 
-        // Gain back lock to set cJSON blob
-        _critical_section_lock(&chunk_downloader->queue_lock);
-
-        if (get_error(chunk_downloader)) {
-            break;
+        // Set the chunk. The consumer may take it as soon as it's ready.
+        if (task == CHUNK_TASK_SPILL) {
+            _atomic_add(&chunk_downloader->spill_bytes, (long long) worker->spill_bytes - (long long) item->spill_bytes);
+            item->spill_bytes = worker->spill_bytes;
+            item->encoding = worker->spill_encoding;
+            item->is_spilled = SF_BOOLEAN_TRUE;
+            if (item->uncompressed_size > 0) {
+                chunk_downloader->spill_ratio = CHUNK_EWMA(chunk_downloader->spill_ratio,
+                                                           worker->spill_bytes * 256 / item->uncompressed_size);
+            }
+            chunk_downloader->stats.spilled_count++;
+        } else {
+            item->chunk = chunk;
+            update_footprint(chunk_downloader, item, footprint);
         }
-
-        // Set the chunk
-        chunk_downloader->queue[index].chunk = chunk;
-
-        // Notify the consumer that we have a chunk ready
-        if (_cond_signal(&chunk_downloader->consumer_cond)) {
+        _atomic_store(&item->ready, 1);
+        chunk_downloader->stats.chunk_count++;
+        if (task == CHUNK_TASK_HEDGE) {
+            chunk_downloader->stats.hedge_won_count++;
+            log_info("Second request for chunk %llu finished first", index);
+        }
+        record_latency(chunk_downloader, sf_get_monotonic_time_usec() - item->start_usec);
+
+        // Feed the scheduler
+        chunk_downloader->download_usec = CHUNK_EWMA(chunk_downloader->download_usec,
+                                                     sf_get_monotonic_time_usec() - start_usec + 1);
+        chunk_downloader->downloaded_bytes += chunk_bytes > 0 ? chunk_bytes : 1;
+        chunk_downloader->downloaded_chunks++;
+        chunk_downloader->chunks_since_grow++;
+        chunk_downloader->chunks_since_probe++;
+        adjust_schedule(chunk_downloader);
+
+        // Notify the consumer that we have a chunk ready, if it ran out of chunks
+        if (chunk_downloader->is_consumer_waiting && _cond_signal(&chunk_downloader->consumer_cond)) {
             _rwlock_wrlock(&chunk_downloader->attr_lock);
             if (!chunk_downloader->has_error) {
                 SET_SNOWFLAKE_ERROR(chunk_downloader->sf_error, SF_STATUS_ERROR_PTHREAD,
                                     "Error sending consumer signal to notify of chunk downloaded", "");
-                chunk_downloader->has_error = SF_BOOLEAN_TRUE;
+                set_error(chunk_downloader, SF_BOOLEAN_TRUE);
             }
             _rwlock_wrunlock(&chunk_downloader->attr_lock);
             break;
@@ -470,6 +3054,9 @@ static void * chunk_downloader_thread(void *downloader) {
     }
 
     _critical_section_unlock(&chunk_downloader->queue_lock);
+    term_worker(worker);
+    // The error was copied to the chunk downloader, if there was one
+    clear_snowflake_error(&err);
     _thread_exit();
     return NULL;
 }
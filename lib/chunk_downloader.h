@@ -19,42 +19,256 @@ extern "C" {
 #include "snowflake/platform.h"
 #include "cJSON.h"
 #include "connection.h"
+#include "rowset_parser.h"
+#include "rowset.h"
+#include "arrow_reader.h"
+
+// Number of recent download times the hedge deadline is computed from
+#define SF_CHUNK_LATENCY_SAMPLES 64
+// Number of rowsets of consumed chunks kept for the next downloads
+#define SF_CHUNK_MAX_SPARES 4
+// Number of byte ranges a chunk is split into at most
+#define SF_CHUNK_MAX_RANGES 8
+
+/**
+ * Content-Encoding of a chunk as it was received
+ */
+typedef enum SF_CHUNK_ENCODING {
+    CHUNK_ENCODING_IDENTITY,
+    // gzip or deflate, which zlib both reads
+    CHUNK_ENCODING_ZLIB,
+    CHUNK_ENCODING_OTHER
+} SF_CHUNK_ENCODING;
+
+/**
+ * Gets the chunks of the result again once their presigned URLs expired, e.g. from the result endpoint
+ * of the query. Called on the consumer thread.
+ *
+ * @param ctx url_refresh_ctx of the chunk downloader
+ * @param chunks receives the "chunks" array of the whole result, in the same order. Freed by the caller
+ * @param error set on failure
+ * @return SF_BOOLEAN_FALSE if the chunks couldn't be fetched
+ */
+typedef sf_bool (STDCALL *SF_CHUNK_URL_REFRESH)(void *ctx, cJSON **chunks, SF_ERROR_STRUCT *error);
 
 typedef struct SF_QUEUE_ITEM {
     char *url;
     int64 row_count;
-    cJSON *chunk;
+    // Number of rows in the chunks before this one
+    int64 first_row;
+    // Size of the chunk as reported by the server. 0 if unknown
+    uint64 uncompressed_size;
+    // Memory reserved for the chunk. An estimate until the chunk is parsed
+    uint64 footprint;
+    SF_ROWSET *chunk;
+    // Set once the chunk is downloaded, so the consumer can take it without the queue_lock
+    SF_ATOMIC_INT64 ready;
+    // When the first request for the chunk was sent
+    uint64 start_usec;
+    // Number of requests for the chunk in flight. Two while it is hedged
+    int downloads;
+    sf_bool is_hedged;
+    // The chunk is in the spill directory as it was received. The consumer parses it when it gets there.
+    sf_bool is_spilled;
+    SF_CHUNK_ENCODING encoding;
+    // Disk space reserved for the chunk. An estimate until the chunk is written
+    uint64 spill_bytes;
 } SF_QUEUE_ITEM;
 
+struct SF_CHUNK_MEMORY_BUDGET {
+    SF_CRITICAL_SECTION_HANDLE lock;
+    // 0 means unlimited
+    uint64 limit;
+    uint64 used;
+    // Chunk downloaders to wake up when memory is released
+    SF_CHUNK_DOWNLOADER *downloaders;
+};
+
+struct SF_CHUNK_SHARE {
+    CURLSH *share;
+    // One lock per type of data shared by the curl handles
+    SF_CRITICAL_SECTION_HANDLE locks[CURL_LOCK_DATA_LAST];
+};
+
+typedef struct SF_CHUNK_WORKER {
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_THREAD_HANDLE thread;
+    // Reused for every chunk the worker downloads so the connection is kept alive
+    CURL *curl;
+    // Turn the chunk into rows while it downloads, depending on the result format
+    SF_ROWSET_PARSER parser;
+    SF_ARROW_READER arrow_reader;
+    SF_ROWSET *rowset;
+    // Workers with an index >= active_thread_count are parked
+    uint64 index;
+    // Retries of the last chunk, and how many of them resumed the body
+    uint64 retry_count;
+    uint64 resumed_count;
+    // Size and encoding of the last chunk written to the spill directory
+    uint64 spill_bytes;
+    SF_CHUNK_ENCODING spill_encoding;
+    // Bytes of values and cells per row of the last chunk the worker parsed, to size the rowset of the next one
+    uint64 row_arena_bytes;
+    uint64 row_cells;
+    // Copy of the URL of the chunk being downloaded, since the consumer may replace it with a fresh one,
+    // and the url_generation it was taken from
+    char *url;
+    size_t url_size;
+    uint64 url_generation;
+    // Downloads chunks again for the consumer of a scrollable result. The chunks are ready already,
+    // so that doesn't abort the download
+    sf_bool is_refetch;
+    // Number of byte ranges to fetch the next chunk in, 0 to fetch it whole, and whether the last
+    // chunk was fetched in ranges
+    uint64 range_count;
+    sf_bool is_split;
+    // Handles the ranges are fetched with. Created the first time a chunk is split
+    CURLM *range_multi;
+    CURL *range_curls[SF_CHUNK_MAX_RANGES];
+} SF_CHUNK_WORKER;
+
 struct SF_CHUNK_DOWNLOADER {
+    // Number of worker threads started so far
     uint64 thread_count;
 
-    // Threads
-    SF_THREAD_HANDLE *threads;
+    // Threads. Allocated for max_thread_count workers, started on demand
+    SF_CHUNK_WORKER *workers;
+
+    // Scheduler state. Protected by the queue_lock
+    uint64 active_thread_count;
+    uint64 max_thread_count;
+    // Number of chunks that may be downloading or waiting to be consumed. Also read by the consumer
+    SF_ATOMIC_INT64 prefetch_window;
+    // Memory footprint of the chunks downloading, waiting or held by the consumer.
+    // The consumer releases its chunk without the queue_lock.
+    SF_ATOMIC_INT64 prefetch_bytes;
+    uint64 max_prefetch_bytes;
+    // Moving averages used to estimate the footprint of a chunk before it is downloaded.
+    // footprint_ratio is the footprint per byte of uncompressedSize in 1/256 units.
+    uint64 footprint_ratio;
+    uint64 row_footprint;
+    uint64 avg_footprint;
+    // Moving averages of the time to download a chunk and the time the consumer spends on one.
+    // consume_usec is only written by the consumer.
+    uint64 download_usec;
+    SF_ATOMIC_INT64 consume_usec;
+    uint64 consume_start_usec;
+    // Aggregate throughput (bytes/sec) measured before the last time we added a thread
+    uint64 throughput_before_grow;
+    uint64 chunks_since_grow;
+    // Thread count beyond which adding threads did not increase the throughput
+    uint64 useful_thread_count;
+    uint64 chunks_since_probe;
+    uint64 downloaded_bytes;
+    uint64 downloaded_chunks;
+    // Footprint of the chunk the consumer is currently reading
+    uint64 held_bytes;
+    // Number of workers waiting on the producer_cond. The consumer only takes the queue_lock to wake them up.
+    SF_ATOMIC_INT64 parked_thread_count;
+    // The consumer is waiting on the consumer_cond. Protected by the queue_lock
+    sf_bool is_consumer_waiting;
+    // Chunks handed over since the consumer last woke up the parked workers
+    uint64 handoffs_since_wake;
+    // Number of chunks handed over and the number of times the consumer had to take the queue_lock for it
+    uint64 handoff_count;
+    uint64 handoff_lock_count;
+
+    // Memory budget shared with the other statements of the connection. Optional
+    SF_CHUNK_MEMORY_BUDGET *memory_budget;
+    SF_CHUNK_DOWNLOADER *next_in_budget;
+    uint64 budget_bytes;
+    // DNS cache and TLS sessions shared by the workers. Owned by the
+    // chunk downloader unless it was shared by the connection
+    SF_CHUNK_SHARE *share;
+    sf_bool owns_share;
+    // Lower bound of prefetch_window
+    uint64 min_prefetch_window;
+
+    // Hedging of the chunk the consumer waits for. Protected by the queue_lock
+    sf_bool hedging;
+    // Chunk waiting for a worker to send its second request, -1 if none
+    int64 hedge_index;
+    // Ring of the most recent download times
+    uint64 latency_samples[SF_CHUNK_LATENCY_SAMPLES];
+    uint64 latency_sample_count;
+    // Number of chunks being downloaded, not counting second requests. Workers stay around
+    // until it drops to 0, so they can hedge the last chunks.
+    uint64 downloading_count;
+    SF_CHUNK_STATS stats;
+
+    // Retries of a failed chunk download before the result set fails
+    uint64 max_retries;
+
+    // The chunk the consumer waits for is fetched in byte ranges over several connections if its
+    // uncompressedSize is at least this many bytes and workers are idle. 0 disables it
+    uint64 range_split_bytes;
+
+    // Gets fresh chunk URLs once a worker got a 403 for one, NULL if the URLs can't be refreshed.
+    // The consumer calls it, with url_refresh_ctx, and picks the URLs of the chunks from first_chunk on.
+    SF_CHUNK_URL_REFRESH url_refresh;
+    void *url_refresh_ctx;
+    uint64 first_chunk;
+    // Bumped every time the URLs are replaced. Protected by the queue_lock
+    uint64 url_generation;
+    // A worker waits for fresh URLs
+    SF_ATOMIC_INT64 is_url_expired;
+
+    // Chunks that don't fit in memory yet are written to the spill directory, NULL if disabled.
+    // The files are named after spill_prefix and the chunk index, so statements don't collide.
+    char *spill_dir;
+    char spill_prefix[SF_UUID4_LEN];
+    uint64 max_spill_bytes;
+    // Disk space reserved by spilled chunks. Only the consumer lowers it, without the queue_lock
+    SF_ATOMIC_INT64 spill_bytes;
+    // Size of a spilled chunk per byte of uncompressedSize in 1/256 units
+    uint64 spill_ratio;
+    // Parse the spilled chunks on the consumer thread
+    SF_ROWSET_PARSER spill_parser;
+    SF_ARROW_READER spill_reader;
+
+    // The consumer may go back to the chunks it got before. The ones it gave back are kept in memory while
+    // retained_bytes fits in half of max_prefetch_bytes, spilled chunks keep their file, and the others
+    // are downloaded again by the refetch_worker. Only used by the consumer.
+    sf_bool scrollable;
+    uint64 retained_bytes;
+    SF_CHUNK_WORKER refetch_worker;
+
+    // Rowsets of consumed chunks the workers parse the next chunks into, so the arrays of a chunk aren't
+    // allocated and grown again every time. They don't count against the prefetch budget, so they only
+    // take up a quarter of it. Protected by the queue_lock
+    SF_ROWSET *spare_chunks[SF_CHUNK_MAX_SPARES];
+    uint64 spare_count;
+    uint64 spare_bytes;
 
     // Queue
     SF_CRITICAL_SECTION_HANDLE queue_lock;
     SF_CONDITION_HANDLE producer_cond;
     SF_CONDITION_HANDLE consumer_cond;
 
-    // A "queue" that is actually just a locked array
+    // A "queue" that is actually just an array. Workers take chunks to download under the queue_lock,
+    // the consumer takes downloaded chunks once their ready flag is set.
     SF_QUEUE_ITEM* queue;
 
-    // Queue attributes
+    // Queue attributes. consumer_head is only written by the consumer.
     uint64 producer_head;
-    uint64 consumer_head;
+    SF_ATOMIC_INT64 consumer_head;
     uint64 queue_size;
 
     // Chunk downloader connection attributes
     char *qrmk;
     SF_HEADER *chunk_headers;
+    // Chunks are Arrow streams instead of JSON rowsets
+    sf_bool arrow_format;
+    // C type of each column the values are decoded as once a chunk is parsed, NULL to keep them as text
+    SF_C_TYPE *column_types;
+    uint64 column_count;
 
-    // Error/shutdown flags
-    sf_bool is_shutdown;
-    sf_bool has_error;
+    // Error/shutdown flags. Read without a lock
+    SF_ATOMIC_INT64 is_shutdown;
+    SF_ATOMIC_INT64 has_error;
 
-    // Chunk downloader attribute read-write lock. If you need to acquire both the queue_lock and attr_lock,
-    // ALWAYS acquire the queue_lock first, otherwise we can deadlock
+    // Serializes setting the error, so only the first one is reported. If you need to acquire both the
+    // queue_lock and attr_lock, ALWAYS acquire the queue_lock first, otherwise we can deadlock
     SF_RWLOCK_HANDLE attr_lock;
 
     // Snowflake statement error
@@ -64,14 +278,158 @@ struct SF_CHUNK_DOWNLOADER {
     sf_bool insecure_mode;
 };
 
+/**
+ * Settings of a chunk downloader other than the chunks themselves. A zeroed struct is a valid default:
+ * JSON chunks downloaded by one thread into unlimited memory, without hedging, retries, spilling, range
+ * requests, URL refreshes or decoding.
+ */
+typedef struct SF_CHUNK_DOWNLOADER_OPTIONS {
+    // Chunks are Arrow streams instead of JSON rowsets
+    sf_bool arrow_format;
+    // Request a straggling chunk a second time
+    sf_bool hedging;
+    // The consumer may go back to the chunks it got before
+    sf_bool scrollable;
+    // Threads and prefetch slots to start with. 0 means 1
+    uint64 thread_count;
+    uint64 fetch_slots;
+    // Threads the scheduler may grow to. 0 means thread_count
+    uint64 max_thread_count;
+    // Memory the prefetched chunks may take. 0 means unlimited
+    uint64 max_prefetch_bytes;
+    // Budget shared with the other chunk downloaders of the connection. Optional
+    SF_CHUNK_MEMORY_BUDGET *memory_budget;
+    // DNS and TLS sessions shared with the other chunk downloaders of the connection. Optional
+    SF_CHUNK_SHARE *share;
+    // Retries of a failed chunk download
+    uint64 max_retries;
+    // Chunks that don't fit in memory are written here, up to max_spill_bytes. Off if either is unset
+    const char *spill_dir;
+    uint64 max_spill_bytes;
+    // Chunks at least this large are downloaded as byte ranges. 0 means never
+    uint64 range_split_bytes;
+    // Gets fresh chunk URLs once they expired, called with url_refresh_ctx. Optional
+    SF_CHUNK_URL_REFRESH url_refresh;
+    void *url_refresh_ctx;
+    // Index of the first of the chunks in the result
+    uint64 first_chunk;
+    // Columns whose values are decoded once a chunk is parsed. NULL keeps them as text
+    const SF_COLUMN_DESC *decode_columns;
+    uint64 column_count;
+    // Disables the OCSP check, like the insecure mode of the connection
+    sf_bool insecure_mode;
+} SF_CHUNK_DOWNLOADER_OPTIONS;
+
+/**
+ * Starts downloading the chunks of a result.
+ *
+ * @param qrmk key of the encrypted chunks, if the response has no chunk_headers
+ * @param chunk_headers headers to send with every chunk request. Optional
+ * @param chunks the "chunks" array of the response
+ * @param options settings, NULL for the defaults of a zeroed struct
+ * @param sf_error set on failure
+ * @return chunk downloader or NULL on failure
+ */
 SF_CHUNK_DOWNLOADER *STDCALL chunk_downloader_init(const char *qrmk,
-                                                   cJSON* chunk_headers,
+                                                   cJSON *chunk_headers,
                                                    cJSON *chunks,
-                                                   uint64 thread_count,
-                                                   uint64 fetch_slots,
-                                                   SF_ERROR_STRUCT *sf_error,
-                                                   sf_bool insecure_mode);
+                                                   const SF_CHUNK_DOWNLOADER_OPTIONS *options,
+                                                   SF_ERROR_STRUCT *sf_error);
 sf_bool STDCALL chunk_downloader_term(SF_CHUNK_DOWNLOADER *chunk_downloader);
+/**
+ * Waits for the next chunk in order and hands its ownership over to the caller.
+ *
+ * @param chunk_downloader chunk downloader
+ * @param chunk the downloaded chunk, or NULL if there are no more chunks
+ * @param row_count number of rows in the chunk
+ * @return SF_BOOLEAN_FALSE if the downloader failed or was shut down, otherwise SF_BOOLEAN_TRUE
+ */
+sf_bool STDCALL chunk_downloader_get_next_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                                SF_ROWSET **chunk,
+                                                int64 *row_count);
+/**
+ * Finds the chunk that has a row in O(log chunks), using the row counts of the chunks.
+ *
+ * @param chunk_downloader chunk downloader
+ * @param row zero based index of the row among the rows of all the chunks
+ * @param index index of the chunk
+ * @param row_in_chunk zero based index of the row in the chunk
+ * @return SF_BOOLEAN_FALSE if the chunks have fewer rows
+ */
+sf_bool STDCALL chunk_downloader_find_row(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                          int64 row,
+                                          uint64 *index,
+                                          int64 *row_in_chunk);
+/**
+ * Hands a chunk of a scrollable result over to the caller, in any order. The chunks after the ones handed
+ * over so far are taken in order, and the ones skipped on the way are given back. A chunk that was given
+ * back is read again from memory, from its spill file, or downloaded again.
+ *
+ * @param chunk_downloader chunk downloader
+ * @param index index of the chunk
+ * @param chunk the chunk, or NULL if there is no such chunk
+ * @param row_count number of rows in the chunk
+ * @return SF_BOOLEAN_FALSE if the downloader failed or was shut down, otherwise SF_BOOLEAN_TRUE
+ */
+sf_bool STDCALL chunk_downloader_get_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                           uint64 index,
+                                           SF_ROWSET **chunk,
+                                           int64 *row_count);
+/**
+ * Gives a chunk of a scrollable result back once the consumer moved on to another one. The chunk
+ * downloader keeps it or frees it.
+ */
+void STDCALL chunk_downloader_return_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, uint64 index, SF_ROWSET *chunk);
+/**
+ * Gives the rowset of a chunk back once the consumer is done with it, so a worker can parse another chunk
+ * into its memory. The chunk downloader frees it if it has enough spares.
+ */
+void STDCALL chunk_downloader_recycle_chunk(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_ROWSET *chunk);
+/**
+ * Number of rows in all the chunks
+ */
+int64 STDCALL chunk_downloader_row_count(SF_CHUNK_DOWNLOADER *chunk_downloader);
+/**
+ * Adds the chunks, the qrmk and the chunkHeaders to data the way the query response has them, so
+ * chunk_downloader_init can read them back.
+ *
+ * @return SF_BOOLEAN_FALSE if out of memory
+ */
+sf_bool STDCALL chunk_downloader_to_cjson(SF_CHUNK_DOWNLOADER *chunk_downloader, cJSON *data);
+/**
+ * Splits the chunks into part_count chunk downloaders with contiguous ranges of about the same number of
+ * rows, so each part can be read by its own thread without sharing a queue_lock. The chunks downloaded so far
+ * move along. Must be called before the first chunk is handed over. On success the chunk downloader is freed.
+ *
+ * @param chunk_downloader chunk downloader
+ * @param part_count number of parts
+ * @param parts receives the chunk downloader of each part, NULL for a part without chunks
+ * @param sf_errors statement error of each part
+ * @param url_refresh_ctxs url_refresh_ctx of each part
+ * @return SF_BOOLEAN_FALSE if the chunk downloader couldn't be split, in which case it is left as it was
+ */
+sf_bool STDCALL chunk_downloader_split(SF_CHUNK_DOWNLOADER *chunk_downloader,
+                                       uint64 part_count,
+                                       SF_CHUNK_DOWNLOADER **parts,
+                                       SF_ERROR_STRUCT **sf_errors,
+                                       void **url_refresh_ctxs);
+/**
+ * Copies the download statistics of the chunk downloader.
+ */
+void STDCALL chunk_downloader_get_stats(SF_CHUNK_DOWNLOADER *chunk_downloader, SF_CHUNK_STATS *stats);
+SF_CHUNK_MEMORY_BUDGET *STDCALL chunk_memory_budget_init(void);
+void STDCALL chunk_memory_budget_set_limit(SF_CHUNK_MEMORY_BUDGET *memory_budget, uint64 limit);
+void STDCALL chunk_memory_budget_term(SF_CHUNK_MEMORY_BUDGET *memory_budget);
+/**
+ * Creates a curl share for the DNS cache and TLS sessions of chunk downloads.
+ *
+ * @return share or NULL if curl couldn't create one
+ */
+SF_CHUNK_SHARE *STDCALL chunk_share_init(void);
+/**
+ * Frees the share. Every chunk downloader using it must be terminated before, or the share is leaked.
+ */
+void STDCALL chunk_share_term(SF_CHUNK_SHARE *share);
 sf_bool STDCALL get_shutdown_or_error(SF_CHUNK_DOWNLOADER *chunk_downloader);
 sf_bool STDCALL get_shutdown(SF_CHUNK_DOWNLOADER *chunk_downloader);
 sf_bool STDCALL get_error(SF_CHUNK_DOWNLOADER *chunk_downloader);
@@ -16,6 +16,12 @@
 #include "results.h"
 #include "error.h"
 #include "chunk_downloader.h"
+#include "number_parser.h"
+#include "time_zone.h"
+#include "calendar.h"
+#include "timestamp_format.h"
+#include "hex.h"
+#include "base64.h"
 
 #define curl_easier_escape(curl, string) curl_easy_escape(curl, string, 0)
 
@@ -172,6 +178,11 @@ static SF_STATUS STDCALL _reset_connection_parameters(
                     strcmp(sf->service_name, value->valuestring) != 0) {
                     alloc_buffer_and_copy(&sf->service_name, value->valuestring);
                 }
+            } else if (strcmp(name->valuestring, "BINARY_OUTPUT_FORMAT") == 0) {
+                output_formats_set_binary(sf->output_formats, value->valuestring);
+            } else if (output_format_parameter(name->valuestring) != SF_OUTPUT_FORMAT_PARAMETER_COUNT) {
+                output_formats_set(sf->output_formats, output_format_parameter(name->valuestring),
+                                   value->valuestring);
             }
         }
     }
@@ -494,6 +505,8 @@ SF_STATUS STDCALL snowflake_global_init(
         fprintf(stderr, "Error during log initialization");
         goto cleanup;
     }
+    sf_time_zone_cache_init();
+    http_response_buffer_pool_init();
     CURLcode curl_ret = curl_global_init(CURL_GLOBAL_DEFAULT);
     if (curl_ret != CURLE_OK) {
         log_fatal("curl_global_init() failed: %s",
@@ -527,6 +540,8 @@ SF_STATUS STDCALL snowflake_global_term() {
     SF_FREE(CA_BUNDLE_FILE);
     SF_FREE(SF_HEADER_USER_AGENT);
 
+    sf_time_zone_cache_term();
+    http_response_buffer_pool_term();
     log_term();
     sf_alloc_map_to_log(SF_BOOLEAN_TRUE);
     sf_error_term();
@@ -622,6 +637,20 @@ SF_CONNECT *STDCALL snowflake_init() {
         sf->master_token = NULL;
         sf->login_timeout = SF_LOGIN_TIMEOUT;
         sf->network_timeout = 0;
+        sf->max_chunk_download_threads = SF_DEFAULT_MAX_CHUNK_DOWNLOAD_THREADS;
+        sf->max_chunk_prefetch_bytes = SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES;
+        sf->max_chunk_memory_bytes = 0;
+        sf->chunk_memory_budget = chunk_memory_budget_init();
+        sf->chunk_share = chunk_share_init();
+        sf->arrow_results = SF_BOOLEAN_FALSE;
+        sf->chunk_hedging = SF_BOOLEAN_FALSE;
+        sf->max_chunk_retries = SF_DEFAULT_MAX_CHUNK_RETRIES;
+        sf->chunk_spill_dir = NULL;
+        sf->max_chunk_spill_bytes = SF_DEFAULT_MAX_CHUNK_SPILL_BYTES;
+        sf->chunk_range_split_bytes = SF_DEFAULT_CHUNK_RANGE_SPLIT_BYTES;
+        sf->eager_chunk_decoding = SF_BOOLEAN_FALSE;
+        sf->session_output_formats = SF_BOOLEAN_FALSE;
+        sf->output_formats = output_formats_init();
         sf->sequence_counter = 0;
         _mutex_init(&sf->mutex_sequence_counter);
         sf->request_id[0] = '\0';
@@ -664,6 +693,9 @@ SF_STATUS STDCALL snowflake_term(SF_CONNECT *sf) {
 
     _mutex_term(&sf->mutex_sequence_counter);
     _mutex_term(&sf->mutex_parameters);
+    chunk_memory_budget_term(sf->chunk_memory_budget);
+    chunk_share_term(sf->chunk_share);
+    output_formats_term(sf->output_formats);
     SF_FREE(sf->host);
     SF_FREE(sf->port);
     SF_FREE(sf->user);
@@ -685,6 +717,7 @@ SF_STATUS STDCALL snowflake_term(SF_CONNECT *sf) {
     SF_FREE(sf->token);
     SF_FREE(sf->directURL);
     SF_FREE(sf->directURL_param);
+    SF_FREE(sf->chunk_spill_dir);
     SF_FREE(sf->direct_query_token);
     SF_FREE(sf);
 
@@ -954,6 +987,45 @@ SF_STATUS STDCALL snowflake_set_attribute(
         case SF_DIR_QUERY_TOKEN:
             alloc_buffer_and_copy(&sf->direct_query_token, value);
             break;
+        case SF_CON_MAX_CHUNK_DOWNLOAD_THREADS:
+            sf->max_chunk_download_threads = value && *((int64 *) value) > 0 ?
+                                             *((int64 *) value) : SF_DEFAULT_MAX_CHUNK_DOWNLOAD_THREADS;
+            break;
+        case SF_CON_MAX_CHUNK_PREFETCH_BYTES:
+            sf->max_chunk_prefetch_bytes = value && *((int64 *) value) > 0 ?
+                                           *((int64 *) value) : SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES;
+            break;
+        case SF_CON_MAX_CHUNK_MEMORY_BYTES:
+            sf->max_chunk_memory_bytes = value && *((int64 *) value) > 0 ? *((int64 *) value) : 0;
+            chunk_memory_budget_set_limit(sf->chunk_memory_budget, (uint64) sf->max_chunk_memory_bytes);
+            break;
+        case SF_CON_ARROW_RESULTS:
+            sf->arrow_results = value ? *((sf_bool *) value) : SF_BOOLEAN_FALSE;
+            break;
+        case SF_CON_CHUNK_HEDGING:
+            sf->chunk_hedging = value ? *((sf_bool *) value) : SF_BOOLEAN_FALSE;
+            break;
+        case SF_CON_MAX_CHUNK_RETRIES:
+            sf->max_chunk_retries = value && *((int64 *) value) >= 0 ?
+                                    *((int64 *) value) : SF_DEFAULT_MAX_CHUNK_RETRIES;
+            break;
+        case SF_CON_CHUNK_SPILL_DIR:
+            alloc_buffer_and_copy(&sf->chunk_spill_dir, value);
+            break;
+        case SF_CON_MAX_CHUNK_SPILL_BYTES:
+            sf->max_chunk_spill_bytes = value && *((int64 *) value) >= 0 ?
+                                        *((int64 *) value) : SF_DEFAULT_MAX_CHUNK_SPILL_BYTES;
+            break;
+        case SF_CON_CHUNK_RANGE_SPLIT_BYTES:
+            sf->chunk_range_split_bytes = value && *((int64 *) value) >= 0 ?
+                                          *((int64 *) value) : SF_DEFAULT_CHUNK_RANGE_SPLIT_BYTES;
+            break;
+        case SF_CON_EAGER_CHUNK_DECODING:
+            sf->eager_chunk_decoding = value ? *((sf_bool *) value) : SF_BOOLEAN_FALSE;
+            break;
+        case SF_CON_SESSION_OUTPUT_FORMATS:
+            sf->session_output_formats = value ? *((sf_bool *) value) : SF_BOOLEAN_FALSE;
+            break;
         default:
             SET_SNOWFLAKE_ERROR(&sf->error, SF_STATUS_ERROR_BAD_ATTRIBUTE_TYPE,
                                 "Invalid attribute type",
@@ -1046,6 +1118,39 @@ SF_STATUS STDCALL snowflake_get_attribute(
         case SF_DIR_QUERY_TOKEN:
             *value = sf->direct_query_token;
             break;
+        case SF_CON_MAX_CHUNK_DOWNLOAD_THREADS:
+            *value = &sf->max_chunk_download_threads;
+            break;
+        case SF_CON_MAX_CHUNK_PREFETCH_BYTES:
+            *value = &sf->max_chunk_prefetch_bytes;
+            break;
+        case SF_CON_MAX_CHUNK_MEMORY_BYTES:
+            *value = &sf->max_chunk_memory_bytes;
+            break;
+        case SF_CON_ARROW_RESULTS:
+            *value = &sf->arrow_results;
+            break;
+        case SF_CON_CHUNK_HEDGING:
+            *value = &sf->chunk_hedging;
+            break;
+        case SF_CON_MAX_CHUNK_RETRIES:
+            *value = &sf->max_chunk_retries;
+            break;
+        case SF_CON_CHUNK_SPILL_DIR:
+            *value = sf->chunk_spill_dir;
+            break;
+        case SF_CON_MAX_CHUNK_SPILL_BYTES:
+            *value = &sf->max_chunk_spill_bytes;
+            break;
+        case SF_CON_CHUNK_RANGE_SPLIT_BYTES:
+            *value = &sf->chunk_range_split_bytes;
+            break;
+        case SF_CON_EAGER_CHUNK_DECODING:
+            *value = &sf->eager_chunk_decoding;
+            break;
+        case SF_CON_SESSION_OUTPUT_FORMATS:
+            *value = &sf->session_output_formats;
+            break;
         default:
             SET_SNOWFLAKE_ERROR(&sf->error, SF_STATUS_ERROR_BAD_ATTRIBUTE_TYPE,
                                 "Invalid attribute type",
@@ -1177,6 +1282,13 @@ static void STDCALL _snowflake_deallocate_named_param_list(void * name_list)
     SF_FREE(name_list);
 }
 
+/**
+ * Index of the current row in the rowset of the current chunk
+ */
+static int64 STDCALL _snowflake_cur_row_index(SF_STMT *sfstmt) {
+    return ((SF_ROWSET *) sfstmt->raw_results)->row_count - sfstmt->chunk_rowcount - 1;
+}
+
 /**
  * Resets SNOWFLAKE_STMT parameters.
  *
@@ -1194,17 +1306,18 @@ static void STDCALL _snowflake_stmt_reset(SF_STMT *sfstmt) {
     }
     sfstmt->sql_text = NULL;
 
-    if (sfstmt->cur_row) {
-        snowflake_cJSON_Delete(sfstmt->cur_row);
-        sfstmt->cur_row = NULL;
-    }
+    // The current row points into the results
     sfstmt->cur_row = NULL;
+    row_scratch_reset((SF_ROW_SCRATCH *) sfstmt->row_scratch);
 
     if (sfstmt->raw_results) {
-        snowflake_cJSON_Delete(sfstmt->raw_results);
+        rowset_term((SF_ROWSET *) sfstmt->raw_results);
         sfstmt->raw_results = NULL;
     }
     sfstmt->raw_results = NULL;
+    rowset_term((SF_ROWSET *) sfstmt->first_results);
+    sfstmt->first_results = NULL;
+    sfstmt->chunk_index = -1;
 
 
     if (_snowflake_get_current_param_style(sfstmt) == NAMED)
@@ -1219,6 +1332,10 @@ static void STDCALL _snowflake_stmt_reset(SF_STMT *sfstmt) {
     sfstmt->params_len = 0;
     sfstmt->name_list = NULL;
 
+    SF_FREE(sfstmt->bound_columns);
+    sfstmt->bound_columns = NULL;
+    sfstmt->bound_columns_len = 0;
+
     _snowflake_stmt_desc_reset(sfstmt);
 
     if (sfstmt->stmt_attrs) {
@@ -1237,6 +1354,7 @@ static void STDCALL _snowflake_stmt_reset(SF_STMT *sfstmt) {
     // Destroy chunk downloader
     chunk_downloader_term(sfstmt->chunk_downloader);
     sfstmt->chunk_downloader = NULL;
+    memset(&sfstmt->chunk_stats, 0, sizeof(sfstmt->chunk_stats));
 
     if (sfstmt->put_get_response) {
         // clean up put get response data
@@ -1322,6 +1440,7 @@ void STDCALL snowflake_bind_input_init(SF_BIND_INPUT * input)
 void STDCALL snowflake_stmt_term(SF_STMT *sfstmt) {
     if (sfstmt) {
         _snowflake_stmt_reset(sfstmt);
+        row_scratch_term((SF_ROW_SCRATCH *) sfstmt->row_scratch);
         SF_FREE(sfstmt);
     }
 }
@@ -1416,124 +1535,966 @@ SF_STATUS snowflake_bind_param_array(
                     sfbind_array[i].name, sfstmt->params_len);
         }
 
-        sfstmt->params_len += 1;
+        sfstmt->params_len += 1;
+    }
+
+    return SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL snowflake_query(
+    SF_STMT *sfstmt, const char *command, size_t command_size) {
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    SF_STATUS ret = snowflake_prepare(sfstmt, command, command_size);
+    if (ret != SF_STATUS_SUCCESS) {
+        return ret;
+    }
+    ret = snowflake_execute(sfstmt);
+    if (ret != SF_STATUS_SUCCESS) {
+        return ret;
+    }
+    return SF_STATUS_SUCCESS;
+}
+
+/**
+ * Makes row the current row of the current chunk
+ */
+static void STDCALL _snowflake_seek_row(SF_STMT *sfstmt, int64 row) {
+    SF_ROWSET *rowset = (SF_ROWSET *) sfstmt->raw_results;
+    sfstmt->chunk_rowcount = rowset->row_count - row - 1;
+    sfstmt->cur_row = &rowset->cells[rowset->row_starts[row]];
+    // Strings formatted from the previous row are no longer valid
+    row_scratch_reset((SF_ROW_SCRATCH *) sfstmt->row_scratch);
+}
+
+/**
+ * Makes a chunk of a scrollable result the current one, -1 being the rows of the query response.
+ * The chunk downloader gets the current chunk back and keeps it or fetches it again when needed.
+ *
+ * @return SF_STATUS_SUCCESS, SF_STATUS_EOF if there is no such chunk, or an error
+ */
+static SF_STATUS STDCALL _snowflake_scroll_to_chunk(SF_STMT *sfstmt, int64 index) {
+    SF_STATUS ret = SF_STATUS_SUCCESS;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+
+    sfstmt->cur_row = NULL;
+    if (index == sfstmt->chunk_index) {
+        return SF_STATUS_SUCCESS;
+    }
+    if (sfstmt->chunk_index < 0) {
+        sfstmt->first_results = sfstmt->raw_results;
+    } else if (sfstmt->chunk_downloader) {
+        chunk_downloader_return_chunk(sfstmt->chunk_downloader, (uint64) sfstmt->chunk_index,
+                                      (SF_ROWSET *) sfstmt->raw_results);
+    }
+    sfstmt->raw_results = NULL;
+    sfstmt->chunk_index = index;
+
+    if (index < 0) {
+        sfstmt->raw_results = sfstmt->first_results;
+        sfstmt->first_results = NULL;
+        row_count = sfstmt->raw_results ? ((SF_ROWSET *) sfstmt->raw_results)->row_count : 0;
+    } else if (!sfstmt->chunk_downloader) {
+        ret = SF_STATUS_EOF;
+    } else if (!chunk_downloader_get_chunk(sfstmt->chunk_downloader, (uint64) index, &chunk, &row_count)) {
+        ret = SF_STATUS_ERROR_GENERAL;
+    } else if (!chunk) {
+        log_debug("Out of chunks, setting EOL.");
+        ret = SF_STATUS_EOF;
+    } else {
+        sfstmt->raw_results = chunk;
+    }
+    sfstmt->chunk_rowcount = row_count;
+    return ret;
+}
+
+/**
+ * Moves on to the next chunk once all the rows of the current one were fetched
+ *
+ * @return SF_STATUS_SUCCESS if there are rows left, SF_STATUS_EOF or an error
+ */
+static SF_STATUS STDCALL _snowflake_next_chunk(SF_STMT *sfstmt) {
+    SF_STATUS ret = SF_STATUS_ERROR_GENERAL;
+    sf_bool get_chunk_success = SF_BOOLEAN_TRUE;
+    SF_ROWSET *chunk = NULL;
+
+    // Check for chunk_downloader error
+    if (sfstmt->chunk_downloader && get_error(sfstmt->chunk_downloader)) {
+        goto cleanup;
+    }
+
+    // If no more results, set return to SF_STATUS_EOF
+    if (sfstmt->chunk_rowcount == 0) {
+        if (sfstmt->scrollable) {
+            // The chunks are kept, and empty ones are skipped
+            do {
+                ret = _snowflake_scroll_to_chunk(sfstmt, sfstmt->chunk_index + 1);
+            } while (ret == SF_STATUS_SUCCESS && sfstmt->chunk_rowcount == 0);
+            goto cleanup;
+        }
+        if (sfstmt->chunk_downloader) {
+            log_debug("Fetching next chunk from chunk downloader.");
+            // The chunk downloader parses another chunk into the memory of the previous one
+            sfstmt->cur_row = NULL;
+            chunk_downloader_recycle_chunk(sfstmt->chunk_downloader, (SF_ROWSET *) sfstmt->raw_results);
+            sfstmt->raw_results = NULL;
+            if (!chunk_downloader_get_next_chunk(sfstmt->chunk_downloader,
+                                                 &chunk, &sfstmt->chunk_rowcount)) {
+                get_chunk_success = SF_BOOLEAN_FALSE;
+            } else if (chunk == NULL) {
+                // No more chunks, set EOL
+                log_debug("Out of chunks, setting EOL.");
+                ret = SF_STATUS_EOF;
+            } else {
+                sfstmt->raw_results = chunk;
+            }
+        } else {
+            // If there is no chunk downloader set, then we've truly reached the end of the results and should set EOL
+            log_debug("No chunk downloader set, end of results.");
+            ret = SF_STATUS_EOF;
+        }
+
+        // If we've reached the end, or we have an error getting the next chunk, goto cleanup and return status
+        if (ret == SF_STATUS_EOF || !get_chunk_success) {
+            goto cleanup;
+        }
+    }
+    ret = SF_STATUS_SUCCESS;
+
+cleanup:
+    return ret;
+}
+
+SF_STATUS STDCALL snowflake_fetch(SF_STMT *sfstmt) {
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    SF_STATUS ret;
+    sfstmt->cur_row = NULL;
+
+    if ((ret = _snowflake_next_chunk(sfstmt)) != SF_STATUS_SUCCESS) {
+        return ret;
+    }
+
+    // Get next result row. Rows stay in the rowset until the whole chunk is consumed.
+    _snowflake_seek_row(sfstmt, ((SF_ROWSET *) sfstmt->raw_results)->row_count - sfstmt->chunk_rowcount);
+    sfstmt->total_row_index++;
+    return SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL snowflake_fetch_absolute(SF_STMT *sfstmt, int64 row) {
+    SF_ROWSET *first_results;
+    SF_STATUS ret;
+    int64 index = -1;
+    int64 row_in_chunk = row;
+    int64 first_row_count;
+    uint64 chunk_index;
+
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    if (!sfstmt->scrollable) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_APPLICATION_ERROR,
+                                 "Statement is not scrollable. Set SF_STMT_SCROLLABLE before the query.",
+                                 SF_SQLSTATE_INVALID_FETCH_ORIENTATION, sfstmt->sfqid);
+        return SF_STATUS_ERROR_APPLICATION_ERROR;
+    }
+    if (row < 0) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_BOUNDS, "Row index must not be negative",
+                                 SF_SQLSTATE_ROW_VALUE_OUT_OF_RANGE, sfstmt->sfqid);
+        return SF_STATUS_ERROR_OUT_OF_BOUNDS;
+    }
+    if (sfstmt->chunk_downloader && get_error(sfstmt->chunk_downloader)) {
+        return SF_STATUS_ERROR_GENERAL;
+    }
+
+    // The rows of the query response come first, then the rows of the chunks
+    first_results = (SF_ROWSET *) (sfstmt->chunk_index < 0 ? sfstmt->raw_results : sfstmt->first_results);
+    first_row_count = first_results ? first_results->row_count : 0;
+    if (row >= first_row_count) {
+        if (!sfstmt->chunk_downloader ||
+            !chunk_downloader_find_row(sfstmt->chunk_downloader, row - first_row_count, &chunk_index,
+                                       &row_in_chunk)) {
+            return SF_STATUS_EOF;
+        }
+        index = (int64) chunk_index;
+    }
+
+    if ((ret = _snowflake_scroll_to_chunk(sfstmt, index)) != SF_STATUS_SUCCESS) {
+        return ret;
+    }
+    _snowflake_seek_row(sfstmt, row_in_chunk);
+    sfstmt->total_row_index = row + 1;
+    return SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL snowflake_rewind(SF_STMT *sfstmt) {
+    SF_STATUS ret;
+
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    if (!sfstmt->scrollable) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_APPLICATION_ERROR,
+                                 "Statement is not scrollable. Set SF_STMT_SCROLLABLE before the query.",
+                                 SF_SQLSTATE_INVALID_FETCH_ORIENTATION, sfstmt->sfqid);
+        return SF_STATUS_ERROR_APPLICATION_ERROR;
+    }
+
+    if ((ret = _snowflake_scroll_to_chunk(sfstmt, -1)) != SF_STATUS_SUCCESS) {
+        return ret;
+    }
+    sfstmt->chunk_rowcount = sfstmt->raw_results ? ((SF_ROWSET *) sfstmt->raw_results)->row_count : 0;
+    sfstmt->total_row_index = 0;
+    return SF_STATUS_SUCCESS;
+}
+
+/**
+ * Sets up a partition of a result with the columns and the settings of the statement
+ */
+static sf_bool STDCALL _snowflake_init_partition(SF_STMT *partition, SF_STMT *sfstmt) {
+    int64 i;
+    size_t len;
+
+    sb_strncpy(partition->sfqid, SF_UUID4_LEN, sfstmt->sfqid, sizeof(partition->sfqid));
+    partition->user_realloc_func = sfstmt->user_realloc_func;
+    partition->max_chunk_prefetch_bytes = sfstmt->max_chunk_prefetch_bytes;
+    partition->scrollable = sfstmt->scrollable;
+    partition->is_dml = sfstmt->is_dml;
+    partition->chunk_rowcount = 0;
+    partition->total_rowcount = 0;
+    partition->total_row_index = 0;
+    if (sfstmt->desc && sfstmt->total_fieldcount > 0) {
+        partition->desc = (SF_COLUMN_DESC *) SF_CALLOC((size_t) sfstmt->total_fieldcount, sizeof(SF_COLUMN_DESC));
+        if (!partition->desc) {
+            return SF_BOOLEAN_FALSE;
+        }
+        partition->total_fieldcount = sfstmt->total_fieldcount;
+        for (i = 0; i < sfstmt->total_fieldcount; i++) {
+            partition->desc[i] = sfstmt->desc[i];
+            partition->desc[i].name = NULL;
+            if (sfstmt->desc[i].name) {
+                len = strlen(sfstmt->desc[i].name) + 1;
+                if ((partition->desc[i].name = (char *) SF_CALLOC(1, len)) == NULL) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                sb_strcpy(partition->desc[i].name, len, sfstmt->desc[i].name);
+            }
+        }
+    } else {
+        partition->total_fieldcount = sfstmt->total_fieldcount;
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+SF_STATUS STDCALL snowflake_partition_result(SF_STMT *sfstmt, int64 partition_count, SF_STMT **partitions) {
+    SF_STATUS ret = SF_STATUS_ERROR_GENERAL;
+    SF_CHUNK_DOWNLOADER **parts = NULL;
+    SF_ERROR_STRUCT **errors = NULL;
+    void **url_refresh_ctxs = NULL;
+    SF_ROWSET *rowset;
+    int64 i;
+
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    if (!partitions) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_NULL_POINTER,
+                                 "partitions must not be NULL", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_NULL_POINTER;
+    }
+    if (partition_count <= 0) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_BOUNDS,
+                                 "Partition count must be positive", SF_SQLSTATE_INVALID_ATTRIBUTE_VALUE,
+                                 sfstmt->sfqid);
+        return SF_STATUS_ERROR_OUT_OF_BOUNDS;
+    }
+    if ((!sfstmt->raw_results && !sfstmt->chunk_downloader) || sfstmt->total_row_index != 0 ||
+        sfstmt->chunk_index >= 0) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_APPLICATION_ERROR,
+                                 "Result can only be partitioned after the query and before the first fetch",
+                                 SF_SQLSTATE_FUNCTION_SEQUENCE_ERROR, sfstmt->sfqid);
+        return SF_STATUS_ERROR_APPLICATION_ERROR;
+    }
+
+    memset(partitions, 0, (size_t) partition_count * sizeof(SF_STMT *));
+    parts = (SF_CHUNK_DOWNLOADER **) SF_CALLOC((size_t) partition_count, sizeof(SF_CHUNK_DOWNLOADER *));
+    errors = (SF_ERROR_STRUCT **) SF_CALLOC((size_t) partition_count, sizeof(SF_ERROR_STRUCT *));
+    url_refresh_ctxs = (void **) SF_CALLOC((size_t) partition_count, sizeof(void *));
+    if (!parts || !errors || !url_refresh_ctxs) {
+        goto out_of_memory;
+    }
+    for (i = 0; i < partition_count; i++) {
+        if ((partitions[i] = snowflake_stmt(sfstmt->connection)) == NULL ||
+            !_snowflake_init_partition(partitions[i], sfstmt)) {
+            goto out_of_memory;
+        }
+        errors[i] = &partitions[i]->error;
+        url_refresh_ctxs[i] = partitions[i];
+    }
+
+    if (sfstmt->chunk_downloader) {
+        if (!chunk_downloader_split(sfstmt->chunk_downloader, (uint64) partition_count, parts, errors,
+                                    url_refresh_ctxs)) {
+            // Error is set in chunk_downloader_split
+            ret = sfstmt->error.error_code;
+            goto cleanup;
+        }
+        sfstmt->chunk_downloader = NULL;
+        for (i = 0; i < partition_count; i++) {
+            partitions[i]->chunk_downloader = parts[i];
+            partitions[i]->total_rowcount = parts[i] ? chunk_downloader_row_count(parts[i]) : 0;
+        }
+    }
+
+    // The rows of the query response go with the first partition
+    rowset = (SF_ROWSET *) sfstmt->raw_results;
+    partitions[0]->raw_results = rowset;
+    partitions[0]->chunk_rowcount = rowset ? rowset->row_count : 0;
+    partitions[0]->total_rowcount += rowset ? rowset->row_count : 0;
+    sfstmt->raw_results = NULL;
+    sfstmt->chunk_rowcount = 0;
+    ret = SF_STATUS_SUCCESS;
+    goto cleanup;
+
+out_of_memory:
+    SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_MEMORY,
+                             "Unable to allocate result partitions", SF_SQLSTATE_MEMORY_ALLOCATION_ERROR,
+                             sfstmt->sfqid);
+    ret = SF_STATUS_ERROR_OUT_OF_MEMORY;
+
+cleanup:
+    SF_FREE(parts);
+    SF_FREE(errors);
+    SF_FREE(url_refresh_ctxs);
+    if (ret != SF_STATUS_SUCCESS) {
+        for (i = 0; i < partition_count; i++) {
+            snowflake_stmt_term(partitions[i]);
+            partitions[i] = NULL;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Gets the chunks of the result of the statement again, with fresh URLs, for the chunk downloader.
+ * Runs on the thread that fetches the rows, like the rest of the calls on the connection.
+ */
+static sf_bool STDCALL _snowflake_refresh_chunk_urls(void *ctx, cJSON **chunks, SF_ERROR_STRUCT *error) {
+    SF_STMT *sfstmt = (SF_STMT *) ctx;
+    cJSON *resp = NULL;
+    cJSON *data;
+    sf_bool success = SF_BOOLEAN_FALSE;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+    char url[sizeof(QUERY_RESULT_URL_FORMAT) + SF_UUID4_LEN];
+
+    sb_sprintf(url, sizeof(url), QUERY_RESULT_URL_FORMAT, sfstmt->sfqid);
+    if (!request(sfstmt->connection, &resp, url, NULL, 0, NULL, NULL, GET_REQUEST_TYPE, error,
+                 SF_BOOLEAN_FALSE)) {
+        goto cleanup;
+    }
+    data = snowflake_cJSON_GetObjectItem(resp, "data");
+    if (json_copy_bool(&success, resp, "success") != SF_JSON_ERROR_NONE || !success ||
+        json_detach_array_from_object(chunks, data, "chunks") != SF_JSON_ERROR_NONE) {
+        SET_SNOWFLAKE_STMT_ERROR(error, SF_STATUS_ERROR_BAD_RESPONSE, "Unable to get the chunks of the result again",
+                                 SF_SQLSTATE_UNABLE_TO_CONNECT, sfstmt->sfqid);
+        goto cleanup;
+    }
+    ret = SF_BOOLEAN_TRUE;
+
+cleanup:
+    snowflake_cJSON_Delete(resp);
+    return ret;
+}
+
+/**
+ * Starts downloading the result chunks with the settings of the statement and its connection.
+ * first_chunk is the index of the first of the chunks in the result.
+ */
+static SF_CHUNK_DOWNLOADER *STDCALL _snowflake_chunk_downloader_init(SF_STMT *sfstmt,
+                                                                     const char *qrmk,
+                                                                     cJSON *chunk_headers,
+                                                                     cJSON *chunks,
+                                                                     sf_bool arrow_format,
+                                                                     int64 first_chunk) {
+    SF_CONNECT *sf = sfstmt->connection;
+    SF_CHUNK_DOWNLOADER_OPTIONS options;
+
+    memset(&options, 0, sizeof(options));
+    options.arrow_format = arrow_format;
+    options.hedging = sf->chunk_hedging;
+    options.scrollable = sfstmt->scrollable;
+    options.thread_count = 2;
+    options.fetch_slots = 4;
+    options.max_thread_count = (uint64) sf->max_chunk_download_threads;
+    options.max_prefetch_bytes = (uint64) (sfstmt->max_chunk_prefetch_bytes > 0 ?
+                                           sfstmt->max_chunk_prefetch_bytes :
+                                           sf->max_chunk_prefetch_bytes);
+    options.memory_budget = sf->chunk_memory_budget;
+    options.share = sf->chunk_share;
+    options.max_retries = (uint64) sf->max_chunk_retries;
+    options.spill_dir = sf->chunk_spill_dir;
+    options.max_spill_bytes = (uint64) sf->max_chunk_spill_bytes;
+    options.range_split_bytes = (uint64) sf->chunk_range_split_bytes;
+    // A cursor of a serialized result may not have a session to get fresh chunk URLs with
+    options.url_refresh = sf->token ? _snowflake_refresh_chunk_urls : NULL;
+    options.url_refresh_ctx = sfstmt;
+    options.first_chunk = (uint64) first_chunk;
+    if (sf->eager_chunk_decoding) {
+        options.decode_columns = sfstmt->desc;
+        options.column_count = (uint64) sfstmt->total_fieldcount;
+    }
+    options.insecure_mode = sf->insecure_mode;
+    return chunk_downloader_init(qrmk, chunk_headers, chunks, &options, &sfstmt->error);
+}
+
+SF_STATUS STDCALL snowflake_serialize_result(SF_STMT *sfstmt, char **blob, size_t *len) {
+    SF_STATUS ret = SF_STATUS_ERROR_OUT_OF_MEMORY;
+    cJSON *data = NULL;
+    cJSON *item;
+
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    if (!blob) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_NULL_POINTER,
+                                 "blob must not be NULL", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_NULL_POINTER;
+    }
+    *blob = NULL;
+    if ((!sfstmt->raw_results && !sfstmt->chunk_downloader) || sfstmt->total_row_index != 0 ||
+        sfstmt->chunk_index >= 0) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_APPLICATION_ERROR,
+                                 "Result can only be serialized after the query and before the first fetch",
+                                 SF_SQLSTATE_FUNCTION_SEQUENCE_ERROR, sfstmt->sfqid);
+        return SF_STATUS_ERROR_APPLICATION_ERROR;
+    }
+
+    // Same keys as the data of the query response, except the rows are always JSON
+    if ((data = snowflake_cJSON_CreateObject()) == NULL ||
+        !snowflake_cJSON_AddNumberToObject(data, "version", SF_RESULT_BLOB_VERSION) ||
+        !snowflake_cJSON_AddStringToObject(data, "queryId", sfstmt->sfqid) ||
+        !snowflake_cJSON_AddNumberToObject(data, "total", (double) sfstmt->total_rowcount) ||
+        !snowflake_cJSON_AddStringToObject(data, "chunkFormat",
+                                           sfstmt->chunk_downloader && sfstmt->chunk_downloader->arrow_format ?
+                                           "arrow" : "json")) {
+        goto cleanup;
+    }
+    if ((item = description_to_cjson(sfstmt->desc, sfstmt->total_fieldcount)) == NULL) {
+        goto cleanup;
+    }
+    snowflake_cJSON_AddItemToObject(data, "rowtype", item);
+    if ((item = rowset_to_cjson((SF_ROWSET *) sfstmt->raw_results)) == NULL) {
+        goto cleanup;
+    }
+    snowflake_cJSON_AddItemToObject(data, "rowset", item);
+    if (sfstmt->chunk_downloader && !chunk_downloader_to_cjson(sfstmt->chunk_downloader, data)) {
+        goto cleanup;
+    }
+    if ((*blob = snowflake_cJSON_PrintUnformatted(data)) == NULL) {
+        goto cleanup;
+    }
+    if (len) {
+        *len = strlen(*blob);
+    }
+    ret = SF_STATUS_SUCCESS;
+
+cleanup:
+    snowflake_cJSON_Delete(data);
+    if (ret != SF_STATUS_SUCCESS) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, ret, "Unable to serialize the result",
+                                 SF_SQLSTATE_MEMORY_ALLOCATION_ERROR, sfstmt->sfqid);
+    }
+    return ret;
+}
+
+void STDCALL snowflake_result_blob_free(char *blob) {
+    snowflake_cJSON_free(blob);
+}
+
+SF_STATUS STDCALL snowflake_stmt_from_result(SF_CONNECT *sf, const char *blob, int64 first_chunk,
+                                             int64 chunk_count, SF_STMT **sfstmt) {
+    SF_STATUS ret = SF_STATUS_ERROR_BAD_JSON;
+    SF_STMT *stmt = NULL;
+    cJSON *data = NULL;
+    cJSON *range = NULL;
+    cJSON *subset;
+    cJSON *chunks;
+    cJSON *rowtype;
+    cJSON *rowset;
+    cJSON *format;
+    char *qrmk = NULL;
+    int64 version;
+    int64 size = 0;
+    int64 i;
+
+    if (!sf) {
+        return SF_STATUS_ERROR_CONNECTION_NOT_EXIST;
+    }
+    clear_snowflake_error(&sf->error);
+    if (!blob || !sfstmt) {
+        SET_SNOWFLAKE_ERROR(&sf->error, SF_STATUS_ERROR_NULL_POINTER,
+                            "blob and sfstmt must not be NULL", "");
+        return SF_STATUS_ERROR_NULL_POINTER;
+    }
+    *sfstmt = NULL;
+
+    data = snowflake_cJSON_Parse(blob);
+    rowtype = snowflake_cJSON_GetObjectItem(data, "rowtype");
+    rowset = snowflake_cJSON_GetObjectItem(data, "rowset");
+    chunks = snowflake_cJSON_GetObjectItem(data, "chunks");
+    if (!data || json_copy_int(&version, data, "version") || version != SF_RESULT_BLOB_VERSION ||
+        !snowflake_cJSON_IsArray(rowtype) || !snowflake_cJSON_IsArray(rowset) ||
+        (chunks && !snowflake_cJSON_IsArray(chunks))) {
+        SET_SNOWFLAKE_ERROR(&sf->error, SF_STATUS_ERROR_BAD_JSON,
+                            "Not a result serialized by snowflake_serialize_result", "");
+        goto cleanup;
+    }
+    size = chunks ? snowflake_cJSON_GetArraySize(chunks) : 0;
+    if (first_chunk < 0 || first_chunk > size) {
+        ret = SF_STATUS_ERROR_OUT_OF_BOUNDS;
+        SET_SNOWFLAKE_ERROR(&sf->error, ret, "First chunk out of range", SF_SQLSTATE_INVALID_ATTRIBUTE_VALUE);
+        goto cleanup;
+    }
+    if (chunk_count < 0 || chunk_count > size - first_chunk) {
+        chunk_count = size - first_chunk;
+    }
+
+    ret = SF_STATUS_ERROR_OUT_OF_MEMORY;
+    if ((stmt = snowflake_stmt(sf)) == NULL) {
+        goto out_of_memory;
+    }
+    json_copy_string_no_alloc(stmt->sfqid, data, "queryId", SF_UUID4_LEN);
+    stmt->chunk_rowcount = 0;
+    stmt->total_rowcount = 0;
+    stmt->total_row_index = 0;
+    stmt->total_fieldcount = snowflake_cJSON_GetArraySize(rowtype);
+    stmt->desc = set_description(rowtype);
+    if (stmt->total_fieldcount > 0 && !stmt->desc) {
+        goto out_of_memory;
+    }
+    // The rows of the query response go with the cursor that starts at the first chunk
+    if (first_chunk == 0) {
+        if ((stmt->raw_results = rowset_from_cjson(rowset)) == NULL) {
+            goto out_of_memory;
+        }
+        stmt->chunk_rowcount = ((SF_ROWSET *) stmt->raw_results)->row_count;
+        stmt->total_rowcount = stmt->chunk_rowcount;
+    }
+
+    if (chunk_count > 0) {
+        // chunk_downloader_init takes the chunks out of an array named "chunks"
+        if ((range = snowflake_cJSON_CreateObject()) == NULL ||
+            (subset = snowflake_cJSON_AddArrayToObject(range, "chunks")) == NULL) {
+            goto out_of_memory;
+        }
+        for (i = 0; i < chunk_count; i++) {
+            snowflake_cJSON_AddItemToArray(subset, snowflake_cJSON_DetachItemFromArray(chunks, (int) first_chunk));
+        }
+        json_copy_string(&qrmk, data, "qrmk");
+        format = snowflake_cJSON_GetObjectItem(data, "chunkFormat");
+        stmt->chunk_downloader = _snowflake_chunk_downloader_init(
+            stmt, qrmk, snowflake_cJSON_GetObjectItem(data, "chunkHeaders"), subset,
+            snowflake_cJSON_IsString(format) && strcmp(format->valuestring, "arrow") == 0, first_chunk);
+        if (!stmt->chunk_downloader) {
+            if (stmt->error.error_code == SF_STATUS_SUCCESS || !stmt->error.msg) {
+                goto out_of_memory;
+            }
+            ret = stmt->error.error_code;
+            SET_SNOWFLAKE_STMT_ERROR(&sf->error, ret, stmt->error.msg, stmt->error.sqlstate, stmt->sfqid);
+            goto cleanup;
+        }
+        stmt->total_rowcount += chunk_downloader_row_count(stmt->chunk_downloader);
+    }
+    *sfstmt = stmt;
+    stmt = NULL;
+    ret = SF_STATUS_SUCCESS;
+    goto cleanup;
+
+out_of_memory:
+    SET_SNOWFLAKE_ERROR(&sf->error, ret, "Unable to create a statement from the result",
+                        SF_SQLSTATE_MEMORY_ALLOCATION_ERROR);
+
+cleanup:
+    snowflake_stmt_term(stmt);
+    snowflake_cJSON_Delete(range);
+    snowflake_cJSON_Delete(data);
+    SF_FREE(qrmk);
+    return ret;
+}
+
+SF_STATUS STDCALL snowflake_bind_column(SF_STMT *sfstmt, size_t idx, SF_C_TYPE c_type, void *value,
+                                        size_t element_size, int64 *len_or_ind) {
+    SF_BIND_OUTPUT *bound_columns;
+    SF_BIND_OUTPUT *output;
+    size_t type_size = 0;
+
+    if (!sfstmt) {
+        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
+    }
+    clear_snowflake_error(&sfstmt->error);
+    if (idx == 0) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_BOUNDS,
+                                 "Column index must be greater than 0", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_OUT_OF_BOUNDS;
+    }
+
+    if (!value) {
+        // Unbind the column
+        if (idx <= sfstmt->bound_columns_len) {
+            memset(&sfstmt->bound_columns[idx - 1], 0, sizeof(SF_BIND_OUTPUT));
+        }
+        return SF_STATUS_SUCCESS;
+    }
+
+    switch (c_type) {
+        case SF_C_TYPE_INT64:
+            type_size = sizeof(int64);
+            break;
+        case SF_C_TYPE_UINT64:
+            type_size = sizeof(uint64);
+            break;
+        case SF_C_TYPE_FLOAT64:
+            type_size = sizeof(float64);
+            break;
+        case SF_C_TYPE_BOOLEAN:
+            type_size = sizeof(sf_bool);
+            break;
+        case SF_C_TYPE_STRING:
+            // At least the NUL terminator
+            type_size = 1;
+            if (element_size == 0) {
+                SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_BUFFER_TOO_SMALL,
+                                         "element_size must be the size of each string", "", sfstmt->sfqid);
+                return SF_STATUS_ERROR_BUFFER_TOO_SMALL;
+            }
+            break;
+        case SF_C_TYPE_BINARY:
+            type_size = 1;
+            if (element_size == 0) {
+                SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_BUFFER_TOO_SMALL,
+                                         "element_size must be the size of each binary value", "", sfstmt->sfqid);
+                return SF_STATUS_ERROR_BUFFER_TOO_SMALL;
+            }
+            break;
+        default:
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_BAD_DATA_OUTPUT_TYPE,
+                                     "C type not supported for a bound column", "", sfstmt->sfqid);
+            return SF_STATUS_ERROR_BAD_DATA_OUTPUT_TYPE;
+    }
+    if (element_size == 0) {
+        element_size = type_size;
+    } else if (element_size < type_size) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_BUFFER_TOO_SMALL,
+                                 "element_size is smaller than the C type", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_BUFFER_TOO_SMALL;
+    }
+
+    if (idx > sfstmt->bound_columns_len) {
+        bound_columns = (SF_BIND_OUTPUT *) SF_REALLOC(sfstmt->bound_columns, idx * sizeof(SF_BIND_OUTPUT));
+        if (!bound_columns) {
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_MEMORY,
+                                     "Out of memory binding a column", SF_SQLSTATE_MEMORY_ALLOCATION_ERROR,
+                                     sfstmt->sfqid);
+            return SF_STATUS_ERROR_OUT_OF_MEMORY;
+        }
+        memset(&bound_columns[sfstmt->bound_columns_len], 0,
+               (idx - sfstmt->bound_columns_len) * sizeof(SF_BIND_OUTPUT));
+        sfstmt->bound_columns = bound_columns;
+        sfstmt->bound_columns_len = idx;
+    }
+
+    output = &sfstmt->bound_columns[idx - 1];
+    output->idx = idx;
+    output->c_type = c_type;
+    output->value = value;
+    output->element_size = element_size;
+    output->len_or_ind = len_or_ind;
+    return SF_STATUS_SUCCESS;
+}
+
+/**
+ * Copies a string into a fixed size element of a bound array, truncating it if needed
+ */
+static void STDCALL _snowflake_copy_bound_string(char *dst, size_t dst_size, const char *src, size_t len) {
+    size_t copy_len = len < dst_size ? len : dst_size - 1;
+    memcpy(dst, src, copy_len);
+    dst[copy_len] = '\0';
+}
+
+// Gets the cell of the row or fails. A NULL value is stored as null_value.
+#define BOUND_COLUMN_NEXT_CELL(null_value) \
+    cell = rowset_cell(rowset, first_row + row, column); \
+    if (!cell) { \
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW, \
+                                 "Column is missing from row.", "", sfstmt->sfqid); \
+        status = SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW; \
+        goto cleanup; \
+    } \
+    if (cell->is_null) { \
+        null_value; \
+        if (len_or_ind) { \
+            len_or_ind[row] = SF_NULL_DATA; \
+        } \
+        continue; \
+    } \
+    value = rowset_cell_value(rowset, cell)
+
+// Takes the value a chunk downloader worker decoded as decoded_type, if any. A NULL value is stored as null_value.
+#define BOUND_COLUMN_DECODED(decoded_type, null_value, store_value, size) \
+    if (rowset_decoded_value(rowset, first_row + row, column, decoded_type, &decoded)) { \
+        if (decoded) { \
+            store_value; \
+        } else { \
+            null_value; \
+        } \
+        if (len_or_ind) { \
+            len_or_ind[row] = decoded ? (int64) (size) : SF_NULL_DATA; \
+        } \
+        continue; \
+    }
+
+#define BOUND_COLUMN_ERROR(error_code, msg) \
+    { \
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, error_code, msg, "", sfstmt->sfqid); \
+        status = error_code; \
+        goto cleanup; \
+    }
+
+/**
+ * Converts a bound column for rows [first_row, first_row + row_count) of the current chunk into the
+ * bound array, starting at element offset. Each C type has its own loop over the rows.
+ */
+static SF_STATUS STDCALL _snowflake_fetch_bound_column(SF_STMT *sfstmt, const SF_BIND_OUTPUT *output,
+                                                       int64 first_row, int64 row_count, int64 offset) {
+    SF_ROWSET *rowset = (SF_ROWSET *) sfstmt->raw_results;
+    size_t column = output->idx - 1;
+    SF_C_TYPE column_c_type;
+    SF_DB_TYPE column_type;
+    const SF_ROWSET_CELL *cell;
+    const SF_ROWSET_VALUE *decoded;
+    const char *value;
+    char *dst = (char *) output->value + (size_t) offset * output->element_size;
+    int64 *len_or_ind = output->len_or_ind ? output->len_or_ind + offset : NULL;
+    float64 float_val;
+    SF_STATUS parse_status;
+    const char *str = NULL;
+    size_t str_len = 0;
+    size_t binary_len;
+    int64 row;
+    SF_STATUS status = SF_STATUS_SUCCESS;
+
+    if (output->idx > (size_t) snowflake_num_fields(sfstmt)) {
+        BOUND_COLUMN_ERROR(SF_STATUS_ERROR_OUT_OF_BOUNDS,
+                           "Bound column index must be between 1 and snowflake_num_fields()");
+    }
+    column_c_type = sfstmt->desc[column].c_type;
+    column_type = sfstmt->desc[column].type;
+
+    switch (output->c_type) {
+        case SF_C_TYPE_INT64:
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_DECODED(SF_C_TYPE_INT64, *(int64 *) dst = 0,
+                                     *(int64 *) dst = decoded->int64_value, sizeof(int64));
+                BOUND_COLUMN_NEXT_CELL(*(int64 *) dst = 0);
+                parse_status = sf_parse_int64(value, cell->len, (int64 *) dst);
+                if (parse_status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Cannot convert value into int64");
+                }
+                if (parse_status == SF_STATUS_ERROR_OUT_OF_RANGE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_OUT_OF_RANGE, "Value out of range for int64");
+                }
+                if (len_or_ind) {
+                    len_or_ind[row] = sizeof(int64);
+                }
+            }
+            break;
+
+        case SF_C_TYPE_UINT64:
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_DECODED(SF_C_TYPE_INT64, *(uint64 *) dst = 0,
+                                     *(uint64 *) dst = (uint64) decoded->int64_value, sizeof(uint64));
+                BOUND_COLUMN_NEXT_CELL(*(uint64 *) dst = 0);
+                parse_status = sf_parse_uint64(value, cell->len, (uint64 *) dst);
+                if (parse_status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Cannot convert value into uint64");
+                }
+                if (parse_status == SF_STATUS_ERROR_OUT_OF_RANGE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_OUT_OF_RANGE, "Value out of range for uint64");
+                }
+                if (len_or_ind) {
+                    len_or_ind[row] = sizeof(uint64);
+                }
+            }
+            break;
+
+        case SF_C_TYPE_FLOAT64:
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_DECODED(SF_C_TYPE_FLOAT64, *(float64 *) dst = 0.0,
+                                     *(float64 *) dst = decoded->float64_value, sizeof(float64));
+                BOUND_COLUMN_NEXT_CELL(*(float64 *) dst = 0.0);
+                parse_status = sf_parse_float64(value, cell->len, &float_val);
+                if (parse_status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Cannot convert value into float64");
+                }
+                if (parse_status == SF_STATUS_ERROR_OUT_OF_RANGE) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_OUT_OF_RANGE, "Value out of range for float64");
+                }
+                *(float64 *) dst = float_val;
+                if (len_or_ind) {
+                    len_or_ind[row] = sizeof(float64);
+                }
+            }
+            break;
+
+        case SF_C_TYPE_BOOLEAN:
+            // Same rules as snowflake_column_as_boolean
+            if (column_c_type != SF_C_TYPE_BOOLEAN && column_c_type != SF_C_TYPE_INT64 &&
+                column_c_type != SF_C_TYPE_FLOAT64 && column_c_type != SF_C_TYPE_STRING) {
+                BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                   "No valid conversion to boolean from data type");
+            }
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_DECODED(column_c_type, *(sf_bool *) dst = SF_BOOLEAN_FALSE,
+                                     *(sf_bool *) dst = (column_c_type == SF_C_TYPE_FLOAT64 ?
+                                                         decoded->float64_value != 0.0 :
+                                                         decoded->int64_value != 0) ?
+                                                        SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE,
+                                     sizeof(sf_bool));
+                BOUND_COLUMN_NEXT_CELL(*(sf_bool *) dst = SF_BOOLEAN_FALSE);
+                if (column_c_type == SF_C_TYPE_BOOLEAN) {
+                    *(sf_bool *) dst = strcmp("1", value) == 0 ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
+                } else if (column_c_type == SF_C_TYPE_STRING) {
+                    *(sf_bool *) dst = cell->len > 0 ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
+                } else {
+                    parse_status = sf_parse_float64(value, cell->len, &float_val);
+                    if (parse_status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
+                        BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Cannot convert value into boolean");
+                    }
+                    if (parse_status == SF_STATUS_ERROR_OUT_OF_RANGE) {
+                        BOUND_COLUMN_ERROR(SF_STATUS_ERROR_OUT_OF_RANGE,
+                                           "Value out of range. Cannot convert value into boolean");
+                    }
+                    *(sf_bool *) dst = float_val == 0.0 ? SF_BOOLEAN_FALSE : SF_BOOLEAN_TRUE;
+                }
+                if (len_or_ind) {
+                    len_or_ind[row] = sizeof(sf_bool);
+                }
+            }
+            break;
+
+        case SF_C_TYPE_STRING:
+            if (column_type == SF_DB_TYPE_DATE || column_type == SF_DB_TYPE_TIME ||
+                column_type == SF_DB_TYPE_TIMESTAMP_LTZ || column_type == SF_DB_TYPE_TIMESTAMP_NTZ ||
+                column_type == SF_DB_TYPE_TIMESTAMP_TZ) {
+                // Dates and times are formatted by snowflake_column_as_strview, row by row
+                for (row = 0; row < row_count; row++, dst += output->element_size) {
+                    BOUND_COLUMN_NEXT_CELL(*dst = '\0');
+                    _snowflake_seek_row(sfstmt, first_row + row);
+                    if ((status = snowflake_column_as_strview(sfstmt, (int) output->idx, &str,
+                                                              &str_len)) != SF_STATUS_SUCCESS) {
+                        goto cleanup;
+                    }
+                    _snowflake_copy_bound_string(dst, output->element_size, str, str_len);
+                    if (len_or_ind) {
+                        len_or_ind[row] = (int64) str_len;
+                    }
+                }
+                break;
+            }
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_NEXT_CELL(*dst = '\0');
+                _snowflake_copy_bound_string(dst, output->element_size, value, cell->len);
+                if (len_or_ind) {
+                    len_or_ind[row] = (int64) cell->len;
+                }
+            }
+            break;
+
+        case SF_C_TYPE_BINARY:
+            if (column_type != SF_DB_TYPE_BINARY) {
+                BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Only BINARY columns convert into binary");
+            }
+            // Hex decoded straight into the array. Longer values are truncated.
+            for (row = 0; row < row_count; row++, dst += output->element_size) {
+                BOUND_COLUMN_NEXT_CELL((void) 0);
+                binary_len = cell->len / 2 < output->element_size ? cell->len : output->element_size * 2;
+                if (!sf_hex_decode(value, binary_len, dst, &binary_len)) {
+                    BOUND_COLUMN_ERROR(SF_STATUS_ERROR_CONVERSION_FAILURE, "Cannot convert value into binary");
+                }
+                if (len_or_ind) {
+                    len_or_ind[row] = (int64) (cell->len / 2);
+                }
+            }
+            break;
+
+        default:
+            BOUND_COLUMN_ERROR(SF_STATUS_ERROR_BAD_DATA_OUTPUT_TYPE, "C type not supported for a bound column");
     }
 
-    return SF_STATUS_SUCCESS;
+cleanup:
+    return status;
 }
 
-SF_STATUS STDCALL snowflake_query(
-    SF_STMT *sfstmt, const char *command, size_t command_size) {
-    if (!sfstmt) {
-        return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
-    }
-    clear_snowflake_error(&sfstmt->error);
-    SF_STATUS ret = snowflake_prepare(sfstmt, command, command_size);
-    if (ret != SF_STATUS_SUCCESS) {
-        return ret;
-    }
-    ret = snowflake_execute(sfstmt);
-    if (ret != SF_STATUS_SUCCESS) {
-        return ret;
-    }
-    return SF_STATUS_SUCCESS;
-}
+#undef BOUND_COLUMN_NEXT_CELL
+#undef BOUND_COLUMN_DECODED
+#undef BOUND_COLUMN_ERROR
+
+SF_STATUS STDCALL snowflake_fetch_rows(SF_STMT *sfstmt, int64 max_rows, int64 *rows_fetched) {
+    SF_STATUS ret = SF_STATUS_SUCCESS;
+    SF_ROWSET *rowset;
+    int64 fetched = 0;
+    int64 first_row;
+    int64 row_count;
+    size_t i;
 
-SF_STATUS STDCALL snowflake_fetch(SF_STMT *sfstmt) {
     if (!sfstmt) {
         return SF_STATUS_ERROR_STATEMENT_NOT_EXIST;
     }
     clear_snowflake_error(&sfstmt->error);
-    SF_STATUS ret = SF_STATUS_ERROR_GENERAL;
-    sf_bool get_chunk_success = SF_BOOLEAN_TRUE;
-    int64 i;
-    uint64 index;
-    if (sfstmt->cur_row != NULL) {
-        snowflake_cJSON_Delete(sfstmt->cur_row);
-        sfstmt->cur_row = NULL;
-    }
-
-    // Check for chunk_downloader error
-    if (sfstmt->chunk_downloader && get_error(sfstmt->chunk_downloader)) {
-        goto cleanup;
+    if (!rows_fetched) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_NULL_POINTER,
+                                 "rows_fetched must not be NULL", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_NULL_POINTER;
     }
+    *rows_fetched = 0;
 
-    // If no more results, set return to SF_STATUS_EOF
-    if (sfstmt->chunk_rowcount == 0) {
-        if (sfstmt->chunk_downloader) {
-            log_debug("Fetching next chunk from chunk downloader.");
-            _critical_section_lock(&sfstmt->chunk_downloader->queue_lock);
-            do {
-                if (sfstmt->chunk_downloader->consumer_head >=
-                    sfstmt->chunk_downloader->queue_size) {
-                    // No more chunks, set EOL and break
-                    log_debug("Out of chunks, setting EOL.");
-                    snowflake_cJSON_Delete(sfstmt->raw_results);
-                    sfstmt->raw_results = NULL;
-                    ret = SF_STATUS_EOF;
-                    break;
-                } else {
-                    // Get index and increment
-                    index = sfstmt->chunk_downloader->consumer_head;
-                    while (
-                        sfstmt->chunk_downloader->queue[index].chunk == NULL &&
-                        !get_shutdown_or_error(
-                            sfstmt->chunk_downloader)) {
-                        _cond_wait(
-                            &sfstmt->chunk_downloader->consumer_cond,
-                            &sfstmt->chunk_downloader->queue_lock);
-                    }
-
-                    if (get_error(sfstmt->chunk_downloader)) {
-                        get_chunk_success = SF_BOOLEAN_FALSE;
-                        break;
-                    } else if (get_shutdown(sfstmt->chunk_downloader)) {
-                        get_chunk_success = SF_BOOLEAN_FALSE;
-                        break;
-                    }
-
-                    sfstmt->chunk_downloader->consumer_head++;
-
-                    // Delete old cJSON results struct
-                    snowflake_cJSON_Delete((cJSON *) sfstmt->raw_results);
-                    // Set new chunk and remove chunk reference from locked array
-                    sfstmt->raw_results = sfstmt->chunk_downloader->queue[index].chunk;
-                    sfstmt->chunk_downloader->queue[index].chunk = NULL;
-                    sfstmt->chunk_rowcount = sfstmt->chunk_downloader->queue[index].row_count;
-                    log_debug("Acquired chunk %llu from chunk downloader",
-                              index);
-                    if (_cond_signal(
-                        &sfstmt->chunk_downloader->producer_cond)) {
-                        SET_SNOWFLAKE_ERROR(&sfstmt->error,
-                                            SF_STATUS_ERROR_PTHREAD,
-                                            "Unable to send signal using produce_cond",
-                                            "");
-                        get_chunk_success = SF_BOOLEAN_FALSE;
-                        break;
-                    }
-                }
+    while (fetched < max_rows) {
+        if ((ret = _snowflake_next_chunk(sfstmt)) != SF_STATUS_SUCCESS) {
+            break;
+        }
+        rowset = (SF_ROWSET *) sfstmt->raw_results;
+        first_row = rowset->row_count - sfstmt->chunk_rowcount;
+        row_count = sfstmt->chunk_rowcount < max_rows - fetched ? sfstmt->chunk_rowcount : max_rows - fetched;
+
+        for (i = 0; i < sfstmt->bound_columns_len && ret == SF_STATUS_SUCCESS; i++) {
+            if (sfstmt->bound_columns[i].value) {
+                ret = _snowflake_fetch_bound_column(sfstmt, &sfstmt->bound_columns[i], first_row, row_count,
+                                                    fetched);
             }
-            while (0);
-            _critical_section_unlock(&sfstmt->chunk_downloader->queue_lock);
-        } else {
-            // If there is no chunk downloader set, then we've truly reached the end of the results and should set EOL
-            log_debug("No chunk downloader set, end of results.");
-            ret = SF_STATUS_EOF;
         }
 
-        // If we've reached the end, or we have an error getting the next chunk, goto cleanup and return status
-        if (ret == SF_STATUS_EOF || !get_chunk_success) {
-            goto cleanup;
+        _snowflake_seek_row(sfstmt, first_row + row_count - 1);
+        sfstmt->total_row_index += row_count;
+        fetched += row_count;
+        if (ret != SF_STATUS_SUCCESS) {
+            break;
         }
     }
 
-    // Get next result row
-    sfstmt->cur_row = snowflake_cJSON_DetachItemFromArray(sfstmt->raw_results, 0);
-    sfstmt->chunk_rowcount--;
-    sfstmt->total_row_index++;
-    ret = SF_STATUS_SUCCESS;
-
-cleanup:
+    *rows_fetched = fetched;
+    if (ret == SF_STATUS_EOF && fetched > 0) {
+        // The next call returns SF_STATUS_EOF
+        ret = SF_STATUS_SUCCESS;
+    }
     return ret;
 }
 
@@ -1579,14 +2540,15 @@ SF_STATUS STDCALL snowflake_trans_rollback(SF_CONNECT *sf) {
 int64 STDCALL snowflake_affected_rows(SF_STMT *sfstmt) {
     size_t i;
     int64 ret = -1;
-    cJSON *row = NULL;
-    cJSON *raw_row_result;
+    SF_ROWSET *rowset;
+    const SF_ROWSET_CELL *cell;
     clear_snowflake_error(&sfstmt->error);
     if (!sfstmt) {
         /* no way to set the error other than return value */
         return ret;
     }
-    if (snowflake_cJSON_GetArraySize(sfstmt->raw_results) == 0) {
+    rowset = (SF_ROWSET *) sfstmt->raw_results;
+    if (!rowset || rowset->row_count == 0) {
         /* no affected rows is determined. The potential cause is
          * the query is not DML or no stmt was executed at all . */
         SET_SNOWFLAKE_STMT_ERROR(
@@ -1598,13 +2560,13 @@ int64 STDCALL snowflake_affected_rows(SF_STMT *sfstmt) {
     }
 
     if (sfstmt->is_dml) {
-        row = snowflake_cJSON_DetachItemFromArray(sfstmt->raw_results, 0);
         ret = 0;
         for (i = 0; i < (size_t) sfstmt->total_fieldcount; ++i) {
-            raw_row_result = snowflake_cJSON_GetArrayItem(row, (int) i);
-            ret += (int64) strtoll(raw_row_result->valuestring, NULL, 10);
+            cell = rowset_cell(rowset, 0, i);
+            if (cell) {
+                ret += (int64) strtoll(rowset_cell_value(rowset, cell), NULL, 10);
+            }
         }
-        snowflake_cJSON_Delete(row);
     } else {
         ret = sfstmt->total_rowcount;
     }
@@ -1658,9 +2620,13 @@ SF_STATUS STDCALL _snowflake_execute_ex(SF_STMT *sfstmt,
     cJSON *body = NULL;
     cJSON *data = NULL;
     cJSON *rowtype = NULL;
+    cJSON *rowset = NULL;
     cJSON *resp = NULL;
     cJSON *chunks = NULL;
     cJSON *chunk_headers = NULL;
+    cJSON *result_format = NULL;
+    sf_bool arrow_format = SF_BOOLEAN_FALSE;
+    const char *arrow_error = NULL;
     char *qrmk = NULL;
     char *s_body = NULL;
     char *s_resp = NULL;
@@ -1750,7 +2716,8 @@ SF_STATUS STDCALL _snowflake_execute_ex(SF_STMT *sfstmt,
     // Create Body
     body = create_query_json_body(sfstmt->sql_text, sfstmt->sequence_counter,
                                   is_string_empty(sfstmt->connection->directURL) ?
-                                  NULL : sfstmt->request_id);
+                                  NULL : sfstmt->request_id,
+                                  sfstmt->connection->arrow_results);
     if (bindings != NULL) {
         /* binding parameters if exists */
       snowflake_cJSON_AddItemToObject(body, "bindings", bindings);
@@ -1878,10 +2845,12 @@ SF_STATUS STDCALL _snowflake_execute_ex(SF_STMT *sfstmt,
                     _snowflake_stmt_desc_reset(sfstmt);
                     sfstmt->desc = set_description(rowtype);
                 }
-                // Set results array
-                if (json_detach_array_from_object(
-                    (cJSON **) (&sfstmt->raw_results),
-                    data, "rowset")) {
+                // Set results array. Arrow results are a base64 encoded Arrow stream
+                result_format = snowflake_cJSON_GetObjectItem(data, "queryResultFormat");
+                arrow_format = snowflake_cJSON_IsString(result_format) &&
+                               sf_strncasecmp(result_format->valuestring, "arrow", 6) == 0;
+                rowset = snowflake_cJSON_GetObjectItem(data, arrow_format ? "rowsetBase64" : "rowset");
+                if (arrow_format ? !snowflake_cJSON_IsString(rowset) : !snowflake_cJSON_IsArray(rowset)) {
                     log_error("No valid rowset found in response");
                     SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
                                              SF_STATUS_ERROR_BAD_JSON,
@@ -1890,18 +2859,41 @@ SF_STATUS STDCALL _snowflake_execute_ex(SF_STMT *sfstmt,
                                              sfstmt->sfqid);
                     goto cleanup;
                 }
+                if (arrow_format) {
+                    sfstmt->raw_results = rowset_from_arrow_base64(rowset->valuestring,
+                                                                   strlen(rowset->valuestring),
+                                                                   &arrow_error);
+                    if (!sfstmt->raw_results && arrow_error) {
+                        log_error("Unable to read the Arrow rowset: %s", arrow_error);
+                        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
+                                                 SF_STATUS_ERROR_BAD_RESPONSE,
+                                                 "Unable to read the Arrow rowset from the response.",
+                                                 SF_SQLSTATE_APP_REJECT_CONNECTION,
+                                                 sfstmt->sfqid);
+                        goto cleanup;
+                    }
+                } else {
+                    sfstmt->raw_results = rowset_from_cjson(rowset);
+                }
+                if (!sfstmt->raw_results) {
+                    SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
+                                             SF_STATUS_ERROR_OUT_OF_MEMORY,
+                                             "Unable to store the rowset from the response.",
+                                             SF_SQLSTATE_MEMORY_ALLOCATION_ERROR,
+                                             sfstmt->sfqid);
+                    goto cleanup;
+                }
+                // Get number of rows in this chunk
+                sfstmt->chunk_rowcount = ((SF_ROWSET *) sfstmt->raw_results)->row_count;
                 if (json_copy_int(&sfstmt->total_rowcount, data, "total")) {
                     log_warn(
                         "No total count found in response. Reverting to using array size of results");
-                    sfstmt->total_rowcount = snowflake_cJSON_GetArraySize(
-                      sfstmt->raw_results);
+                    sfstmt->total_rowcount = sfstmt->chunk_rowcount;
                 }
-                // Get number of rows in this chunk
-                sfstmt->chunk_rowcount = snowflake_cJSON_GetArraySize(
-                  sfstmt->raw_results);
 
                 // Index starts at 0 and incremented each fetch
                 sfstmt->total_row_index = 0;
+                sfstmt->chunk_index = -1;
 
                 // Set large result set if one exists
                 if ((chunks = snowflake_cJSON_GetObjectItem(data, "chunks")) != NULL) {
@@ -1909,14 +2901,8 @@ SF_STATUS STDCALL _snowflake_execute_ex(SF_STMT *sfstmt,
                     json_copy_string(&qrmk, data, "qrmk");
                     chunk_headers = snowflake_cJSON_GetObjectItem(data,
                                                                   "chunkHeaders");
-                    sfstmt->chunk_downloader = chunk_downloader_init(
-                        qrmk,
-                        chunk_headers,
-                        chunks,
-                        2, // thread count
-                        4, // fetch slot
-                        &sfstmt->error,
-                        sfstmt->connection->insecure_mode);
+                    sfstmt->chunk_downloader = _snowflake_chunk_downloader_init(sfstmt, qrmk, chunk_headers,
+                                                                                chunks, arrow_format, 0);
                     if (!sfstmt->chunk_downloader) {
                         // Unable to create chunk downloader. Error is set in chunk_downloader_init function.
                         goto cleanup;
@@ -2043,6 +3029,18 @@ SF_STATUS STDCALL snowflake_stmt_get_attr(
         case SF_STMT_USER_REALLOC_FUNC:
             *value = sfstmt->user_realloc_func;
             break;
+        case SF_STMT_MAX_CHUNK_PREFETCH_BYTES:
+            *value = &sfstmt->max_chunk_prefetch_bytes;
+            break;
+        case SF_STMT_CHUNK_STATS:
+            if (sfstmt->chunk_downloader) {
+                chunk_downloader_get_stats(sfstmt->chunk_downloader, &sfstmt->chunk_stats);
+            }
+            *value = &sfstmt->chunk_stats;
+            break;
+        case SF_STMT_SCROLLABLE:
+            *value = &sfstmt->scrollable;
+            break;
         default:
             SET_SNOWFLAKE_ERROR(
                 &sfstmt->error, SF_STATUS_ERROR_BAD_ATTRIBUTE_TYPE,
@@ -2063,6 +3061,12 @@ SF_STATUS STDCALL snowflake_stmt_set_attr(
         case SF_STMT_USER_REALLOC_FUNC:
             sfstmt->user_realloc_func = value;
             break;
+        case SF_STMT_MAX_CHUNK_PREFETCH_BYTES:
+            sfstmt->max_chunk_prefetch_bytes = value && *((int64 *) value) > 0 ? *((int64 *) value) : 0;
+            break;
+        case SF_STMT_SCROLLABLE:
+            sfstmt->scrollable = value ? *((sf_bool *) value) : SF_BOOLEAN_FALSE;
+            break;
         default:
             SET_SNOWFLAKE_ERROR(
                 &sfstmt->error, SF_STATUS_ERROR_BAD_ATTRIBUTE_TYPE,
@@ -2101,26 +3105,48 @@ SF_STATUS STDCALL snowflake_propagate_error(SF_CONNECT *sf, SF_STMT *sfstmt) {
     return SF_STATUS_SUCCESS;
 }
 
-// Make sure that idx is in bounds and that column exists
-SF_STATUS STDCALL _snowflake_get_cJSON_column(SF_STMT *sfstmt, int idx, cJSON **column_ptr) {
+// Make sure that idx is in bounds and that column exists. The value is NULL for a null column.
+SF_STATUS STDCALL _snowflake_get_column(SF_STMT *sfstmt, int idx, const char **value_ptr, size_t *len_ptr) {
+    SF_ROWSET *rowset = (SF_ROWSET *) sfstmt->raw_results;
+    const SF_ROWSET_CELL *cell = NULL;
+
     if (idx > snowflake_num_fields(sfstmt) || idx <= 0) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_BOUNDS,
                                  "Column index must be between 1 and snowflake_num_fields()", "", sfstmt->sfqid);
         return SF_STATUS_ERROR_OUT_OF_BOUNDS;
     }
 
-    cJSON *column = snowflake_cJSON_GetArrayItem(sfstmt->cur_row, idx - 1);
-    if (!column) {
-        *column_ptr = NULL;
+    if (sfstmt->cur_row && rowset) {
+        cell = rowset_cell(rowset, _snowflake_cur_row_index(sfstmt), (size_t) (idx - 1));
+    }
+    if (!cell) {
+        *value_ptr = NULL;
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW,
                                  "Column is missing from row.", "", sfstmt->sfqid);
         return SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW;
     }
 
-    *column_ptr = column;
+    *value_ptr = cell->is_null ? NULL : rowset_cell_value(rowset, cell);
+    if (len_ptr) {
+        *len_ptr = cell->len;
+    }
     return SF_STATUS_SUCCESS;
 }
 
+/**
+ * Value of the column in the current row as a chunk downloader worker decoded it to c_type, NULL for a
+ * null value. Returns SF_BOOLEAN_FALSE if the value has to be converted from the text.
+ */
+static sf_bool STDCALL _snowflake_get_decoded(SF_STMT *sfstmt, int idx, SF_C_TYPE c_type,
+                                              const SF_ROWSET_VALUE **value_ptr) {
+    SF_ROWSET *rowset = (SF_ROWSET *) sfstmt->raw_results;
+
+    if (!sfstmt->cur_row || !rowset || idx > snowflake_num_fields(sfstmt) || idx <= 0) {
+        return SF_BOOLEAN_FALSE;
+    }
+    return rowset_decoded_value(rowset, _snowflake_cur_row_index(sfstmt), (size_t) (idx - 1), c_type, value_ptr);
+}
+
 // Does NULL checking and clears the SF_STMT error struct
 SF_STATUS STDCALL _snowflake_column_null_checks(SF_STMT *sfstmt, void *value_ptr) {
     if (!sfstmt) {
@@ -2138,38 +3164,51 @@ SF_STATUS STDCALL _snowflake_column_null_checks(SF_STMT *sfstmt, void *value_ptr
 
 SF_STATUS STDCALL snowflake_column_as_boolean(SF_STMT *sfstmt, int idx, sf_bool *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
+    const SF_ROWSET_VALUE *decoded;
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
+    if (idx > 0 && idx <= snowflake_num_fields(sfstmt) &&
+        _snowflake_get_decoded(sfstmt, idx, sfstmt->desc[idx - 1].c_type, &decoded)) {
+        if (!decoded) {
+            *value_ptr = SF_BOOLEAN_FALSE;
+        } else if (sfstmt->desc[idx - 1].c_type == SF_C_TYPE_FLOAT64) {
+            *value_ptr = decoded->float64_value == 0.0 ? SF_BOOLEAN_FALSE : SF_BOOLEAN_TRUE;
+        } else {
+            *value_ptr = decoded->int64_value == 0 ? SF_BOOLEAN_FALSE : SF_BOOLEAN_TRUE;
+        }
+        return SF_STATUS_SUCCESS;
+    }
+
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     sf_bool value = SF_BOOLEAN_FALSE;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
     switch (sfstmt->desc[idx - 1].c_type) {
         case SF_C_TYPE_BOOLEAN:
-            value = strcmp("1", column->valuestring) == 0 ? SF_BOOLEAN_TRUE: SF_BOOLEAN_FALSE;
+            value = strcmp("1", column) == 0 ? SF_BOOLEAN_TRUE: SF_BOOLEAN_FALSE;
             break;
         case SF_C_TYPE_FLOAT64: ;
-            float64 float_val = strtod(column->valuestring, &endptr);
+            float64 float_val;
+            status = sf_parse_float64(column, len, &float_val);
             // Check for errors
-            if (endptr == column->valuestring) {
+            if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                          "Cannot convert value into boolean from float64", "", sfstmt->sfqid);
                 status = SF_STATUS_ERROR_CONVERSION_FAILURE;
                 goto cleanup;
             }
-            if (errno == ERANGE || float_val == INFINITY || float_val == -INFINITY) {
+            if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                          "Value out of range for float64. Cannot convert value into boolean", "", sfstmt->sfqid);
                 status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2179,15 +3218,16 @@ SF_STATUS STDCALL snowflake_column_as_boolean(SF_STMT *sfstmt, int idx, sf_bool
             value = (float_val == 0.0) ? SF_BOOLEAN_FALSE : SF_BOOLEAN_TRUE;
             break;
         case SF_C_TYPE_INT64: ;
-            int64 int_val = strtoll(column->valuestring, &endptr, 10);
+            int64 int_val;
+            status = sf_parse_int64(column, len, &int_val);
             // Check for errors
-            if (endptr == column->valuestring) {
+            if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                          "Cannot convert value into boolean from int64", "", sfstmt->sfqid);
                 status = SF_STATUS_ERROR_CONVERSION_FAILURE;
                 goto cleanup;
             }
-            if ((int_val == SF_INT64_MAX || int_val == SF_INT64_MIN) && errno == ERANGE) {
+            if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                          "Value out of range for int64. Cannot convert value into boolean", "", sfstmt->sfqid);
                 status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2197,7 +3237,7 @@ SF_STATUS STDCALL snowflake_column_as_boolean(SF_STMT *sfstmt, int idx, sf_bool
             value = (int_val == 0) ? SF_BOOLEAN_FALSE : SF_BOOLEAN_TRUE;
             break;
         case SF_C_TYPE_STRING:
-            if (strlen(column->valuestring) == 0) {
+            if (column[0] == '\0') {
                 value = SF_BOOLEAN_FALSE;
             } else {
                 value = SF_BOOLEAN_TRUE;
@@ -2217,53 +3257,52 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_uint8(SF_STMT *sfstmt, int idx, uint8 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, NULL)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
-    *value_ptr = (!snowflake_cJSON_IsNull(column)) ? (uint8) column->valuestring[0] : (uint8) 0;
+    *value_ptr = (column != NULL) ? (uint8) column[0] : (uint8) 0;
     return SF_STATUS_SUCCESS;
 }
 
 SF_STATUS STDCALL snowflake_column_as_uint32(SF_STMT *sfstmt, int idx, uint32 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     uint64 value = 0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtoull(column->valuestring, &endptr, 10);
+    status = sf_parse_uint64(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into uint32", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    sf_bool neg = (strchr(column->valuestring, '-') != NULL) ? SF_BOOLEAN_TRUE: SF_BOOLEAN_FALSE;
+    sf_bool neg = (strchr(column, '-') != NULL) ? SF_BOOLEAN_TRUE: SF_BOOLEAN_FALSE;
     // Check for out of range
-    if (((value == ULONG_MAX || value == 0) && errno == ERANGE) ||
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE ||
             (!neg && value > SF_UINT32_MAX) ||
             (neg && value < (SF_UINT64_MAX - SF_UINT32_MAX))) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
@@ -2285,34 +3324,40 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_uint64(SF_STMT *sfstmt, int idx, uint64 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
+    const SF_ROWSET_VALUE *decoded;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
+    // strtoull wraps negative numbers around like the cast does
+    if (_snowflake_get_decoded(sfstmt, idx, SF_C_TYPE_INT64, &decoded)) {
+        *value_ptr = decoded ? (uint64) decoded->int64_value : 0;
+        return SF_STATUS_SUCCESS;
+    }
+
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     uint64 value = 0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtoull(column->valuestring, &endptr, 10);
+    status = sf_parse_uint64(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into uint64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    if ((value == SF_UINT64_MAX || value == 0) && errno == ERANGE) {
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                  "Value out of range for uint64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2328,51 +3373,62 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_int8(SF_STMT *sfstmt, int idx, int8 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, NULL)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
-    *value_ptr = (!snowflake_cJSON_IsNull(column)) ? (int8) column->valuestring[0] : (int8) 0;
+    *value_ptr = (column != NULL) ? (int8) column[0] : (int8) 0;
     return SF_STATUS_SUCCESS;
 }
 
 SF_STATUS STDCALL snowflake_column_as_int32(SF_STMT *sfstmt, int idx, int32 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
+    const SF_ROWSET_VALUE *decoded;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
+    if (_snowflake_get_decoded(sfstmt, idx, SF_C_TYPE_INT64, &decoded)) {
+        if (decoded && (decoded->int64_value > SF_INT32_MAX || decoded->int64_value < SF_INT32_MIN)) {
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
+                                     "Value out of range for int32", "", sfstmt->sfqid);
+            *value_ptr = (int32) decoded->int64_value;
+            return SF_STATUS_ERROR_OUT_OF_RANGE;
+        }
+        *value_ptr = decoded ? (int32) decoded->int64_value : 0;
+        return SF_STATUS_SUCCESS;
+    }
+
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     int64 value = 0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtoll(column->valuestring, &endptr, 10);
+    status = sf_parse_int64(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into int32", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    if (((value == LONG_MAX || value == LONG_MIN) && errno == ERANGE) || (value > SF_INT32_MAX || value < SF_INT32_MIN)) {
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE || value > SF_INT32_MAX || value < SF_INT32_MIN) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                  "Value out of range for int32", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2388,34 +3444,39 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_int64(SF_STMT *sfstmt, int idx, int64 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
+    const SF_ROWSET_VALUE *decoded;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
+    if (_snowflake_get_decoded(sfstmt, idx, SF_C_TYPE_INT64, &decoded)) {
+        *value_ptr = decoded ? decoded->int64_value : 0;
+        return SF_STATUS_SUCCESS;
+    }
+
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     int64 value = 0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtoll(column->valuestring, &endptr, 10);
+    status = sf_parse_int64(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into int64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    if ((value == SF_INT64_MAX || value == SF_INT64_MIN) && errno == ERANGE) {
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                  "Value out of range for int64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2431,34 +3492,33 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_float32(SF_STMT *sfstmt, int idx, float32 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     float32 value = 0.0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtof(column->valuestring, &endptr);
+    status = sf_parse_float32(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into float32", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    if (errno == ERANGE || value == INFINITY || value == -INFINITY) {
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                  "Value out of range for float32", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2474,34 +3534,39 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_float64(SF_STMT *sfstmt, int idx, float64 *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t len = 0;
+    const SF_ROWSET_VALUE *decoded;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
+    if (_snowflake_get_decoded(sfstmt, idx, SF_C_TYPE_FLOAT64, &decoded)) {
+        *value_ptr = decoded ? decoded->float64_value : 0.0;
+        return SF_STATUS_SUCCESS;
+    }
+
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     float64 value = 0.0;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         status = SF_STATUS_SUCCESS;
         goto cleanup;
     }
 
-    char *endptr;
-    errno = 0;
-    value = strtod(column->valuestring, &endptr);
+    status = sf_parse_float64(column, len, &value);
     // Check for errors
-    if (endptr == column->valuestring) {
+    if (status == SF_STATUS_ERROR_CONVERSION_FAILURE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
                                  "Cannot convert value into float64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_CONVERSION_FAILURE;
         goto cleanup;
     }
-    if (errno == ERANGE || value == INFINITY || value == -INFINITY) {
+    if (status == SF_STATUS_ERROR_OUT_OF_RANGE) {
         SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_RANGE,
                                  "Value out of range for float64", "", sfstmt->sfqid);
         status = SF_STATUS_ERROR_OUT_OF_RANGE;
@@ -2517,19 +3582,19 @@ cleanup:
 
 SF_STATUS STDCALL snowflake_column_as_timestamp(SF_STMT *sfstmt, int idx, SF_TIMESTAMP *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, NULL)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     SF_DB_TYPE db_type = sfstmt->desc[idx - 1].type;
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         snowflake_timestamp_from_parts(value_ptr, 0, 0, 0, 0, 1, 1, 1970, 0, 9, SF_DB_TYPE_TIMESTAMP_NTZ);
         return SF_STATUS_SUCCESS;
     }
@@ -2540,7 +3605,7 @@ SF_STATUS STDCALL snowflake_column_as_timestamp(SF_STMT *sfstmt, int idx, SF_TIM
         db_type == SF_DB_TYPE_TIMESTAMP_NTZ ||
         db_type == SF_DB_TYPE_TIMESTAMP_TZ) {
         return snowflake_timestamp_from_epoch_seconds(value_ptr,
-                                                      column->valuestring,
+                                                      column,
                                                       sfstmt->connection->timezone,
                                                       (int32) sfstmt->desc[idx - 1].scale,
                                                       db_type);
@@ -2551,32 +3616,142 @@ SF_STATUS STDCALL snowflake_column_as_timestamp(SF_STMT *sfstmt, int idx, SF_TIM
 
 SF_STATUS STDCALL snowflake_column_as_const_str(SF_STMT *sfstmt, int idx, const char **value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, NULL)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
-    *value_ptr = (!snowflake_cJSON_IsNull(column)) ? column->valuestring : NULL;
+    *value_ptr = column;
+
+    return SF_STATUS_SUCCESS;
+}
+
+/**
+ * Room for a string of up to size bytes in the row scratch of the statement, which row_scratch_commit takes
+ *
+ * @return NULL if out of memory
+ */
+static char *STDCALL _snowflake_reserve_row_scratch(SF_STMT *sfstmt, size_t size) {
+    char *buffer = NULL;
+
+    if (!sfstmt->row_scratch) {
+        sfstmt->row_scratch = row_scratch_init();
+    }
+    if (sfstmt->row_scratch) {
+        buffer = row_scratch_reserve((SF_ROW_SCRATCH *) sfstmt->row_scratch, size);
+    }
+    if (!buffer) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_MEMORY,
+                                 "Cannot allocate memory for the string value.",
+                                 SF_SQLSTATE_MEMORY_ALLOCATION_ERROR, sfstmt->sfqid);
+    }
+    return buffer;
+}
+
+/**
+ * Whether BINARY values are shown in base64, as BINARY_OUTPUT_FORMAT of the session says
+ */
+static sf_bool STDCALL _snowflake_binary_base64(SF_STMT *sfstmt) {
+    return sfstmt->connection->session_output_formats &&
+           output_formats_binary_base64(sfstmt->connection->output_formats);
+}
+
+/**
+ * Converts the hex text of a BINARY value to base64 in the row scratch of the statement
+ */
+static SF_STATUS STDCALL _snowflake_format_binary_view(SF_STMT *sfstmt, const char *column, size_t column_len,
+                                                       const char **value_ptr, size_t *value_len_ptr) {
+    size_t byte_len = column_len / 2;
+    size_t len;
+    // The bytes first, then their text
+    char *buffer = _snowflake_reserve_row_scratch(sfstmt, byte_len + sf_base64_encoded_size(byte_len) + 1);
+
+    if (!buffer) {
+        return SF_STATUS_ERROR_OUT_OF_MEMORY;
+    }
+    if (!sf_hex_decode(column, column_len, buffer, &byte_len)) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                 "Failed to convert a binary value to a string.",
+                                 SF_SQLSTATE_GENERAL_ERROR, sfstmt->sfqid);
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    len = sf_base64_encode(buffer, byte_len, buffer + byte_len);
+    row_scratch_commit((SF_ROW_SCRATCH *) sfstmt->row_scratch, byte_len + len + 1);
+    *value_ptr = buffer + byte_len;
+    *value_len_ptr = len;
+    return SF_STATUS_SUCCESS;
+}
 
+/**
+ * Formats a date or time value with a session output format into the string buffer of snowflake_column_as_str,
+ * growing it like the other types do. If the buffer can't grow, a preallocated one is left as it was and
+ * one we allocated is freed.
+ */
+static SF_STATUS STDCALL format_column_value(SF_STMT *sfstmt, const SF_TIMESTAMP_FORMAT *format,
+                                             const SF_TIMESTAMP *ts, char **value, size_t init_value_len,
+                                             sf_bool preallocated, size_t *max_value_size, size_t *value_len) {
+    char *buffer = *value;
+    size_t size = init_value_len;
+
+    *value_len = 0;
+    if (format->max_len + 1 > init_value_len) {
+        size = format->max_len + 1;
+        buffer = preallocated ? global_hooks.realloc(*value, size) : global_hooks.calloc(1, size);
+        if (!buffer) {
+            goto out_of_memory;
+        }
+        *value = buffer;
+    }
+    *max_value_size = size;
+    *value_len = sf_timestamp_format_apply(format, ts, buffer, size);
+    if (*value_len == 0 && format->op_count > 0) {
+        // A year of more than four digits
+        size = format->max_len + format->op_count * SF_FORMAT_MAX_ELEMENT_LEN + 1;
+        if ((buffer = global_hooks.realloc(*value, size)) == NULL) {
+            goto out_of_memory;
+        }
+        *value = buffer;
+        *max_value_size = size;
+        *value_len = sf_timestamp_format_apply(format, ts, buffer, size);
+    }
     return SF_STATUS_SUCCESS;
+
+out_of_memory:
+    if (preallocated) {
+        // The application keeps its buffer, grown or not
+        if (*max_value_size < init_value_len) {
+            *max_value_size = init_value_len;
+        }
+    } else {
+        if (*value) {
+            global_hooks.dealloc(*value);
+        }
+        *value = NULL;
+        *max_value_size = 0;
+    }
+    SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_OUT_OF_MEMORY,
+                             "Cannot allocate memory for the string value.",
+                             SF_SQLSTATE_MEMORY_ALLOCATION_ERROR, sfstmt->sfqid);
+    return SF_STATUS_ERROR_OUT_OF_MEMORY;
 }
 
 SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value_ptr, size_t *value_len_ptr, size_t *max_value_size_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t column_len = 0;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &column_len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
@@ -2594,7 +3769,7 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
         preallocated = SF_BOOLEAN_TRUE;
     }
 
-    if (snowflake_cJSON_IsNull(column)) {
+    if (column == NULL) {
         // If value is NULL, allocate buffer for empty string
         if (init_value_len == 0) {
             value = global_hooks.calloc(1, 1);
@@ -2609,15 +3784,16 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
         goto cleanup;
     }
 
-    time_t sec = 0L;
     struct tm tm_obj;
-    struct tm *tm_ptr;
     memset(&tm_obj, 0, sizeof(tm_obj));
+    SF_TIMESTAMP ts;
+    const SF_TIMESTAMP_FORMAT *format = sfstmt->connection->session_output_formats ?
+        output_formats_get(sfstmt->connection->output_formats, sfstmt->desc[idx - 1].type) : NULL;
 
     switch (sfstmt->desc[idx - 1].type) {
         case SF_DB_TYPE_BOOLEAN: ;
             const char *bool_value;
-            if (strcmp(column->valuestring, "0") == 0) {
+            if (strcmp(column, "0") == 0) {
                 /* False */
                 bool_value = SF_BOOLEAN_FALSE_STR;
             } else {
@@ -2640,13 +3816,24 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
             sb_strncpy(value, max_value_size, bool_value, value_len + 1);
             break;
         case SF_DB_TYPE_DATE:
-            sec =
-              (time_t) strtol(column->valuestring, NULL, 10) *
-              86400L;
-            _mutex_lock(&gmlocaltime_lock);
-            tm_ptr = sf_gmtime(&sec, &tm_obj);
-            _mutex_unlock(&gmlocaltime_lock);
-            if (tm_ptr == NULL) {
+            if (format) {
+                if (snowflake_timestamp_from_epoch_seconds(&ts, column, NULL, 0, SF_DB_TYPE_DATE)) {
+                    SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
+                                             SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                             "Failed to convert a date value to a string.",
+                                             SF_SQLSTATE_GENERAL_ERROR,
+                                             sfstmt->sfqid);
+                    value = NULL;
+                    max_value_size = 0;
+                    goto cleanup;
+                }
+                if ((status = format_column_value(sfstmt, format, &ts, &value, init_value_len, preallocated,
+                                                  &max_value_size, &value_len)) != SF_STATUS_SUCCESS) {
+                    goto cleanup;
+                }
+                break;
+            }
+            if (!sf_seconds_to_tm((int64) strtoll(column, NULL, 10) * SF_SECONDS_PER_DAY, &tm_obj)) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
                                     SF_STATUS_ERROR_CONVERSION_FAILURE,
                                     "Failed to convert a date value to a string.",
@@ -2670,15 +3857,14 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
             } else {
                 max_value_size = init_value_len;
             }
-            value_len = strftime(value, value_len + 1, "%Y-%m-%d", &tm_obj);
+            value_len = sf_format_date(value, value_len + 1, &tm_obj);
             break;
         case SF_DB_TYPE_TIME:
         case SF_DB_TYPE_TIMESTAMP_NTZ:
         case SF_DB_TYPE_TIMESTAMP_LTZ:
-        case SF_DB_TYPE_TIMESTAMP_TZ: ;
-            SF_TIMESTAMP ts;
+        case SF_DB_TYPE_TIMESTAMP_TZ:
             if (snowflake_timestamp_from_epoch_seconds(&ts,
-                                                        column->valuestring,
+                                                        column,
                                                         sfstmt->connection->timezone,
                                                         (int32) sfstmt->desc[idx - 1].scale,
                                                         sfstmt->desc[idx - 1].type)) {
@@ -2691,7 +3877,13 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
                 max_value_size = 0;
                 goto cleanup;
             }
-            // TODO add format when format is no longer a fixed string
+            if (format) {
+                if ((status = format_column_value(sfstmt, format, &ts, &value, init_value_len, preallocated,
+                                                  &max_value_size, &value_len)) != SF_STATUS_SUCCESS) {
+                    goto cleanup;
+                }
+                break;
+            }
             if (snowflake_timestamp_to_string(&ts, "", &value, max_value_size, &value_len, SF_BOOLEAN_TRUE)) {
                 SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error,
                                          SF_STATUS_ERROR_CONVERSION_FAILURE,
@@ -2716,8 +3908,17 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
             }
 
             break;
+        case SF_DB_TYPE_BINARY:
+            if (_snowflake_binary_base64(sfstmt) &&
+                (status = _snowflake_format_binary_view(sfstmt, column, column_len, &column,
+                                                        &column_len)) != SF_STATUS_SUCCESS) {
+                max_value_size = init_value_len;
+                goto cleanup;
+            }
+            // The text is copied like any other
+            /* fall through */
         default:
-            value_len = strlen(column->valuestring);
+            value_len = column_len;
             if (value_len + 1 > init_value_len) {
                 if (preallocated) {
                     value = global_hooks.realloc(value, value_len + 1);
@@ -2730,7 +3931,7 @@ SF_STATUS STDCALL snowflake_column_as_str(SF_STMT *sfstmt, int idx, char **value
             } else {
                 max_value_size = init_value_len;
             }
-            sb_strncpy(value, max_value_size, column->valuestring, value_len + 1);
+            sb_strncpy(value, max_value_size, column, value_len + 1);
             break;
     }
 
@@ -2748,42 +3949,185 @@ cleanup:
     return status;
 }
 
-SF_STATUS STDCALL snowflake_column_strlen(SF_STMT *sfstmt, int idx, size_t *value_ptr) {
+/**
+ * Formats a date or time value like snowflake_column_as_str into the row scratch of the statement
+ */
+static SF_STATUS STDCALL _snowflake_format_column_view(SF_STMT *sfstmt, int idx, const char *column,
+                                                       const char **value_ptr, size_t *value_len_ptr) {
+    SF_DB_TYPE db_type = sfstmt->desc[idx - 1].type;
+    const SF_TIMESTAMP_FORMAT *format = sfstmt->connection->session_output_formats ?
+        output_formats_get(sfstmt->connection->output_formats, db_type) : NULL;
+    size_t size = format ? format->max_len + format->op_count * SF_FORMAT_MAX_ELEMENT_LEN + 1 :
+                  TIMESTAMP_STRING_MAX_SIZE;
+    char *buffer = _snowflake_reserve_row_scratch(sfstmt, size);
+    size_t len = 0;
+    struct tm tm_obj;
+    SF_TIMESTAMP ts;
+
+    if (!buffer) {
+        return SF_STATUS_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (db_type == SF_DB_TYPE_DATE && !format) {
+        memset(&tm_obj, 0, sizeof(tm_obj));
+        if (!sf_seconds_to_tm((int64) strtoll(column, NULL, 10) * SF_SECONDS_PER_DAY, &tm_obj)) {
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                     "Failed to convert a date value to a string.",
+                                     SF_SQLSTATE_GENERAL_ERROR, sfstmt->sfqid);
+            return SF_STATUS_ERROR_CONVERSION_FAILURE;
+        }
+        len = sf_format_date(buffer, size, &tm_obj);
+    } else {
+        if (snowflake_timestamp_from_epoch_seconds(&ts, column, sfstmt->connection->timezone,
+                                                   (int32) sfstmt->desc[idx - 1].scale, db_type)) {
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                     "Failed to convert the response from the server into a SF_TIMESTAMP.",
+                                     SF_SQLSTATE_GENERAL_ERROR, sfstmt->sfqid);
+            return SF_STATUS_ERROR_CONVERSION_FAILURE;
+        }
+        if (format) {
+            len = sf_timestamp_format_apply(format, &ts, buffer, size);
+        } else if (snowflake_timestamp_to_string(&ts, "", &buffer, size, &len, SF_BOOLEAN_FALSE)) {
+            SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                     "Failed to convert a SF_TIMESTAMP value to a string.",
+                                     SF_SQLSTATE_GENERAL_ERROR, sfstmt->sfqid);
+            return SF_STATUS_ERROR_CONVERSION_FAILURE;
+        }
+    }
+
+    row_scratch_commit((SF_ROW_SCRATCH *) sfstmt->row_scratch, len + 1);
+    *value_ptr = buffer;
+    *value_len_ptr = len;
+    return SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL snowflake_column_as_strview(SF_STMT *sfstmt, int idx, const char **value_ptr,
+                                              size_t *value_len_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
+    size_t column_len = 0;
+    const char *value = NULL;
+    size_t value_len = 0;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &column_len)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
-    if (snowflake_cJSON_IsNull(column)) {
-        *value_ptr = 0;
-    } else {
-        *value_ptr = strlen(snowflake_cJSON_GetArrayItem(sfstmt->cur_row, idx - 1)->valuestring);
+    if (column != NULL) {
+        switch (sfstmt->desc[idx - 1].type) {
+            case SF_DB_TYPE_BOOLEAN:
+                value = strcmp(column, "0") == 0 ? SF_BOOLEAN_FALSE_STR : SF_BOOLEAN_TRUE_STR;
+                value_len = strlen(value);
+                break;
+            case SF_DB_TYPE_DATE:
+            case SF_DB_TYPE_TIME:
+            case SF_DB_TYPE_TIMESTAMP_NTZ:
+            case SF_DB_TYPE_TIMESTAMP_LTZ:
+            case SF_DB_TYPE_TIMESTAMP_TZ:
+                status = _snowflake_format_column_view(sfstmt, idx, column, &value, &value_len);
+                break;
+            case SF_DB_TYPE_BINARY:
+                if (_snowflake_binary_base64(sfstmt)) {
+                    status = _snowflake_format_binary_view(sfstmt, column, column_len, &value, &value_len);
+                    break;
+                }
+                value = column;
+                value_len = column_len;
+                break;
+            default:
+                // The value in the rowset, NUL terminated already
+                value = column;
+                value_len = column_len;
+                break;
+        }
+    }
+
+    *value_ptr = value;
+    if (value_len_ptr) {
+        *value_len_ptr = value_len;
+    }
+    return status;
+}
+
+SF_STATUS STDCALL snowflake_column_as_binary(SF_STMT *sfstmt, int idx, void *buffer, size_t capacity,
+                                             size_t *len_ptr) {
+    SF_STATUS status;
+    const char *column = NULL;
+    size_t column_len = 0;
+    size_t len = 0;
+
+    if ((status = _snowflake_column_null_checks(sfstmt, (void *) len_ptr)) != SF_STATUS_SUCCESS) {
+        return status;
+    }
+    *len_ptr = 0;
+
+    // Get column
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &column_len)) != SF_STATUS_SUCCESS) {
+        return status;
+    }
+    if (column == NULL) {
+        return SF_STATUS_SUCCESS;
+    }
+    if (sfstmt->desc[idx - 1].type != SF_DB_TYPE_BINARY) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                 "Only BINARY columns convert into binary", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+
+    // The server sends the bytes as hex text
+    *len_ptr = column_len / 2;
+    if (column_len / 2 > capacity || (buffer == NULL && column_len > 0)) {
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_BUFFER_TOO_SMALL,
+                                 "Buffer is too small for the binary value", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (!sf_hex_decode(column, column_len, (char *) buffer, &len)) {
+        *len_ptr = 0;
+        SET_SNOWFLAKE_STMT_ERROR(&sfstmt->error, SF_STATUS_ERROR_CONVERSION_FAILURE,
+                                 "Cannot convert value into binary", "", sfstmt->sfqid);
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    return SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL snowflake_column_strlen(SF_STMT *sfstmt, int idx, size_t *value_ptr) {
+    SF_STATUS status;
+    const char *column = NULL;
+    size_t column_len = 0;
+
+    if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
+        return status;
+    }
+
+    // Get column
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, &column_len)) != SF_STATUS_SUCCESS) {
+        return status;
     }
 
+    *value_ptr = column_len;
+
     return SF_STATUS_SUCCESS;
 }
 
 SF_STATUS STDCALL snowflake_column_is_null(SF_STMT *sfstmt, int idx, sf_bool *value_ptr) {
     SF_STATUS status;
-    cJSON *column = NULL;
+    const char *column = NULL;
 
     if ((status = _snowflake_column_null_checks(sfstmt, (void *) value_ptr)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
     // Get column
-    if ((status = _snowflake_get_cJSON_column(sfstmt, idx, &column)) != SF_STATUS_SUCCESS) {
+    if ((status = _snowflake_get_column(sfstmt, idx, &column, NULL)) != SF_STATUS_SUCCESS) {
         return status;
     }
 
-    *value_ptr = snowflake_cJSON_IsNull(column) ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
+    *value_ptr = column == NULL ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
 
     return SF_STATUS_SUCCESS;
 }
@@ -2868,9 +4212,10 @@ SF_STATUS STDCALL snowflake_timestamp_from_epoch_seconds(SF_TIMESTAMP *ts, const
     time_t nsec = 0L;
     time_t sec = 0L;
     int64 tzoffset = 0;
+    int32 utc_offset = 0;
+    sf_bool is_dst = SF_BOOLEAN_FALSE;
     struct tm *tm_ptr = NULL;
-    char tzname[64];
-    char *tzptr = (char *) timezone;
+    const SF_TIME_ZONE *zone = NULL;
 
     memset(&ts->tm_obj, 0, sizeof(ts->tm_obj));
     ts->nsec = 0;
@@ -2906,39 +4251,46 @@ SF_STATUS STDCALL snowflake_timestamp_from_epoch_seconds(SF_TIMESTAMP *ts, const
         nsec = pow10_int64[ts->scale] - nsec;
         sec--;
     }
-    log_info("sec: %lld, nsec: %lld", sec, nsec);
     // Transform nsec to a 9 digit number to store in the timestamp struct
     ts->nsec = (int32) (nsec * pow10_int64[9-ts->scale]);
 
     if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ) {
-        /* make up Timezone name from the tzoffset */
-        ldiv_t dm = ldiv((long) tzoffset, 60L);
-        sb_sprintf(tzname, sizeof(tzname), "UTC%c%02ld:%02ld",
-                dm.quot > 0 ? '+' : '-', labs(dm.quot), labs(dm.rem));
-        tzptr = tzname;
+        // The value carries its own offset, so the local time is plain arithmetic
+        utc_offset = (int32) (tzoffset * 60);
         ts->tzoffset = (int32) tzoffset;
+    } else if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_LTZ) {
+        zone = sf_time_zone_get(timezone);
+        if (zone) {
+            utc_offset = sf_time_zone_offset(zone, (int64) sec, &is_dst);
+            ts->tzoffset = utc_offset / 60;
+        }
     }
 
-    /* replace a dot character with NULL */
     if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_NTZ ||
         ts->ts_type == SF_DB_TYPE_TIME ||
-        ts->ts_type == SF_DB_TYPE_DATE) {
-        tm_ptr = sf_gmtime(&sec, &ts->tm_obj);
-    } else if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_LTZ ||
-      ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ) {
-        /* set the environment variable TZ to the session timezone
-         * so that localtime_tz honors it.
+        ts->ts_type == SF_DB_TYPE_DATE ||
+        ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ ||
+        (ts->ts_type == SF_DB_TYPE_TIMESTAMP_LTZ && zone)) {
+        /* NTZ, TIME and DATE are in UTC, TZ and LTZ are shifted by the offset in their zone */
+        sec += utc_offset;
+        tm_ptr = sf_seconds_to_tm((int64) sec, &ts->tm_obj) ? &ts->tm_obj : NULL;
+        if (tm_ptr != NULL) {
+            ts->tm_obj.tm_isdst = is_dst;
+#if defined(__linux__) || defined(__APPLE__)
+            ts->tm_obj.tm_gmtoff = utc_offset;
+#endif
+        }
+    } else if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_LTZ) {
+        /* The session timezone isn't one the time zone engine knows, so libc converts it
+         * with the environment variable TZ set to it.
          */
         _mutex_lock(&gmlocaltime_lock);
         const char *prev_tz_ptr = sf_getenv("TZ");
-        sf_setenv("TZ", tzptr);
+        sf_setenv("TZ", timezone);
         sf_tzset();
-        sec += tzoffset * 60 * 2; /* adjust for TIMESTAMP_TZ */
         tm_ptr = sf_localtime(&sec, &ts->tm_obj);
 #if defined(__linux__) || defined(__APPLE__)
-        if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_LTZ) {
-            ts->tzoffset = (int32) (ts->tm_obj.tm_gmtoff / 60);
-        }
+        ts->tzoffset = (int32) (ts->tm_obj.tm_gmtoff / 60);
 #endif
         if (prev_tz_ptr != NULL) {
             sf_setenv("TZ", prev_tz_ptr); /* cannot set to NULL */
@@ -2969,29 +4321,34 @@ SF_STATUS STDCALL snowflake_timestamp_to_string(SF_TIMESTAMP *ts, const char *fm
         return SF_STATUS_ERROR_NULL_POINTER;
     }
     char *buffer = *buffer_ptr;
+    // A buffer we allocate ourselves can grow too
+    sf_bool can_grow = reallocate || buffer == NULL;
+    SF_TIMESTAMP_FORMAT format;
+    sf_bool has_format = fmt != NULL && *fmt != '\0';
 
-    // Using a fixed format for now.
-    // TODO update to translate sql format to C date format instead of using fixed format.
-    const char *fmt0;
     size_t max_len = 1;
-    if (ts->ts_type != SF_DB_TYPE_TIME) {
-        max_len += 21;
-        fmt0 = "%Y-%m-%d %H:%M:%S";
+    if (has_format) {
+        if (sf_timestamp_format_compile(fmt, &format) != SF_STATUS_SUCCESS) {
+            ret = SF_STATUS_ERROR_STRING_FORMATTING;
+            goto cleanup;
+        }
+        max_len += format.max_len;
     } else {
-        max_len += 8;
-        fmt0 = "%H:%M:%S";
-    }
-    /* adjust scale */
-    char fmt_static[20];
-    sb_sprintf(fmt_static, sizeof(fmt_static), ".%%0%dld", ts->scale);
+        // Without a format, the fixed layout of the type
+        if (ts->ts_type != SF_DB_TYPE_TIME) {
+            max_len += 21;
+        } else {
+            max_len += 8;
+        }
 
-    // Add space for scale if scale is greater than 0
-    max_len += (ts->scale > 0) ? 1 + ts->scale : 0;
-    // Add space for timezone if SF_DB_TYPE_TIMESTAMP_TZ is set
-    max_len += (ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ) ? 7 : 0;
+        // Add space for scale if scale is greater than 0
+        max_len += (ts->scale > 0) ? 1 + ts->scale : 0;
+        // Add space for timezone if SF_DB_TYPE_TIMESTAMP_TZ is set
+        max_len += (ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ) ? 7 : 0;
+    }
     // Allocate string buffer to store date using our calculated max length
     if (max_len > buf_size || buffer == NULL) {
-        if (reallocate || buffer == NULL) {
+        if (can_grow) {
             buffer = global_hooks.realloc(buffer, max_len);
             buf_size = max_len;
         } else {
@@ -2999,22 +4356,39 @@ SF_STATUS STDCALL snowflake_timestamp_to_string(SF_TIMESTAMP *ts, const char *fm
             goto cleanup;
         }
     }
-    len = strftime(buffer, buf_size, fmt0, &ts->tm_obj);
+    if (has_format) {
+        len = sf_timestamp_format_apply(&format, ts, buffer, buf_size);
+        if (len == 0 && can_grow) {
+            // A year of more than four digits
+            buf_size = max_len + format.op_count * SF_FORMAT_MAX_ELEMENT_LEN;
+            buffer = global_hooks.realloc(buffer, buf_size);
+            len = sf_timestamp_format_apply(&format, ts, buffer, buf_size);
+        }
+        ret = len > 0 ? SF_STATUS_SUCCESS : SF_STATUS_ERROR_BUFFER_TOO_SMALL;
+        goto cleanup;
+    }
+    if (ts->ts_type != SF_DB_TYPE_TIME) {
+        len = sf_format_date_time(buffer, buf_size, &ts->tm_obj);
+    } else {
+        len = sf_format_time(buffer, buf_size, &ts->tm_obj);
+    }
     if (ts->scale > 0) {
         int64 nsec = ts->nsec / pow10_int64[9-ts->scale];
-        len += sb_sprintf(
-          &(buffer)[len],
-          max_len - len, fmt_static,
-          nsec);
+        if (nsec >= 0 && nsec < pow10_int64[ts->scale] && len + 2 + ts->scale <= max_len) {
+            buffer[len++] = '.';
+            len += sf_format_fraction(&buffer[len], nsec, ts->scale);
+        } else {
+            len += sb_sprintf(&buffer[len], max_len - len, ".%0*lld", (int) ts->scale, (long long) nsec);
+        }
     }
     if (ts->ts_type == SF_DB_TYPE_TIMESTAMP_TZ) {
         /* Timezone info */
-        ldiv_t dm = ldiv((long) ts->tzoffset, 60L);
+        ldiv_t dm = ldiv(labs((long) ts->tzoffset), 60L);
         len += sb_sprintf(
           &((char *) buffer)[len],
           max_len - len,
           " %c%02ld:%02ld",
-          dm.quot > 0 ? '+' : '-', labs(dm.quot), labs(dm.rem));
+          ts->tzoffset < 0 ? '-' : '+', dm.quot, dm.rem);
     }
 
     ret = SF_STATUS_SUCCESS;
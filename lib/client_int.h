@@ -26,6 +26,7 @@
 #define QUERY_URL "/queries/v1/query-request"
 #define RENEW_SESSION_URL "/session/token-request"
 #define DELETE_SESSION_URL "/session"
+#define QUERY_RESULT_URL_FORMAT "/queries/%s/result"
 
 #define URL_QUERY_DELIMITER "?"
 #define URL_PARAM_DELIM "&"
@@ -44,6 +45,8 @@
 #define REQUEST_TYPE_ISSUE "ISSUE"
 
 #define DATE_STRING_MAX_SIZE 12
+// Fixed layout of a TIMESTAMP_TZ with 9 fraction digits and the NUL
+#define TIMESTAMP_STRING_MAX_SIZE 39
 #define SECONDS_IN_AN_HOUR 86400L
 
 /**
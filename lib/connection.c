@@ -183,8 +183,10 @@ cJSON *STDCALL create_auth_json_body(SF_CONNECT *sf,
     return body;
 }
 
-cJSON *STDCALL create_query_json_body(const char *sql_text, int64 sequence_id, const char *request_id) {
+cJSON *STDCALL create_query_json_body(const char *sql_text, int64 sequence_id, const char *request_id,
+                                      sf_bool arrow_results) {
     cJSON *body;
+    cJSON *parameters;
     double submission_time;
     // Create body
 #ifdef MOCK_ENABLED
@@ -201,6 +203,13 @@ cJSON *STDCALL create_query_json_body(const char *sql_text, int64 sequence_id, c
     {
         snowflake_cJSON_AddStringToObject(body, "requestId", request_id);
     }
+    // The server may still answer in JSON, e.g. for statements without a result set. Without the
+    // parameter it answers in JSON, the format of the session.
+    if (arrow_results) {
+        parameters = snowflake_cJSON_CreateObject();
+        snowflake_cJSON_AddStringToObject(parameters, "C_API_QUERY_RESULT_FORMAT", "ARROW");
+        snowflake_cJSON_AddItemToObject(body, "parameters", parameters);
+    }
     return body;
 }
 
@@ -823,9 +832,36 @@ ARRAY_LIST *json_get_object_keys(const cJSON *item) {
 size_t
 json_resp_cb(char *data, size_t size, size_t nmemb, RAW_JSON_BUFFER *raw_json) {
     size_t data_size = size * nmemb;
+    size_t needed = raw_json->size + data_size + 1;
+    size_t capacity;
+    curl_off_t content_length = -1;
+    char *buffer;
     log_debug("Curl response size: %zu", data_size);
-    raw_json->buffer = (char *) SF_REALLOC(raw_json->buffer,
-                                           raw_json->size + data_size + 1);
+    if (needed > raw_json->capacity) {
+        capacity = raw_json->capacity < RAW_JSON_BUFFER_MIN_SIZE ? RAW_JSON_BUFFER_MIN_SIZE : raw_json->capacity;
+        // Make room for the whole body at once if the server told us its size. A compressed
+        // body is larger once decoded, so it may still grow.
+        if (!raw_json->is_sized && raw_json->curl &&
+            curl_easy_getinfo(raw_json->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length) == CURLE_OK &&
+            content_length >= 0) {
+            raw_json->is_sized = SF_BOOLEAN_TRUE;
+            if (content_length > RAW_JSON_BUFFER_MAX_PRESIZE) {
+                content_length = RAW_JSON_BUFFER_MAX_PRESIZE;
+            }
+            if ((size_t) content_length + raw_json->size + 1 > capacity) {
+                capacity = (size_t) content_length + raw_json->size + 1;
+            }
+        }
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        if ((buffer = (char *) SF_REALLOC(raw_json->buffer, capacity)) == NULL) {
+            // Returning less than we got aborts the transfer
+            return 0;
+        }
+        raw_json->buffer = buffer;
+        raw_json->capacity = capacity;
+    }
     // Start copying where last null terminator existed
     sb_memcpy(&raw_json->buffer[raw_json->size], data_size, data, data_size);
     raw_json->size += data_size;
@@ -62,6 +62,14 @@ typedef enum SF_JSON_ERROR {
     SF_JSON_ERROR_OOM
 } SF_JSON_ERROR;
 
+// Initial size of a RAW_JSON_BUFFER, about what curl passes to the write callback at once
+#define RAW_JSON_BUFFER_MIN_SIZE (16 * 1024)
+// Largest size a RAW_JSON_BUFFER is made for up front from the Content-Length of a response. Past that it
+// only grows as the body arrives, so a bogus header can't make us allocate whatever it claims.
+#define RAW_JSON_BUFFER_MAX_PRESIZE SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES
+// Largest RAW_JSON_BUFFER a thread keeps for its next request. Larger ones are freed after the request.
+#define RAW_JSON_BUFFER_MAX_POOLED (4 * 1024 * 1024)
+
 /**
  * Dynamically growing char buffer to hold retrieved in cURL call.
  */
@@ -70,6 +78,12 @@ typedef struct RAW_JSON_BUFFER {
     char *buffer;
     // Number of characters in char buffer
     size_t size;
+    // Allocated size of the char buffer. Grows geometrically
+    size_t capacity;
+    // Handle the response is received on, to size the buffer from the Content-Length. Optional
+    CURL *curl;
+    // The buffer was sized from the Content-Length of the response
+    sf_bool is_sized;
 } RAW_JSON_BUFFER;
 
 /**
@@ -164,9 +178,11 @@ cJSON *STDCALL create_auth_json_body(SF_CONNECT *sf, const char *application, co
  * @param sql_text The sql query to send to Snowflake
  * @param sequence_id Sequence ID from the Snowflake Connection object.
  * @param request_id  requestId to be passed as a part of body instead of header.
+ * @param arrow_results Ask for the results in the Arrow format instead of JSON.
  * @return Query cJSON Body.
  */
-cJSON *STDCALL create_query_json_body(const char *sql_text, int64 sequence_id, const char *request_id);
+cJSON *STDCALL create_query_json_body(const char *sql_text, int64 sequence_id, const char *request_id,
+                                      sf_bool arrow_results);
 
 /**
  * Creates a cJSON blob that is used to renew a session with Snowflake. cJSON blob must be freed by the caller using
@@ -370,6 +386,27 @@ sf_bool STDCALL http_perform(CURL *curl, SF_REQUEST_TYPE request_type, char *url
                              char *body, cJSON **json, int64 network_timeout, sf_bool chunk_downloader,
                              SF_ERROR_STRUCT *error, sf_bool insecure_mode);
 
+/**
+ * Sets up the response buffer each thread keeps for its next HTTP request. http_perform allocates a buffer
+ * for every request if this wasn't called.
+ */
+void STDCALL http_response_buffer_pool_init(void);
+
+/**
+ * Frees the response buffer of the calling thread and stops keeping them. Threads that exit afterwards may
+ * leak the buffer they kept.
+ */
+void STDCALL http_response_buffer_pool_term(void);
+
+/**
+ * Sets the peer verification, CA bundle, SSL version and OCSP options on a cURL object.
+ *
+ * @param curl cURL object.
+ * @param insecure_mode Insecure mode disable OCSP check when set to true
+ * @return Success/failure status of setting the options. 1 = Success; 0 = Failure
+ */
+sf_bool STDCALL set_curl_tls_options(CURL *curl, sf_bool insecure_mode);
+
 /**
  * Returns true if HTTP code is retryable, false otherwise.
  *
@@ -76,9 +76,16 @@ void STDCALL set_snowflake_error(SF_ERROR_STRUCT *error,
 }
 
 void STDCALL clear_snowflake_error(SF_ERROR_STRUCT *error) {
-    _mutex_lock(&mutex_shared_msg);
-    memset(_shared_msg, 0, sizeof(_shared_msg));
-    _mutex_unlock(&mutex_shared_msg);
+    // Nothing to clear. Column accessors clear the error on every call.
+    if (error->error_code == SF_STATUS_SUCCESS && error->msg == NULL &&
+        strncmp(error->sqlstate, SF_SQLSTATE_NO_ERROR, sizeof(SF_SQLSTATE_NO_ERROR)) == 0) {
+        return;
+    }
+    if (error->is_shared_msg) {
+        _mutex_lock(&mutex_shared_msg);
+        memset(_shared_msg, 0, sizeof(_shared_msg));
+        _mutex_unlock(&mutex_shared_msg);
+    }
     if (strncmp(error->sqlstate, SF_SQLSTATE_NO_ERROR,
                 sizeof(SF_SQLSTATE_NO_ERROR)) && !error->is_shared_msg) {
         /* Error already set and msg is not on shared mem */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include "hex.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEX_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Value of each hex digit, 0xFF for anything else
+static const uint8 hex_values[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 10,   11,   12,   13,   14,   15,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 10,   11,   12,   13,   14,   15,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#ifdef HEX_SSE2
+/**
+ * Values of 16 hex digits, or SF_BOOLEAN_FALSE if one is not a hex digit
+ */
+static inline sf_bool decode_digits(__m128i chars, __m128i *values) {
+    // Signed compares, so that the characters above 0x7F fall outside both ranges
+    __m128i digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i letters = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(digits, _mm_set1_epi8(-1)),
+                                     _mm_cmplt_epi8(digits, _mm_set1_epi8(10)));
+    __m128i is_letter = _mm_and_si128(_mm_cmpgt_epi8(letters, _mm_set1_epi8(-1)),
+                                      _mm_cmplt_epi8(letters, _mm_set1_epi8(6)));
+
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xFFFF) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *values = _mm_or_si128(_mm_and_si128(is_digit, digits),
+                           _mm_and_si128(is_letter, _mm_add_epi8(letters, _mm_set1_epi8(10))));
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Bytes of 16 digit pairs. The first digit of a pair is the low byte of its 16 bit lane.
+ */
+static inline __m128i combine_digits(__m128i values) {
+    return _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 4),
+                        _mm_srli_epi16(values, 8));
+}
+#endif
+
+sf_bool STDCALL sf_hex_decode(const char *src, size_t src_len, char *dst, size_t *dst_len) {
+    const uint8 *in = (const uint8 *) src;
+    uint8 *out = (uint8 *) dst;
+    size_t i = 0;
+    uint32 high;
+    uint32 low;
+
+    if (src_len % 2 != 0) {
+        return SF_BOOLEAN_FALSE;
+    }
+
+#ifdef HEX_SSE2
+    // 32 characters into 16 bytes
+    for (; i + 32 <= src_len; i += 32) {
+        __m128i first;
+        __m128i second;
+
+        if (!decode_digits(_mm_loadu_si128((const __m128i *) (in + i)), &first) ||
+            !decode_digits(_mm_loadu_si128((const __m128i *) (in + i + 16)), &second)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        _mm_storeu_si128((__m128i *) out, _mm_packus_epi16(combine_digits(first), combine_digits(second)));
+        out += 16;
+    }
+#endif
+
+    for (; i < src_len; i += 2) {
+        high = hex_values[in[i]];
+        low = hex_values[in[i + 1]];
+        if ((high | low) > 0x0F) {
+            return SF_BOOLEAN_FALSE;
+        }
+        *out++ = (uint8) (high << 4 | low);
+    }
+
+    *dst_len = (size_t) (out - (uint8 *) dst);
+    return SF_BOOLEAN_TRUE;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_HEX_H
+#define SNOWFLAKE_HEX_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+
+/**
+ * Decodes hex text of either case, e.g. a BINARY value of a result. On x86-64, 32 characters are decoded
+ * at a time with SSE2, which every such CPU has.
+ *
+ * @param src hex text
+ * @param src_len length of the text
+ * @param dst buffer of at least src_len / 2 bytes
+ * @param dst_len number of bytes decoded
+ * @return SF_BOOLEAN_FALSE if the text is not valid hex
+ */
+sf_bool STDCALL sf_hex_decode(const char *src, size_t src_len, char *dst, size_t *dst_len);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_HEX_H
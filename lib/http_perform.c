@@ -25,6 +25,10 @@
 
 #define REQUEST_GUID_KEY_SIZE 13
 
+// Response buffer each thread keeps from its last request, so the next one doesn't grow a new one
+static SF_THREAD_LOCAL_KEY response_buffer_key;
+static sf_bool response_buffer_pool_ready;
+
 static void
 dump(const char *text, FILE *stream, unsigned char *ptr, size_t size,
      char nohex);
@@ -122,6 +126,123 @@ int my_trace(CURL *handle, curl_infotype type,
     return 0;
 }
 
+sf_bool STDCALL set_curl_tls_options(CURL *curl, sf_bool insecure_mode) {
+    CURLcode res;
+
+    if (DISABLE_VERIFY_PEER) {
+        res = curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+        if (res != CURLE_OK) {
+            log_error("Failed to disable peer verification [%s]",
+                      curl_easy_strerror(res));
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+
+    if (CA_BUNDLE_FILE) {
+        res = curl_easy_setopt(curl, CURLOPT_CAINFO, CA_BUNDLE_FILE);
+        if (res != CURLE_OK) {
+            log_error("Unable to set certificate file [%s]",
+                      curl_easy_strerror(res));
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+
+    res = curl_easy_setopt(curl, CURLOPT_SSLVERSION, SSL_VERSION);
+    if (res != CURLE_OK) {
+        log_error("Unable to set SSL Version [%s]",
+                  curl_easy_strerror(res));
+        return SF_BOOLEAN_FALSE;
+    }
+
+#ifndef _WIN32
+    // If insecure mode is set to true, skip OCSP check not matter the value of SF_OCSP_CHECK (global OCSP variable)
+    sf_bool ocsp_check;
+    if (insecure_mode) {
+        ocsp_check = SF_BOOLEAN_FALSE;
+    } else {
+        ocsp_check = SF_OCSP_CHECK;
+    }
+    res = curl_easy_setopt(curl, CURLOPT_SSL_SF_OCSP_CHECK, ocsp_check);
+    if (res != CURLE_OK) {
+        log_error("Unable to set OCSP check enable/disable [%s]",
+                  curl_easy_strerror(res));
+        return SF_BOOLEAN_FALSE;
+    }
+#endif
+
+    return SF_BOOLEAN_TRUE;
+}
+
+static void STDCALL free_response_buffer(void *pooled) {
+    RAW_JSON_BUFFER *buffer = (RAW_JSON_BUFFER *) pooled;
+    SF_FREE(buffer->buffer);
+    SF_FREE(buffer);
+}
+
+void STDCALL http_response_buffer_pool_init(void) {
+    if (response_buffer_pool_ready) {
+        return;
+    }
+    if (_thread_local_init(&response_buffer_key, free_response_buffer) != 0) {
+        log_warn("Unable to set up the response buffer pool, each request allocates its own buffer");
+        return;
+    }
+    response_buffer_pool_ready = SF_BOOLEAN_TRUE;
+}
+
+void STDCALL http_response_buffer_pool_term(void) {
+    RAW_JSON_BUFFER *pooled;
+
+    if (!response_buffer_pool_ready) {
+        return;
+    }
+    pooled = (RAW_JSON_BUFFER *) _thread_local_get(&response_buffer_key);
+    if (pooled) {
+        _thread_local_set(&response_buffer_key, NULL);
+        free_response_buffer(pooled);
+    }
+    _thread_local_term(&response_buffer_key);
+    response_buffer_pool_ready = SF_BOOLEAN_FALSE;
+}
+
+/**
+ * Takes the buffer the calling thread kept from its last request, if any
+ */
+static void STDCALL take_response_buffer(RAW_JSON_BUFFER *buffer) {
+    RAW_JSON_BUFFER *pooled;
+
+    if (!response_buffer_pool_ready ||
+        (pooled = (RAW_JSON_BUFFER *) _thread_local_get(&response_buffer_key)) == NULL) {
+        return;
+    }
+    buffer->buffer = pooled->buffer;
+    buffer->capacity = pooled->capacity;
+    pooled->buffer = NULL;
+    pooled->capacity = 0;
+}
+
+/**
+ * Keeps the buffer of a finished request for the next request of the calling thread, or frees it
+ */
+static void STDCALL give_back_response_buffer(RAW_JSON_BUFFER *buffer) {
+    RAW_JSON_BUFFER *pooled;
+
+    if (response_buffer_pool_ready && buffer->buffer && buffer->capacity <= RAW_JSON_BUFFER_MAX_POOLED) {
+        pooled = (RAW_JSON_BUFFER *) _thread_local_get(&response_buffer_key);
+        if (!pooled && (pooled = (RAW_JSON_BUFFER *) SF_CALLOC(1, sizeof(RAW_JSON_BUFFER))) != NULL &&
+            _thread_local_set(&response_buffer_key, pooled) != 0) {
+            SF_FREE(pooled);
+        }
+        if (pooled && !pooled->buffer) {
+            pooled->buffer = buffer->buffer;
+            pooled->capacity = buffer->capacity;
+            buffer->buffer = NULL;
+        }
+    }
+    SF_FREE(buffer->buffer);
+    buffer->capacity = 0;
+}
+
 sf_bool STDCALL http_perform(CURL *curl,
                              SF_REQUEST_TYPE request_type,
                              char *url,
@@ -148,13 +269,14 @@ sf_bool STDCALL http_perform(CURL *curl,
             &djb    // Decorrelate jitter
     };
     */
-    RAW_JSON_BUFFER buffer = {NULL, 0};
+    RAW_JSON_BUFFER buffer = {NULL, 0, 0, curl, SF_BOOLEAN_FALSE};
     struct data config;
     config.trace_ascii = 1;
 
     if (curl == NULL) {
         return SF_BOOLEAN_FALSE;
     }
+    take_response_buffer(&buffer);
 
     //TODO set error buffer
 
@@ -166,9 +288,13 @@ sf_bool STDCALL http_perform(CURL *curl,
     }
 
     do {
-        // Reset buffer since this may not be our first rodeo
-        SF_FREE(buffer.buffer);
+        // Reset buffer since this may not be our first rodeo. Retries and the next requests of the thread
+        // reuse its memory.
         buffer.size = 0;
+        buffer.is_sized = SF_BOOLEAN_FALSE;
+        if (buffer.buffer) {
+            buffer.buffer[0] = '\0';
+        }
 
         // Generate new request guid, if request guid exists in url
         if (request_guid_ptr && uuid4_generate_non_terminated(request_guid_ptr)) {
@@ -230,46 +356,9 @@ sf_bool STDCALL http_perform(CURL *curl,
             break;
         }
 
-        if (DISABLE_VERIFY_PEER) {
-            res = curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
-            if (res != CURLE_OK) {
-                log_error("Failed to disable peer verification [%s]",
-                          curl_easy_strerror(res));
-                break;
-            }
-        }
-
-        if (CA_BUNDLE_FILE) {
-            res = curl_easy_setopt(curl, CURLOPT_CAINFO, CA_BUNDLE_FILE);
-            if (res != CURLE_OK) {
-                log_error("Unable to set certificate file [%s]",
-                          curl_easy_strerror(res));
-                break;
-            }
-        }
-
-        res = curl_easy_setopt(curl, CURLOPT_SSLVERSION, SSL_VERSION);
-        if (res != CURLE_OK) {
-            log_error("Unable to set SSL Version [%s]",
-                      curl_easy_strerror(res));
-            break;
-        }
-
-#ifndef _WIN32
-        // If insecure mode is set to true, skip OCSP check not matter the value of SF_OCSP_CHECK (global OCSP variable)
-        sf_bool ocsp_check;
-        if (insecure_mode) {
-            ocsp_check = SF_BOOLEAN_FALSE;
-        } else {
-            ocsp_check = SF_OCSP_CHECK;
-        }
-        res = curl_easy_setopt(curl, CURLOPT_SSL_SF_OCSP_CHECK, ocsp_check);
-        if (res != CURLE_OK) {
-            log_error("Unable to set OCSP check enable/disable [%s]",
-                      curl_easy_strerror(res));
+        if (!set_curl_tls_options(curl, insecure_mode)) {
             break;
         }
-#endif
 
         // Set chunk downloader specific stuff here
         if (chunk_downloader) {
@@ -281,8 +370,10 @@ sf_bool STDCALL http_perform(CURL *curl,
             }
 
             // Set the first character in the buffer as a bracket
-            buffer.buffer = (char *) SF_CALLOC(1,
-                                               2); // Don't forget null terminator
+            if (buffer.capacity < 2) {
+                buffer.buffer = (char *) SF_REALLOC(buffer.buffer, 2); // Don't forget null terminator
+                buffer.capacity = 2;
+            }
             buffer.size = 1;
             sb_strncpy(buffer.buffer, 2, "[", 2);
         }
@@ -340,8 +431,11 @@ sf_bool STDCALL http_perform(CURL *curl,
     // We were successful so parse JSON from text
     if (ret) {
         if (chunk_downloader) {
-            buffer.buffer = (char *) SF_REALLOC(buffer.buffer, buffer.size +
-                                                               2); // 1 byte for closing bracket, 1 for null terminator
+            if (buffer.capacity < buffer.size + 2) {
+                buffer.buffer = (char *) SF_REALLOC(buffer.buffer, buffer.size +
+                                                                   2); // 1 byte for closing bracket, 1 for null terminator
+                buffer.capacity = buffer.size + 2;
+            }
             sb_memcpy(&buffer.buffer[buffer.size], 1, "]", 1);
             buffer.size += 1;
             // Set null terminator
@@ -360,7 +454,7 @@ sf_bool STDCALL http_perform(CURL *curl,
         }
     }
 
-    SF_FREE(buffer.buffer);
+    give_back_response_buffer(&buffer);
 
     return ret;
 }
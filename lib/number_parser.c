@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "number_parser.h"
+
+// Eight digits are checked and converted as one little endian word
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define NUMBER_SWAR
+#endif
+
+// A product or quotient of two exact values is correctly rounded only if it is computed in the precision
+// of the type, not in extended precision like the x87 does
+#if (defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0) || defined(_M_X64) || defined(_M_ARM64)
+#define NUMBER_FAST_FLOAT
+#endif
+
+// More digits may not fit in 64 bits
+#define NUMBER_MAX_DIGITS 19
+// Larger exponents of the text are left to libc, and so are the values they would overflow with
+#define NUMBER_MAX_EXPONENT_DIGITS 4
+
+// Mantissas and powers of ten up to these are exact in double and float
+#define NUMBER_MAX_EXACT_FLOAT64 (1ULL << 53)
+#define NUMBER_MAX_POW10_FLOAT64 22
+#define NUMBER_MAX_EXACT_FLOAT32 (1ULL << 24)
+#define NUMBER_MAX_POW10_FLOAT32 10
+
+static const float64 POW10_FLOAT64[NUMBER_MAX_POW10_FLOAT64 + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const float32 POW10_FLOAT32[NUMBER_MAX_POW10_FLOAT32 + 1] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+/**
+ * A number as written in the text: negative, mantissa * 10^exponent
+ */
+typedef struct NUMBER_DECIMAL {
+    uint64 mantissa;
+    int64 exponent;
+    sf_bool negative;
+} NUMBER_DECIMAL;
+
+#ifdef NUMBER_SWAR
+static uint64 STDCALL load_word(const char *str) {
+    uint64 word;
+    memcpy(&word, str, sizeof(word));
+    return word;
+}
+
+/**
+ * Whether all the bytes of the word are ASCII digits. The high nibble of each byte must be 3, and adding 6
+ * must not carry into it.
+ */
+static sf_bool STDCALL is_eight_digits(uint64 word) {
+    return (((word & 0xF0F0F0F0F0F0F0F0ULL) |
+             (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL);
+}
+
+/**
+ * Value of eight ASCII digits, the first one in the lowest byte. Pairs of digits are combined into
+ * 2 digit numbers, those into 4 digit ones and those into the result, with one multiplication per step.
+ */
+static uint32 STDCALL eight_digits(uint64 word) {
+    word = (word & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    word = (word & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (uint32) ((word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+#endif
+
+/**
+ * Reads the digits at the start of the text into value, which wraps around after NUMBER_MAX_DIGITS digits.
+ *
+ * @return number of digits
+ */
+static size_t STDCALL parse_digits(const char *str, size_t len, uint64 *value) {
+    uint64 result = *value;
+    size_t i = 0;
+
+#ifdef NUMBER_SWAR
+    while (i + 8 <= len && is_eight_digits(load_word(str + i))) {
+        result = result * 100000000 + eight_digits(load_word(str + i));
+        i += 8;
+    }
+#endif
+    while (i < len && str[i] >= '0' && str[i] <= '9') {
+        result = result * 10 + (uint64) (str[i] - '0');
+        i++;
+    }
+    *value = result;
+    return i;
+}
+
+/**
+ * Reads [sign]digits[.digits][(e|E)[sign]digits] exactly, or [sign].digits like libc does.
+ *
+ * @return SF_BOOLEAN_FALSE if the text is something else or the mantissa may not fit
+ */
+static sf_bool STDCALL parse_decimal(const char *str, size_t len, NUMBER_DECIMAL *decimal) {
+    size_t i = 0;
+    size_t digits;
+    size_t fraction_digits = 0;
+    size_t exponent_digits;
+    uint64 exponent = 0;
+    sf_bool negative_exponent = SF_BOOLEAN_FALSE;
+
+    decimal->mantissa = 0;
+    decimal->negative = SF_BOOLEAN_FALSE;
+    if (len > 0 && (str[0] == '-' || str[0] == '+')) {
+        decimal->negative = str[0] == '-';
+        i++;
+    }
+    digits = parse_digits(str + i, len - i, &decimal->mantissa);
+    i += digits;
+    if (i < len && str[i] == '.') {
+        i++;
+        fraction_digits = parse_digits(str + i, len - i, &decimal->mantissa);
+        i += fraction_digits;
+        digits += fraction_digits;
+    }
+    // libc reads 0x as the start of a hexadecimal number
+    if (digits == 0 || digits > NUMBER_MAX_DIGITS || (i < len && (str[i] == 'x' || str[i] == 'X'))) {
+        return SF_BOOLEAN_FALSE;
+    }
+    decimal->exponent = -(int64) fraction_digits;
+
+    // Without digits the e isn't part of the number
+    if (i + 1 < len && (str[i] == 'e' || str[i] == 'E')) {
+        i++;
+        if (str[i] == '-' || str[i] == '+') {
+            negative_exponent = str[i] == '-';
+            i++;
+        }
+        exponent_digits = parse_digits(str + i, len - i, &exponent);
+        if (exponent_digits > NUMBER_MAX_EXPONENT_DIGITS) {
+            return SF_BOOLEAN_FALSE;
+        }
+        decimal->exponent += negative_exponent ? -(int64) exponent : (int64) exponent;
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+SF_STATUS STDCALL sf_parse_int64(const char *str, size_t len, int64 *value) {
+    uint64 magnitude = 0;
+    sf_bool negative = SF_BOOLEAN_FALSE;
+    size_t digits;
+    size_t i = 0;
+    char *end;
+
+    if (len > 0 && (str[0] == '-' || str[0] == '+')) {
+        negative = str[0] == '-';
+        i++;
+    }
+    digits = parse_digits(str + i, len - i, &magnitude);
+    if (digits > 0 && digits <= NUMBER_MAX_DIGITS) {
+        if (!negative && magnitude > (uint64) SF_INT64_MAX) {
+            *value = SF_INT64_MAX;
+            return SF_STATUS_ERROR_OUT_OF_RANGE;
+        }
+        if (negative && magnitude > (uint64) SF_INT64_MAX + 1) {
+            *value = SF_INT64_MIN;
+            return SF_STATUS_ERROR_OUT_OF_RANGE;
+        }
+        *value = negative ? (int64) (0 - magnitude) : (int64) magnitude;
+        return SF_STATUS_SUCCESS;
+    }
+
+    errno = 0;
+    *value = (int64) strtoll(str, &end, 10);
+    if (end == str) {
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    return errno == ERANGE ? SF_STATUS_ERROR_OUT_OF_RANGE : SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL sf_parse_uint64(const char *str, size_t len, uint64 *value) {
+    size_t digits;
+    size_t i = 0;
+    char *end;
+
+    // strtoull negates negative numbers in unsigned arithmetic, which is left to it
+    if (len > 0 && str[0] == '+') {
+        i++;
+    }
+    *value = 0;
+    digits = parse_digits(str + i, len - i, value);
+    if (digits > 0 && digits <= NUMBER_MAX_DIGITS) {
+        return SF_STATUS_SUCCESS;
+    }
+
+    errno = 0;
+    *value = (uint64) strtoull(str, &end, 10);
+    if (end == str) {
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    return errno == ERANGE ? SF_STATUS_ERROR_OUT_OF_RANGE : SF_STATUS_SUCCESS;
+}
+
+SF_STATUS STDCALL sf_parse_float64(const char *str, size_t len, float64 *value) {
+    char *end;
+#ifdef NUMBER_FAST_FLOAT
+    NUMBER_DECIMAL decimal;
+
+    // Both the mantissa and the power of ten are exact, so their product or quotient is correctly rounded
+    if (parse_decimal(str, len, &decimal) && decimal.mantissa <= NUMBER_MAX_EXACT_FLOAT64 &&
+        decimal.exponent >= -NUMBER_MAX_POW10_FLOAT64 && decimal.exponent <= NUMBER_MAX_POW10_FLOAT64) {
+        *value = decimal.exponent < 0 ? (float64) decimal.mantissa / POW10_FLOAT64[-decimal.exponent]
+                                      : (float64) decimal.mantissa * POW10_FLOAT64[decimal.exponent];
+        if (decimal.negative) {
+            *value = -*value;
+        }
+        return SF_STATUS_SUCCESS;
+    }
+#endif
+
+    errno = 0;
+    *value = strtod(str, &end);
+    if (end == str) {
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    if (errno == ERANGE || *value == INFINITY || *value == -INFINITY) {
+        return SF_STATUS_ERROR_OUT_OF_RANGE;
+    }
+    return SF_STATUS_SUCCESS;
+}
+
+sf_bool STDCALL sf_scaled_to_float64(uint64 mantissa, sf_bool negative, int32 scale, float64 *value) {
+#ifdef NUMBER_FAST_FLOAT
+    if (mantissa <= NUMBER_MAX_EXACT_FLOAT64 && scale >= 0 && scale <= NUMBER_MAX_POW10_FLOAT64) {
+        *value = (float64) mantissa / POW10_FLOAT64[scale];
+        if (negative) {
+            *value = -*value;
+        }
+        return SF_BOOLEAN_TRUE;
+    }
+#endif
+    return SF_BOOLEAN_FALSE;
+}
+
+SF_STATUS STDCALL sf_parse_float32(const char *str, size_t len, float32 *value) {
+    char *end;
+#ifdef NUMBER_FAST_FLOAT
+    NUMBER_DECIMAL decimal;
+
+    if (parse_decimal(str, len, &decimal) && decimal.mantissa <= NUMBER_MAX_EXACT_FLOAT32 &&
+        decimal.exponent >= -NUMBER_MAX_POW10_FLOAT32 && decimal.exponent <= NUMBER_MAX_POW10_FLOAT32) {
+        *value = decimal.exponent < 0 ? (float32) decimal.mantissa / POW10_FLOAT32[-decimal.exponent]
+                                      : (float32) decimal.mantissa * POW10_FLOAT32[decimal.exponent];
+        if (decimal.negative) {
+            *value = -*value;
+        }
+        return SF_STATUS_SUCCESS;
+    }
+#endif
+
+    errno = 0;
+    *value = strtof(str, &end);
+    if (end == str) {
+        return SF_STATUS_ERROR_CONVERSION_FAILURE;
+    }
+    if (errno == ERANGE || *value == INFINITY || *value == -INFINITY) {
+        return SF_STATUS_ERROR_OUT_OF_RANGE;
+    }
+    return SF_STATUS_SUCCESS;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_NUMBER_PARSER_H
+#define SNOWFLAKE_NUMBER_PARSER_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+#include "snowflake/client.h"
+
+/*
+ * Parse the text of FIXED and REAL values the way strtoll, strtoull, strtod and strtof do, i.e. the number
+ * at the start of the text. Values in the canonical form the server sends are parsed without libc, eight
+ * digits at a time. Anything else, e.g. leading white space, more digits than fit or an exponent out of the
+ * exactly representable range, goes to libc.
+ *
+ * The text must be NUL terminated after len characters.
+ *
+ * @return SF_STATUS_SUCCESS, SF_STATUS_ERROR_CONVERSION_FAILURE if the text doesn't start with a number,
+ *         or SF_STATUS_ERROR_OUT_OF_RANGE if the number doesn't fit, in which case value is what libc
+ *         returns for it. Infinity is out of range for the floating point types.
+ */
+SF_STATUS STDCALL sf_parse_int64(const char *str, size_t len, int64 *value);
+SF_STATUS STDCALL sf_parse_uint64(const char *str, size_t len, uint64 *value);
+SF_STATUS STDCALL sf_parse_float64(const char *str, size_t len, float64 *value);
+SF_STATUS STDCALL sf_parse_float32(const char *str, size_t len, float32 *value);
+
+/*
+ * mantissa / 10^scale, e.g. a FIXED value stored as a scaled integer, rounded the way sf_parse_float64
+ * rounds its text.
+ *
+ * @return SF_BOOLEAN_FALSE if the quotient can't be rounded exactly without the text, e.g. more than 53 bits
+ *         of mantissa, in which case value is unchanged
+ */
+sf_bool STDCALL sf_scaled_to_float64(uint64 mantissa, sf_bool negative, int32 scale, float64 *value);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_NUMBER_PARSER_H
@@ -12,7 +12,10 @@
 #if defined(__linux__) || defined(__APPLE__)
 
 #include <sys/time.h>
+#include <sys/mman.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #endif
 
@@ -164,6 +167,24 @@ _cond_wait(SF_CONDITION_HANDLE *cond, SF_CRITICAL_SECTION_HANDLE *crit) {
 #endif
 }
 
+int STDCALL
+_cond_timed_wait(SF_CONDITION_HANDLE *cond, SF_CRITICAL_SECTION_HANDLE *crit, unsigned long msec) {
+#ifdef _WIN32
+    BOOL ret = SleepConditionVariableCS(cond, crit, msec);
+    return ret ? 0 : 1;
+#else
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += msec / 1000;
+    deadline.tv_nsec += (long) (msec % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return pthread_cond_timedwait(cond, crit, &deadline);
+#endif
+}
+
 int STDCALL _cond_term(SF_CONDITION_HANDLE *cond) {
 #ifdef _WIN32
     // nop
@@ -303,6 +324,145 @@ int STDCALL _mutex_term(SF_MUTEX_HANDLE *lock) {
 #endif
 }
 
+int STDCALL _thread_local_init(SF_THREAD_LOCAL_KEY *key, void (STDCALL *destructor)(void *)) {
+#ifdef _WIN32
+    // Fiber local storage calls the destructor when a thread exits, thread local storage doesn't
+    *key = FlsAlloc((PFLS_CALLBACK_FUNCTION) destructor);
+    return *key == FLS_OUT_OF_INDEXES ? -1 : 0;
+#else
+    return pthread_key_create(key, destructor);
+#endif
+}
+
+void *STDCALL _thread_local_get(SF_THREAD_LOCAL_KEY *key) {
+#ifdef _WIN32
+    return FlsGetValue(*key);
+#else
+    return pthread_getspecific(*key);
+#endif
+}
+
+int STDCALL _thread_local_set(SF_THREAD_LOCAL_KEY *key, void *value) {
+#ifdef _WIN32
+    return FlsSetValue(*key, value) ? 0 : -1;
+#else
+    return pthread_setspecific(*key, value);
+#endif
+}
+
+int STDCALL _thread_local_term(SF_THREAD_LOCAL_KEY *key) {
+#ifdef _WIN32
+    return FlsFree(*key) ? 0 : -1;
+#else
+    return pthread_key_delete(*key);
+#endif
+}
+
+long long STDCALL _atomic_load(SF_ATOMIC_INT64 *value) {
+#ifdef _WIN32
+    return InterlockedCompareExchange64(value, 0, 0);
+#else
+    return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+void STDCALL _atomic_store(SF_ATOMIC_INT64 *value, long long new_value) {
+#ifdef _WIN32
+    InterlockedExchange64(value, new_value);
+#else
+    __atomic_store_n(value, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+long long STDCALL _atomic_add(SF_ATOMIC_INT64 *value, long long delta) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd64(value, delta) + delta;
+#else
+    return __atomic_add_fetch(value, delta, __ATOMIC_SEQ_CST);
+#endif
+}
+
+int STDCALL sf_map_file(const char *path, SF_MAPPED_FILE *mapped) {
+#ifdef _WIN32
+    LARGE_INTEGER size;
+    mapped->data = NULL;
+    mapped->len = 0;
+    mapped->mapping = NULL;
+    mapped->file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped->file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+    if (!GetFileSizeEx(mapped->file, &size)) {
+        CloseHandle(mapped->file);
+        return -1;
+    }
+    // A file mapping can't be empty
+    if (size.QuadPart == 0) {
+        return 0;
+    }
+    mapped->mapping = CreateFileMapping(mapped->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapped->mapping == NULL) {
+        CloseHandle(mapped->file);
+        return -1;
+    }
+    mapped->data = (const char *) MapViewOfFile(mapped->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (mapped->data == NULL) {
+        CloseHandle(mapped->mapping);
+        CloseHandle(mapped->file);
+        return -1;
+    }
+    mapped->len = (size_t) size.QuadPart;
+    return 0;
+#else
+    struct stat st;
+    void *data;
+    int fd = open(path, O_RDONLY);
+
+    mapped->data = NULL;
+    mapped->len = 0;
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if (st.st_size > 0) {
+        data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        mapped->data = (const char *) data;
+        mapped->len = (size_t) st.st_size;
+    }
+    // The mapping stays valid without the descriptor
+    close(fd);
+    return 0;
+#endif
+}
+
+int STDCALL sf_unmap_file(SF_MAPPED_FILE *mapped) {
+    int ret = 0;
+#ifdef _WIN32
+    if (mapped->data && !UnmapViewOfFile(mapped->data)) {
+        ret = -1;
+    }
+    if (mapped->mapping) {
+        CloseHandle(mapped->mapping);
+    }
+    CloseHandle(mapped->file);
+#else
+    if (mapped->data) {
+        ret = munmap((void *) mapped->data, mapped->len);
+    }
+#endif
+    mapped->data = NULL;
+    mapped->len = 0;
+    return ret;
+}
+
 sf_bool STDCALL _is_put_get_command(char *sql_text) {
 #ifdef _WIN32
   // TODO use some library to parse put get command in windows
@@ -513,6 +673,26 @@ void STDCALL sf_log_timestamp(char *tsbuf, size_t tsbufsize) {
 #endif
 }
 
+/**
+ * Monotonic clock used to measure elapsed time. Not related to wall clock time.
+ *
+ * @return microseconds since an arbitrary starting point
+ */
+unsigned long long STDCALL sf_get_monotonic_time_usec(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (unsigned long long) (counter.QuadPart / frequency.QuadPart) * 1000000ULL +
+           (unsigned long long) (counter.QuadPart % frequency.QuadPart) * 1000000ULL / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long) now.tv_sec * 1000000ULL + (unsigned long long) now.tv_nsec / 1000ULL;
+#endif
+}
+
 int STDCALL sf_create_directory_if_not_exists(const char * directoryName)
 {
 #ifdef _WIN32
@@ -3,6 +3,7 @@
  */
 
 #include <string.h>
+#include <ctype.h>
 #include "results.h"
 #include "connection.h"
 #include "memory.h"
@@ -295,3 +296,38 @@ SF_COLUMN_DESC * set_description(const cJSON *rowtype) {
 
     return desc;
 }
+
+cJSON * description_to_cjson(const SF_COLUMN_DESC *desc, int64 column_count) {
+    int64 i;
+    size_t c;
+    char type[32];
+    cJSON *rowtype;
+    cJSON *column;
+
+    if ((rowtype = snowflake_cJSON_CreateArray()) == NULL) {
+        return NULL;
+    }
+    for (i = 0; desc && i < column_count; i++) {
+        if ((column = snowflake_cJSON_CreateObject()) == NULL) {
+            snowflake_cJSON_Delete(rowtype);
+            return NULL;
+        }
+        snowflake_cJSON_AddItemToArray(rowtype, column);
+        // string_to_snowflake_type reads the lower case names of the query response
+        sb_strcpy(type, sizeof(type), snowflake_type_to_string(desc[i].type));
+        for (c = 0; type[c]; c++) {
+            type[c] = (char) tolower((unsigned char) type[c]);
+        }
+        if ((desc[i].name && !snowflake_cJSON_AddStringToObject(column, "name", desc[i].name)) ||
+            !snowflake_cJSON_AddNumberToObject(column, "byteLength", (double) desc[i].byte_size) ||
+            !snowflake_cJSON_AddNumberToObject(column, "length", (double) desc[i].internal_size) ||
+            !snowflake_cJSON_AddNumberToObject(column, "precision", (double) desc[i].precision) ||
+            !snowflake_cJSON_AddNumberToObject(column, "scale", (double) desc[i].scale) ||
+            !snowflake_cJSON_AddBoolToObject(column, "nullable", desc[i].null_ok) ||
+            !snowflake_cJSON_AddStringToObject(column, "type", type)) {
+            snowflake_cJSON_Delete(rowtype);
+            return NULL;
+        }
+    }
+    return rowtype;
+}
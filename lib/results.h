@@ -19,6 +19,11 @@ SF_DB_TYPE c_type_to_snowflake(SF_C_TYPE c_type, SF_DB_TYPE tsmode);
 char *value_to_string(void *value, size_t len, SF_C_TYPE c_type);
 SF_COLUMN_DESC * set_description(const cJSON *rowtype);
 
+/**
+ * Inverse of set_description. Returns NULL if out of memory.
+ */
+cJSON * description_to_cjson(const SF_COLUMN_DESC *desc, int64 column_count);
+
 #ifdef __cplusplus
 }
 #endif
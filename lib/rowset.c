@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <string.h>
+#include "rowset.h"
+#include "memory.h"
+#include "number_parser.h"
+
+#define ROWSET_MIN_ARENA_SIZE 1024
+#define ROWSET_MIN_CELLS 256
+#define ROWSET_MIN_ROWS 32
+#define ROW_SCRATCH_MIN_SIZE 256
+
+/**
+ * Grows an array geometrically so that it fits at least needed elements
+ */
+static sf_bool STDCALL grow(void **data, size_t *capacity, size_t needed, size_t element_size, size_t min_capacity) {
+    size_t new_capacity = *capacity < min_capacity ? min_capacity : *capacity;
+    void *new_data;
+
+    if (needed <= *capacity) {
+        return SF_BOOLEAN_TRUE;
+    }
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    new_data = SF_REALLOC(*data, new_capacity * element_size);
+    if (!new_data) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *data = new_data;
+    *capacity = new_capacity;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Grows an array to exactly needed elements, for when the final size is known
+ */
+static sf_bool STDCALL reserve(void **data, size_t *capacity, size_t needed, size_t element_size) {
+    void *new_data;
+
+    if (needed <= *capacity) {
+        return SF_BOOLEAN_TRUE;
+    }
+    new_data = SF_REALLOC(*data, needed * element_size);
+    if (!new_data) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *data = new_data;
+    *capacity = needed;
+    return SF_BOOLEAN_TRUE;
+}
+
+SF_ROWSET *STDCALL rowset_init(void) {
+    SF_ROWSET *rowset = (SF_ROWSET *) SF_CALLOC(1, sizeof(SF_ROWSET));
+    if (!rowset) {
+        return NULL;
+    }
+    // Null cells and empty strings all point to the empty string at offset 0
+    if (!grow((void **) &rowset->arena, &rowset->arena_size, 1, 1, ROWSET_MIN_ARENA_SIZE) ||
+        !grow((void **) &rowset->row_starts, &rowset->row_capacity, 1, sizeof(size_t), ROWSET_MIN_ROWS)) {
+        rowset_term(rowset);
+        return NULL;
+    }
+    rowset_clear(rowset);
+    return rowset;
+}
+
+void STDCALL rowset_term(SF_ROWSET *rowset) {
+    size_t i;
+
+    if (!rowset) {
+        return;
+    }
+    for (i = 0; i < rowset->column_capacity; i++) {
+        SF_FREE(rowset->columns[i].values);
+        SF_FREE(rowset->columns[i].nulls);
+        SF_FREE(rowset->columns[i].decoded);
+    }
+    SF_FREE(rowset->columns);
+    SF_FREE(rowset->arena);
+    SF_FREE(rowset->cells);
+    SF_FREE(rowset->row_starts);
+    SF_FREE(rowset);
+}
+
+void STDCALL rowset_clear(SF_ROWSET *rowset) {
+    rowset->arena[0] = '\0';
+    rowset->arena_used = 1;
+    rowset->cell_count = 0;
+    rowset->row_count = 0;
+    rowset->row_starts[0] = 0;
+    rowset->column_count = 0;
+}
+
+sf_bool STDCALL rowset_begin_row(SF_ROWSET *rowset) {
+    // Room for the end of this row
+    return grow((void **) &rowset->row_starts, &rowset->row_capacity, (size_t) rowset->row_count + 2,
+                sizeof(size_t), ROWSET_MIN_ROWS);
+}
+
+sf_bool STDCALL rowset_add_cell(SF_ROWSET *rowset, const char *value, size_t len, sf_bool is_null) {
+    SF_ROWSET_CELL *cell;
+
+    if (!grow((void **) &rowset->cells, &rowset->cell_capacity, rowset->cell_count + 1,
+              sizeof(SF_ROWSET_CELL), ROWSET_MIN_CELLS)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    cell = &rowset->cells[rowset->cell_count];
+    cell->offset = 0;
+    cell->len = 0;
+    cell->is_null = is_null;
+
+    if (!is_null && len > 0) {
+        // Offsets and lengths are 32 bit to keep the cells small. A chunk is much smaller than that.
+        if (rowset->arena_used + len + 1 > SF_UINT32_MAX ||
+            !grow((void **) &rowset->arena, &rowset->arena_size, rowset->arena_used + len + 1, 1,
+                  ROWSET_MIN_ARENA_SIZE)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        memcpy(rowset->arena + rowset->arena_used, value, len);
+        rowset->arena[rowset->arena_used + len] = '\0';
+        cell->offset = (uint32) rowset->arena_used;
+        cell->len = (uint32) len;
+        rowset->arena_used += len + 1;
+    }
+
+    rowset->cell_count++;
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL rowset_end_row(SF_ROWSET *rowset) {
+    rowset->row_count++;
+    rowset->row_starts[rowset->row_count] = rowset->cell_count;
+}
+
+void STDCALL rowset_trim(SF_ROWSET *rowset) {
+    void *data;
+
+    if (rowset->arena_size > rowset->arena_used &&
+        (data = SF_REALLOC(rowset->arena, rowset->arena_used)) != NULL) {
+        rowset->arena = (char *) data;
+        rowset->arena_size = rowset->arena_used;
+    }
+    if (rowset->cell_count > 0 && rowset->cell_capacity > rowset->cell_count &&
+        (data = SF_REALLOC(rowset->cells, rowset->cell_count * sizeof(SF_ROWSET_CELL))) != NULL) {
+        rowset->cells = (SF_ROWSET_CELL *) data;
+        rowset->cell_capacity = rowset->cell_count;
+    }
+    if (rowset->row_capacity > (size_t) rowset->row_count + 1 &&
+        (data = SF_REALLOC(rowset->row_starts, ((size_t) rowset->row_count + 1) * sizeof(size_t))) != NULL) {
+        rowset->row_starts = (size_t *) data;
+        rowset->row_capacity = (size_t) rowset->row_count + 1;
+    }
+}
+
+sf_bool STDCALL rowset_reserve(SF_ROWSET *rowset, size_t arena_size, size_t cell_count, int64 row_count) {
+    return reserve((void **) &rowset->arena, &rowset->arena_size, rowset->arena_used + arena_size, 1) &&
+           reserve((void **) &rowset->cells, &rowset->cell_capacity, rowset->cell_count + cell_count,
+                   sizeof(SF_ROWSET_CELL)) &&
+           reserve((void **) &rowset->row_starts, &rowset->row_capacity,
+                   (size_t) (rowset->row_count + row_count) + 1, sizeof(size_t));
+}
+
+/**
+ * Makes room for the values of row_count rows in a decoded column
+ */
+static sf_bool STDCALL reserve_column(SF_ROWSET_COLUMN *column, size_t row_count) {
+    void *data;
+    size_t bitmap_size = (row_count + 7) / 8;
+
+    if (row_count <= column->capacity) {
+        return SF_BOOLEAN_TRUE;
+    }
+    if ((data = SF_REALLOC(column->values, row_count * sizeof(SF_ROWSET_VALUE))) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    column->values = (SF_ROWSET_VALUE *) data;
+    if ((data = SF_REALLOC(column->nulls, bitmap_size)) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    column->nulls = (uint8 *) data;
+    if ((data = SF_REALLOC(column->decoded, bitmap_size)) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    column->decoded = (uint8 *) data;
+    column->capacity = row_count;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Converts the values of one column. Values that don't convert are left to the accessors, which
+ * report the error when the application reads them.
+ */
+static void STDCALL decode_column(const SF_ROWSET *rowset, size_t index, SF_ROWSET_COLUMN *column) {
+    const SF_ROWSET_CELL *cell;
+    const char *value;
+    SF_STATUS status;
+    uint8 mask;
+    int64 row;
+
+    memset(column->nulls, 0, ((size_t) rowset->row_count + 7) / 8);
+    memset(column->decoded, 0, ((size_t) rowset->row_count + 7) / 8);
+    for (row = 0; row < rowset->row_count; row++) {
+        mask = (uint8) (1 << (row & 7));
+        if ((cell = rowset_cell(rowset, row, index)) == NULL) {
+            continue;
+        }
+        if (cell->is_null) {
+            column->nulls[row >> 3] |= mask;
+            continue;
+        }
+        value = rowset_cell_value(rowset, cell);
+        switch (column->c_type) {
+            case SF_C_TYPE_INT64:
+                status = sf_parse_int64(value, cell->len, &column->values[row].int64_value);
+                break;
+            case SF_C_TYPE_FLOAT64:
+                status = sf_parse_float64(value, cell->len, &column->values[row].float64_value);
+                break;
+            default:
+                column->values[row].int64_value = strcmp("1", value) == 0 ? 1 : 0;
+                status = SF_STATUS_SUCCESS;
+                break;
+        }
+        if (status == SF_STATUS_SUCCESS) {
+            column->decoded[row >> 3] |= mask;
+        }
+    }
+}
+
+/**
+ * Makes room for column_count decoded columns. New columns aren't decoded.
+ */
+static sf_bool STDCALL reserve_columns(SF_ROWSET *rowset, size_t column_count) {
+    void *data;
+
+    if (column_count <= rowset->column_capacity) {
+        return SF_BOOLEAN_TRUE;
+    }
+    if ((data = SF_REALLOC(rowset->columns, column_count * sizeof(SF_ROWSET_COLUMN))) == NULL) {
+        return SF_BOOLEAN_FALSE;
+    }
+    rowset->columns = (SF_ROWSET_COLUMN *) data;
+    memset(rowset->columns + rowset->column_capacity, 0,
+           (column_count - rowset->column_capacity) * sizeof(SF_ROWSET_COLUMN));
+    rowset->column_capacity = column_count;
+    return SF_BOOLEAN_TRUE;
+}
+
+sf_bool STDCALL rowset_decode(SF_ROWSET *rowset, const SF_C_TYPE *c_types, size_t column_count) {
+    SF_ROWSET_COLUMN *column;
+    size_t decoded_count = rowset->column_count;
+    size_t i;
+
+    rowset->column_count = 0;
+    if (!reserve_columns(rowset, column_count)) {
+        return SF_BOOLEAN_FALSE;
+    }
+
+    for (i = 0; i < column_count; i++) {
+        column = &rowset->columns[i];
+        if (i < decoded_count && column->c_type == c_types[i] && column->row_count == rowset->row_count) {
+            // Decoded as the rows were added
+            continue;
+        }
+        column->row_count = 0;
+        if (c_types[i] != SF_C_TYPE_INT64 && c_types[i] != SF_C_TYPE_FLOAT64 && c_types[i] != SF_C_TYPE_BOOLEAN) {
+            column->c_type = SF_C_TYPE_NULL;
+            continue;
+        }
+        column->c_type = c_types[i];
+        if (!reserve_column(column, (size_t) rowset->row_count)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        decode_column(rowset, i, column);
+        column->row_count = rowset->row_count;
+    }
+    rowset->column_count = column_count;
+    return SF_BOOLEAN_TRUE;
+}
+
+sf_bool STDCALL rowset_add_decoded(SF_ROWSET *rowset, size_t column, SF_C_TYPE c_type, const SF_ROWSET_VALUE *value) {
+    SF_ROWSET_COLUMN *decoded;
+    const SF_ROWSET_CELL *cell;
+    int64 row = rowset->row_count;
+    size_t row_start = rowset->row_starts[row];
+    size_t capacity;
+    uint8 mask = (uint8) (1 << (row & 7));
+
+    if (column >= rowset->cell_count - row_start) {
+        return SF_BOOLEAN_FALSE;
+    }
+    cell = &rowset->cells[row_start + column];
+    if (column >= rowset->column_count) {
+        if (!reserve_columns(rowset, column + 1)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        for (; rowset->column_count <= column; rowset->column_count++) {
+            rowset->columns[rowset->column_count].c_type = SF_C_TYPE_NULL;
+            rowset->columns[rowset->column_count].row_count = 0;
+        }
+    }
+    decoded = &rowset->columns[column];
+    if (row == 0) {
+        decoded->c_type = c_type;
+        decoded->row_count = 0;
+    }
+    // A row without a value, or with another type, ends the decoded rows of the column
+    if (decoded->c_type != c_type || decoded->row_count != row) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if ((size_t) row >= decoded->capacity) {
+        capacity = decoded->capacity < ROWSET_MIN_ROWS ? ROWSET_MIN_ROWS : decoded->capacity * 2;
+        if (!reserve_column(decoded, capacity)) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+
+    decoded->nulls[row >> 3] &= (uint8) ~mask;
+    decoded->decoded[row >> 3] &= (uint8) ~mask;
+    if (cell->is_null) {
+        decoded->nulls[row >> 3] |= mask;
+    } else if (value) {
+        decoded->values[row] = *value;
+        decoded->decoded[row >> 3] |= mask;
+    }
+    decoded->row_count++;
+    return SF_BOOLEAN_TRUE;
+}
+
+uint64 STDCALL rowset_footprint(const SF_ROWSET *rowset) {
+    uint64 footprint;
+    size_t i;
+
+    if (!rowset) {
+        return 0;
+    }
+    footprint = sizeof(SF_ROWSET) + rowset->arena_size + rowset->cell_capacity * sizeof(SF_ROWSET_CELL) +
+                rowset->row_capacity * sizeof(size_t) + rowset->column_capacity * sizeof(SF_ROWSET_COLUMN);
+    for (i = 0; i < rowset->column_capacity; i++) {
+        // Values plus the two bitmaps
+        footprint += rowset->columns[i].capacity * sizeof(SF_ROWSET_VALUE) +
+                     (rowset->columns[i].capacity + 7) / 8 * 2;
+    }
+    return footprint;
+}
+
+static sf_bool sink_begin_row(void *ctx) {
+    return rowset_begin_row((SF_ROWSET *) ctx);
+}
+
+static sf_bool sink_add_cell(void *ctx, SF_ROWSET_CELL_TYPE type, const char *value, size_t len) {
+    return rowset_add_cell((SF_ROWSET *) ctx, value, len, type == SF_ROWSET_CELL_NULL);
+}
+
+static sf_bool sink_end_row(void *ctx) {
+    rowset_end_row((SF_ROWSET *) ctx);
+    return SF_BOOLEAN_TRUE;
+}
+
+static void sink_add_decoded(void *ctx, size_t column, SF_C_TYPE c_type, const SF_ROWSET_VALUE *value) {
+    rowset_add_decoded((SF_ROWSET *) ctx, column, c_type, value);
+}
+
+static void sink_reset(void *ctx) {
+    rowset_clear((SF_ROWSET *) ctx);
+}
+
+void STDCALL rowset_init_sink(SF_ROWSET *rowset, SF_ROWSET_SINK *sink) {
+    sink->ctx = rowset;
+    sink->begin_row = sink_begin_row;
+    sink->add_cell = sink_add_cell;
+    sink->end_row = sink_end_row;
+    sink->add_decoded = sink_add_decoded;
+    sink->reset = sink_reset;
+}
+
+SF_ROWSET *STDCALL rowset_from_cjson(cJSON *rows) {
+    SF_ROWSET *rowset;
+    cJSON *row;
+    cJSON *cell;
+    char *text;
+    sf_bool ok;
+
+    if (!snowflake_cJSON_IsArray(rows) || (rowset = rowset_init()) == NULL) {
+        return NULL;
+    }
+
+    for (row = rows->child; row; row = row->next) {
+        if (!snowflake_cJSON_IsArray(row) || !rowset_begin_row(rowset)) {
+            goto error;
+        }
+        for (cell = row->child; cell; cell = cell->next) {
+            if (snowflake_cJSON_IsNull(cell)) {
+                ok = rowset_add_cell(rowset, "", 0, SF_BOOLEAN_TRUE);
+            } else if (snowflake_cJSON_IsString(cell)) {
+                ok = rowset_add_cell(rowset, cell->valuestring, strlen(cell->valuestring), SF_BOOLEAN_FALSE);
+            } else {
+                // Numbers and booleans keep their JSON text
+                text = snowflake_cJSON_PrintUnformatted(cell);
+                ok = text && rowset_add_cell(rowset, text, strlen(text), SF_BOOLEAN_FALSE);
+                snowflake_cJSON_free(text);
+            }
+            if (!ok) {
+                goto error;
+            }
+        }
+        rowset_end_row(rowset);
+    }
+    rowset_trim(rowset);
+    return rowset;
+
+error:
+    rowset_term(rowset);
+    return NULL;
+}
+
+cJSON *STDCALL rowset_to_cjson(const SF_ROWSET *rowset) {
+    cJSON *rows;
+    cJSON *row;
+    cJSON *cell;
+    const SF_ROWSET_CELL *value;
+    int64 r;
+    size_t c;
+
+    if ((rows = snowflake_cJSON_CreateArray()) == NULL) {
+        return NULL;
+    }
+    for (r = 0; rowset && r < rowset->row_count; r++) {
+        if ((row = snowflake_cJSON_CreateArray()) == NULL) {
+            goto error;
+        }
+        snowflake_cJSON_AddItemToArray(rows, row);
+        for (c = 0; c < rowset_row_size(rowset, r); c++) {
+            value = rowset_cell(rowset, r, c);
+            cell = value->is_null ? snowflake_cJSON_CreateNull() :
+                   snowflake_cJSON_CreateString(rowset_cell_value(rowset, value));
+            if (!cell) {
+                goto error;
+            }
+            snowflake_cJSON_AddItemToArray(row, cell);
+        }
+    }
+    return rows;
+
+error:
+    snowflake_cJSON_Delete(rows);
+    return NULL;
+}
+
+SF_ROW_SCRATCH *STDCALL row_scratch_init(void) {
+    return (SF_ROW_SCRATCH *) SF_CALLOC(1, sizeof(SF_ROW_SCRATCH));
+}
+
+void STDCALL row_scratch_term(SF_ROW_SCRATCH *scratch) {
+    if (!scratch) {
+        return;
+    }
+    row_scratch_reset(scratch);
+    SF_FREE(scratch->blocks);
+    SF_FREE(scratch);
+}
+
+char *STDCALL row_scratch_reserve(SF_ROW_SCRATCH *scratch, size_t size) {
+    SF_ROW_SCRATCH_BLOCK *block = scratch->blocks;
+    size_t block_size;
+
+    if (!block || block->size - block->used < size) {
+        // Each block doubles the last one, so the newest block is the largest
+        block_size = block ? block->size * 2 : ROW_SCRATCH_MIN_SIZE;
+        while (block_size < size) {
+            block_size *= 2;
+        }
+        block = (SF_ROW_SCRATCH_BLOCK *) SF_MALLOC(sizeof(SF_ROW_SCRATCH_BLOCK) + block_size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = scratch->blocks;
+        block->size = block_size;
+        block->used = 0;
+        scratch->blocks = block;
+    }
+    return (char *) (block + 1) + block->used;
+}
+
+void STDCALL row_scratch_commit(SF_ROW_SCRATCH *scratch, size_t size) {
+    scratch->blocks->used += size;
+}
+
+void STDCALL row_scratch_reset(SF_ROW_SCRATCH *scratch) {
+    SF_ROW_SCRATCH_BLOCK *block;
+    SF_ROW_SCRATCH_BLOCK *next;
+
+    if (!scratch || !scratch->blocks) {
+        return;
+    }
+    for (block = scratch->blocks->next; block; block = next) {
+        next = block->next;
+        SF_FREE(block);
+    }
+    scratch->blocks->next = NULL;
+    scratch->blocks->used = 0;
+}
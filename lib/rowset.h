@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_ROWSET_H
+#define SNOWFLAKE_ROWSET_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+#include "snowflake/client.h"
+#include "cJSON.h"
+#include "rowset_parser.h"
+
+typedef struct SF_ROWSET_CELL {
+    // Offset of the NUL terminated value in the arena
+    uint32 offset;
+    uint32 len;
+    sf_bool is_null;
+} SF_ROWSET_CELL;
+
+typedef union SF_ROWSET_VALUE {
+    int64 int64_value;
+    float64 float64_value;
+} SF_ROWSET_VALUE;
+
+/**
+ * Values of a column converted to a native type once, one per row. Booleans are decoded as int64 0 or 1.
+ */
+typedef struct SF_ROWSET_COLUMN {
+    // SF_C_TYPE_INT64, SF_C_TYPE_FLOAT64 or SF_C_TYPE_BOOLEAN. SF_C_TYPE_NULL if the column isn't decoded
+    SF_C_TYPE c_type;
+    SF_ROWSET_VALUE *values;
+    // One bit per row. A value that is neither NULL nor decoded, e.g. because it didn't convert, is read
+    // from the text again
+    uint8 *nulls;
+    uint8 *decoded;
+    // Number of rows the arrays have room for
+    size_t capacity;
+    // Number of rows decoded, from the first one. Rows added afterwards are read from the text.
+    int64 row_count;
+} SF_ROWSET_COLUMN;
+
+/**
+ * Rows of a result chunk in three contiguous arrays: the cell values in one string arena,
+ * the cells of all the rows and the index of the first cell of each row.
+ */
+typedef struct SF_ROWSET {
+    char *arena;
+    size_t arena_used;
+    size_t arena_size;
+
+    SF_ROWSET_CELL *cells;
+    size_t cell_count;
+    size_t cell_capacity;
+
+    // Index of the first cell of each row. Has row_count + 1 entries once a row was added
+    size_t *row_starts;
+    int64 row_count;
+    size_t row_capacity;
+
+    // Columns decoded by rowset_decode or as the rows were added, 0 until then
+    SF_ROWSET_COLUMN *columns;
+    size_t column_count;
+    size_t column_capacity;
+} SF_ROWSET;
+
+SF_ROWSET *STDCALL rowset_init(void);
+void STDCALL rowset_term(SF_ROWSET *rowset);
+
+/**
+ * Drops all the rows but keeps the memory for the next ones
+ */
+void STDCALL rowset_clear(SF_ROWSET *rowset);
+
+sf_bool STDCALL rowset_begin_row(SF_ROWSET *rowset);
+sf_bool STDCALL rowset_add_cell(SF_ROWSET *rowset, const char *value, size_t len, sf_bool is_null);
+void STDCALL rowset_end_row(SF_ROWSET *rowset);
+
+/**
+ * Gives back the unused capacity once all the rows were added
+ */
+void STDCALL rowset_trim(SF_ROWSET *rowset);
+
+/**
+ * Makes room for arena_size more bytes of values, cell_count more cells and row_count more rows at once,
+ * e.g. when the size of a chunk is known before it is parsed. Rows beyond that still grow the arrays.
+ */
+sf_bool STDCALL rowset_reserve(SF_ROWSET *rowset, size_t arena_size, size_t cell_count, int64 row_count);
+
+/**
+ * Converts the values of the columns that have a native type once all the rows were added, so they are
+ * read without parsing the text. Rows added afterwards are read from the text. Columns rowset_add_decoded
+ * already decoded as the same type are kept.
+ *
+ * @param c_types C type of each column
+ * @return SF_BOOLEAN_FALSE if out of memory, in which case the values are only read from the text
+ */
+sf_bool STDCALL rowset_decode(SF_ROWSET *rowset, const SF_C_TYPE *c_types, size_t column_count);
+
+/**
+ * Keeps the native value of a cell of the row being added, right after rowset_add_cell, so the column is
+ * decoded without parsing the text. A column only stays decoded while every row gets a value of the same
+ * c_type, from the first row.
+ *
+ * @param c_type SF_C_TYPE_INT64, SF_C_TYPE_FLOAT64 or SF_C_TYPE_BOOLEAN
+ * @param value NULL for a null cell or a value that has to be read from the text
+ * @return SF_BOOLEAN_FALSE if the value wasn't kept, e.g. out of memory, in which case the rest of the
+ *         column is read from the text
+ */
+sf_bool STDCALL rowset_add_decoded(SF_ROWSET *rowset, size_t column, SF_C_TYPE c_type, const SF_ROWSET_VALUE *value);
+
+/**
+ * Memory allocated for the rowset
+ */
+uint64 STDCALL rowset_footprint(const SF_ROWSET *rowset);
+
+/**
+ * Sets up a rowset parser sink that appends to the rowset
+ */
+void STDCALL rowset_init_sink(SF_ROWSET *rowset, SF_ROWSET_SINK *sink);
+
+/**
+ * Copies a cJSON array of rows, e.g. the inline rowset of a query response
+ *
+ * @return rowset or NULL if rows is not an array of arrays or out of memory
+ */
+SF_ROWSET *STDCALL rowset_from_cjson(cJSON *rows);
+
+/**
+ * Copies the rows to a cJSON array of arrays of strings and nulls, which rowset_from_cjson reads back
+ *
+ * @return array or NULL if out of memory
+ */
+cJSON *STDCALL rowset_to_cjson(const SF_ROWSET *rowset);
+
+/**
+ * Memory for the strings formatted from the values of the current row, e.g. dates. A string keeps its address
+ * until the scratch is reset for the next row, so the scratch grows by blocks rather than by realloc.
+ */
+typedef struct SF_ROW_SCRATCH_BLOCK {
+    struct SF_ROW_SCRATCH_BLOCK *next;
+    size_t size;
+    size_t used;
+} SF_ROW_SCRATCH_BLOCK;
+
+typedef struct SF_ROW_SCRATCH {
+    // Block strings are taken from, followed by the ones filled earlier in the row
+    SF_ROW_SCRATCH_BLOCK *blocks;
+} SF_ROW_SCRATCH;
+
+SF_ROW_SCRATCH *STDCALL row_scratch_init(void);
+void STDCALL row_scratch_term(SF_ROW_SCRATCH *scratch);
+
+/**
+ * Room for a string of up to size bytes, which row_scratch_commit then takes
+ *
+ * @return NULL if out of memory
+ */
+char *STDCALL row_scratch_reserve(SF_ROW_SCRATCH *scratch, size_t size);
+
+/**
+ * Takes the first size bytes of the room row_scratch_reserve made
+ */
+void STDCALL row_scratch_commit(SF_ROW_SCRATCH *scratch, size_t size);
+
+/**
+ * Drops the strings of the row. Keeps the largest block, so rows like the ones before need no allocation.
+ */
+void STDCALL row_scratch_reset(SF_ROW_SCRATCH *scratch);
+
+/**
+ * Number of cells in a row
+ */
+static inline size_t rowset_row_size(const SF_ROWSET *rowset, int64 row) {
+    return rowset->row_starts[row + 1] - rowset->row_starts[row];
+}
+
+/**
+ * Cell of a row or NULL if the row has no such column
+ */
+static inline const SF_ROWSET_CELL *rowset_cell(const SF_ROWSET *rowset, int64 row, size_t column) {
+    if (row < 0 || row >= rowset->row_count || column >= rowset_row_size(rowset, row)) {
+        return NULL;
+    }
+    return &rowset->cells[rowset->row_starts[row] + column];
+}
+
+/**
+ * NUL terminated value of a cell. Empty for a null cell.
+ */
+static inline const char *rowset_cell_value(const SF_ROWSET *rowset, const SF_ROWSET_CELL *cell) {
+    return rowset->arena + cell->offset;
+}
+
+/**
+ * Value decoded for a cell, NULL for a null cell.
+ *
+ * @return SF_BOOLEAN_FALSE if the column wasn't decoded as c_type or the value has to be read from the text
+ */
+static inline sf_bool rowset_decoded_value(const SF_ROWSET *rowset, int64 row, size_t column, SF_C_TYPE c_type,
+                                           const SF_ROWSET_VALUE **value) {
+    const SF_ROWSET_COLUMN *decoded;
+    uint8 mask = (uint8) (1 << (row & 7));
+
+    if (column >= rowset->column_count || row < 0 || row >= rowset->row_count) {
+        return SF_BOOLEAN_FALSE;
+    }
+    decoded = &rowset->columns[column];
+    if (decoded->c_type != c_type || c_type == SF_C_TYPE_NULL || row >= decoded->row_count) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (decoded->nulls[row >> 3] & mask) {
+        *value = NULL;
+        return SF_BOOLEAN_TRUE;
+    }
+    if (!(decoded->decoded[row >> 3] & mask)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    *value = &decoded->values[row];
+    return SF_BOOLEAN_TRUE;
+}
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_ROWSET_H
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <string.h>
+#include "rowset_parser.h"
+#include "memory.h"
+
+#define ROWSET_MIN_VALUE_SIZE 64
+
+#define IS_WHITESPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+#define IS_LITERAL(c) (((c) >= '0' && (c) <= '9') || ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || \
+                       (c) == '-' || (c) == '+' || (c) == '.')
+
+static sf_bool STDCALL parser_error(SF_ROWSET_PARSER *parser, const char *msg) {
+    if (!parser->error_msg) {
+        parser->error_msg = msg;
+    }
+    return SF_BOOLEAN_FALSE;
+}
+
+static sf_bool STDCALL value_append(SF_ROWSET_PARSER *parser, const char *data, size_t len) {
+    size_t size = parser->value_size;
+    char *value;
+
+    if (parser->value_len + len + 1 > size) {
+        if (size < ROWSET_MIN_VALUE_SIZE) {
+            size = ROWSET_MIN_VALUE_SIZE;
+        }
+        while (parser->value_len + len + 1 > size) {
+            size *= 2;
+        }
+        value = (char *) SF_REALLOC(parser->value, size);
+        if (!value) {
+            return parser_error(parser, "Out of memory parsing rowset");
+        }
+        parser->value = value;
+        parser->value_size = size;
+    }
+    memcpy(parser->value + parser->value_len, data, len);
+    parser->value_len += len;
+    parser->value[parser->value_len] = '\0';
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL value_append_utf8(SF_ROWSET_PARSER *parser, uint32 code_point) {
+    char utf8[4];
+    size_t len;
+
+    if (code_point < 0x80) {
+        utf8[0] = (char) code_point;
+        len = 1;
+    } else if (code_point < 0x800) {
+        utf8[0] = (char) (0xC0 | (code_point >> 6));
+        utf8[1] = (char) (0x80 | (code_point & 0x3F));
+        len = 2;
+    } else if (code_point < 0x10000) {
+        utf8[0] = (char) (0xE0 | (code_point >> 12));
+        utf8[1] = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        utf8[2] = (char) (0x80 | (code_point & 0x3F));
+        len = 3;
+    } else {
+        utf8[0] = (char) (0xF0 | (code_point >> 18));
+        utf8[1] = (char) (0x80 | ((code_point >> 12) & 0x3F));
+        utf8[2] = (char) (0x80 | ((code_point >> 6) & 0x3F));
+        utf8[3] = (char) (0x80 | (code_point & 0x3F));
+        len = 4;
+    }
+    return value_append(parser, utf8, len);
+}
+
+/**
+ * Decodes a complete \uXXXX escape. A high surrogate is kept until the low surrogate escape that must follow it.
+ */
+static sf_bool STDCALL end_unicode_escape(SF_ROWSET_PARSER *parser) {
+    uint32 code_point = parser->code_point;
+
+    if (parser->high_surrogate) {
+        if (code_point < 0xDC00 || code_point > 0xDFFF) {
+            return parser_error(parser, "Invalid low surrogate in rowset string");
+        }
+        code_point = 0x10000 + ((parser->high_surrogate - 0xD800) << 10) + (code_point - 0xDC00);
+        parser->high_surrogate = 0;
+    } else if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+        parser->high_surrogate = code_point;
+        return SF_BOOLEAN_TRUE;
+    } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+        return parser_error(parser, "Unexpected low surrogate in rowset string");
+    }
+    return value_append_utf8(parser, code_point);
+}
+
+/**
+ * Checks that an unquoted token is true, false or a JSON number
+ */
+static sf_bool STDCALL is_valid_literal(const char *value, size_t len) {
+    size_t i = 0;
+    size_t digits;
+
+    if ((len == 4 && memcmp(value, "true", 4) == 0) || (len == 5 && memcmp(value, "false", 5) == 0)) {
+        return SF_BOOLEAN_TRUE;
+    }
+    if (i < len && value[i] == '-') {
+        i++;
+    }
+    for (digits = 0; i < len && value[i] >= '0' && value[i] <= '9'; digits++) {
+        i++;
+    }
+    if (digits == 0) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (i < len && value[i] == '.') {
+        for (i++, digits = 0; i < len && value[i] >= '0' && value[i] <= '9'; digits++) {
+            i++;
+        }
+        if (digits == 0) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+    if (i < len && (value[i] == 'e' || value[i] == 'E')) {
+        i++;
+        if (i < len && (value[i] == '+' || value[i] == '-')) {
+            i++;
+        }
+        for (digits = 0; i < len && value[i] >= '0' && value[i] <= '9'; digits++) {
+            i++;
+        }
+        if (digits == 0) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+    return i == len;
+}
+
+static sf_bool STDCALL add_cell(SF_ROWSET_PARSER *parser, SF_ROWSET_CELL_TYPE type) {
+    // The sink always gets a NUL terminated value, even if it is empty
+    if (!parser->value && !value_append(parser, "", 0)) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (type == SF_ROWSET_CELL_LITERAL && parser->value_len == 4 && memcmp(parser->value, "null", 4) == 0) {
+        type = SF_ROWSET_CELL_NULL;
+        parser->value_len = 0;
+        parser->value[0] = '\0';
+    } else if (type == SF_ROWSET_CELL_LITERAL && !is_valid_literal(parser->value, parser->value_len)) {
+        return parser_error(parser, "Invalid literal in rowset");
+    }
+    if (!parser->sink.add_cell(parser->sink.ctx, type, parser->value, parser->value_len)) {
+        return parser_error(parser, "Unable to add cell");
+    }
+    parser->value_len = 0;
+    parser->state = ROWSET_AFTER_VALUE;
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL end_row(SF_ROWSET_PARSER *parser) {
+    if (!parser->sink.end_row(parser->sink.ctx)) {
+        return parser_error(parser, "Unable to add row");
+    }
+    parser->row_count++;
+    parser->state = ROWSET_AFTER_ROW;
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL rowset_parser_init(SF_ROWSET_PARSER *parser, const SF_ROWSET_SINK *sink) {
+    memset(parser, 0, sizeof(SF_ROWSET_PARSER));
+    parser->sink = *sink;
+    parser->state = ROWSET_START;
+}
+
+sf_bool STDCALL rowset_parser_feed(SF_ROWSET_PARSER *parser, const char *data, size_t len) {
+    size_t i = 0;
+    size_t start;
+    char c;
+
+    if (parser->error_msg) {
+        return SF_BOOLEAN_FALSE;
+    }
+
+    while (i < len) {
+        c = data[i];
+        switch (parser->state) {
+            case ROWSET_START:
+            case ROWSET_EXPECT_ROW:
+                if (c == '[') {
+                    if (!parser->sink.begin_row(parser->sink.ctx)) {
+                        return parser_error(parser, "Unable to add row");
+                    }
+                    parser->state = ROWSET_ROW_START;
+                } else if (!IS_WHITESPACE(c)) {
+                    return parser_error(parser, "Expected the start of a row in rowset");
+                }
+                i++;
+                break;
+
+            case ROWSET_AFTER_ROW:
+                if (c == ',') {
+                    parser->state = ROWSET_EXPECT_ROW;
+                } else if (!IS_WHITESPACE(c)) {
+                    return parser_error(parser, "Expected a comma after a row in rowset");
+                }
+                i++;
+                break;
+
+            case ROWSET_ROW_START:
+                if (c == ']') {
+                    if (!end_row(parser)) {
+                        return SF_BOOLEAN_FALSE;
+                    }
+                    i++;
+                    break;
+                }
+                // Fall through, the row has at least one value
+            case ROWSET_EXPECT_VALUE:
+                if (c == '"') {
+                    parser->state = ROWSET_IN_STRING;
+                    i++;
+                } else if (IS_LITERAL(c)) {
+                    // The literal state consumes the character
+                    parser->state = ROWSET_IN_LITERAL;
+                } else if (c == '[' || c == '{') {
+                    return parser_error(parser, "Nested values are not supported in rowset");
+                } else if (IS_WHITESPACE(c)) {
+                    i++;
+                } else {
+                    return parser_error(parser, "Expected a value in rowset");
+                }
+                break;
+
+            case ROWSET_AFTER_VALUE:
+                if (c == ',') {
+                    parser->state = ROWSET_EXPECT_VALUE;
+                } else if (c == ']') {
+                    if (!end_row(parser)) {
+                        return SF_BOOLEAN_FALSE;
+                    }
+                } else if (!IS_WHITESPACE(c)) {
+                    return parser_error(parser, "Expected a comma or the end of a row in rowset");
+                }
+                i++;
+                break;
+
+            case ROWSET_IN_STRING:
+                if (parser->high_surrogate) {
+                    if (c != '\\') {
+                        return parser_error(parser, "Missing low surrogate in rowset string");
+                    }
+                    parser->state = ROWSET_IN_ESCAPE;
+                    i++;
+                    break;
+                }
+                // Copy everything up to the closing quote or the next escape at once
+                start = i;
+                while (i < len && data[i] != '"' && data[i] != '\\') {
+                    i++;
+                }
+                if (i > start && !value_append(parser, data + start, i - start)) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                if (i < len) {
+                    if (data[i] == '"') {
+                        if (!add_cell(parser, SF_ROWSET_CELL_STRING)) {
+                            return SF_BOOLEAN_FALSE;
+                        }
+                    } else {
+                        parser->state = ROWSET_IN_ESCAPE;
+                    }
+                    i++;
+                }
+                break;
+
+            case ROWSET_IN_ESCAPE:
+                if (parser->high_surrogate && c != 'u') {
+                    return parser_error(parser, "Missing low surrogate in rowset string");
+                }
+                parser->state = ROWSET_IN_STRING;
+                switch (c) {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        break;
+                    case 'b':
+                        c = '\b';
+                        break;
+                    case 'f':
+                        c = '\f';
+                        break;
+                    case 'n':
+                        c = '\n';
+                        break;
+                    case 'r':
+                        c = '\r';
+                        break;
+                    case 't':
+                        c = '\t';
+                        break;
+                    case 'u':
+                        parser->code_point = 0;
+                        parser->hex_digits = 0;
+                        parser->state = ROWSET_IN_UNICODE;
+                        break;
+                    default:
+                        return parser_error(parser, "Invalid escape sequence in rowset string");
+                }
+                if (parser->state == ROWSET_IN_STRING && !value_append(parser, &c, 1)) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                i++;
+                break;
+
+            case ROWSET_IN_UNICODE:
+                if (c >= '0' && c <= '9') {
+                    parser->code_point = parser->code_point * 16 + (uint32) (c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    parser->code_point = parser->code_point * 16 + (uint32) (c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    parser->code_point = parser->code_point * 16 + (uint32) (c - 'A' + 10);
+                } else {
+                    return parser_error(parser, "Invalid unicode escape in rowset string");
+                }
+                if (++parser->hex_digits == 4) {
+                    if (!end_unicode_escape(parser)) {
+                        return SF_BOOLEAN_FALSE;
+                    }
+                    parser->state = ROWSET_IN_STRING;
+                }
+                i++;
+                break;
+
+            case ROWSET_IN_LITERAL:
+                start = i;
+                while (i < len && IS_LITERAL(data[i])) {
+                    i++;
+                }
+                if (i > start && !value_append(parser, data + start, i - start)) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                // The delimiter is handled in the next state
+                if (i < len && !add_cell(parser, SF_ROWSET_CELL_LITERAL)) {
+                    return SF_BOOLEAN_FALSE;
+                }
+                break;
+        }
+    }
+
+    return SF_BOOLEAN_TRUE;
+}
+
+sf_bool STDCALL rowset_parser_finish(SF_ROWSET_PARSER *parser) {
+    if (parser->error_msg) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (parser->state != ROWSET_START && parser->state != ROWSET_AFTER_ROW) {
+        return parser_error(parser, "Unexpected end of rowset");
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+void STDCALL rowset_parser_reset(SF_ROWSET_PARSER *parser) {
+    parser->state = ROWSET_START;
+    parser->value_len = 0;
+    parser->code_point = 0;
+    parser->hex_digits = 0;
+    parser->high_surrogate = 0;
+    parser->row_count = 0;
+    parser->error_msg = NULL;
+    if (parser->sink.reset) {
+        parser->sink.reset(parser->sink.ctx);
+    }
+}
+
+void STDCALL rowset_parser_term(SF_ROWSET_PARSER *parser) {
+    SF_FREE(parser->value);
+    parser->value_len = 0;
+    parser->value_size = 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_ROWSET_PARSER_H
+#define SNOWFLAKE_ROWSET_PARSER_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+#include "snowflake/client.h"
+
+union SF_ROWSET_VALUE;
+
+typedef enum SF_ROWSET_CELL_TYPE {
+    SF_ROWSET_CELL_NULL,
+    SF_ROWSET_CELL_STRING,
+    // Unquoted token other than null, e.g. a number or a boolean
+    SF_ROWSET_CELL_LITERAL
+} SF_ROWSET_CELL_TYPE;
+
+/**
+ * Receives the rows of a rowset as they are parsed, from either a JSON rowset or an Arrow stream
+ */
+typedef struct SF_ROWSET_SINK {
+    void *ctx;
+    sf_bool (*begin_row)(void *ctx);
+    /**
+     * value has len bytes, is not necessarily NUL terminated and is only valid during the call.
+     * It is empty for SF_ROWSET_CELL_NULL.
+     */
+    sf_bool (*add_cell)(void *ctx, SF_ROWSET_CELL_TYPE type, const char *value, size_t len);
+    sf_bool (*end_row)(void *ctx);
+    /**
+     * Optional. Native value of the cell just added, so it needn't be parsed from the text, e.g. an Arrow
+     * integer. value is NULL for a null cell or a value only the text has. A value the sink can't keep
+     * is read from the text.
+     */
+    void (*add_decoded)(void *ctx, size_t column, SF_C_TYPE c_type, const union SF_ROWSET_VALUE *value);
+    // Drops all the rows received so far
+    void (*reset)(void *ctx);
+} SF_ROWSET_SINK;
+
+typedef enum SF_ROWSET_PARSER_STATE {
+    ROWSET_START,
+    ROWSET_EXPECT_ROW,
+    ROWSET_AFTER_ROW,
+    ROWSET_ROW_START,
+    ROWSET_EXPECT_VALUE,
+    ROWSET_AFTER_VALUE,
+    ROWSET_IN_STRING,
+    ROWSET_IN_ESCAPE,
+    ROWSET_IN_UNICODE,
+    ROWSET_IN_LITERAL
+} SF_ROWSET_PARSER_STATE;
+
+/**
+ * Incremental parser of the rows of a result chunk, which is a comma separated list of JSON arrays of
+ * strings and nulls without the enclosing brackets. The input can be split at any byte.
+ */
+typedef struct SF_ROWSET_PARSER {
+    SF_ROWSET_PARSER_STATE state;
+    SF_ROWSET_SINK sink;
+
+    // Value of the current cell. Reused from cell to cell
+    char *value;
+    size_t value_len;
+    size_t value_size;
+
+    // \uXXXX escape being decoded
+    uint32 code_point;
+    int hex_digits;
+    uint32 high_surrogate;
+
+    int64 row_count;
+    uint64 bytes_parsed;
+    // Static message, NULL unless parsing failed
+    const char *error_msg;
+} SF_ROWSET_PARSER;
+
+void STDCALL rowset_parser_init(SF_ROWSET_PARSER *parser, const SF_ROWSET_SINK *sink);
+
+/**
+ * Parses the next part of the rowset and passes all the completed cells and rows to the sink.
+ *
+ * @return SF_BOOLEAN_FALSE if the input is malformed or the sink failed. See error_msg.
+ */
+sf_bool STDCALL rowset_parser_feed(SF_ROWSET_PARSER *parser, const char *data, size_t len);
+
+/**
+ * Checks that the rowset ended after a complete row.
+ */
+sf_bool STDCALL rowset_parser_finish(SF_ROWSET_PARSER *parser);
+
+/**
+ * Starts over with a new rowset and resets the sink.
+ */
+void STDCALL rowset_parser_reset(SF_ROWSET_PARSER *parser);
+
+void STDCALL rowset_parser_term(SF_ROWSET_PARSER *parser);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_ROWSET_PARSER_H
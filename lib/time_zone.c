@@ -0,0 +1,498 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "time_zone.h"
+#include "calendar.h"
+#include "memory.h"
+#include "snowflake/logger.h"
+
+#ifndef _WIN32
+#define TIME_ZONE_DEFAULT_DIR "/usr/share/zoneinfo"
+#endif
+
+// Zone names come from the sessions, so only a handful is expected
+#define TIME_ZONE_MAX_CACHED 256
+#define TIME_ZONE_MAX_PATH 1024
+
+#define TZIF_HEADER_SIZE 44
+#define TZIF_MAX_TYPES 256
+
+#define TIME_ZONE_SECONDS_PER_HOUR 3600
+// TZ string rule times are within +-167 hours, offsets within +-24 hours
+#define RULE_MAX_HOURS 167
+#define OFFSET_MAX_HOURS 24
+
+// Head of the list of loaded zones. Zones are only ever pushed while the cache is up, so readers walk the
+// list without a lock and the mutex only serializes the pushes.
+static SF_ATOMIC_INT64 zone_cache;
+static SF_ATOMIC_INT64 zone_cache_count;
+static SF_MUTEX_HANDLE zone_cache_lock;
+
+static SF_TIME_ZONE *STDCALL cache_head(void) {
+    return (SF_TIME_ZONE *) (intptr_t) _atomic_load(&zone_cache);
+}
+
+static int64 STDCALL floor_div(int64 value, int64 divisor) {
+    int64 quotient = value / divisor;
+    return (value % divisor < 0) ? quotient - 1 : quotient;
+}
+
+/**
+ * UTC time a TZ string rule changes the offset at in a year, given the offset in effect before the change
+ */
+static int64 STDCALL rule_change(const SF_TIME_ZONE_RULE *rule, int64 year, int32 utc_offset) {
+    int64 days = sf_days_from_civil(year, 1, 1);
+    int64 first;
+    int32 day;
+
+    if (rule->kind == 'J') {
+        days += rule->day - 1 + (rule->day >= 60 && sf_is_leap_year(year));
+    } else if (rule->kind == 'D') {
+        days += rule->day;
+    } else {
+        first = sf_days_from_civil(year, rule->month, 1);
+        day = (rule->day - sf_weekday_from_days(first) + 7) % 7 + (rule->week - 1) * 7;
+        // Week 5 is the last one
+        while (day >= sf_days_in_month(year, rule->month)) {
+            day -= 7;
+        }
+        days = first + day;
+    }
+    return days * SF_SECONDS_PER_DAY + rule->time - utc_offset;
+}
+
+static int32 STDCALL rule_offset(const SF_TIME_ZONE *zone, int64 utc_seconds, sf_bool *is_dst) {
+    int64 year;
+    int32 month;
+    int32 day;
+    int64 start;
+    int64 end;
+    sf_bool dst;
+
+    if (!zone->has_dst) {
+        *is_dst = SF_BOOLEAN_FALSE;
+        return zone->std_offset;
+    }
+    sf_civil_from_days(floor_div(utc_seconds + zone->std_offset, SF_SECONDS_PER_DAY), &year, &month, &day);
+    start = rule_change(&zone->dst_start, year, zone->std_offset);
+    end = rule_change(&zone->dst_end, year, zone->dst_offset);
+    // Daylight saving time spans the new year in the southern hemisphere
+    dst = start < end ? (utc_seconds >= start && utc_seconds < end) : (utc_seconds >= start || utc_seconds < end);
+    *is_dst = dst;
+    return dst ? zone->dst_offset : zone->std_offset;
+}
+
+int32 STDCALL sf_time_zone_offset(const SF_TIME_ZONE *zone, int64 utc_seconds, sf_bool *is_dst) {
+    const SF_TIME_ZONE_TYPE *type;
+    sf_bool dst;
+    size_t low;
+    size_t high;
+    size_t middle;
+    size_t i;
+
+    if (!is_dst) {
+        is_dst = &dst;
+    }
+    if (zone->has_rule &&
+        (zone->transition_count == 0 || utc_seconds >= zone->transitions[zone->transition_count - 1])) {
+        return rule_offset(zone, utc_seconds, is_dst);
+    }
+
+    if (zone->transition_count == 0 || utc_seconds < zone->transitions[0]) {
+        // Like libc, the first standard time type is in effect before the first transition
+        for (i = 0; i < zone->type_count && zone->types[i].is_dst; i++) {}
+        type = &zone->types[i < zone->type_count ? i : 0];
+    } else {
+        // Last transition at or before the time
+        low = 0;
+        high = zone->transition_count;
+        while (high - low > 1) {
+            middle = low + (high - low) / 2;
+            if (zone->transitions[middle] <= utc_seconds) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        type = &zone->types[zone->transition_types[low]];
+    }
+    *is_dst = type->is_dst;
+    return type->utc_offset;
+}
+
+/**
+ * Reads a number of at most max_digits digits
+ *
+ * @return position after the number, or NULL if there is none
+ */
+static const char *STDCALL parse_number(const char *str, int32 max_digits, int32 *value) {
+    int32 digits = 0;
+
+    *value = 0;
+    while (*str >= '0' && *str <= '9' && digits < max_digits) {
+        *value = *value * 10 + (*str - '0');
+        str++;
+        digits++;
+    }
+    return digits > 0 ? str : NULL;
+}
+
+/**
+ * Reads [+|-]hh[:mm[:ss]] into seconds
+ */
+static const char *STDCALL parse_time(const char *str, int32 max_hours, int32 *seconds) {
+    int32 sign = 1;
+    int32 hours;
+    int32 minutes = 0;
+    int32 secs = 0;
+
+    if (*str == '+' || *str == '-') {
+        sign = *str == '-' ? -1 : 1;
+        str++;
+    }
+    if (!(str = parse_number(str, 3, &hours)) || hours > max_hours) {
+        return NULL;
+    }
+    if (*str == ':') {
+        if (!(str = parse_number(str + 1, 2, &minutes)) || minutes > 59) {
+            return NULL;
+        }
+        if (*str == ':') {
+            if (!(str = parse_number(str + 1, 2, &secs)) || secs > 59) {
+                return NULL;
+            }
+        }
+    }
+    *seconds = sign * (hours * TIME_ZONE_SECONDS_PER_HOUR + minutes * 60 + secs);
+    return str;
+}
+
+/**
+ * Reads a zone abbreviation, either three or more letters or <[+|-]alphanumerics>
+ */
+static const char *STDCALL parse_abbreviation(const char *str) {
+    const char *start;
+
+    if (*str == '<') {
+        start = ++str;
+        while ((*str >= 'A' && *str <= 'Z') || (*str >= 'a' && *str <= 'z') || (*str >= '0' && *str <= '9') ||
+               *str == '+' || *str == '-') {
+            str++;
+        }
+        return *str == '>' && str - start >= 3 ? str + 1 : NULL;
+    }
+    start = str;
+    while ((*str >= 'A' && *str <= 'Z') || (*str >= 'a' && *str <= 'z')) {
+        str++;
+    }
+    return str - start >= 3 ? str : NULL;
+}
+
+/**
+ * Reads Jn, n or Mm.w.d[/time]
+ */
+static const char *STDCALL parse_rule(const char *str, SF_TIME_ZONE_RULE *rule) {
+    rule->day = 0;
+    rule->week = 0;
+    rule->month = 0;
+    rule->time = 2 * TIME_ZONE_SECONDS_PER_HOUR;
+    if (*str == 'J') {
+        rule->kind = 'J';
+        if (!(str = parse_number(str + 1, 3, &rule->day)) || rule->day < 1 || rule->day > 365) {
+            return NULL;
+        }
+    } else if (*str == 'M') {
+        rule->kind = 'M';
+        if (!(str = parse_number(str + 1, 2, &rule->month)) || rule->month < 1 || rule->month > 12 ||
+            *str != '.' || !(str = parse_number(str + 1, 1, &rule->week)) || rule->week < 1 || rule->week > 5 ||
+            *str != '.' || !(str = parse_number(str + 1, 1, &rule->day)) || rule->day > 6) {
+            return NULL;
+        }
+    } else {
+        rule->kind = 'D';
+        if (!(str = parse_number(str, 3, &rule->day)) || rule->day > 365) {
+            return NULL;
+        }
+    }
+    if (*str == '/') {
+        str = parse_time(str + 1, RULE_MAX_HOURS, &rule->time);
+    }
+    return str;
+}
+
+/**
+ * Reads a POSIX TZ string, std offset[dst[offset][,start[/time],end[/time]]]. Offsets in it are west of UTC.
+ */
+static sf_bool STDCALL parse_tz_string(SF_TIME_ZONE *zone, const char *str) {
+    int32 offset;
+
+    if (!(str = parse_abbreviation(str)) || !(str = parse_time(str, OFFSET_MAX_HOURS, &offset))) {
+        return SF_BOOLEAN_FALSE;
+    }
+    zone->has_rule = SF_BOOLEAN_TRUE;
+    zone->std_offset = -offset;
+    zone->dst_offset = zone->std_offset;
+    zone->has_dst = SF_BOOLEAN_FALSE;
+    if (*str == '\0') {
+        return SF_BOOLEAN_TRUE;
+    }
+
+    if (!(str = parse_abbreviation(str))) {
+        return SF_BOOLEAN_FALSE;
+    }
+    zone->has_dst = SF_BOOLEAN_TRUE;
+    zone->dst_offset = zone->std_offset + TIME_ZONE_SECONDS_PER_HOUR;
+    if (*str != ',' && *str != '\0') {
+        if (!(str = parse_time(str, OFFSET_MAX_HOURS, &offset))) {
+            return SF_BOOLEAN_FALSE;
+        }
+        zone->dst_offset = -offset;
+    }
+    if (*str == '\0') {
+        // The US rules, which libc assumes without a posixrules file too
+        str = ",M3.2.0,M11.1.0";
+    }
+    if (*str != ',' || !(str = parse_rule(str + 1, &zone->dst_start)) ||
+        *str != ',' || !(str = parse_rule(str + 1, &zone->dst_end))) {
+        return SF_BOOLEAN_FALSE;
+    }
+    return *str == '\0';
+}
+
+static uint32 STDCALL read_uint32(const unsigned char *data) {
+    return ((uint32) data[0] << 24) | ((uint32) data[1] << 16) | ((uint32) data[2] << 8) | (uint32) data[3];
+}
+
+static int64 STDCALL read_int64(const unsigned char *data) {
+    return (int64) (((uint64) read_uint32(data) << 32) | (uint64) read_uint32(data + 4));
+}
+
+/**
+ * Reads a TZif file, RFC 8536. Files of version 2 and later repeat the data with 64 bit times after the
+ * version 1 data, followed by the TZ string for the times after the last transition.
+ */
+static sf_bool STDCALL parse_tzif(SF_TIME_ZONE *zone, const unsigned char *data, size_t len) {
+    const unsigned char *header = data;
+    const unsigned char *end = data + len;
+    const unsigned char *footer;
+    const unsigned char *footer_end;
+    size_t time_size = 4;
+    size_t counts[6];
+    size_t block_size;
+    size_t i;
+    char *rule = NULL;
+    sf_bool ret = SF_BOOLEAN_FALSE;
+
+    for (;;) {
+        if ((size_t) (end - header) < TZIF_HEADER_SIZE || memcmp(header, "TZif", 4) != 0) {
+            goto cleanup;
+        }
+        // isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt
+        for (i = 0; i < 6; i++) {
+            counts[i] = read_uint32(header + 20 + 4 * i);
+        }
+        block_size = counts[3] * time_size + counts[3] + counts[4] * 6 + counts[5] +
+                     counts[2] * (time_size + 4) + counts[1] + counts[0];
+        if (counts[4] == 0 || counts[4] > TZIF_MAX_TYPES || block_size > (size_t) (end - header) - TZIF_HEADER_SIZE) {
+            goto cleanup;
+        }
+        if (time_size == 8 || header[4] < '2') {
+            break;
+        }
+        header += TZIF_HEADER_SIZE + block_size;
+        time_size = 8;
+    }
+
+    data = header + TZIF_HEADER_SIZE;
+    zone->transition_count = counts[3];
+    zone->type_count = counts[4];
+    zone->transitions = (int64 *) SF_CALLOC(zone->transition_count + 1, sizeof(int64));
+    zone->transition_types = (uint8 *) SF_CALLOC(zone->transition_count + 1, sizeof(uint8));
+    zone->types = (SF_TIME_ZONE_TYPE *) SF_CALLOC(zone->type_count, sizeof(SF_TIME_ZONE_TYPE));
+    if (!zone->transitions || !zone->transition_types || !zone->types) {
+        goto cleanup;
+    }
+    for (i = 0; i < zone->transition_count; i++) {
+        zone->transitions[i] = time_size == 8 ? read_int64(data) : (int64) (int32) read_uint32(data);
+        data += time_size;
+    }
+    for (i = 0; i < zone->transition_count; i++) {
+        zone->transition_types[i] = data[i];
+        if (data[i] >= zone->type_count) {
+            goto cleanup;
+        }
+    }
+    data += zone->transition_count;
+    for (i = 0; i < zone->type_count; i++) {
+        zone->types[i].utc_offset = (int32) read_uint32(data);
+        zone->types[i].is_dst = data[4] != 0;
+        data += 6;
+    }
+
+    // Version 1 files end with the data, later ones with the TZ string between new lines
+    footer = header + TZIF_HEADER_SIZE + block_size;
+    if (time_size == 8 && footer < end && *footer == '\n') {
+        footer++;
+        footer_end = (const unsigned char *) memchr(footer, '\n', (size_t) (end - footer));
+        if (footer_end && footer_end > footer) {
+            rule = (char *) SF_CALLOC(1, (size_t) (footer_end - footer) + 1);
+            if (!rule) {
+                goto cleanup;
+            }
+            memcpy(rule, footer, (size_t) (footer_end - footer));
+            if (!parse_tz_string(zone, rule)) {
+                log_warn("Ignoring the invalid rule %s of the time zone %s", rule, zone->name);
+                zone->has_rule = SF_BOOLEAN_FALSE;
+            }
+        }
+    }
+    ret = SF_BOOLEAN_TRUE;
+
+cleanup:
+    SF_FREE(rule);
+    return ret;
+}
+
+static void STDCALL free_time_zone(SF_TIME_ZONE *zone) {
+    if (zone) {
+        SF_FREE(zone->name);
+        SF_FREE(zone->transitions);
+        SF_FREE(zone->transition_types);
+        SF_FREE(zone->types);
+        SF_FREE(zone);
+    }
+}
+
+/**
+ * Reads the zone file of a tz database name
+ */
+static sf_bool STDCALL load_zone_file(SF_TIME_ZONE *zone, const char *name) {
+    char path[TIME_ZONE_MAX_PATH];
+    const char *dir = sf_getenv("TZDIR");
+    SF_MAPPED_FILE file;
+    sf_bool ret;
+
+#ifdef TIME_ZONE_DEFAULT_DIR
+    if (!dir || !*dir) {
+        dir = TIME_ZONE_DEFAULT_DIR;
+    }
+#endif
+    // A name can't leave the zone directory
+    if (*name == '\0' || strstr(name, "..") || (*name != '/' && (!dir || !*dir))) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (*name == '/') {
+        sb_strcpy(path, sizeof(path), name);
+    } else {
+        sb_sprintf(path, sizeof(path), "%s/%s", dir, name);
+    }
+    if (sf_map_file(path, &file) != 0) {
+        return SF_BOOLEAN_FALSE;
+    }
+    ret = file.data != NULL && parse_tzif(zone, (const unsigned char *) file.data, file.len);
+    sf_unmap_file(&file);
+    return ret;
+}
+
+static SF_TIME_ZONE *STDCALL load_time_zone(const char *name) {
+    SF_TIME_ZONE *zone = (SF_TIME_ZONE *) SF_CALLOC(1, sizeof(SF_TIME_ZONE));
+    const char *spec = name;
+
+    if (!zone) {
+        return NULL;
+    }
+    zone->name = (char *) SF_CALLOC(1, strlen(name) + 1);
+    if (!zone->name) {
+        SF_FREE(zone);
+        return NULL;
+    }
+    sb_strcpy(zone->name, strlen(name) + 1, name);
+
+    // Like libc, TZ=:name names a file and an empty TZ is UTC
+    if (*spec == ':') {
+        spec++;
+    }
+    if (*spec == '\0') {
+        zone->is_valid = parse_tz_string(zone, "UTC0");
+    } else if (load_zone_file(zone, spec)) {
+        zone->is_valid = SF_BOOLEAN_TRUE;
+    } else {
+        SF_FREE(zone->transitions);
+        SF_FREE(zone->transition_types);
+        SF_FREE(zone->types);
+        zone->transition_count = 0;
+        zone->type_count = 0;
+        zone->has_rule = SF_BOOLEAN_FALSE;
+        zone->is_valid = parse_tz_string(zone, spec);
+    }
+    if (!zone->is_valid) {
+        log_debug("Time zone %s is converted by libc", name);
+    }
+    return zone;
+}
+
+void STDCALL sf_time_zone_cache_init(void) {
+    _mutex_init(&zone_cache_lock);
+    _atomic_store(&zone_cache, 0);
+    _atomic_store(&zone_cache_count, 0);
+}
+
+void STDCALL sf_time_zone_cache_term(void) {
+    SF_TIME_ZONE *zone = cache_head();
+    SF_TIME_ZONE *next;
+
+    while (zone) {
+        next = zone->next;
+        free_time_zone(zone);
+        zone = next;
+    }
+    _atomic_store(&zone_cache, 0);
+    _atomic_store(&zone_cache_count, 0);
+    _mutex_term(&zone_cache_lock);
+}
+
+static SF_TIME_ZONE *STDCALL find_cached(const char *name) {
+    SF_TIME_ZONE *zone;
+
+    for (zone = cache_head(); zone; zone = zone->next) {
+        if (strcmp(zone->name, name) == 0) {
+            return zone;
+        }
+    }
+    return NULL;
+}
+
+const SF_TIME_ZONE *STDCALL sf_time_zone_get(const char *name) {
+    SF_TIME_ZONE *zone;
+    SF_TIME_ZONE *loaded;
+
+    if (!name) {
+        return NULL;
+    }
+    zone = find_cached(name);
+    if (!zone) {
+        // Loaded outside the lock, so a slow disk doesn't hold up the other threads
+        loaded = load_time_zone(name);
+        if (!loaded) {
+            return NULL;
+        }
+        _mutex_lock(&zone_cache_lock);
+        zone = find_cached(name);
+        if (!zone && _atomic_load(&zone_cache_count) < TIME_ZONE_MAX_CACHED) {
+            loaded->next = cache_head();
+            _atomic_store(&zone_cache, (long long) (intptr_t) loaded);
+            _atomic_add(&zone_cache_count, 1);
+            zone = loaded;
+            loaded = NULL;
+        }
+        _mutex_unlock(&zone_cache_lock);
+        if (!zone) {
+            log_warn("Time zone cache is full, %s is converted by libc", name);
+        }
+        free_time_zone(loaded);
+    }
+    return zone && zone->is_valid ? zone : NULL;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_TIME_ZONE_H
+#define SNOWFLAKE_TIME_ZONE_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+
+/**
+ * Day of the year a POSIX TZ rule changes between standard and daylight saving time on
+ */
+typedef struct SF_TIME_ZONE_RULE {
+    // 'J' for Jn (1 based, February 29 never counted), 'D' for n (0 based) or 'M' for Mm.w.d
+    char kind;
+    int32 day;
+    int32 week;
+    int32 month;
+    // Local time of the change in seconds after midnight, may be negative or more than a day
+    int32 time;
+} SF_TIME_ZONE_RULE;
+
+typedef struct SF_TIME_ZONE_TYPE {
+    // Seconds east of UTC
+    int32 utc_offset;
+    sf_bool is_dst;
+} SF_TIME_ZONE_TYPE;
+
+/**
+ * Offsets of a time zone over time, from the tz database or a POSIX TZ string. Read only once loaded, so any
+ * number of threads convert times with it without a lock.
+ */
+typedef struct SF_TIME_ZONE {
+    char *name;
+    // The name is neither in the tz database nor a valid TZ string
+    sf_bool is_valid;
+
+    // UTC times the offset changes at, ascending, and the index into types of the offset from then on
+    int64 *transitions;
+    uint8 *transition_types;
+    size_t transition_count;
+    SF_TIME_ZONE_TYPE *types;
+    size_t type_count;
+
+    // TZ string rule for the times after the last transition
+    sf_bool has_rule;
+    sf_bool has_dst;
+    int32 std_offset;
+    int32 dst_offset;
+    SF_TIME_ZONE_RULE dst_start;
+    SF_TIME_ZONE_RULE dst_end;
+
+    struct SF_TIME_ZONE *next;
+} SF_TIME_ZONE;
+
+void STDCALL sf_time_zone_cache_init(void);
+
+void STDCALL sf_time_zone_cache_term(void);
+
+/**
+ * Looks up a time zone by the name the TZ environment variable would take, i.e. a tz database name like
+ * America/New_York or a POSIX TZ string like UTC+05:00 or EST5EDT,M3.2.0,M11.1.0. The zone files are read
+ * from TZDIR or /usr/share/zoneinfo. A zone is loaded once and stays cached until sf_time_zone_cache_term.
+ *
+ * @return the zone, or NULL if the name can't be loaded, in which case libc has to convert times in it
+ */
+const SF_TIME_ZONE *STDCALL sf_time_zone_get(const char *name);
+
+/**
+ * @param is_dst set to whether daylight saving time is in effect, may be NULL
+ * @return seconds east of UTC in the zone at a UTC time
+ */
+int32 STDCALL sf_time_zone_offset(const SF_TIME_ZONE *zone, int64 utc_seconds, sf_bool *is_dst);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_TIME_ZONE_H
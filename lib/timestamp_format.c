@@ -0,0 +1,400 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "timestamp_format.h"
+#include "calendar.h"
+#include "memory.h"
+#include "snowflake/logger.h"
+
+
+static const char *const MONTH_NAMES[12] = {
+    "January", "February", "March", "April", "May", "June", "July", "August", "September", "October",
+    "November", "December"
+};
+
+static const char *const WEEKDAY_NAMES[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+
+static const int32 POW10_INT32[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/**
+ * Format elements, the longer ones first where one starts with another
+ */
+static const struct {
+    const char *name;
+    SF_FORMAT_OPCODE code;
+    // Longest output for the values of years 0 to 9999
+    size_t max_len;
+} ELEMENTS[] = {
+    {"YYYY", SF_FORMAT_YEAR, 4},
+    {"YY", SF_FORMAT_YEAR2, 2},
+    {"MMMM", SF_FORMAT_MONTH_NAME, 9},
+    {"MON", SF_FORMAT_MONTH_ABBREVIATION, 3},
+    {"MM", SF_FORMAT_MONTH, 2},
+    {"MI", SF_FORMAT_MINUTE, 2},
+    {"DD", SF_FORMAT_DAY, 2},
+    {"DY", SF_FORMAT_WEEKDAY_ABBREVIATION, 3},
+    {"HH24", SF_FORMAT_HOUR24, 2},
+    {"HH12", SF_FORMAT_HOUR12, 2},
+    {"HH", SF_FORMAT_HOUR24, 2},
+    {"AM", SF_FORMAT_MERIDIEM, 2},
+    {"PM", SF_FORMAT_MERIDIEM, 2},
+    {"SS", SF_FORMAT_SECOND, 2},
+    {"FF", SF_FORMAT_FRACTION, 9},
+    {"TZH", SF_FORMAT_TZ_HOUR, 3},
+    {"TZM", SF_FORMAT_TZ_MINUTE, 2},
+};
+
+static sf_bool STDCALL starts_with_ignoring_case(const char *str, const char *prefix) {
+    for (; *prefix; str++, prefix++) {
+        if ((*str >= 'a' && *str <= 'z' ? *str - 'a' + 'A' : *str) != *prefix) {
+            return SF_BOOLEAN_FALSE;
+        }
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+static sf_bool STDCALL is_letter(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+static sf_bool STDCALL add_op(SF_TIMESTAMP_FORMAT *compiled, SF_FORMAT_OPCODE code, uint8 digits, size_t max_len) {
+    if (compiled->op_count == SF_FORMAT_MAX_OPS) {
+        return SF_BOOLEAN_FALSE;
+    }
+    compiled->ops[compiled->op_count].code = (uint8) code;
+    compiled->ops[compiled->op_count].digits = digits;
+    compiled->ops[compiled->op_count].offset = 0;
+    compiled->ops[compiled->op_count].length = 0;
+    compiled->op_count++;
+    compiled->max_len += max_len;
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Appends a character to the literal op at the end, or to a new one
+ */
+static sf_bool STDCALL add_literal(SF_TIMESTAMP_FORMAT *compiled, size_t *literals_len, char c) {
+    SF_FORMAT_OP *op = compiled->op_count > 0 ? &compiled->ops[compiled->op_count - 1] : NULL;
+
+    if (*literals_len == SF_FORMAT_MAX_LITERALS) {
+        return SF_BOOLEAN_FALSE;
+    }
+    if (!op || op->code != SF_FORMAT_LITERAL) {
+        if (!add_op(compiled, SF_FORMAT_LITERAL, 0, 0)) {
+            return SF_BOOLEAN_FALSE;
+        }
+        op = &compiled->ops[compiled->op_count - 1];
+        op->offset = (uint32) *literals_len;
+    }
+    compiled->literals[(*literals_len)++] = c;
+    op->length++;
+    compiled->max_len++;
+    return SF_BOOLEAN_TRUE;
+}
+
+SF_STATUS STDCALL sf_timestamp_format_compile(const char *format, SF_TIMESTAMP_FORMAT *compiled) {
+    const char *str = format;
+    size_t literals_len = 0;
+    size_t i;
+    uint8 digits;
+
+    compiled->op_count = 0;
+    compiled->max_len = 0;
+    while (*str) {
+        if (*str == '"') {
+            // Quoted text is copied as is
+            for (str++; *str && *str != '"'; str++) {
+                if (!add_literal(compiled, &literals_len, *str)) {
+                    return SF_STATUS_ERROR_STRING_FORMATTING;
+                }
+            }
+            if (*str != '"') {
+                return SF_STATUS_ERROR_STRING_FORMATTING;
+            }
+            str++;
+            continue;
+        }
+        if (!is_letter(*str)) {
+            if (!add_literal(compiled, &literals_len, *str)) {
+                return SF_STATUS_ERROR_STRING_FORMATTING;
+            }
+            str++;
+            continue;
+        }
+
+        for (i = 0; i < sizeof(ELEMENTS) / sizeof(ELEMENTS[0]); i++) {
+            if (starts_with_ignoring_case(str, ELEMENTS[i].name)) {
+                break;
+            }
+        }
+        if (i == sizeof(ELEMENTS) / sizeof(ELEMENTS[0])) {
+            return SF_STATUS_ERROR_STRING_FORMATTING;
+        }
+        str += strlen(ELEMENTS[i].name);
+        digits = 0;
+        if (ELEMENTS[i].code == SF_FORMAT_FRACTION) {
+            // FF alone means nanoseconds
+            digits = 9;
+            if (*str >= '0' && *str <= '9') {
+                digits = (uint8) (*str - '0');
+                str++;
+            }
+        }
+        if (!add_op(compiled, ELEMENTS[i].code, digits,
+                    ELEMENTS[i].code == SF_FORMAT_FRACTION ? digits : ELEMENTS[i].max_len)) {
+            return SF_STATUS_ERROR_STRING_FORMATTING;
+        }
+    }
+    return SF_STATUS_SUCCESS;
+}
+
+/**
+ * Writes a number with at least two digits, zero padded like %02d
+ */
+static size_t STDCALL write_two_digits(char *buffer, int64 value) {
+    char digits[SF_FORMAT_MAX_ELEMENT_LEN];
+    size_t len = 0;
+    size_t i;
+    uint64 magnitude;
+
+    if (value >= 0 && value <= 99) {
+        memcpy(buffer, &SF_DIGIT_PAIRS[value * 2], 2);
+        return 2;
+    }
+    magnitude = value < 0 ? 0 - (uint64) value : (uint64) value;
+    while (magnitude > 0) {
+        digits[len++] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    }
+    i = 0;
+    if (value < 0) {
+        buffer[i++] = '-';
+    }
+    while (len > 0) {
+        buffer[i++] = digits[--len];
+    }
+    return i;
+}
+
+static size_t STDCALL write_text(char *buffer, const char *text, size_t len) {
+    memcpy(buffer, text, len);
+    return len;
+}
+
+/**
+ * Writes the value of an element
+ *
+ * @return number of characters, at most SF_FORMAT_MAX_ELEMENT_LEN
+ */
+static size_t STDCALL write_element(const SF_FORMAT_OP *op, const SF_TIMESTAMP *ts, char *buffer) {
+    const struct tm *tm_obj = &ts->tm_obj;
+    int64 year = (int64) tm_obj->tm_year + 1900;
+    int64 tzoffset = ts->tzoffset < 0 ? -(int64) ts->tzoffset : ts->tzoffset;
+    int32 fraction;
+    size_t len;
+    size_t i;
+
+    switch (op->code) {
+        case SF_FORMAT_YEAR:
+            if (year >= 0 && year <= 9999) {
+                len = write_two_digits(buffer, year / 100);
+                return len + write_two_digits(&buffer[len], year % 100);
+            }
+            return write_two_digits(buffer, year);
+        case SF_FORMAT_YEAR2:
+            return write_two_digits(buffer, (year < 0 ? -year : year) % 100);
+        case SF_FORMAT_MONTH:
+            return write_two_digits(buffer, (int64) tm_obj->tm_mon + 1);
+        case SF_FORMAT_MONTH_ABBREVIATION:
+        case SF_FORMAT_MONTH_NAME:
+            if (tm_obj->tm_mon < 0 || tm_obj->tm_mon >= 12) {
+                return write_text(buffer, "???", 3);
+            }
+            return write_text(buffer, MONTH_NAMES[tm_obj->tm_mon],
+                              op->code == SF_FORMAT_MONTH_NAME ? strlen(MONTH_NAMES[tm_obj->tm_mon]) : 3);
+        case SF_FORMAT_DAY:
+            return write_two_digits(buffer, tm_obj->tm_mday);
+        case SF_FORMAT_WEEKDAY_ABBREVIATION:
+            return write_text(buffer,
+                              tm_obj->tm_wday >= 0 && tm_obj->tm_wday < 7 ? WEEKDAY_NAMES[tm_obj->tm_wday] : "???", 3);
+        case SF_FORMAT_HOUR24:
+            return write_two_digits(buffer, tm_obj->tm_hour);
+        case SF_FORMAT_HOUR12:
+            return write_two_digits(buffer, tm_obj->tm_hour % 12 == 0 ? 12 : tm_obj->tm_hour % 12);
+        case SF_FORMAT_MERIDIEM:
+            return write_text(buffer, tm_obj->tm_hour < 12 ? "AM" : "PM", 2);
+        case SF_FORMAT_MINUTE:
+            return write_two_digits(buffer, tm_obj->tm_min);
+        case SF_FORMAT_SECOND:
+            return write_two_digits(buffer, tm_obj->tm_sec);
+        case SF_FORMAT_FRACTION:
+            // Truncated to the digits
+            fraction = (ts->nsec < 0 ? 0 : ts->nsec % 1000000000) / POW10_INT32[9 - op->digits];
+            for (i = op->digits; i > 0; i--) {
+                buffer[i - 1] = (char) ('0' + fraction % 10);
+                fraction /= 10;
+            }
+            return op->digits;
+        case SF_FORMAT_TZ_HOUR:
+            buffer[0] = ts->tzoffset < 0 ? '-' : '+';
+            return 1 + write_two_digits(&buffer[1], tzoffset / 60);
+        case SF_FORMAT_TZ_MINUTE:
+            return write_two_digits(buffer, tzoffset % 60);
+        default:
+            return 0;
+    }
+}
+
+size_t STDCALL sf_timestamp_format_apply(const SF_TIMESTAMP_FORMAT *compiled, const SF_TIMESTAMP *ts,
+                                         char *buffer, size_t size) {
+    const SF_FORMAT_OP *op;
+    char element[SF_FORMAT_MAX_ELEMENT_LEN];
+    size_t element_len;
+    size_t len = 0;
+    size_t i;
+
+    for (i = 0; i < compiled->op_count; i++) {
+        op = &compiled->ops[i];
+        if (op->code == SF_FORMAT_LITERAL) {
+            if (op->length >= size - len) {
+                return 0;
+            }
+            len += write_text(&buffer[len], &compiled->literals[op->offset], op->length);
+        } else if (size - len > SF_FORMAT_MAX_ELEMENT_LEN) {
+            len += write_element(op, ts, &buffer[len]);
+        } else {
+            // Near the end of the buffer, values wider than usual may not fit
+            element_len = write_element(op, ts, element);
+            if (element_len >= size - len) {
+                return 0;
+            }
+            len += write_text(&buffer[len], element, element_len);
+        }
+    }
+    if (len >= size) {
+        return 0;
+    }
+    buffer[len] = '\0';
+    return len;
+}
+
+SF_OUTPUT_FORMATS *STDCALL output_formats_init(void) {
+    return (SF_OUTPUT_FORMATS *) SF_CALLOC(1, sizeof(SF_OUTPUT_FORMATS));
+}
+
+void STDCALL output_formats_term(SF_OUTPUT_FORMATS *formats) {
+    SF_OUTPUT_FORMAT *format;
+
+    if (!formats) {
+        return;
+    }
+    while (formats->compiled) {
+        format = formats->compiled;
+        formats->compiled = format->next;
+        SF_FREE(format->text);
+        SF_FREE(format);
+    }
+    SF_FREE(formats);
+}
+
+SF_OUTPUT_FORMAT_PARAMETER STDCALL output_format_parameter(const char *name) {
+    static const char *const NAMES[SF_OUTPUT_FORMAT_PARAMETER_COUNT] = {
+        "TIMESTAMP_OUTPUT_FORMAT", "TIMESTAMP_NTZ_OUTPUT_FORMAT", "TIMESTAMP_LTZ_OUTPUT_FORMAT",
+        "TIMESTAMP_TZ_OUTPUT_FORMAT", "TIME_OUTPUT_FORMAT", "DATE_OUTPUT_FORMAT"
+    };
+    int i;
+
+    for (i = 0; i < SF_OUTPUT_FORMAT_PARAMETER_COUNT; i++) {
+        if (strcmp(name, NAMES[i]) == 0) {
+            return (SF_OUTPUT_FORMAT_PARAMETER) i;
+        }
+    }
+    return SF_OUTPUT_FORMAT_PARAMETER_COUNT;
+}
+
+void STDCALL output_formats_set(SF_OUTPUT_FORMATS *formats, SF_OUTPUT_FORMAT_PARAMETER parameter,
+                                const char *text) {
+    SF_OUTPUT_FORMAT *format = NULL;
+    size_t len;
+
+    if (!formats || parameter >= SF_OUTPUT_FORMAT_PARAMETER_COUNT) {
+        return;
+    }
+    if (text && *text) {
+        for (format = formats->compiled; format; format = format->next) {
+            if (strcmp(format->text, text) == 0) {
+                break;
+            }
+        }
+        if (!format) {
+            len = strlen(text) + 1;
+            format = (SF_OUTPUT_FORMAT *) SF_CALLOC(1, sizeof(SF_OUTPUT_FORMAT));
+            if (format) {
+                format->text = (char *) SF_CALLOC(1, len);
+            }
+            if (!format || !format->text) {
+                SF_FREE(format);
+                return;
+            }
+            sb_strcpy(format->text, len, text);
+            if (sf_timestamp_format_compile(text, &format->compiled) != SF_STATUS_SUCCESS) {
+                log_warn("Unsupported output format %s, the values are formatted in the default layout", text);
+                // Kept, so that it's only compiled once, but never used
+                format->compiled.op_count = 0;
+            }
+            format->next = formats->compiled;
+            formats->compiled = format;
+        }
+        if (format->compiled.op_count == 0) {
+            format = NULL;
+        }
+    }
+    _atomic_store(&formats->current[parameter], (long long) (intptr_t) format);
+}
+
+static const SF_TIMESTAMP_FORMAT *STDCALL current_format(SF_OUTPUT_FORMATS *formats,
+                                                          SF_OUTPUT_FORMAT_PARAMETER parameter) {
+    SF_OUTPUT_FORMAT *format = (SF_OUTPUT_FORMAT *) (intptr_t) _atomic_load(&formats->current[parameter]);
+    return format ? &format->compiled : NULL;
+}
+
+const SF_TIMESTAMP_FORMAT *STDCALL output_formats_get(SF_OUTPUT_FORMATS *formats, SF_DB_TYPE type) {
+    const SF_TIMESTAMP_FORMAT *format;
+
+    if (!formats) {
+        return NULL;
+    }
+    switch (type) {
+        case SF_DB_TYPE_TIMESTAMP_NTZ:
+            format = current_format(formats, SF_OUTPUT_FORMAT_TIMESTAMP_NTZ);
+            break;
+        case SF_DB_TYPE_TIMESTAMP_LTZ:
+            format = current_format(formats, SF_OUTPUT_FORMAT_TIMESTAMP_LTZ);
+            break;
+        case SF_DB_TYPE_TIMESTAMP_TZ:
+            format = current_format(formats, SF_OUTPUT_FORMAT_TIMESTAMP_TZ);
+            break;
+        case SF_DB_TYPE_TIME:
+            return current_format(formats, SF_OUTPUT_FORMAT_TIME);
+        case SF_DB_TYPE_DATE:
+            return current_format(formats, SF_OUTPUT_FORMAT_DATE);
+        default:
+            return NULL;
+    }
+    return format ? format : current_format(formats, SF_OUTPUT_FORMAT_TIMESTAMP);
+}
+
+void STDCALL output_formats_set_binary(SF_OUTPUT_FORMATS *formats, const char *text) {
+    if (formats) {
+        _atomic_store(&formats->binary_base64, text && sf_strncasecmp(text, "BASE64", 7) == 0);
+    }
+}
+
+sf_bool STDCALL output_formats_binary_base64(SF_OUTPUT_FORMATS *formats) {
+    return formats && _atomic_load(&formats->binary_base64) ? SF_BOOLEAN_TRUE : SF_BOOLEAN_FALSE;
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_TIMESTAMP_FORMAT_H
+#define SNOWFLAKE_TIMESTAMP_FORMAT_H
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "snowflake/basic_types.h"
+#include "snowflake/platform.h"
+#include "snowflake/client.h"
+
+#define SF_FORMAT_MAX_OPS 64
+#define SF_FORMAT_MAX_LITERALS 128
+// Widest an element prints, e.g. the year -2147481748 of tm_year INT_MIN
+#define SF_FORMAT_MAX_ELEMENT_LEN 11
+
+typedef enum SF_FORMAT_OPCODE {
+    // Copies length characters of the literals from offset
+    SF_FORMAT_LITERAL,
+    SF_FORMAT_YEAR,
+    SF_FORMAT_YEAR2,
+    SF_FORMAT_MONTH,
+    SF_FORMAT_MONTH_ABBREVIATION,
+    SF_FORMAT_MONTH_NAME,
+    SF_FORMAT_DAY,
+    SF_FORMAT_WEEKDAY_ABBREVIATION,
+    SF_FORMAT_HOUR24,
+    SF_FORMAT_HOUR12,
+    SF_FORMAT_MERIDIEM,
+    SF_FORMAT_MINUTE,
+    SF_FORMAT_SECOND,
+    // digits digits of the fraction of the second
+    SF_FORMAT_FRACTION,
+    // Sign and hours of the time zone offset, then its minutes
+    SF_FORMAT_TZ_HOUR,
+    SF_FORMAT_TZ_MINUTE
+} SF_FORMAT_OPCODE;
+
+typedef struct SF_FORMAT_OP {
+    uint8 code;
+    uint8 digits;
+    uint32 offset;
+    uint32 length;
+} SF_FORMAT_OP;
+
+/**
+ * A Snowflake output format like YYYY-MM-DD HH24:MI:SS.FF3 TZH:TZM compiled into one op per element, so
+ * formatting a value is a loop over the ops without parsing the format again or allocating
+ */
+typedef struct SF_TIMESTAMP_FORMAT {
+    SF_FORMAT_OP ops[SF_FORMAT_MAX_OPS];
+    size_t op_count;
+    char literals[SF_FORMAT_MAX_LITERALS];
+    // Longest string the format produces for years 0 to 9999, without the NUL
+    size_t max_len;
+} SF_TIMESTAMP_FORMAT;
+
+/**
+ * Compiles a format of the elements YYYY, YY, MM, MON, MMMM, DD, DY, HH24, HH12, AM, PM, MI, SS, FF[0-9],
+ * TZH and TZM, matched without regard to case. Other characters but letters and "quoted text" are copied.
+ *
+ * @return SF_STATUS_ERROR_STRING_FORMATTING if the format has an unknown element or is too long
+ */
+SF_STATUS STDCALL sf_timestamp_format_compile(const char *format, SF_TIMESTAMP_FORMAT *compiled);
+
+/**
+ * Formats a timestamp with a compiled format and a NUL. A buffer of max_len + 1 bytes fits the years 0 to 9999
+ * the server sends, one of max_len + op_count * SF_FORMAT_MAX_ELEMENT_LEN + 1 bytes any value.
+ *
+ * @return length of the string, 0 if it doesn't fit into size bytes
+ */
+size_t STDCALL sf_timestamp_format_apply(const SF_TIMESTAMP_FORMAT *compiled, const SF_TIMESTAMP *ts,
+                                         char *buffer, size_t size);
+
+/**
+ * Session parameters with output formats
+ */
+typedef enum SF_OUTPUT_FORMAT_PARAMETER {
+    SF_OUTPUT_FORMAT_TIMESTAMP,
+    SF_OUTPUT_FORMAT_TIMESTAMP_NTZ,
+    SF_OUTPUT_FORMAT_TIMESTAMP_LTZ,
+    SF_OUTPUT_FORMAT_TIMESTAMP_TZ,
+    SF_OUTPUT_FORMAT_TIME,
+    SF_OUTPUT_FORMAT_DATE,
+    SF_OUTPUT_FORMAT_PARAMETER_COUNT
+} SF_OUTPUT_FORMAT_PARAMETER;
+
+/**
+ * A compiled output format parameter value. Never changed or freed while the session is up, so a reader
+ * that loaded it keeps a valid format when the parameter changes.
+ */
+typedef struct SF_OUTPUT_FORMAT {
+    char *text;
+    SF_TIMESTAMP_FORMAT compiled;
+    struct SF_OUTPUT_FORMAT *next;
+} SF_OUTPUT_FORMAT;
+
+struct SF_OUTPUT_FORMATS {
+    // Current SF_OUTPUT_FORMAT of each parameter, 0 if the parameter is unset or empty
+    SF_ATOMIC_INT64 current[SF_OUTPUT_FORMAT_PARAMETER_COUNT];
+    // All the formats compiled in the session
+    SF_OUTPUT_FORMAT *compiled;
+    // Whether BINARY_OUTPUT_FORMAT is BASE64 rather than HEX
+    SF_ATOMIC_INT64 binary_base64;
+};
+
+SF_OUTPUT_FORMATS *STDCALL output_formats_init(void);
+
+void STDCALL output_formats_term(SF_OUTPUT_FORMATS *formats);
+
+/**
+ * @return the parameter the session parameter name sets, or SF_OUTPUT_FORMAT_PARAMETER_COUNT if it's another
+ */
+SF_OUTPUT_FORMAT_PARAMETER STDCALL output_format_parameter(const char *name);
+
+/**
+ * Sets a parameter to a format, compiled once per distinct text in the session. Calls are serialized by the
+ * caller, the readers need no lock. A format that doesn't compile unsets the parameter.
+ */
+void STDCALL output_formats_set(SF_OUTPUT_FORMATS *formats, SF_OUTPUT_FORMAT_PARAMETER parameter,
+                                const char *text);
+
+/**
+ * Format of values of a type, the type specific parameter or else TIMESTAMP_OUTPUT_FORMAT for timestamps
+ *
+ * @return NULL if the session has none for the type
+ */
+const SF_TIMESTAMP_FORMAT *STDCALL output_formats_get(SF_OUTPUT_FORMATS *formats, SF_DB_TYPE type);
+
+/**
+ * Sets BINARY_OUTPUT_FORMAT, HEX or BASE64
+ */
+void STDCALL output_formats_set_binary(SF_OUTPUT_FORMATS *formats, const char *text);
+
+/**
+ * @return whether BINARY values are shown as base64 rather than as the hex text the server sends
+ */
+sf_bool STDCALL output_formats_binary_base64(SF_OUTPUT_FORMATS *formats);
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_TIMESTAMP_FORMAT_H
@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "utils/test_setup.h"
+#include "utils/test_http_server.h"
+#include "arrow_reader.h"
+#include "rowset.h"
+#include "chunk_downloader.h"
+#include "memory.h"
+#include "error.h"
+
+#define TYPES_COLUMN_COUNT 15
+
+/**
+ * Rows of tests/data/arrow/types.arrow as the JSON rowset has them. NULL stands for a null cell.
+ * The columns are FIXED as int64, int32 with scale 2, int8 with scale 1 and decimal128 with scale 4,
+ * REAL, TEXT, BINARY, BOOLEAN, DATE, TIME with scale 9, TIMESTAMP_NTZ as int64 with scale 3,
+ * TIMESTAMP_LTZ as an epoch and fraction struct with scale 9, TIMESTAMP_TZ as an epoch and timezone
+ * struct with scale 3 and as an epoch, fraction and timezone struct with scale 9, and VARIANT.
+ */
+static const char *TYPES_ROWS[][TYPES_COLUMN_COUNT] = {
+    {"1", "1.23", "-12.8", "12345678901234567890.1234", "1.5", "hello", "00FF", "1", "0",
+     "3600.123000000", "1600000000.123", "1600000000.123456789", "1600000000.123 1500",
+     "1600000000.000000001 1440", "{\"a\":1}"},
+    {"-42", "-0.05", "0.5", "-0.0001", "-0.1", "", "", "0", "18262",
+     "0.000000000", "-1.500", "-1.900000000", "-1.500 960",
+     NULL, NULL},
+    {NULL, "0.00", NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+     NULL, NULL, NULL, NULL,
+     "-2.000000001 1500", "[]"},
+    {"9223372036854775807", NULL, "0.0", "0.0000", "1e+300", "na\xc3\xafve \xe2\x9c\x93", "4142", "1", "-1",
+     "86399.999999999", "0.000", "0.000000000", "0.000 1440",
+     "0.000000000 1440", "\"x\""},
+    {"-9223372036854775808", "1.00", "12.7", "-9999999999999999999999999999999999.9999", "inf", "a,b\"c", "0A",
+     "0", "2932896",
+     "0.000000001", "-0.001", "-1.000000000", "0.005 0",
+     "7.500000000 2000", "null"},
+};
+
+static char *read_data_file(const char *name, size_t *len) {
+    char path[4096];
+    char *data;
+    long size;
+    FILE *file;
+
+    get_data_dir(path, sizeof(path));
+    strncat(path, name, sizeof(path) - strlen(path) - 1);
+    file = fopen(path, "rb");
+    assert_non_null(file);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (char *) SF_MALLOC((size_t) size + 1);
+    assert_non_null(data);
+    assert_int_equal(fread(data, 1, (size_t) size, file), (size_t) size);
+    data[size] = '\0';
+    fclose(file);
+    *len = (size_t) size;
+    return data;
+}
+
+/**
+ * Reads the stream fed in pieces of at most step bytes
+ */
+static SF_ROWSET *read_in_steps(const char *data, size_t len, size_t step, const char **error_msg) {
+    SF_ROWSET_SINK sink;
+    SF_ARROW_READER reader;
+    size_t i;
+    sf_bool ok = SF_BOOLEAN_TRUE;
+    SF_ROWSET *rows = rowset_init();
+
+    assert_non_null(rows);
+    rowset_init_sink(rows, &sink);
+    arrow_reader_init(&reader, &sink);
+    for (i = 0; i < len && ok; i += step) {
+        ok = arrow_reader_feed(&reader, data + i, len - i < step ? len - i : step);
+    }
+    if (!ok || !arrow_reader_finish(&reader)) {
+        rowset_term(rows);
+        rows = NULL;
+    }
+    *error_msg = reader.error_msg;
+    arrow_reader_term(&reader);
+    return rows;
+}
+
+static void assert_types_rows(const SF_ROWSET *rows, int64 row_count) {
+    const SF_ROWSET_CELL *cell;
+    const char *expected;
+    int64 row;
+    size_t column;
+
+    assert_int_equal(rows->row_count, row_count);
+    for (row = 0; row < row_count; row++) {
+        assert_int_equal(rowset_row_size(rows, row), TYPES_COLUMN_COUNT);
+        for (column = 0; column < TYPES_COLUMN_COUNT; column++) {
+            cell = rowset_cell(rows, row, column);
+            expected = TYPES_ROWS[row][column];
+            if (!expected) {
+                assert_true(cell->is_null);
+                assert_int_equal(cell->len, 0);
+            } else {
+                assert_false(cell->is_null);
+                assert_string_equal(rowset_cell_value(rows, cell), expected);
+                assert_int_equal(cell->len, strlen(expected));
+            }
+        }
+    }
+}
+
+/**
+ * Every type Snowflake sends is rendered as the JSON rowset has it, no matter where the stream is split
+ */
+void test_arrow_reader_types(void **unused) {
+    const size_t steps[] = {1, 3, 8, 100, 4096, 1 << 20};
+    const char *error_msg;
+    size_t len;
+    size_t i;
+    char *data = read_data_file("arrow/types.arrow", &len);
+    SF_ROWSET *rows;
+
+    for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        rows = read_in_steps(data, len, steps[i], &error_msg);
+        assert_non_null(rows);
+        assert_null(error_msg);
+        assert_types_rows(rows, 5);
+        rowset_term(rows);
+    }
+    SF_FREE(data);
+}
+
+/**
+ * Numbers and booleans are decoded as they are read, to the same values rowset_decode parses from the text
+ */
+void test_arrow_reader_decoded(void **unused) {
+    const SF_C_TYPE c_types[TYPES_COLUMN_COUNT] = {
+        SF_C_TYPE_INT64, SF_C_TYPE_FLOAT64, SF_C_TYPE_FLOAT64, SF_C_TYPE_FLOAT64, SF_C_TYPE_FLOAT64,
+        SF_C_TYPE_STRING, SF_C_TYPE_BINARY, SF_C_TYPE_BOOLEAN, SF_C_TYPE_STRING, SF_C_TYPE_STRING,
+        SF_C_TYPE_TIMESTAMP, SF_C_TYPE_TIMESTAMP, SF_C_TYPE_TIMESTAMP, SF_C_TYPE_TIMESTAMP, SF_C_TYPE_STRING
+    };
+    const SF_ROWSET_VALUE *value;
+    const SF_ROWSET_VALUE *expected;
+    const char *error_msg;
+    size_t len;
+    size_t column;
+    int64 row;
+    sf_bool is_decoded;
+    char *data = read_data_file("arrow/types.arrow", &len);
+    SF_ROWSET *rows = read_in_steps(data, len, len, &error_msg);
+    cJSON *json = rowset_to_cjson(rows);
+    SF_ROWSET *parsed = rowset_from_cjson(json);
+
+    assert_non_null(rows);
+    assert_non_null(parsed);
+    assert_true(rowset_decode(parsed, c_types, TYPES_COLUMN_COUNT));
+    for (column = 0; column < TYPES_COLUMN_COUNT; column++) {
+        for (row = 0; row < rows->row_count; row++) {
+            is_decoded = rowset_decoded_value(rows, row, column, c_types[column], &value);
+            // FIXED, its scaled variants and REAL and BOOLEAN, but not the decimal128
+            if ((column > 4 && column != 7) || column == 3) {
+                assert_false(is_decoded);
+                continue;
+            }
+            // Infinity is left to the text, which reports it as out of range
+            assert_int_equal(is_decoded, rowset_decoded_value(parsed, row, column, c_types[column], &expected));
+            if (!is_decoded) {
+                assert_int_equal(column, 4);
+                assert_int_equal(row, 4);
+            } else if (!expected) {
+                assert_null(value);
+            } else {
+                assert_non_null(value);
+                assert_memory_equal(value, expected, sizeof(SF_ROWSET_VALUE));
+            }
+        }
+    }
+
+    // rowset_decode keeps them and decodes the rest
+    assert_true(rowset_decode(rows, c_types, TYPES_COLUMN_COUNT));
+    assert_true(rowset_decoded_value(rows, 0, 0, SF_C_TYPE_INT64, &value));
+    assert_int_equal(value->int64_value, 1);
+    assert_true(rowset_decoded_value(rows, 3, 3, SF_C_TYPE_FLOAT64, &value));
+    assert_true(value->float64_value == 0.0);
+
+    snowflake_cJSON_Delete(json);
+    rowset_term(parsed);
+    rowset_term(rows);
+    SF_FREE(data);
+}
+
+/**
+ * A chunk of several record batches without an end of stream marker
+ */
+void test_arrow_reader_chunk(void **unused) {
+    const char *error_msg;
+    const SF_ROWSET_CELL *cell;
+    char expected[32];
+    size_t len;
+    int64 row;
+    char *data = read_data_file("arrow/chunk.arrow", &len);
+    SF_ROWSET *rows = read_in_steps(data, len, 1000, &error_msg);
+
+    assert_non_null(rows);
+    assert_int_equal(rows->row_count, 5000);
+    for (row = 0; row < rows->row_count; row++) {
+        sprintf(expected, "%lld", (long long) row);
+        assert_string_equal(rowset_cell_value(rows, rowset_cell(rows, row, 0)), expected);
+        cell = rowset_cell(rows, row, 1);
+        if (row % 7 == 0) {
+            assert_true(cell->is_null);
+        } else {
+            sprintf(expected, "name_%lld", (long long) row);
+            assert_string_equal(rowset_cell_value(rows, cell), expected);
+        }
+    }
+    rowset_term(rows);
+    SF_FREE(data);
+}
+
+/**
+ * The first rows come as the base64 encoded rowsetBase64 of the query response
+ */
+void test_arrow_reader_base64(void **unused) {
+    const char *error_msg = NULL;
+    size_t len;
+    char *text = read_data_file("arrow/types_rowset.b64", &len);
+    SF_ROWSET *rows = rowset_from_arrow_base64(text, len, &error_msg);
+
+    assert_non_null(rows);
+    assert_types_rows(rows, 2);
+    rowset_term(rows);
+
+    // No rows at all
+    rows = rowset_from_arrow_base64("", 0, &error_msg);
+    assert_non_null(rows);
+    assert_int_equal(rows->row_count, 0);
+    rowset_term(rows);
+
+    assert_null(rowset_from_arrow_base64("QUJD*A==", 8, &error_msg));
+    assert_string_equal(error_msg, "Invalid base64 in Arrow rowset");
+    assert_null(rowset_from_arrow_base64(text, len - 4, &error_msg));
+    assert_non_null(error_msg);
+    SF_FREE(text);
+}
+
+void test_arrow_reader_rejects_malformed(void **unused) {
+    const char *error_msg;
+    size_t len;
+    size_t i;
+    uint32 schema_len;
+    char *data = read_data_file("arrow/types.arrow", &len);
+    char *copy = (char *) SF_MALLOC(len + 8);
+    SF_ROWSET *rows;
+
+    // Cut in the middle of a message
+    assert_null(read_in_steps(data, len / 2, 16, &error_msg));
+    assert_string_equal(error_msg, "Unexpected end of Arrow stream");
+
+    // The stream ends with an end of stream marker, so anything after it is an error
+    memcpy(copy, data, len);
+    memset(copy + len, 0, 8);
+    assert_null(read_in_steps(copy, len + 8, len, &error_msg));
+    assert_string_equal(error_msg, "Data after the end of the Arrow stream");
+
+    // Record batch without the schema. The schema message is the metadata after the marker and the length
+    memcpy(&schema_len, data + 4, sizeof(schema_len));
+    assert_null(read_in_steps(data + schema_len + 8, len - schema_len - 8, len, &error_msg));
+    assert_string_equal(error_msg, "Arrow record batch before the schema");
+
+    // A huge metadata length
+    memcpy(copy, data, len);
+    memset(copy + 4, 0x7F, 4);
+    assert_null(read_in_steps(copy, len, len, &error_msg));
+    assert_string_equal(error_msg, "Invalid Arrow message length");
+
+    // Corrupting any byte never reads out of the stream. Most are caught, the others change a value.
+    for (i = 0; i < len; i++) {
+        memcpy(copy, data, len);
+        copy[i] ^= 0x5A;
+        rows = read_in_steps(copy, len, len, &error_msg);
+        rowset_term(rows);
+    }
+
+    SF_FREE(copy);
+    SF_FREE(data);
+}
+
+/**
+ * Reset drops the rows and the schema so the reader can start over, e.g. when a chunk download is retried
+ */
+void test_arrow_reader_reset(void **unused) {
+    SF_ROWSET_SINK sink;
+    SF_ARROW_READER reader;
+    size_t len;
+    char *data = read_data_file("arrow/types.arrow", &len);
+    SF_ROWSET *rows = rowset_init();
+
+    rowset_init_sink(rows, &sink);
+    arrow_reader_init(&reader, &sink);
+    assert_true(arrow_reader_feed(&reader, data, len / 2));
+    arrow_reader_reset(&reader);
+    assert_int_equal(rows->row_count, 0);
+
+    assert_true(arrow_reader_feed(&reader, data, len));
+    assert_true(arrow_reader_finish(&reader));
+    assert_int_equal(reader.row_count, 5);
+    assert_types_rows(rows, 5);
+
+    arrow_reader_term(&reader);
+    rowset_term(rows);
+    SF_FREE(data);
+}
+
+/**
+ * The chunk downloader threads read Arrow chunks into rows while they download
+ */
+void test_arrow_reader_chunk_downloader(void **unused) {
+    TEST_HTTP_RESOURCE resources[3];
+    TEST_HTTP_SERVER *server;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_DOWNLOADER_OPTIONS options;
+    SF_ERROR_STRUCT error;
+    SF_ROWSET *chunk = NULL;
+    const SF_ROWSET_VALUE *value;
+    int64 row_count = 0;
+    char url[128];
+    size_t len;
+    int i;
+    cJSON *response;
+    cJSON *chunks;
+    cJSON *item;
+    char *data = read_data_file("arrow/chunk.arrow", &len);
+    const char *paths[] = {"/chunk0", "/chunk1", "/bad"};
+
+    memset(resources, 0, sizeof(resources));
+    for (i = 0; i < 3; i++) {
+        resources[i].path = paths[i];
+        resources[i].body = i < 2 ? data : "not an arrow stream";
+        resources[i].body_len = i < 2 ? len : strlen(resources[i].body);
+    }
+    // The retry starts over with a fresh reader
+    resources[1].error_status = 503;
+    resources[1].error_count = 1;
+    server = test_http_server_start(resources, 3);
+    if (!server) {
+        SF_FREE(data);
+        skip();
+    }
+
+    response = snowflake_cJSON_CreateObject();
+    chunks = snowflake_cJSON_AddArrayToObject(response, "chunks");
+    for (i = 0; i < 3; i++) {
+        test_http_server_url(server, paths[i], url, sizeof(url));
+        item = snowflake_cJSON_CreateObject();
+        snowflake_cJSON_AddStringToObject(item, "url", url);
+        snowflake_cJSON_AddNumberToObject(item, "rowCount", 5000);
+        snowflake_cJSON_AddItemToArray(chunks, item);
+    }
+
+    memset(&error, 0, sizeof(error));
+    clear_snowflake_error(&error);
+    memset(&options, 0, sizeof(options));
+    options.arrow_format = SF_BOOLEAN_TRUE;
+    options.max_retries = SF_DEFAULT_MAX_CHUNK_RETRIES;
+    chunk_downloader = chunk_downloader_init(NULL, NULL, chunks, &options, &error);
+    assert_non_null(chunk_downloader);
+    for (i = 0; i < 2; i++) {
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+        assert_non_null(chunk);
+        assert_int_equal(chunk->row_count, 5000);
+        assert_string_equal(rowset_cell_value(chunk, rowset_cell(chunk, 4999, 0)), "4999");
+        assert_string_equal(rowset_cell_value(chunk, rowset_cell(chunk, 4999, 1)), "name_4999");
+        assert_true(rowset_decoded_value(chunk, 4999, 0, SF_C_TYPE_INT64, &value));
+        assert_int_equal(value->int64_value, 4999);
+        rowset_term(chunk);
+    }
+    assert_int_equal(resources[1].requests, 2);
+
+    assert_false(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_int_equal(error.error_code, SF_STATUS_ERROR_BAD_RESPONSE);
+    assert_non_null(strstr(error.msg, "Unable to parse chunk"));
+    clear_snowflake_error(&error);
+
+    chunk_downloader_term(chunk_downloader);
+    test_http_server_stop(server);
+    snowflake_cJSON_Delete(response);
+    SF_FREE(data);
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_arrow_reader_types),
+        cmocka_unit_test(test_arrow_reader_decoded),
+        cmocka_unit_test(test_arrow_reader_chunk),
+        cmocka_unit_test(test_arrow_reader_base64),
+        cmocka_unit_test(test_arrow_reader_rejects_malformed),
+        cmocka_unit_test(test_arrow_reader_reset),
+        cmocka_unit_test(test_arrow_reader_chunk_downloader),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utils/test_setup.h"
+#include "calendar.h"
+
+#define RANDOM_VALUES 200000
+
+// -9999-01-01 and 99999-12-31, wider than the server sends
+#define MIN_TIME (-377705116800LL)
+#define MAX_TIME 3093527980799LL
+
+/**
+ * The broken down times are the ones gmtime_r finds
+ */
+void test_calendar_matches_gmtime(void **unused) {
+    uint64 state = 88172645463325252ULL;
+    struct tm expected;
+    struct tm actual;
+    time_t seconds;
+    int64 year;
+    int32 month;
+    int32 day;
+    int i;
+
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        seconds = (time_t) (MIN_TIME + (int64) (next_random(&state) % (uint64) (MAX_TIME - MIN_TIME)));
+        // Whole days and their neighbors too, where off by one errors hide
+        if (i % 4 == 0) {
+            seconds -= seconds % SF_SECONDS_PER_DAY + (i % 8 == 0);
+        }
+        assert_non_null(sf_gmtime(&seconds, &expected));
+        memset(&actual, 0, sizeof(actual));
+        assert_true(sf_seconds_to_tm((int64) seconds, &actual));
+        if (actual.tm_year != expected.tm_year || actual.tm_mon != expected.tm_mon ||
+            actual.tm_mday != expected.tm_mday || actual.tm_hour != expected.tm_hour ||
+            actual.tm_min != expected.tm_min || actual.tm_sec != expected.tm_sec ||
+            actual.tm_wday != expected.tm_wday || actual.tm_yday != expected.tm_yday) {
+            fail_msg("%lld broken down as %d-%d-%d %d:%d:%d instead of %d-%d-%d %d:%d:%d", (long long) seconds,
+                     actual.tm_year, actual.tm_mon, actual.tm_mday, actual.tm_hour, actual.tm_min, actual.tm_sec,
+                     expected.tm_year, expected.tm_mon, expected.tm_mday, expected.tm_hour, expected.tm_min,
+                     expected.tm_sec);
+        }
+
+        sf_civil_from_days(((int64) seconds - (int64) expected.tm_hour * 3600 - expected.tm_min * 60 -
+                            expected.tm_sec) / SF_SECONDS_PER_DAY, &year, &month, &day);
+        assert_int_equal(sf_days_from_civil(year, month, day) * SF_SECONDS_PER_DAY + expected.tm_hour * 3600 +
+                         expected.tm_min * 60 + expected.tm_sec, (int64) seconds);
+    }
+}
+
+static void assert_formats_like_strftime(const struct tm *tm_obj) {
+    char expected[64];
+    char actual[64];
+
+    strftime(expected, sizeof(expected), "%Y-%m-%d", tm_obj);
+    assert_int_equal(sf_format_date(actual, sizeof(actual), tm_obj), strlen(expected));
+    assert_string_equal(actual, expected);
+    strftime(expected, sizeof(expected), "%H:%M:%S", tm_obj);
+    assert_int_equal(sf_format_time(actual, sizeof(actual), tm_obj), strlen(expected));
+    assert_string_equal(actual, expected);
+    strftime(expected, sizeof(expected), "%Y-%m-%d %H:%M:%S", tm_obj);
+    assert_int_equal(sf_format_date_time(actual, sizeof(actual), tm_obj), strlen(expected));
+    assert_string_equal(actual, expected);
+}
+
+void test_calendar_formats_like_strftime(void **unused) {
+    uint64 state = 2463534242ULL;
+    struct tm tm_obj;
+    char fraction[16];
+    int i;
+
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        memset(&tm_obj, 0, sizeof(tm_obj));
+        sf_seconds_to_tm(MIN_TIME + (int64) (next_random(&state) % (uint64) (MAX_TIME - MIN_TIME)), &tm_obj);
+        assert_formats_like_strftime(&tm_obj);
+    }
+
+    // Fields out of their ranges, e.g. set by hand, are formatted by strftime
+    memset(&tm_obj, 0, sizeof(tm_obj));
+    tm_obj.tm_mon = 100;
+    tm_obj.tm_mday = -5;
+    tm_obj.tm_hour = 123;
+    tm_obj.tm_sec = 60;
+    assert_formats_like_strftime(&tm_obj);
+
+    // Too small a buffer
+    sf_seconds_to_tm(0, &tm_obj);
+    assert_int_equal(sf_format_date(fraction, 10, &tm_obj), 0);
+    assert_int_equal(sf_format_date_time(fraction, 16, &tm_obj), 0);
+
+    assert_int_equal(sf_format_fraction(fraction, 123, 9), 9);
+    assert_string_equal(fraction, "000000123");
+    assert_int_equal(sf_format_fraction(fraction, 98765, 5), 5);
+    assert_string_equal(fraction, "98765");
+    assert_int_equal(sf_format_fraction(fraction, 7, 1), 1);
+    assert_string_equal(fraction, "7");
+}
+
+static void assert_timestamp_string(const char *value, int32 scale, SF_DB_TYPE type, const char *expected) {
+    SF_TIMESTAMP ts;
+    char *buffer = NULL;
+    size_t len = 0;
+
+    assert_int_equal(snowflake_timestamp_from_epoch_seconds(&ts, value, "UTC", scale, type), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "", &buffer, 0, &len, SF_BOOLEAN_TRUE), SF_STATUS_SUCCESS);
+    assert_string_equal(buffer, expected);
+    assert_int_equal(len, strlen(expected));
+    free(buffer);
+}
+
+void test_calendar_timestamp_strings(void **unused) {
+    assert_timestamp_string("18000", 0, SF_DB_TYPE_DATE, "2019-04-14 00:00:00");
+    assert_timestamp_string("1555245296.123456789", 9, SF_DB_TYPE_TIMESTAMP_NTZ,
+                            "2019-04-14 12:34:56.123456789");
+    assert_timestamp_string("-1.5", 1, SF_DB_TYPE_TIMESTAMP_NTZ, "1969-12-31 23:59:58.5");
+    assert_timestamp_string("45296.010", 3, SF_DB_TYPE_TIME, "12:34:56.010");
+    assert_timestamp_string("253402300799.000001", 6, SF_DB_TYPE_TIMESTAMP_NTZ, "9999-12-31 23:59:59.000001");
+    // Offsets under an hour keep their sign
+    assert_timestamp_string("0.00 1470", 2, SF_DB_TYPE_TIMESTAMP_TZ, "1970-01-01 00:30:00.00 +00:30");
+    assert_timestamp_string("0.00 1410", 2, SF_DB_TYPE_TIMESTAMP_TZ, "1969-12-31 23:30:00.00 -00:30");
+    assert_timestamp_string("0.00 1440", 2, SF_DB_TYPE_TIMESTAMP_TZ, "1970-01-01 00:00:00.00 +00:00");
+    assert_timestamp_string("0.00 2000", 2, SF_DB_TYPE_TIMESTAMP_TZ, "1970-01-01 09:20:00.00 +09:20");
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_calendar_matches_gmtime),
+        cmocka_unit_test(test_calendar_formats_like_strftime),
+        cmocka_unit_test(test_calendar_timestamp_strings),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,1502 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <zlib.h>
+#include "utils/test_setup.h"
+#include "utils/test_http_server.h"
+#include <snowflake/logger.h>
+#include "chunk_downloader.h"
+#include "memory.h"
+#include "error.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define MAX_TEST_CHUNKS 512
+
+static void sleep_ms(unsigned int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+typedef struct CHUNK_FIXTURE {
+    TEST_HTTP_SERVER *server;
+    TEST_HTTP_RESOURCE resources[MAX_TEST_CHUNKS];
+    char paths[MAX_TEST_CHUNKS][32];
+    char *bodies[MAX_TEST_CHUNKS];
+    int chunk_count;
+    int rows_per_chunk;
+    size_t chunk_size;
+    cJSON *response;
+    // Hedge straggling chunks. Off unless a test turns it on, since it adds requests
+    sf_bool hedging;
+    uint64 max_retries;
+    // Spilling is off unless a test sets the directory
+    const char *spill_dir;
+    uint64 max_spill_bytes;
+    sf_bool scrollable;
+    // Sent with every chunk request. Optional
+    cJSON *chunk_headers;
+    // consume_all gives the chunks back instead of freeing them
+    sf_bool recycle;
+    // Splitting chunks into ranges is off unless a test sets it, since it adds requests
+    uint64 range_split_bytes;
+    // Hands out fresh chunk URLs once they expire. Off unless a test sets it
+    SF_CHUNK_URL_REFRESH url_refresh;
+    int url_refreshes;
+    sf_bool fail_url_refresh;
+    // Columns the workers decode. Off unless a test sets them
+    const SF_COLUMN_DESC *decode_columns;
+    uint64 column_count;
+} CHUNK_FIXTURE;
+
+/**
+ * Serves chunk_count chunks of rows_per_chunk rows. The first column of every row is the chunk index
+ * and the second one is the row index in the chunk.
+ */
+static void fixture_setup(CHUNK_FIXTURE *fixture, int chunk_count, int rows_per_chunk, unsigned int delay_ms,
+                          sf_bool tls) {
+    char url[128];
+    char row[128];
+    size_t row_len;
+    size_t used;
+    int i;
+    int r;
+    cJSON *chunks;
+    cJSON *chunk;
+
+    memset(fixture, 0, sizeof(CHUNK_FIXTURE));
+    fixture->chunk_count = chunk_count;
+    fixture->rows_per_chunk = rows_per_chunk;
+    fixture->max_retries = SF_DEFAULT_MAX_CHUNK_RETRIES;
+    for (i = 0; i < chunk_count; i++) {
+        fixture->bodies[i] = (char *) malloc((size_t) rows_per_chunk * sizeof(row));
+        used = 0;
+        for (r = 0; r < rows_per_chunk; r++) {
+            row_len = (size_t) snprintf(row, sizeof(row), "%s[\"%d\",\"%d\",\"padding padding padding\",null]",
+                                        r == 0 ? "" : ",", i, r);
+            memcpy(fixture->bodies[i] + used, row, row_len);
+            used += row_len;
+        }
+        snprintf(fixture->paths[i], sizeof(fixture->paths[i]), "/chunk%d", i);
+        fixture->resources[i].path = fixture->paths[i];
+        fixture->resources[i].body = fixture->bodies[i];
+        fixture->resources[i].body_len = used;
+        fixture->resources[i].delay_ms = delay_ms;
+        fixture->chunk_size = used;
+    }
+
+    if (tls) {
+        fixture->server = test_https_server_start(fixture->resources, (size_t) chunk_count);
+    } else {
+        fixture->server = test_http_server_start(fixture->resources, (size_t) chunk_count);
+    }
+    if (!fixture->server) {
+        return;
+    }
+
+    fixture->response = snowflake_cJSON_CreateObject();
+    chunks = snowflake_cJSON_AddArrayToObject(fixture->response, "chunks");
+    for (i = 0; i < chunk_count; i++) {
+        test_http_server_url(fixture->server, fixture->paths[i], url, sizeof(url));
+        chunk = snowflake_cJSON_CreateObject();
+        snowflake_cJSON_AddStringToObject(chunk, "url", url);
+        snowflake_cJSON_AddNumberToObject(chunk, "rowCount", rows_per_chunk);
+        snowflake_cJSON_AddNumberToObject(chunk, "uncompressedSize", (double) fixture->resources[i].body_len);
+        snowflake_cJSON_AddItemToArray(chunks, chunk);
+    }
+}
+
+static void fixture_teardown(CHUNK_FIXTURE *fixture) {
+    int i;
+    test_http_server_stop(fixture->server);
+    snowflake_cJSON_Delete(fixture->response);
+    for (i = 0; i < fixture->chunk_count; i++) {
+        free(fixture->bodies[i]);
+    }
+}
+
+static SF_CHUNK_DOWNLOADER *fixture_downloader(CHUNK_FIXTURE *fixture,
+                                               uint64 max_thread_count,
+                                               uint64 max_prefetch_bytes,
+                                               SF_CHUNK_MEMORY_BUDGET *memory_budget,
+                                               SF_CHUNK_SHARE *share,
+                                               SF_ERROR_STRUCT *error) {
+    // The chunk downloader consumes the chunks array, so give it a copy
+    cJSON *chunks = snowflake_cJSON_Duplicate(snowflake_cJSON_GetObjectItem(fixture->response, "chunks"), 1);
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_DOWNLOADER_OPTIONS options;
+
+    memset(error, 0, sizeof(SF_ERROR_STRUCT));
+    clear_snowflake_error(error);
+    memset(&options, 0, sizeof(options));
+    options.hedging = fixture->hedging;
+    options.scrollable = fixture->scrollable;
+    options.thread_count = 2;
+    options.fetch_slots = 4;
+    options.max_thread_count = max_thread_count;
+    options.max_prefetch_bytes = max_prefetch_bytes;
+    options.memory_budget = memory_budget;
+    options.share = share;
+    options.max_retries = fixture->max_retries;
+    options.spill_dir = fixture->spill_dir;
+    options.max_spill_bytes = fixture->max_spill_bytes;
+    options.range_split_bytes = fixture->range_split_bytes;
+    options.url_refresh = fixture->url_refresh;
+    options.url_refresh_ctx = fixture;
+    options.decode_columns = fixture->decode_columns;
+    options.column_count = fixture->column_count;
+    options.insecure_mode = SF_BOOLEAN_TRUE;
+    chunk_downloader = chunk_downloader_init(NULL, fixture->chunk_headers, chunks, &options, error);
+    snowflake_cJSON_Delete(chunks);
+    return chunk_downloader;
+}
+
+/**
+ * url_refresh of the fixture. The fresh URLs have a query string, which the server ignores.
+ */
+static sf_bool STDCALL fixture_refresh_urls(void *ctx, cJSON **chunks, SF_ERROR_STRUCT *error) {
+    CHUNK_FIXTURE *fixture = (CHUNK_FIXTURE *) ctx;
+    char url[160];
+    cJSON *chunk;
+    cJSON *item;
+
+    fixture->url_refreshes++;
+    if (fixture->fail_url_refresh) {
+        SET_SNOWFLAKE_ERROR(error, SF_STATUS_ERROR_BAD_RESPONSE, "Result is gone", SF_SQLSTATE_UNABLE_TO_CONNECT);
+        return SF_BOOLEAN_FALSE;
+    }
+    *chunks = snowflake_cJSON_Duplicate(snowflake_cJSON_GetObjectItem(fixture->response, "chunks"), 1);
+    snowflake_cJSON_ArrayForEach(chunk, *chunks) {
+        item = snowflake_cJSON_GetObjectItem(chunk, "url");
+        snprintf(url, sizeof(url), "%s?fresh=%d", item->valuestring, fixture->url_refreshes);
+        snowflake_cJSON_ReplaceItemInObject(chunk, "url", snowflake_cJSON_CreateString(url));
+    }
+    return SF_BOOLEAN_TRUE;
+}
+
+/**
+ * Memory footprint of one parsed chunk of the fixture as measured by the chunk downloader
+ */
+static uint64 fixture_chunk_footprint(CHUNK_FIXTURE *fixture) {
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader = fixture_downloader(fixture, 1, 0, NULL, NULL, &error);
+    SF_ROWSET *chunk = NULL;
+    int64 row_count;
+    uint64 footprint;
+
+    assert_non_null(chunk_downloader);
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    footprint = chunk_downloader->held_bytes;
+    assert_int_equal(footprint, rowset_footprint(chunk));
+    rowset_term(chunk);
+    chunk_downloader_term(chunk_downloader);
+    return footprint;
+}
+
+/**
+ * Reads every chunk and checks that they arrive complete and in order.
+ */
+static void consume_all(CHUNK_FIXTURE *fixture, SF_CHUNK_DOWNLOADER *chunk_downloader,
+                        unsigned int consume_delay_ms) {
+    SF_ROWSET *chunk = NULL;
+    const SF_ROWSET_CELL *cell;
+    int64 row_count = 0;
+    int i;
+
+    for (i = 0; i < fixture->chunk_count; i++) {
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+        assert_non_null(chunk);
+        assert_int_equal(row_count, fixture->rows_per_chunk);
+        assert_int_equal(chunk->row_count, fixture->rows_per_chunk);
+        assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, 0, 0))), i);
+        cell = rowset_cell(chunk, chunk->row_count - 1, 1);
+        assert_int_equal(atoi(rowset_cell_value(chunk, cell)), fixture->rows_per_chunk - 1);
+        assert_true(rowset_cell(chunk, 0, 3)->is_null);
+        if (fixture->recycle) {
+            chunk_downloader_recycle_chunk(chunk_downloader, chunk);
+        } else {
+            rowset_term(chunk);
+        }
+
+        if (consume_delay_ms) {
+            sleep_ms(consume_delay_ms);
+        }
+    }
+
+    // End of results
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_null(chunk);
+}
+
+/**
+ * A fast consumer on a slow link makes the scheduler add threads
+ */
+void test_chunk_downloader_grows_threads(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+
+    fixture_setup(&fixture, 32, 100, 50, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    chunk_downloader = fixture_downloader(&fixture, 8, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    consume_all(&fixture, chunk_downloader, 0);
+    assert_true(chunk_downloader->thread_count > 2);
+    assert_true(chunk_downloader->thread_count <= 8);
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * A slow consumer on a fast link makes the scheduler park threads
+ */
+void test_chunk_downloader_shrinks_threads(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+
+    fixture_setup(&fixture, 12, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    chunk_downloader = fixture_downloader(&fixture, 8, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    consume_all(&fixture, chunk_downloader, 100);
+    assert_int_equal(chunk_downloader->thread_count, 2);
+    assert_int_equal(chunk_downloader->active_thread_count, 1);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Chunks the consumer is done with are parsed into again, and the rows of the next chunks are intact
+ */
+void test_chunk_downloader_recycles_chunks(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+
+    fixture_setup(&fixture, 24, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    fixture.recycle = SF_BOOLEAN_TRUE;
+    // A slow consumer and a budget of a few chunks, so the workers wait for the chunks it gives back
+    chunk_downloader = fixture_downloader(&fixture, 4, 8 * fixture_chunk_footprint(&fixture), NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    consume_all(&fixture, chunk_downloader, 5);
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    assert_int_equal(stats.chunk_count, fixture.chunk_count);
+    assert_true(stats.recycled_count > 0);
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * The memory of prefetched chunks stays within the statement budget no matter how many threads we allow
+ */
+void test_chunk_downloader_byte_budget(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count;
+    uint64 footprint;
+    int i;
+
+    fixture_setup(&fixture, 16, 100, 20, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    footprint = fixture_chunk_footprint(&fixture);
+    assert_true(footprint > fixture.chunk_size);
+
+    // Room for the chunk being read and one more
+    chunk_downloader = fixture_downloader(&fixture, 8, footprint * 5 / 2, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+        assert_non_null(chunk);
+        _critical_section_lock(&chunk_downloader->queue_lock);
+        assert_true(chunk_downloader->producer_head - chunk_downloader->consumer_head <= 1);
+        _critical_section_unlock(&chunk_downloader->queue_lock);
+        rowset_term(chunk);
+    }
+    assert_true(chunk_downloader->active_thread_count <= 2);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Two statements share the memory budget of their connection
+ */
+void test_chunk_downloader_connection_budget(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error1;
+    SF_ERROR_STRUCT error2;
+    SF_CHUNK_DOWNLOADER *chunk_downloader1;
+    SF_CHUNK_DOWNLOADER *chunk_downloader2;
+    SF_CHUNK_MEMORY_BUDGET *memory_budget;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count;
+    uint64 footprint;
+    int i;
+
+    fixture_setup(&fixture, 16, 100, 10, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    footprint = fixture_chunk_footprint(&fixture);
+
+    memory_budget = chunk_memory_budget_init();
+    assert_non_null(memory_budget);
+    chunk_memory_budget_set_limit(memory_budget, footprint * 3);
+
+    chunk_downloader1 = fixture_downloader(&fixture, 4, 0, memory_budget, NULL, &error1);
+    chunk_downloader2 = fixture_downloader(&fixture, 4, 0, memory_budget, NULL, &error2);
+    assert_non_null(chunk_downloader1);
+    assert_non_null(chunk_downloader2);
+
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader1, &chunk, &row_count));
+        rowset_term(chunk);
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader2, &chunk, &row_count));
+        rowset_term(chunk);
+
+        // Each statement may go over the limit by one chunk while it has nothing else in memory
+        _critical_section_lock(&memory_budget->lock);
+        assert_true(memory_budget->used <= footprint * 5);
+        _critical_section_unlock(&memory_budget->lock);
+    }
+
+    chunk_downloader_term(chunk_downloader1);
+    chunk_downloader_term(chunk_downloader2);
+    assert_int_equal(memory_budget->used, 0);
+    assert_null(memory_budget->downloaders);
+    chunk_memory_budget_term(memory_budget);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Workers keep their connections open between chunks and share them with the next statement of the connection,
+ * so the number of TLS handshakes doesn't grow with the number of chunks
+ */
+void test_chunk_downloader_reuses_connections(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_SHARE *share;
+    uint64 thread_count;
+    uint64 start_usec;
+    uint64 elapsed_usec;
+    int handshakes;
+    int resumed;
+
+    fixture_setup(&fixture, 64, 20, 0, SF_BOOLEAN_TRUE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    snowflake_global_set_attribute(SF_GLOBAL_CA_BUNDLE_FILE, test_http_server_ca_file(fixture.server));
+    share = chunk_share_init();
+    assert_non_null(share);
+
+    start_usec = sf_get_monotonic_time_usec();
+    chunk_downloader = fixture_downloader(&fixture, 4, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, share, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 0);
+    elapsed_usec = sf_get_monotonic_time_usec() - start_usec + 1;
+    assert_false(get_error(chunk_downloader));
+    thread_count = chunk_downloader->thread_count;
+    chunk_downloader_term(chunk_downloader);
+
+    handshakes = test_http_server_handshakes(fixture.server, &resumed);
+    log_info("Downloaded %d chunks with %llu threads: %llu chunks/sec, %d TLS handshakes, %d resumed",
+             fixture.chunk_count, thread_count,
+             (uint64) fixture.chunk_count * 1000000 / elapsed_usec, handshakes, resumed);
+    assert_int_equal(test_http_server_requests(fixture.server), fixture.chunk_count);
+    assert_true(handshakes > 0);
+    assert_true((uint64) handshakes <= thread_count);
+
+    // The next statement resumes the TLS sessions
+    chunk_downloader = fixture_downloader(&fixture, 4, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, share, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 0);
+    assert_false(get_error(chunk_downloader));
+    thread_count = chunk_downloader->thread_count;
+    chunk_downloader_term(chunk_downloader);
+    assert_true((uint64) test_http_server_handshakes(fixture.server, NULL) <= (uint64) handshakes + thread_count);
+
+    chunk_share_term(share);
+    snowflake_global_set_attribute(SF_GLOBAL_CA_BUNDLE_FILE, getenv("SNOWFLAKE_TEST_CA_BUNDLE_FILE"));
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Many small chunks: a chunk that is already downloaded is handed over without the queue_lock, so the consumer
+ * only takes the lock to wait for a chunk or to wake up the parked workers
+ */
+void test_chunk_downloader_lock_free_handoff(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count;
+    uint64 start_usec;
+    uint64 handoff_usec = 0;
+    int i;
+
+    fixture_setup(&fixture, MAX_TEST_CHUNKS, 1, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+
+    // As fast as possible
+    chunk_downloader = fixture_downloader(&fixture, 8, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    start_usec = sf_get_monotonic_time_usec();
+    consume_all(&fixture, chunk_downloader, 0);
+    log_info("Consumed %d chunks in %llu usec with %llu threads, took the queue lock %llu times",
+             fixture.chunk_count, sf_get_monotonic_time_usec() - start_usec, chunk_downloader->thread_count,
+             chunk_downloader->handoff_lock_count);
+    assert_false(get_error(chunk_downloader));
+    assert_int_equal(chunk_downloader->handoff_count, fixture.chunk_count);
+    chunk_downloader_term(chunk_downloader);
+
+    // Give the workers time to fill the prefetch window every few chunks, so the chunks are ready when we
+    // ask for them
+    chunk_downloader = fixture_downloader(&fixture, 8, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    for (i = 0; i < 64; i++) {
+        if (i % 4 == 0) {
+            sleep_ms(20);
+        }
+        start_usec = sf_get_monotonic_time_usec();
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+        handoff_usec += sf_get_monotonic_time_usec() - start_usec;
+        assert_non_null(chunk);
+        assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, 0, 0))), i);
+        rowset_term(chunk);
+    }
+    log_info("Handed over %llu prefetched chunks in %llu usec, took the queue lock %llu times",
+             chunk_downloader->handoff_count, handoff_usec, chunk_downloader->handoff_lock_count);
+    assert_int_equal(chunk_downloader->handoff_count, 64);
+    assert_true(chunk_downloader->handoff_lock_count < chunk_downloader->handoff_count);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * A chunk whose first request gets stuck is requested a second time once the consumer waited for it longer
+ * than the hedge deadline, so it doesn't hold up the results
+ */
+void test_chunk_downloader_hedges_straggler(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    uint64 start_usec;
+    uint64 elapsed_usec;
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    fixture.resources[10].delay_ms = 3000;
+    fixture.resources[10].delay_count = 1;
+    fixture.hedging = SF_BOOLEAN_TRUE;
+
+    start_usec = sf_get_monotonic_time_usec();
+    chunk_downloader = fixture_downloader(&fixture, 4, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 0);
+    elapsed_usec = sf_get_monotonic_time_usec() - start_usec;
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    log_info("Read %llu chunks in %llu ms, hedged %llu, deadline %llu usec",
+             stats.chunk_count, elapsed_usec / 1000, stats.hedged_count, stats.hedge_deadline_usec);
+    assert_int_equal(stats.chunk_count, fixture.chunk_count);
+    assert_int_equal(stats.hedged_count, 1);
+    assert_int_equal(stats.hedge_won_count, 1);
+    assert_true(stats.hedge_deadline_usec > 0);
+    assert_int_equal(fixture.resources[10].requests, 2);
+    assert_true(elapsed_usec < 2000000);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Dropped connections and retryable http codes are retried, and a retry goes on where the failed
+ * one stopped without parsing any row twice
+ */
+void test_chunk_downloader_retries_chunks(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+
+    fixture_setup(&fixture, 8, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    // Cut in the middle of a row twice, then resume from there
+    fixture.resources[2].truncate_bytes = fixture.chunk_size / 3 + 7;
+    fixture.resources[2].truncate_count = 2;
+    // The server sends the whole body again, so the retry skips what it already has
+    fixture.resources[4].truncate_bytes = fixture.chunk_size / 2 + 3;
+    fixture.resources[4].truncate_count = 1;
+    fixture.resources[4].ignore_range = 1;
+    fixture.resources[6].error_status = 503;
+    fixture.resources[6].error_count = 2;
+
+    chunk_downloader = fixture_downloader(&fixture, 2, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 0);
+    assert_false(get_error(chunk_downloader));
+
+    assert_int_equal(fixture.resources[2].requests, 3);
+    assert_int_equal(fixture.resources[2].range_requests, 2);
+    assert_int_equal(fixture.resources[4].requests, 2);
+    assert_int_equal(fixture.resources[4].range_requests, 1);
+    assert_int_equal(fixture.resources[6].requests, 3);
+    assert_int_equal(fixture.resources[6].range_requests, 0);
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    assert_int_equal(stats.retry_count, 5);
+    assert_int_equal(stats.resumed_count, 3);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * The result set fails once a chunk used up its retries
+ */
+void test_chunk_downloader_retry_budget(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+
+    fixture_setup(&fixture, 4, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    fixture.resources[1].error_status = 503;
+    fixture.resources[1].error_count = 1000;
+    fixture.max_retries = 2;
+
+    chunk_downloader = fixture_downloader(&fixture, 1, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_non_null(chunk);
+    rowset_term(chunk);
+    assert_false(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_int_equal(error.error_code, SF_STATUS_ERROR_RETRY);
+    assert_non_null(strstr(error.msg, "Giving up on chunk after 2 retries"));
+    assert_int_equal(fixture.resources[1].requests, 3);
+    clear_snowflake_error(&error);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * A 403 for a chunk gets fresh URLs from url_refresh and the chunk is fetched again without counting
+ * as a retry. If the URLs can't be refreshed the result set fails.
+ */
+void test_chunk_downloader_refreshes_urls(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+
+    fixture_setup(&fixture, 8, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    fixture.url_refresh = fixture_refresh_urls;
+    // A retry would use up the budget
+    fixture.max_retries = 0;
+    fixture.resources[1].error_status = 403;
+    fixture.resources[1].error_count = 1;
+    fixture.resources[5].error_status = 403;
+    fixture.resources[5].error_count = 2;
+
+    chunk_downloader = fixture_downloader(&fixture, 2, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 0);
+    assert_false(get_error(chunk_downloader));
+
+    assert_int_equal(fixture.resources[1].requests, 2);
+    assert_int_equal(fixture.resources[5].requests, 3);
+    assert_non_null(strstr(chunk_downloader->queue[7].url, "?fresh="));
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    assert_int_equal(stats.retry_count, 0);
+    assert_true(stats.url_refresh_count >= 2);
+    assert_int_equal(stats.url_refresh_count, fixture.url_refreshes);
+    chunk_downloader_term(chunk_downloader);
+
+    // The error of url_refresh fails the result set
+    fixture.resources[0].error_status = 403;
+    fixture.resources[0].error_count = 1000;
+    fixture.resources[0].requests = 0;
+    fixture.fail_url_refresh = SF_BOOLEAN_TRUE;
+    chunk_downloader = fixture_downloader(&fixture, 1, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    assert_false(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_null(chunk);
+    assert_int_equal(error.error_code, SF_STATUS_ERROR_BAD_RESPONSE);
+    assert_string_equal(error.msg, "Result is gone");
+    assert_int_equal(fixture.resources[0].requests, 1);
+    clear_snowflake_error(&error);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * A slow consumer makes the workers spill the chunks that don't fit in memory, and reads them back
+ */
+void test_chunk_downloader_spills_chunks(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    char spill_dir[MAX_PATH];
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    sf_get_tmp_dir(spill_dir);
+    sb_strcat(spill_dir, sizeof(spill_dir), "sf_chunk_spill_test");
+    fixture.spill_dir = spill_dir;
+    fixture.max_spill_bytes = SF_DEFAULT_MAX_CHUNK_SPILL_BYTES;
+
+    // Only one chunk fits in memory at a time
+    chunk_downloader = fixture_downloader(&fixture, 2, 1, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    consume_all(&fixture, chunk_downloader, 20);
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    log_info("Spilled %llu of %llu chunks", stats.spilled_count, stats.chunk_count);
+    assert_int_equal(stats.chunk_count, fixture.chunk_count);
+    assert_true(stats.spilled_count > 0);
+    assert_int_equal(_atomic_load(&chunk_downloader->spill_bytes), 0);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+    sf_delete_directory_if_exists(spill_dir);
+}
+
+/**
+ * Compresses the body of a fixture chunk the way a gzip Content-Encoding has it
+ */
+static void gzip_chunk(CHUNK_FIXTURE *fixture, int index) {
+    TEST_HTTP_RESOURCE *resource = &fixture->resources[index];
+    z_stream stream;
+    uLong size;
+    char *body;
+
+    memset(&stream, 0, sizeof(stream));
+    assert_int_equal(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    size = deflateBound(&stream, (uLong) resource->body_len) + 32;
+    body = (char *) malloc(size);
+    stream.next_in = (Bytef *) resource->body;
+    stream.avail_in = (uInt) resource->body_len;
+    stream.next_out = (Bytef *) body;
+    stream.avail_out = (uInt) size;
+    assert_int_equal(deflate(&stream, Z_FINISH), Z_STREAM_END);
+    resource->body_len = stream.total_out;
+    resource->body = body;
+    resource->content_encoding = "gzip";
+    deflateEnd(&stream);
+    free(fixture->bodies[index]);
+    fixture->bodies[index] = body;
+}
+
+/**
+ * Spilled chunks stay compressed on disk, and the ones the consumer didn't get to are deleted on term
+ */
+void test_chunk_downloader_spill_cleanup(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+    char spill_dir[MAX_PATH];
+    char spill_prefix[SF_UUID4_LEN];
+    char path[MAX_PATH];
+    FILE *file;
+    long size;
+    int spilled = 0;
+    int i;
+
+    fixture_setup(&fixture, 8, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    for (i = 0; i < fixture.chunk_count; i++) {
+        gzip_chunk(&fixture, i);
+    }
+    sf_get_tmp_dir(spill_dir);
+    sb_strcat(spill_dir, sizeof(spill_dir), "sf_chunk_spill_test");
+    fixture.spill_dir = spill_dir;
+    fixture.max_spill_bytes = SF_DEFAULT_MAX_CHUNK_SPILL_BYTES;
+
+    chunk_downloader = fixture_downloader(&fixture, 2, 1, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    sb_strcpy(spill_prefix, sizeof(spill_prefix), chunk_downloader->spill_prefix);
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_int_equal(chunk->row_count, fixture.rows_per_chunk);
+    rowset_term(chunk);
+    for (i = 0; i < 500; i++) {
+        chunk_downloader_get_stats(chunk_downloader, &stats);
+        if (stats.chunk_count == (uint64) fixture.chunk_count) {
+            break;
+        }
+        sleep_ms(10);
+    }
+    assert_int_equal(stats.chunk_count, fixture.chunk_count);
+
+    // A spilled chunk has the size it had on the wire
+    for (i = 1; i < fixture.chunk_count; i++) {
+        if (!chunk_downloader->queue[i].is_spilled) {
+            continue;
+        }
+        sb_sprintf(path, sizeof(path), "%s%csfchunk_%s_%d", spill_dir, PATH_SEP, spill_prefix, i);
+        assert_non_null(file = fopen(path, "rb"));
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+        fclose(file);
+        assert_int_equal(size, fixture.resources[i].body_len);
+        spilled++;
+    }
+    assert_true(spilled > 0);
+
+    // Reads a spilled chunk back
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_int_equal(chunk->row_count, fixture.rows_per_chunk);
+    assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, 0, 0))), 1);
+    rowset_term(chunk);
+
+    chunk_downloader_term(chunk_downloader);
+    for (i = 0; i < fixture.chunk_count; i++) {
+        sb_sprintf(path, sizeof(path), "%s%csfchunk_%s_%d", spill_dir, PATH_SEP, spill_prefix, i);
+        assert_null(fopen(path, "rb"));
+    }
+    fixture_teardown(&fixture);
+    sf_delete_directory_if_exists(spill_dir);
+}
+
+/**
+ * The chunk the consumer waits for is fetched in ranges while the other threads are idle, whether it is
+ * compressed or not, and fetched whole if the server doesn't do ranges
+ */
+void test_chunk_downloader_splits_chunks(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    int mode;
+    int i;
+
+    // Plain, gzip, and a server that ignores ranges
+    for (mode = 0; mode < 3; mode++) {
+        fixture_setup(&fixture, 4, 2000, 0, SF_BOOLEAN_FALSE);
+        if (!fixture.server) {
+            fixture_teardown(&fixture);
+            skip();
+        }
+        if (mode == 1) {
+            gzip_chunk(&fixture, 0);
+        } else if (mode == 2) {
+            for (i = 0; i < fixture.chunk_count; i++) {
+                fixture.resources[i].ignore_range = 1;
+            }
+        }
+        fixture.range_split_bytes = fixture.chunk_size / 2;
+
+        chunk_downloader = fixture_downloader(&fixture, 4, SF_DEFAULT_MAX_CHUNK_PREFETCH_BYTES, NULL, NULL, &error);
+        assert_non_null(chunk_downloader);
+        consume_all(&fixture, chunk_downloader, 0);
+        assert_false(get_error(chunk_downloader));
+
+        // The first chunk is taken while nothing else downloads, so it is split between all the threads
+        chunk_downloader_get_stats(chunk_downloader, &stats);
+        log_info("Split %llu of %llu chunks", stats.split_count, stats.chunk_count);
+        if (mode < 2) {
+            assert_true(stats.split_count >= 1);
+            assert_int_equal(fixture.resources[0].requests, 4);
+            assert_int_equal(fixture.resources[0].range_requests, 4);
+        } else {
+            assert_int_equal(stats.split_count, 0);
+            assert_int_equal(fixture.resources[0].requests, 2);
+        }
+
+        chunk_downloader_term(chunk_downloader);
+        fixture_teardown(&fixture);
+    }
+}
+
+/**
+ * Checks that a chunk is the one with the given index
+ */
+static void assert_chunk(CHUNK_FIXTURE *fixture, SF_ROWSET *chunk, int index) {
+    assert_non_null(chunk);
+    assert_int_equal(chunk->row_count, fixture->rows_per_chunk);
+    assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, 0, 0))), index);
+    assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, chunk->row_count - 1, 0))), index);
+}
+
+/**
+ * Chunks of a scrollable result can be read in any order, whether they were kept, evicted or spilled
+ */
+void test_chunk_downloader_scrolls(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_CHUNK_STATS stats;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+    int64 row_in_chunk;
+    uint64 index;
+    uint64 footprint;
+    char spill_dir[MAX_PATH];
+    int i;
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    footprint = fixture_chunk_footprint(&fixture);
+    fixture.scrollable = SF_BOOLEAN_TRUE;
+
+    // Only one chunk is kept once the consumer moved on
+    chunk_downloader = fixture_downloader(&fixture, 2, 3 * footprint, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    assert_true(chunk_downloader_find_row(chunk_downloader, 0, &index, &row_in_chunk));
+    assert_int_equal(index, 0);
+    assert_int_equal(row_in_chunk, 0);
+    assert_true(chunk_downloader_find_row(chunk_downloader, 250, &index, &row_in_chunk));
+    assert_int_equal(index, 2);
+    assert_int_equal(row_in_chunk, 50);
+    assert_true(chunk_downloader_find_row(chunk_downloader, 1599, &index, &row_in_chunk));
+    assert_int_equal(index, 15);
+    assert_int_equal(row_in_chunk, 99);
+    assert_false(chunk_downloader_find_row(chunk_downloader, 1600, &index, &row_in_chunk));
+
+    // Skips ahead, then goes back to every chunk
+    assert_true(chunk_downloader_get_chunk(chunk_downloader, 5, &chunk, &row_count));
+    assert_int_equal(row_count, fixture.rows_per_chunk);
+    assert_chunk(&fixture, chunk, 5);
+    chunk_downloader_return_chunk(chunk_downloader, 5, chunk);
+    for (i = fixture.chunk_count - 1; i >= 0; i--) {
+        assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) i, &chunk, &row_count));
+        assert_chunk(&fixture, chunk, i);
+        chunk_downloader_return_chunk(chunk_downloader, (uint64) i, chunk);
+    }
+    assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) fixture.chunk_count, &chunk, &row_count));
+    assert_null(chunk);
+    assert_false(get_error(chunk_downloader));
+    assert_true(chunk_downloader->retained_bytes <= 3 * footprint / 2);
+
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    log_info("Downloaded %llu of %llu chunks again", stats.refetched_count, stats.chunk_count);
+    assert_int_equal(stats.chunk_count, fixture.chunk_count);
+    assert_true(stats.refetched_count > 0);
+    chunk_downloader_term(chunk_downloader);
+
+    // Spilled chunks are read from their files again
+    sf_get_tmp_dir(spill_dir);
+    sb_strcat(spill_dir, sizeof(spill_dir), "sf_chunk_spill_test");
+    fixture.spill_dir = spill_dir;
+    fixture.max_spill_bytes = SF_DEFAULT_MAX_CHUNK_SPILL_BYTES;
+    chunk_downloader = fixture_downloader(&fixture, 2, 1, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) i, &chunk, &row_count));
+        assert_chunk(&fixture, chunk, i);
+        chunk_downloader_return_chunk(chunk_downloader, (uint64) i, chunk);
+        sleep_ms(20);
+    }
+    for (i = fixture.chunk_count - 1; i >= 0; i--) {
+        assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) i, &chunk, &row_count));
+        assert_chunk(&fixture, chunk, i);
+        chunk_downloader_return_chunk(chunk_downloader, (uint64) i, chunk);
+    }
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_get_stats(chunk_downloader, &stats);
+    log_info("Spilled %llu and downloaded %llu of %llu chunks again", stats.spilled_count, stats.refetched_count,
+             stats.chunk_count);
+    assert_true(stats.spilled_count > 0);
+    assert_int_equal(stats.spilled_count + stats.refetched_count, fixture.chunk_count);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+    sf_delete_directory_if_exists(spill_dir);
+}
+
+/**
+ * Makes a chunk of the fixture factor times as large, its rows repeated
+ */
+static void fixture_grow_chunk(CHUNK_FIXTURE *fixture, int index, int factor) {
+    TEST_HTTP_RESOURCE *resource = &fixture->resources[index];
+    size_t len = resource->body_len;
+    char *body = (char *) malloc((len + 1) * (size_t) factor);
+    cJSON *chunk = snowflake_cJSON_GetArrayItem(snowflake_cJSON_GetObjectItem(fixture->response, "chunks"), index);
+    int i;
+
+    assert_non_null(body);
+    for (i = 0; i < factor; i++) {
+        if (i > 0) {
+            body[i * (len + 1) - 1] = ',';
+        }
+        memcpy(body + i * (len + 1), fixture->bodies[index], len);
+    }
+    free(fixture->bodies[index]);
+    fixture->bodies[index] = body;
+    resource->body = body;
+    resource->body_len = (len + 1) * (size_t) factor - 1;
+    snowflake_cJSON_ReplaceItemInObject(chunk, "rowCount",
+                                        snowflake_cJSON_CreateNumber(fixture->rows_per_chunk * factor));
+    snowflake_cJSON_ReplaceItemInObject(chunk, "uncompressedSize",
+                                        snowflake_cJSON_CreateNumber((double) resource->body_len));
+}
+
+/**
+ * A chunk larger than what the kept chunks leave of the budget is still downloaded once the consumer
+ * waits for it
+ */
+void test_chunk_downloader_scrolls_mixed_sizes(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_ROWSET *chunk = NULL;
+    int64 row_count = 0;
+    uint64 footprint;
+    int i;
+
+    fixture_setup(&fixture, 6, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    footprint = fixture_chunk_footprint(&fixture);
+    fixture.scrollable = SF_BOOLEAN_TRUE;
+    fixture_grow_chunk(&fixture, 1, 8);
+    fixture_grow_chunk(&fixture, 4, 8);
+
+    chunk_downloader = fixture_downloader(&fixture, 2, 3 * footprint, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) i, &chunk, &row_count));
+        assert_non_null(chunk);
+        assert_int_equal(row_count, fixture.rows_per_chunk * (i == 1 || i == 4 ? 8 : 1));
+        assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, row_count - 1, 0))), i);
+        // The small chunks are kept
+        chunk_downloader_return_chunk(chunk_downloader, (uint64) i, chunk);
+        if (i == 0) {
+            assert_true(chunk_downloader->retained_bytes > 0);
+        }
+    }
+    for (i = fixture.chunk_count - 1; i >= 0; i--) {
+        assert_true(chunk_downloader_get_chunk(chunk_downloader, (uint64) i, &chunk, &row_count));
+        assert_int_equal(atoi(rowset_cell_value(chunk, rowset_cell(chunk, 0, 0))), i);
+        chunk_downloader_return_chunk(chunk_downloader, (uint64) i, chunk);
+    }
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Checks the chunk index and the row index in the chunk of the current row
+ */
+static void assert_current_row(SF_STMT *sfstmt, int64 index, int64 row) {
+    int64 value;
+
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 1, &value), SF_STATUS_SUCCESS);
+    assert_int_equal(value, index);
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 2, &value), SF_STATUS_SUCCESS);
+    assert_int_equal(value, row);
+}
+
+/**
+ * Sets up the statement as if a query returned the rows and the chunks of the fixture
+ */
+static void fixture_stmt_results(CHUNK_FIXTURE *fixture, SF_STMT *sfstmt, const char *rows,
+                                 uint64 max_prefetch_bytes) {
+    cJSON *json = snowflake_cJSON_Parse(rows);
+    int i;
+
+    sfstmt->raw_results = rowset_from_cjson(json);
+    snowflake_cJSON_Delete(json);
+    assert_non_null(sfstmt->raw_results);
+    sfstmt->chunk_rowcount = ((SF_ROWSET *) sfstmt->raw_results)->row_count;
+    sfstmt->total_rowcount = sfstmt->chunk_rowcount + fixture->chunk_count * fixture->rows_per_chunk;
+    sfstmt->total_fieldcount = 4;
+    sfstmt->total_row_index = 0;
+    sfstmt->desc = (SF_COLUMN_DESC *) SF_CALLOC(4, sizeof(SF_COLUMN_DESC));
+    for (i = 0; i < 4; i++) {
+        sfstmt->desc[i].idx = (size_t) i + 1;
+        sfstmt->desc[i].type = SF_DB_TYPE_FIXED;
+        sfstmt->desc[i].c_type = SF_C_TYPE_INT64;
+    }
+    // fixture_downloader starts over with the error
+    clear_snowflake_error(&sfstmt->error);
+    sfstmt->chunk_downloader = fixture_downloader(fixture, 2, max_prefetch_bytes, NULL, NULL, &sfstmt->error);
+    assert_non_null(sfstmt->chunk_downloader);
+}
+
+/**
+ * Moves around the rows of the query response and the chunks of a scrollable statement
+ */
+void test_chunk_downloader_fetch_absolute(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    sf_bool scrollable = SF_BOOLEAN_TRUE;
+    int64 first_row_count = 3;
+    int i;
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        snowflake_stmt_term(sfstmt);
+        snowflake_term(sf);
+        skip();
+    }
+    fixture.scrollable = SF_BOOLEAN_TRUE;
+
+    // Not scrollable yet
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, 0), SF_STATUS_ERROR_APPLICATION_ERROR);
+    assert_int_equal(snowflake_stmt_set_attr(sfstmt, SF_STMT_SCROLLABLE, &scrollable), SF_STATUS_SUCCESS);
+
+    // Only one chunk is kept
+    fixture_stmt_results(&fixture, sfstmt, "[[\"-1\",\"0\",\"\",null],[\"-1\",\"1\",\"\",null],[\"-1\",\"2\",\"\",null]]",
+                         3 * fixture_chunk_footprint(&fixture));
+
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, 1), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, -1, 1);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, -1, 2);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, 0, 0);
+
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, first_row_count + 507), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, 5, 7);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, 5, 8);
+    assert_int_equal(sfstmt->total_row_index, first_row_count + 509);
+
+    // Past the end, the current row stays
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, sfstmt->total_rowcount), SF_STATUS_EOF);
+    assert_current_row(sfstmt, 5, 8);
+
+    assert_int_equal(snowflake_rewind(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, -1, 0);
+
+    // Back to chunks that were evicted on the way
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, sfstmt->total_rowcount - 1), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, 15, 99);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_EOF);
+    for (i = fixture.chunk_count - 1; i >= 0; i--) {
+        assert_int_equal(snowflake_fetch_absolute(sfstmt, first_row_count + i * fixture.rows_per_chunk + 42),
+                         SF_STATUS_SUCCESS);
+        assert_current_row(sfstmt, i, 42);
+    }
+    assert_int_equal(snowflake_fetch_absolute(sfstmt, 0), SF_STATUS_SUCCESS);
+    assert_current_row(sfstmt, -1, 0);
+
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+    fixture_teardown(&fixture);
+}
+
+typedef struct PARTITION_READER {
+    SF_STMT *sfstmt;
+    // Rows read per chunk, the first entry being the rows of the query response
+    int row_counts[MAX_TEST_CHUNKS + 1];
+    int64 row_count;
+    int first_chunk;
+    int last_chunk;
+    sf_bool is_ordered;
+    SF_STATUS status;
+} PARTITION_READER;
+
+static void *read_partition(void *arg) {
+    PARTITION_READER *reader = (PARTITION_READER *) arg;
+    int64 index;
+    int64 row;
+    int64 last = -2;
+
+    reader->first_chunk = -2;
+    reader->is_ordered = SF_BOOLEAN_TRUE;
+    while ((reader->status = snowflake_fetch(reader->sfstmt)) == SF_STATUS_SUCCESS) {
+        if (snowflake_column_as_int64(reader->sfstmt, 1, &index) != SF_STATUS_SUCCESS ||
+            snowflake_column_as_int64(reader->sfstmt, 2, &row) != SF_STATUS_SUCCESS) {
+            reader->status = SF_STATUS_ERROR_GENERAL;
+            break;
+        }
+        if (index < last) {
+            reader->is_ordered = SF_BOOLEAN_FALSE;
+        }
+        if (reader->first_chunk == -2) {
+            reader->first_chunk = (int) index;
+        }
+        reader->last_chunk = (int) index;
+        last = index;
+        reader->row_counts[index + 1]++;
+        reader->row_count++;
+    }
+    return NULL;
+}
+
+/**
+ * Each partition of a result is read by its own thread, and together they have every row once
+ */
+void test_chunk_downloader_partitions(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    SF_STMT *partitions[3];
+    PARTITION_READER readers[3];
+    SF_THREAD_HANDLE threads[3];
+    int row_counts[MAX_TEST_CHUNKS + 1];
+    int64 total_rowcount = 0;
+    int i;
+    int c;
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        snowflake_stmt_term(sfstmt);
+        snowflake_term(sf);
+        skip();
+    }
+
+    // Nothing to partition before the query
+    assert_int_equal(snowflake_partition_result(sfstmt, 3, partitions), SF_STATUS_ERROR_APPLICATION_ERROR);
+
+    fixture_stmt_results(&fixture, sfstmt, "[[\"-1\",\"0\",\"\",null],[\"-1\",\"1\",\"\",null]]", 0);
+    // Let the downloader get ahead, so some chunks move to the partitions downloaded
+    sleep_ms(50);
+    assert_int_equal(snowflake_partition_result(sfstmt, 3, partitions), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_EOF);
+
+    memset(readers, 0, sizeof(readers));
+    for (i = 0; i < 3; i++) {
+        assert_non_null(partitions[i]);
+        readers[i].sfstmt = partitions[i];
+        total_rowcount += partitions[i]->total_rowcount;
+        assert_int_equal(_thread_init(&threads[i], read_partition, &readers[i]), 0);
+    }
+    assert_int_equal(total_rowcount, sfstmt->total_rowcount);
+
+    memset(row_counts, 0, sizeof(row_counts));
+    for (i = 0; i < 3; i++) {
+        _thread_join(threads[i]);
+        assert_int_equal(readers[i].status, SF_STATUS_EOF);
+        assert_true(readers[i].is_ordered);
+        assert_int_equal(readers[i].row_count, partitions[i]->total_rowcount);
+        // Contiguous ranges of about the same size
+        assert_true(readers[i].row_count >= 5 * fixture.rows_per_chunk);
+        if (i > 0) {
+            assert_int_equal(readers[i].first_chunk, readers[i - 1].last_chunk + 1);
+        }
+        for (c = 0; c <= fixture.chunk_count; c++) {
+            row_counts[c] += readers[i].row_counts[c];
+        }
+        snowflake_stmt_term(partitions[i]);
+    }
+    assert_int_equal(readers[0].first_chunk, -1);
+    assert_int_equal(readers[2].last_chunk, fixture.chunk_count - 1);
+    assert_int_equal(row_counts[0], 2);
+    for (c = 1; c <= fixture.chunk_count; c++) {
+        assert_int_equal(row_counts[c], fixture.rows_per_chunk);
+    }
+
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Cursors over disjoint chunk ranges of a serialized result read every row once, without the statement
+ * that ran the query
+ */
+void test_chunk_downloader_serialized_result(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_CONNECT *sf = snowflake_init();
+    SF_CONNECT *reader_sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    SF_STMT *cursors[3];
+    PARTITION_READER readers[3];
+    int64 first_chunks[3] = {0, 5, 10};
+    int64 chunk_counts[3] = {5, 5, -1};
+    int row_counts[MAX_TEST_CHUNKS + 1];
+    sf_bool insecure_mode = SF_BOOLEAN_TRUE;
+    SF_STMT *cursor;
+    char *blob = NULL;
+    char *fetched_blob = NULL;
+    size_t len = 0;
+    int i;
+    int c;
+
+    fixture_setup(&fixture, 16, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        snowflake_stmt_term(sfstmt);
+        snowflake_term(sf);
+        snowflake_term(reader_sf);
+        skip();
+    }
+    fixture.chunk_headers = snowflake_cJSON_CreateObject();
+    snowflake_cJSON_AddStringToObject(fixture.chunk_headers, "x-amz-server-side-encryption-customer-key", "key");
+
+    // Nothing to serialize before the query
+    assert_int_equal(snowflake_serialize_result(sfstmt, &blob, &len), SF_STATUS_ERROR_APPLICATION_ERROR);
+
+    fixture_stmt_results(&fixture, sfstmt, "[[\"-1\",\"0\",\"\",null],[\"-1\",\"1\",\"\",null]]", 0);
+    sb_strcpy(sfstmt->sfqid, SF_UUID4_LEN, "01a2b3c4-0000-0000-0000-000000000001");
+    sfstmt->desc[0].name = (char *) SF_CALLOC(1, 6);
+    sb_strcpy(sfstmt->desc[0].name, 6, "CHUNK");
+    sfstmt->desc[1].null_ok = SF_BOOLEAN_TRUE;
+    assert_int_equal(snowflake_serialize_result(sfstmt, &blob, &len), SF_STATUS_SUCCESS);
+    assert_non_null(blob);
+    assert_int_equal(len, strlen(blob));
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_serialize_result(sfstmt, &fetched_blob, NULL), SF_STATUS_ERROR_APPLICATION_ERROR);
+    assert_null(fetched_blob);
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+
+    // Another connection that never logged in reads the result
+    assert_int_equal(snowflake_set_attribute(reader_sf, SF_CON_INSECURE_MODE, &insecure_mode), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_stmt_from_result(reader_sf, "{}", 0, -1, &cursor), SF_STATUS_ERROR_BAD_JSON);
+    assert_null(cursor);
+    assert_int_equal(snowflake_stmt_from_result(reader_sf, blob, fixture.chunk_count + 1, -1, &cursor),
+                     SF_STATUS_ERROR_OUT_OF_BOUNDS);
+
+    memset(readers, 0, sizeof(readers));
+    memset(row_counts, 0, sizeof(row_counts));
+    for (i = 0; i < 3; i++) {
+        assert_int_equal(snowflake_stmt_from_result(reader_sf, blob, first_chunks[i], chunk_counts[i], &cursors[i]),
+                         SF_STATUS_SUCCESS);
+        assert_string_equal(cursors[i]->sfqid, "01a2b3c4-0000-0000-0000-000000000001");
+        assert_int_equal(cursors[i]->total_fieldcount, 4);
+        assert_string_equal(cursors[i]->desc[0].name, "CHUNK");
+        assert_int_equal(cursors[i]->desc[0].type, SF_DB_TYPE_FIXED);
+        assert_int_equal(cursors[i]->desc[0].c_type, SF_C_TYPE_INT64);
+        assert_false(cursors[i]->desc[0].null_ok);
+        assert_true(cursors[i]->desc[1].null_ok);
+        assert_string_equal(cursors[i]->chunk_downloader->chunk_headers->header->data,
+                            "x-amz-server-side-encryption-customer-key: key");
+
+        readers[i].sfstmt = cursors[i];
+        read_partition(&readers[i]);
+        assert_int_equal(readers[i].status, SF_STATUS_EOF);
+        assert_true(readers[i].is_ordered);
+        assert_int_equal(readers[i].row_count, cursors[i]->total_rowcount);
+        assert_int_equal(readers[i].first_chunk, i == 0 ? -1 : first_chunks[i]);
+        for (c = 0; c <= fixture.chunk_count; c++) {
+            row_counts[c] += readers[i].row_counts[c];
+        }
+        snowflake_stmt_term(cursors[i]);
+    }
+    assert_int_equal(readers[2].last_chunk, fixture.chunk_count - 1);
+    assert_int_equal(row_counts[0], 2);
+    for (c = 1; c <= fixture.chunk_count; c++) {
+        assert_int_equal(row_counts[c], fixture.rows_per_chunk);
+    }
+
+    snowflake_result_blob_free(blob);
+    snowflake_term(reader_sf);
+    snowflake_cJSON_Delete(fixture.chunk_headers);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Workers decode the numbers of a chunk before handing it over, into recycled rowsets too
+ */
+void test_chunk_downloader_decodes_columns(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    SF_COLUMN_DESC desc[4];
+    SF_ROWSET *chunk = NULL;
+    const SF_ROWSET_VALUE *value;
+    int64 row_count;
+    int64 r;
+    int i;
+
+    fixture_setup(&fixture, 8, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    memset(desc, 0, sizeof(desc));
+    desc[0].c_type = SF_C_TYPE_INT64;
+    desc[1].c_type = SF_C_TYPE_FLOAT64;
+    desc[2].c_type = SF_C_TYPE_STRING;
+    desc[3].c_type = SF_C_TYPE_BOOLEAN;
+    fixture.decode_columns = desc;
+    fixture.column_count = 4;
+    chunk_downloader = fixture_downloader(&fixture, 2, 0, NULL, NULL, &error);
+    assert_non_null(chunk_downloader);
+
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+        assert_non_null(chunk);
+        assert_int_equal(chunk->column_count, 4);
+        for (r = 0; r < row_count; r++) {
+            assert_true(rowset_decoded_value(chunk, r, 0, SF_C_TYPE_INT64, &value));
+            assert_non_null(value);
+            assert_int_equal(value->int64_value, i);
+            assert_true(rowset_decoded_value(chunk, r, 1, SF_C_TYPE_FLOAT64, &value));
+            assert_true(value->float64_value == (float64) r);
+            // Strings stay text, and the last column is all NULL
+            assert_false(rowset_decoded_value(chunk, r, 2, SF_C_TYPE_STRING, &value));
+            assert_true(rowset_decoded_value(chunk, r, 3, SF_C_TYPE_BOOLEAN, &value));
+            assert_null(value);
+        }
+        // Only the type the column was decoded as
+        assert_false(rowset_decoded_value(chunk, 0, 0, SF_C_TYPE_FLOAT64, &value));
+        assert_false(rowset_decoded_value(chunk, row_count, 0, SF_C_TYPE_INT64, &value));
+        chunk_downloader_recycle_chunk(chunk_downloader, chunk);
+    }
+    assert_true(chunk_downloader_get_next_chunk(chunk_downloader, &chunk, &row_count));
+    assert_null(chunk);
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+/**
+ * Without options the chunks are downloaded by a single thread that never hedges or splits them
+ */
+void test_chunk_downloader_default_options(void **unused) {
+    CHUNK_FIXTURE fixture;
+    SF_ERROR_STRUCT error;
+    SF_CHUNK_DOWNLOADER *chunk_downloader;
+    cJSON *chunks;
+    int i;
+
+    fixture_setup(&fixture, 4, 100, 0, SF_BOOLEAN_FALSE);
+    if (!fixture.server) {
+        fixture_teardown(&fixture);
+        skip();
+    }
+    chunks = snowflake_cJSON_Duplicate(snowflake_cJSON_GetObjectItem(fixture.response, "chunks"), 1);
+    memset(&error, 0, sizeof(error));
+    clear_snowflake_error(&error);
+    chunk_downloader = chunk_downloader_init(NULL, NULL, chunks, NULL, &error);
+    snowflake_cJSON_Delete(chunks);
+    assert_non_null(chunk_downloader);
+    assert_int_equal(chunk_downloader->max_thread_count, 1);
+
+    consume_all(&fixture, chunk_downloader, 0);
+    for (i = 0; i < fixture.chunk_count; i++) {
+        assert_int_equal(fixture.resources[i].requests, 1);
+    }
+    assert_false(get_error(chunk_downloader));
+
+    chunk_downloader_term(chunk_downloader);
+    fixture_teardown(&fixture);
+}
+
+void test_chunk_downloader_init_fails(void **unused) {
+    // The second chunk has no row count
+    cJSON *response = snowflake_cJSON_Parse("{\"chunks\": [{\"url\": \"http://127.0.0.1/0\", \"rowCount\": 1},"
+                                            " {\"url\": \"http://127.0.0.1/1\"}]}");
+    cJSON *chunk_headers = snowflake_cJSON_Parse("{\"x-amz-server-side-encryption-customer-key\": \"key\"}");
+    SF_ERROR_STRUCT error;
+
+    memset(&error, 0, sizeof(error));
+    clear_snowflake_error(&error);
+    // Everything set up before the queue, and the locks, is freed again
+    assert_null(chunk_downloader_init(NULL, chunk_headers, snowflake_cJSON_GetObjectItem(response, "chunks"), NULL,
+                                      &error));
+    snowflake_cJSON_Delete(response);
+    snowflake_cJSON_Delete(chunk_headers);
+    clear_snowflake_error(&error);
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_chunk_downloader_grows_threads),
+        cmocka_unit_test(test_chunk_downloader_shrinks_threads),
+        cmocka_unit_test(test_chunk_downloader_recycles_chunks),
+        cmocka_unit_test(test_chunk_downloader_byte_budget),
+        cmocka_unit_test(test_chunk_downloader_connection_budget),
+        cmocka_unit_test(test_chunk_downloader_reuses_connections),
+        cmocka_unit_test(test_chunk_downloader_lock_free_handoff),
+        cmocka_unit_test(test_chunk_downloader_hedges_straggler),
+        cmocka_unit_test(test_chunk_downloader_retries_chunks),
+        cmocka_unit_test(test_chunk_downloader_retry_budget),
+        cmocka_unit_test(test_chunk_downloader_refreshes_urls),
+        cmocka_unit_test(test_chunk_downloader_spills_chunks),
+        cmocka_unit_test(test_chunk_downloader_spill_cleanup),
+        cmocka_unit_test(test_chunk_downloader_splits_chunks),
+        cmocka_unit_test(test_chunk_downloader_scrolls),
+        cmocka_unit_test(test_chunk_downloader_scrolls_mixed_sizes),
+        cmocka_unit_test(test_chunk_downloader_fetch_absolute),
+        cmocka_unit_test(test_chunk_downloader_partitions),
+        cmocka_unit_test(test_chunk_downloader_serialized_result),
+        cmocka_unit_test(test_chunk_downloader_decodes_columns),
+        cmocka_unit_test(test_chunk_downloader_default_options),
+        cmocka_unit_test(test_chunk_downloader_init_fails),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
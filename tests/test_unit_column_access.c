@@ -0,0 +1,684 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/test_setup.h"
+#include <snowflake/logger.h>
+#include "rowset.h"
+#include "timestamp_format.h"
+#include "memory.h"
+
+/**
+ * Sets up the statement as if a query returned the rows, without a server
+ */
+static void stmt_set_results(SF_STMT *sfstmt, SF_ROWSET *rowset, int64 columns) {
+    int64 i;
+
+    assert_non_null(rowset);
+    sfstmt->raw_results = rowset;
+    sfstmt->chunk_rowcount = rowset->row_count;
+    sfstmt->total_rowcount = rowset->row_count;
+    sfstmt->total_fieldcount = columns;
+    sfstmt->total_row_index = 0;
+    sfstmt->desc = (SF_COLUMN_DESC *) SF_CALLOC((size_t) columns, sizeof(SF_COLUMN_DESC));
+    assert_non_null(sfstmt->desc);
+    for (i = 0; i < columns; i++) {
+        sfstmt->desc[i].idx = i + 1;
+        sfstmt->desc[i].type = SF_DB_TYPE_FIXED;
+        sfstmt->desc[i].c_type = SF_C_TYPE_INT64;
+    }
+}
+
+static SF_ROWSET *wide_rowset(int64 columns, int64 rows) {
+    SF_ROWSET *rowset = rowset_init();
+    char value[32];
+    int64 r;
+    int64 c;
+
+    assert_non_null(rowset);
+    for (r = 0; r < rows; r++) {
+        assert_true(rowset_begin_row(rowset));
+        for (c = 0; c < columns; c++) {
+            snprintf(value, sizeof(value), "%lld", (long long) (r * columns + c));
+            assert_true(rowset_add_cell(rowset, value, strlen(value), SF_BOOLEAN_FALSE));
+        }
+        rowset_end_row(rowset);
+    }
+    rowset_trim(rowset);
+    return rowset;
+}
+
+void test_column_access_values(void **unused) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"12\",null,\"hello\"],[\"-3\",\"\"]]");
+    int64 int_value;
+    sf_bool is_null;
+    size_t len;
+    const char *str;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 3);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[2].c_type = SF_C_TYPE_STRING;
+
+    // No row was fetched yet
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 1, &int_value), SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW);
+
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 1, &int_value), SF_STATUS_SUCCESS);
+    assert_int_equal(int_value, 12);
+    assert_int_equal(snowflake_column_is_null(sfstmt, 2, &is_null), SF_STATUS_SUCCESS);
+    assert_true(is_null);
+    assert_int_equal(snowflake_column_strlen(sfstmt, 2, &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 0);
+    assert_int_equal(snowflake_column_as_const_str(sfstmt, 2, &str), SF_STATUS_SUCCESS);
+    assert_null(str);
+    assert_int_equal(snowflake_column_strlen(sfstmt, 3, &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 5);
+    assert_int_equal(snowflake_column_as_const_str(sfstmt, 3, &str), SF_STATUS_SUCCESS);
+    assert_string_equal(str, "hello");
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 4, &int_value), SF_STATUS_ERROR_OUT_OF_BOUNDS);
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 0, &int_value), SF_STATUS_ERROR_OUT_OF_BOUNDS);
+
+    // The second row is shorter than the row type
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_int64(sfstmt, 1, &int_value), SF_STATUS_SUCCESS);
+    assert_int_equal(int_value, -3);
+    assert_int_equal(snowflake_column_is_null(sfstmt, 2, &is_null), SF_STATUS_SUCCESS);
+    assert_false(is_null);
+    assert_int_equal(snowflake_column_is_null(sfstmt, 3, &is_null), SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW);
+
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_EOF);
+    assert_int_equal(sfstmt->total_row_index, 2);
+
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+/**
+ * Reads every column of every row and returns the time per cell in nanoseconds
+ */
+static uint64 read_all_columns(int64 columns, int64 rows) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    int64 int_value;
+    int64 sum = 0;
+    int64 expected_sum;
+    sf_bool is_null;
+    size_t len;
+    uint64 start_usec;
+    uint64 elapsed_usec;
+    int i;
+
+    stmt_set_results(sfstmt, wide_rowset(columns, rows), columns);
+    start_usec = sf_get_monotonic_time_usec();
+    while (snowflake_fetch(sfstmt) == SF_STATUS_SUCCESS) {
+        for (i = 1; i <= columns; i++) {
+            assert_int_equal(snowflake_column_is_null(sfstmt, i, &is_null), SF_STATUS_SUCCESS);
+            assert_int_equal(snowflake_column_strlen(sfstmt, i, &len), SF_STATUS_SUCCESS);
+            assert_int_equal(snowflake_column_as_int64(sfstmt, i, &int_value), SF_STATUS_SUCCESS);
+            sum += int_value;
+        }
+    }
+    elapsed_usec = sf_get_monotonic_time_usec() - start_usec;
+
+    // Every cell holds its own index
+    expected_sum = rows * columns * (rows * columns - 1) / 2;
+    assert_true(sum == expected_sum);
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+    return elapsed_usec * 1000 / (uint64) (rows * columns);
+}
+
+/**
+ * The cost of reading a column does not depend on the width of the row
+ */
+void test_column_access_width_scaling(void **unused) {
+    const int64 cells = 1 << 18;
+    const int64 widths[] = {4, 32, 300, 2000};
+    uint64 narrow_nsec = 0;
+    uint64 nsec;
+    size_t i;
+
+    for (i = 0; i < sizeof(widths) / sizeof(widths[0]); i++) {
+        nsec = read_all_columns(widths[i], cells / widths[i]);
+        log_info("Read %lld columns wide rows: %llu ns per column", widths[i], nsec);
+        if (i == 0) {
+            narrow_nsec = nsec;
+        } else {
+            // A linear lookup would be hundreds of times slower at the widest rows
+            assert_true(nsec <= narrow_nsec * 8 + 50);
+        }
+    }
+}
+
+/**
+ * The rows of test_perf_type_conversion without a server: 12000 rows of one column, either seq4() or
+ * as_double(10.01), decoded ahead of time like the chunk downloader does if decode is set. Returns the time
+ * per value in nanoseconds.
+ */
+static uint64 convert_column(SF_C_TYPE c_type, sf_bool decode) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    SF_ROWSET *rowset = c_type == SF_C_TYPE_INT64 ? wide_rowset(1, 12000) : rowset_init();
+    int64 int_value;
+    int64 int_sum = 0;
+    float64 float_value;
+    float64 float_sum = 0.0;
+    uint64 start_usec;
+    uint64 elapsed_usec;
+    int64 r;
+
+    if (c_type == SF_C_TYPE_FLOAT64) {
+        assert_non_null(rowset);
+        for (r = 0; r < 12000; r++) {
+            assert_true(rowset_begin_row(rowset));
+            assert_true(rowset_add_cell(rowset, "10.01", 5, SF_BOOLEAN_FALSE));
+            rowset_end_row(rowset);
+        }
+        rowset_trim(rowset);
+    }
+    if (decode) {
+        assert_true(rowset_decode(rowset, &c_type, 1));
+    }
+    stmt_set_results(sfstmt, rowset, 1);
+    sfstmt->desc[0].c_type = c_type;
+
+    start_usec = sf_get_monotonic_time_usec();
+    while (snowflake_fetch(sfstmt) == SF_STATUS_SUCCESS) {
+        if (c_type == SF_C_TYPE_INT64) {
+            assert_int_equal(snowflake_column_as_int64(sfstmt, 1, &int_value), SF_STATUS_SUCCESS);
+            int_sum += int_value;
+        } else {
+            assert_int_equal(snowflake_column_as_float64(sfstmt, 1, &float_value), SF_STATUS_SUCCESS);
+            float_sum += float_value;
+        }
+    }
+    elapsed_usec = sf_get_monotonic_time_usec() - start_usec;
+
+    if (c_type == SF_C_TYPE_INT64) {
+        assert_true(int_sum == 12000LL * 11999 / 2);
+    } else {
+        assert_true(float_value == 10.01 && float_sum > 120119.0 && float_sum < 120121.0);
+    }
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+    return elapsed_usec * 1000 / 12000;
+}
+
+/**
+ * Offline version of the int64 and float64 cases of test_perf_type_conversion
+ */
+void test_column_access_type_conversion(void **unused) {
+    log_info("snowflake_column_as_int64: %llu ns per value", convert_column(SF_C_TYPE_INT64, SF_BOOLEAN_FALSE));
+    log_info("snowflake_column_as_float64: %llu ns per value", convert_column(SF_C_TYPE_FLOAT64, SF_BOOLEAN_FALSE));
+    log_info("snowflake_column_as_int64 decoded: %llu ns per value",
+             convert_column(SF_C_TYPE_INT64, SF_BOOLEAN_TRUE));
+    log_info("snowflake_column_as_float64 decoded: %llu ns per value",
+             convert_column(SF_C_TYPE_FLOAT64, SF_BOOLEAN_TRUE));
+}
+
+#define DECODED_ROWS 7
+#define DECODED_COLUMNS 4
+
+static void append(char *out, size_t size, size_t *used, const char *format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    *used += (size_t) vsnprintf(out + *used, size - *used, format, args);
+    va_end(args);
+    assert_true(*used < size);
+}
+
+/**
+ * Statement with numbers that don't convert or don't fit, NULLs and a short row next to ones that convert
+ */
+static SF_STMT *number_stmt(SF_CONNECT *sf, sf_bool decode) {
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"1\",\"1.5\",\"1\",\"short\"],"
+                                        "[null,null,null,null],"
+                                        "[\"-7\",\"2e3\",\"0\",\"\"],"
+                                        "[\"9223372036854775808\",\"1e400\",\"true\",\"x\"],"
+                                        "[\"3000000000\",\"abc\",\"1\",\"y\"],"
+                                        "[\"x\",\"-0.0\",\"0\",\"z\"],"
+                                        "[\"-1\"]]");
+    const SF_C_TYPE c_types[DECODED_COLUMNS] = {
+        SF_C_TYPE_INT64, SF_C_TYPE_FLOAT64, SF_C_TYPE_BOOLEAN, SF_C_TYPE_STRING
+    };
+    SF_ROWSET *rowset = rowset_from_cjson(rows);
+    int c;
+
+    snowflake_cJSON_Delete(rows);
+    assert_non_null(rowset);
+    if (decode) {
+        assert_true(rowset_decode(rowset, c_types, DECODED_COLUMNS));
+    }
+    stmt_set_results(sfstmt, rowset, DECODED_COLUMNS);
+    for (c = 0; c < DECODED_COLUMNS; c++) {
+        sfstmt->desc[c].c_type = c_types[c];
+    }
+    return sfstmt;
+}
+
+/**
+ * Reads every column of every row with each numeric accessor, and all the rows into bound arrays.
+ * Returns the statuses and values as text to compare.
+ */
+static void read_numbers(sf_bool decode, char *out, size_t size) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = number_stmt(sf, decode);
+    SF_STATUS status;
+    sf_bool bool_value;
+    int32 int32_value;
+    int64 int64_value;
+    uint64 uint64_value;
+    float64 float64_value;
+    int64 int_ind;
+    int64 rows_fetched;
+    size_t used = 0;
+    int64 i;
+    int c;
+
+    while (snowflake_fetch(sfstmt) == SF_STATUS_SUCCESS) {
+        // One past the last column is out of bounds
+        for (c = 1; c <= DECODED_COLUMNS + 1; c++) {
+            status = snowflake_column_as_boolean(sfstmt, c, &bool_value);
+            append(out, size, &used, "%d: %d/%d ", c, status, bool_value);
+            status = snowflake_column_as_int32(sfstmt, c, &int32_value);
+            append(out, size, &used, "%d/%d ", status, int32_value);
+            status = snowflake_column_as_int64(sfstmt, c, &int64_value);
+            append(out, size, &used, "%d/%lld ", status, (long long) int64_value);
+            status = snowflake_column_as_uint64(sfstmt, c, &uint64_value);
+            append(out, size, &used, "%d/%llu ", status, (unsigned long long) uint64_value);
+            status = snowflake_column_as_float64(sfstmt, c, &float64_value);
+            append(out, size, &used, "%d/%.17g\n", status, float64_value);
+        }
+    }
+    snowflake_stmt_term(sfstmt);
+
+    // Again into bound arrays, one row at a time so every failing row is seen. The first column as int64
+    // and then as uint64.
+    for (c = 0; c < 2; c++) {
+        sfstmt = number_stmt(sf, decode);
+        assert_int_equal(snowflake_bind_column(sfstmt, 1, c == 0 ? SF_C_TYPE_INT64 : SF_C_TYPE_UINT64,
+                                               c == 0 ? (void *) &int64_value : (void *) &uint64_value, 0, &int_ind),
+                         SF_STATUS_SUCCESS);
+        assert_int_equal(snowflake_bind_column(sfstmt, 2, SF_C_TYPE_FLOAT64, &float64_value, 0, NULL),
+                         SF_STATUS_SUCCESS);
+        assert_int_equal(snowflake_bind_column(sfstmt, 3, SF_C_TYPE_BOOLEAN, &bool_value, 0, NULL),
+                         SF_STATUS_SUCCESS);
+        for (i = 0; i < DECODED_ROWS; i++) {
+            status = snowflake_fetch_rows(sfstmt, 1, &rows_fetched);
+            append(out, size, &used, "%d %lld %llu/%lld %.17g %d\n", status, (long long) int64_value,
+                   (unsigned long long) uint64_value, (long long) int_ind, float64_value, bool_value);
+        }
+        snowflake_stmt_term(sfstmt);
+    }
+    snowflake_term(sf);
+}
+
+/**
+ * Values decoded ahead of time read the same as the ones converted from the text, errors included
+ */
+void test_column_access_decoded(void **unused) {
+    char expected[8192];
+    char decoded[8192];
+
+    read_numbers(SF_BOOLEAN_FALSE, expected, sizeof(expected));
+    read_numbers(SF_BOOLEAN_TRUE, decoded, sizeof(decoded));
+    assert_string_equal(decoded, expected);
+}
+
+#define VIEW_COLUMNS 5
+
+/**
+ * String views read like the copies of snowflake_column_as_str and stay valid for the whole row
+ */
+void test_column_access_strview(void **unused) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"hello\",\"1\",\"18000\",\"1555245296.123456789\",\"1555245296.000 1770\"],"
+                                        "[null,\"0\",\"-1\",\"-1.500000000\",\"0.000 1410\"],"
+                                        "[\"\",null,null,null,null]]");
+    const SF_DB_TYPE types[VIEW_COLUMNS] = {
+        SF_DB_TYPE_TEXT, SF_DB_TYPE_BOOLEAN, SF_DB_TYPE_DATE, SF_DB_TYPE_TIMESTAMP_NTZ, SF_DB_TYPE_TIMESTAMP_TZ
+    };
+    const char *views[VIEW_COLUMNS];
+    size_t view_lens[VIEW_COLUMNS];
+    char *copies[VIEW_COLUMNS] = {NULL};
+    const char *first_view;
+    const char *view;
+    const char *raw;
+    size_t len;
+    int c;
+    int i;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), VIEW_COLUMNS);
+    snowflake_cJSON_Delete(rows);
+    for (c = 0; c < VIEW_COLUMNS; c++) {
+        sfstmt->desc[c].type = types[c];
+        sfstmt->desc[c].c_type = SF_C_TYPE_STRING;
+    }
+    sfstmt->desc[3].scale = 9;
+    sfstmt->desc[4].scale = 3;
+
+    while (snowflake_fetch(sfstmt) == SF_STATUS_SUCCESS) {
+        for (c = 0; c < VIEW_COLUMNS; c++) {
+            assert_int_equal(snowflake_column_as_strview(sfstmt, c + 1, &views[c], &view_lens[c]),
+                             SF_STATUS_SUCCESS);
+        }
+        for (c = 0; c < VIEW_COLUMNS; c++) {
+            assert_int_equal(snowflake_column_as_str(sfstmt, c + 1, &copies[c], &len, NULL), SF_STATUS_SUCCESS);
+            if (views[c] == NULL) {
+                assert_string_equal(copies[c], "");
+                assert_int_equal(view_lens[c], 0);
+            } else {
+                assert_string_equal(views[c], copies[c]);
+                assert_int_equal(view_lens[c], len);
+            }
+            SF_FREE(copies[c]);
+        }
+        // Text is not copied
+        assert_int_equal(snowflake_column_as_const_str(sfstmt, 1, &raw), SF_STATUS_SUCCESS);
+        assert_ptr_equal(views[0], raw);
+    }
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_EOF);
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_ERROR_MISSING_COLUMN_IN_ROW);
+    snowflake_stmt_term(sfstmt);
+
+    // More strings than the first block holds keep their addresses
+    sfstmt = snowflake_stmt(sf);
+    rows = snowflake_cJSON_Parse("[[\"1555245296.123456789\"],[\"-1.000000001\"]]");
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 1);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[0].type = SF_DB_TYPE_TIMESTAMP_NTZ;
+    sfstmt->desc[0].scale = 9;
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &first_view, &len), SF_STATUS_SUCCESS);
+    for (i = 0; i < 100; i++) {
+        assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+        assert_ptr_not_equal(view, first_view);
+    }
+    assert_string_equal(first_view, "2019-04-14 12:34:56.123456789");
+    assert_string_equal(view, "2019-04-14 12:34:56.123456789");
+    assert_non_null(((SF_ROW_SCRATCH *) sfstmt->row_scratch)->blocks->next);
+    // The next row reuses the largest block only
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_null(((SF_ROW_SCRATCH *) sfstmt->row_scratch)->blocks->next);
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+    assert_string_equal(view, "1969-12-31 23:59:58.999999999");
+    assert_int_equal(len, strlen(view));
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+/**
+ * snowflake_column_as_str formats dates with the session format, growing the buffer of the application
+ */
+void test_column_access_str_format(void **unused) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"18000\"],[\"3000000\"]]");
+    char *value = (char *) malloc(4);
+    size_t max_value_size = 4;
+    size_t len;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 1);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[0].type = SF_DB_TYPE_DATE;
+    sfstmt->desc[0].c_type = SF_C_TYPE_STRING;
+    output_formats_set(sf->output_formats, SF_OUTPUT_FORMAT_DATE, "DD.MM.YYYY");
+    sf->session_output_formats = SF_BOOLEAN_TRUE;
+
+    assert_non_null(value);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_str(sfstmt, 1, &value, &len, &max_value_size), SF_STATUS_SUCCESS);
+    assert_string_equal(value, "14.04.2019");
+    assert_int_equal(len, 10);
+    assert_true(max_value_size > 10);
+    // A year of five digits takes more room than the format has
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_str(sfstmt, 1, &value, &len, &max_value_size), SF_STATUS_SUCCESS);
+    assert_string_equal(value, "21.09.10183");
+    assert_int_equal(len, 11);
+    assert_true(max_value_size > len);
+
+    free(value);
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+/**
+ * BINARY values are decoded from hex straight into the buffers, row by row and in blocks
+ */
+void test_column_access_binary(void **unused) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"ABCDEF1234\",\"x\"],[null,\"y\"],[\"\",\"z\"],"
+                                        "[\"00112233445566778899aabbccddeeff0011223344\",\"w\"],[\"0G\",\"v\"]]");
+    char buffer[32];
+    char bound[4][8];
+    int64 len_or_ind[4];
+    int64 rows_fetched;
+    size_t len;
+    const char *view;
+    char *copy = NULL;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 2);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[0].type = SF_DB_TYPE_BINARY;
+    sfstmt->desc[0].c_type = SF_C_TYPE_BINARY;
+    sfstmt->desc[1].type = SF_DB_TYPE_TEXT;
+    sfstmt->desc[1].c_type = SF_C_TYPE_STRING;
+
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    // The length first, then the bytes
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, NULL, 0, &len), SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(len, 5);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, buffer, 4, &len), SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, buffer, 5, &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 5);
+    assert_memory_equal(buffer, "\xab\xcd\xef\x12\x34", 5);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 2, buffer, sizeof(buffer), &len),
+                     SF_STATUS_ERROR_CONVERSION_FAILURE);
+    // HEX is the default output format
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+    assert_string_equal(view, "ABCDEF1234");
+
+    // Base64 once BINARY_OUTPUT_FORMAT says so and the session formats are used
+    output_formats_set_binary(sf->output_formats, "BASE64");
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+    assert_string_equal(view, "ABCDEF1234");
+    sf->session_output_formats = SF_BOOLEAN_TRUE;
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+    assert_string_equal(view, "q83vEjQ=");
+    assert_int_equal(len, 8);
+    assert_int_equal(snowflake_column_as_str(sfstmt, 1, &copy, &len, NULL), SF_STATUS_SUCCESS);
+    assert_string_equal(copy, "q83vEjQ=");
+    SF_FREE(copy);
+
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, buffer, sizeof(buffer), &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 0);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, NULL, 0, &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 0);
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_SUCCESS);
+    assert_string_equal(view, "");
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, buffer, sizeof(buffer), &len), SF_STATUS_SUCCESS);
+    assert_int_equal(len, 21);
+    assert_memory_equal(buffer, "\x00\x11\x22\x33\x44\x55\x66\x77\x88\x99\xaa\xbb\xcc\xdd\xee\xff"
+                                "\x00\x11\x22\x33\x44", 21);
+    assert_int_equal(snowflake_fetch(sfstmt), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_column_as_binary(sfstmt, 1, buffer, sizeof(buffer), &len),
+                     SF_STATUS_ERROR_CONVERSION_FAILURE);
+    assert_int_equal(snowflake_column_as_strview(sfstmt, 1, &view, &len), SF_STATUS_ERROR_CONVERSION_FAILURE);
+    snowflake_stmt_term(sfstmt);
+
+    // In blocks, truncated to the element size
+    sfstmt = snowflake_stmt(sf);
+    rows = snowflake_cJSON_Parse("[[\"ABCDEF1234\"],[null],[\"\"],[\"00112233445566778899aabbccddeeff\"],"
+                                 "[\"0G\"]]");
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 1);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[0].type = SF_DB_TYPE_BINARY;
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_BINARY, bound, 0, len_or_ind),
+                     SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_BINARY, bound, sizeof(bound[0]), len_or_ind),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 4, &rows_fetched), SF_STATUS_SUCCESS);
+    assert_int_equal(rows_fetched, 4);
+    assert_int_equal(len_or_ind[0], 5);
+    assert_memory_equal(bound[0], "\xab\xcd\xef\x12\x34", 5);
+    assert_int_equal(len_or_ind[1], SF_NULL_DATA);
+    assert_int_equal(len_or_ind[2], 0);
+    assert_int_equal(len_or_ind[3], 16);
+    assert_memory_equal(bound[3], "\x00\x11\x22\x33\x44\x55\x66\x77", 8);
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 4, &rows_fetched), SF_STATUS_ERROR_CONVERSION_FAILURE);
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+/**
+ * Fetches the rows in blocks into bound arrays of every supported C type
+ */
+void test_fetch_rows(void **unused) {
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"1\",\"1.5\",\"1\",\"short\"],"
+                                        "[null,null,null,null],"
+                                        "[\"-7\",\"2e3\",\"0\",\"much longer string\"],"
+                                        "[\"42\",\"0\",\"1\",\"\"],"
+                                        "[\"5\",\"-1\",\"0\",\"x\"]]");
+    int64 ints[3];
+    float64 floats[3];
+    sf_bool bools[3];
+    char strings[3][8];
+    int64 int_ind[3];
+    int64 string_len[3];
+    int64 rows_fetched;
+    const char *str;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 4);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[1].c_type = SF_C_TYPE_FLOAT64;
+    sfstmt->desc[2].c_type = SF_C_TYPE_BOOLEAN;
+    sfstmt->desc[3].c_type = SF_C_TYPE_STRING;
+    sfstmt->desc[3].type = SF_DB_TYPE_TEXT;
+
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_INT64, ints, 0, int_ind), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 2, SF_C_TYPE_FLOAT64, floats, 0, NULL), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 3, SF_C_TYPE_BOOLEAN, bools, 0, NULL), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 4, SF_C_TYPE_STRING, strings, sizeof(strings[0]), string_len),
+                     SF_STATUS_SUCCESS);
+
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 3, &rows_fetched), SF_STATUS_SUCCESS);
+    assert_int_equal(rows_fetched, 3);
+    assert_int_equal(ints[0], 1);
+    assert_int_equal(int_ind[0], sizeof(int64));
+    assert_int_equal(ints[1], 0);
+    assert_int_equal(int_ind[1], SF_NULL_DATA);
+    assert_int_equal(ints[2], -7);
+    assert_true(floats[0] == 1.5 && floats[1] == 0.0 && floats[2] == 2000.0);
+    assert_true(bools[0] && !bools[1] && !bools[2]);
+    assert_string_equal(strings[0], "short");
+    assert_int_equal(string_len[0], 5);
+    assert_string_equal(strings[1], "");
+    assert_int_equal(string_len[1], SF_NULL_DATA);
+    // Truncated, the length tells that it did not fit
+    assert_string_equal(strings[2], "much lo");
+    assert_int_equal(string_len[2], 18);
+
+    // The last fetched row is the current row
+    assert_int_equal(sfstmt->total_row_index, 3);
+    assert_int_equal(snowflake_column_as_const_str(sfstmt, 4, &str), SF_STATUS_SUCCESS);
+    assert_string_equal(str, "much longer string");
+
+    // Only the bound columns are written
+    assert_int_equal(snowflake_bind_column(sfstmt, 2, SF_C_TYPE_FLOAT64, NULL, 0, NULL), SF_STATUS_SUCCESS);
+    floats[0] = floats[1] = -1.0;
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 3, &rows_fetched), SF_STATUS_SUCCESS);
+    assert_int_equal(rows_fetched, 2);
+    assert_int_equal(ints[0], 42);
+    assert_int_equal(ints[1], 5);
+    assert_true(floats[0] == -1.0 && floats[1] == -1.0);
+    assert_true(bools[0] && !bools[1]);
+    assert_string_equal(strings[0], "");
+    assert_int_equal(string_len[0], 0);
+
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 3, &rows_fetched), SF_STATUS_EOF);
+    assert_int_equal(rows_fetched, 0);
+
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+/**
+ * element_size is the distance between two values, so the rows can be an array of structs
+ */
+void test_fetch_rows_row_wise(void **unused) {
+    struct {
+        int64 id;
+        char name[16];
+    } out[4];
+    SF_CONNECT *sf = snowflake_init();
+    SF_STMT *sfstmt = snowflake_stmt(sf);
+    cJSON *rows = snowflake_cJSON_Parse("[[\"10\",\"ten\"],[\"20\",\"twenty\"],[\"x\",\"bad\"]]");
+    int64 name_len[4];
+    int64 rows_fetched;
+
+    stmt_set_results(sfstmt, rowset_from_cjson(rows), 2);
+    snowflake_cJSON_Delete(rows);
+    sfstmt->desc[1].c_type = SF_C_TYPE_STRING;
+
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_INT64, &out[0].id, sizeof(out[0]), NULL),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 2, SF_C_TYPE_STRING, out[0].name, sizeof(out[0]), name_len),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 3, SF_C_TYPE_INT64, NULL, 0, NULL), SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 0, SF_C_TYPE_INT64, &out[0].id, 0, NULL),
+                     SF_STATUS_ERROR_OUT_OF_BOUNDS);
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_INT64, &out[0].id, 4, NULL),
+                     SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(snowflake_bind_column(sfstmt, 1, SF_C_TYPE_TIMESTAMP, &out[0].id, 0, NULL),
+                     SF_STATUS_ERROR_BAD_DATA_OUTPUT_TYPE);
+
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 2, &rows_fetched), SF_STATUS_SUCCESS);
+    assert_int_equal(rows_fetched, 2);
+    assert_int_equal(out[0].id, 10);
+    assert_string_equal(out[0].name, "ten");
+    assert_int_equal(out[1].id, 20);
+    assert_string_equal(out[1].name, "twenty");
+    assert_int_equal(name_len[1], 6);
+
+    // The failing row is consumed
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 2, &rows_fetched), SF_STATUS_ERROR_CONVERSION_FAILURE);
+    assert_int_equal(rows_fetched, 1);
+    assert_int_equal(snowflake_fetch_rows(sfstmt, 2, &rows_fetched), SF_STATUS_EOF);
+
+    snowflake_stmt_term(sfstmt);
+    snowflake_term(sf);
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_column_access_values),
+        cmocka_unit_test(test_column_access_width_scaling),
+        cmocka_unit_test(test_column_access_type_conversion),
+        cmocka_unit_test(test_column_access_decoded),
+        cmocka_unit_test(test_column_access_strview),
+        cmocka_unit_test(test_column_access_str_format),
+        cmocka_unit_test(test_column_access_binary),
+        cmocka_unit_test(test_fetch_rows),
+        cmocka_unit_test(test_fetch_rows_row_wise),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
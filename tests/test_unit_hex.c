@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <string.h>
+#include "utils/test_setup.h"
+#include "hex.h"
+#include "base64.h"
+
+#define MAX_BYTES 100
+
+/**
+ * Every length, so that both the 32 character blocks and the rest are covered
+ */
+void test_hex_decode(void **unused) {
+    static const char UPPER[] = "0123456789ABCDEF";
+    static const char LOWER[] = "0123456789abcdef";
+    uint64 state = 88172645463325252ULL;
+    char bytes[MAX_BYTES];
+    char text[MAX_BYTES * 2];
+    char decoded[MAX_BYTES];
+    size_t decoded_len;
+    size_t len;
+    size_t i;
+
+    for (len = 0; len <= MAX_BYTES; len++) {
+        for (i = 0; i < len; i++) {
+            bytes[i] = (char) next_random(&state);
+            // Either case, even within a value
+            text[i * 2] = (i % 3 ? UPPER : LOWER)[(uint8) bytes[i] >> 4];
+            text[i * 2 + 1] = (i % 2 ? UPPER : LOWER)[(uint8) bytes[i] & 0x0F];
+        }
+        assert_true(sf_hex_decode(text, len * 2, decoded, &decoded_len));
+        assert_int_equal(decoded_len, len);
+        assert_memory_equal(decoded, bytes, len);
+    }
+}
+
+void test_hex_decode_invalid(void **unused) {
+    static const char INVALID[] = {'g', 'G', 'z', '/', ':', '@', '`', ' ', '\0', (char) 0x80, (char) 0xB0,
+                                   (char) 0xC1, (char) 0xE1, (char) 0xFF};
+    char text[70];
+    char decoded[35];
+    size_t decoded_len;
+    size_t i;
+    size_t c;
+
+    memset(text, 'a', sizeof(text));
+    for (i = 0; i < sizeof(text); i++) {
+        for (c = 0; c < sizeof(INVALID); c++) {
+            text[i] = INVALID[c];
+            assert_false(sf_hex_decode(text, sizeof(text), decoded, &decoded_len));
+        }
+        text[i] = '9';
+    }
+    assert_true(sf_hex_decode(text, sizeof(text), decoded, &decoded_len));
+    assert_int_equal(decoded_len, 35);
+    assert_false(sf_hex_decode(text, sizeof(text) - 1, decoded, &decoded_len));
+}
+
+static void assert_base64(const char *bytes, const char *expected) {
+    char text[16];
+    char decoded[16];
+    size_t decoded_len;
+
+    assert_int_equal(sf_base64_encoded_size(strlen(bytes)), strlen(expected));
+    assert_int_equal(sf_base64_encode(bytes, strlen(bytes), text), strlen(expected));
+    assert_string_equal(text, expected);
+    assert_true(sf_base64_decode(text, strlen(text), decoded, &decoded_len));
+    assert_int_equal(decoded_len, strlen(bytes));
+    assert_memory_equal(decoded, bytes, decoded_len);
+}
+
+void test_base64_encode(void **unused) {
+    assert_base64("", "");
+    assert_base64("f", "Zg==");
+    assert_base64("fo", "Zm8=");
+    assert_base64("foo", "Zm9v");
+    assert_base64("foob", "Zm9vYg==");
+    assert_base64("fooba", "Zm9vYmE=");
+    assert_base64("foobar", "Zm9vYmFy");
+    assert_base64("\xfb\xff\xbf", "+/+/");
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_hex_decode),
+        cmocka_unit_test(test_hex_decode_invalid),
+        cmocka_unit_test(test_base64_encode),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils/test_setup.h"
+#include "number_parser.h"
+
+#define RANDOM_VALUES 200000
+
+static void assert_int64(const char *str, SF_STATUS status, int64 expected) {
+    int64 value = 0;
+
+    assert_int_equal(sf_parse_int64(str, strlen(str), &value), status);
+    if (status != SF_STATUS_ERROR_CONVERSION_FAILURE) {
+        assert_true(value == expected);
+    }
+}
+
+static void assert_uint64(const char *str, SF_STATUS status, uint64 expected) {
+    uint64 value = 0;
+
+    assert_int_equal(sf_parse_uint64(str, strlen(str), &value), status);
+    if (status != SF_STATUS_ERROR_CONVERSION_FAILURE) {
+        assert_true(value == expected);
+    }
+}
+
+/**
+ * Parses the text like strtod does, to the bit
+ */
+static void assert_float64_like_libc(const char *str) {
+    float64 value = 0.0;
+    float64 expected;
+    char *end;
+    SF_STATUS status = sf_parse_float64(str, strlen(str), &value);
+
+    errno = 0;
+    expected = strtod(str, &end);
+    if (end == str) {
+        assert_int_equal(status, SF_STATUS_ERROR_CONVERSION_FAILURE);
+    } else if (errno == ERANGE || isinf(expected)) {
+        assert_int_equal(status, SF_STATUS_ERROR_OUT_OF_RANGE);
+    } else {
+        assert_int_equal(status, SF_STATUS_SUCCESS);
+        if (isnan(expected)) {
+            assert_true(isnan(value));
+        } else if (memcmp(&value, &expected, sizeof(value)) != 0) {
+            fail_msg("%s parsed as %.17g instead of %.17g", str, value, expected);
+        }
+    }
+}
+
+static void assert_float32_like_libc(const char *str) {
+    float32 value = 0.0f;
+    float32 expected;
+    char *end;
+    SF_STATUS status = sf_parse_float32(str, strlen(str), &value);
+
+    errno = 0;
+    expected = strtof(str, &end);
+    if (end == str) {
+        assert_int_equal(status, SF_STATUS_ERROR_CONVERSION_FAILURE);
+    } else if (errno == ERANGE || isinf(expected)) {
+        assert_int_equal(status, SF_STATUS_ERROR_OUT_OF_RANGE);
+    } else {
+        assert_int_equal(status, SF_STATUS_SUCCESS);
+        if (isnan(expected)) {
+            assert_true(isnan(value));
+        } else if (memcmp(&value, &expected, sizeof(value)) != 0) {
+            fail_msg("%s parsed as %.9g instead of %.9g", str, value, expected);
+        }
+    }
+}
+
+/**
+ * Formats a random decimal with up to max_digits digits, a random decimal point and maybe an exponent
+ */
+static void random_decimal(uint64 *state, int max_digits, char *str, size_t size) {
+    char digits[32];
+    int count = 1 + (int) (next_random(state) % (uint64) max_digits);
+    int point = (int) (next_random(state) % (uint64) (count + 1));
+    int exponent = (int) (next_random(state) % 61) - 30;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        digits[i] = (char) ('0' + next_random(state) % 10);
+    }
+    digits[count] = '\0';
+    snprintf(str, size, "%s%.*s%s%s", next_random(state) % 2 ? "-" : "", point, digits,
+             point < count ? "." : "", digits + point);
+    if (next_random(state) % 2) {
+        snprintf(str + strlen(str), size - strlen(str), "e%d", exponent);
+    }
+}
+
+void test_number_parser_int64(void **unused) {
+    char str[32];
+    uint64 state = 88172645463325252ULL;
+    int64 value;
+    int64 parsed;
+    int i;
+
+    assert_int64("0", SF_STATUS_SUCCESS, 0);
+    assert_int64("-0", SF_STATUS_SUCCESS, 0);
+    assert_int64("+7", SF_STATUS_SUCCESS, 7);
+    assert_int64("12345678", SF_STATUS_SUCCESS, 12345678);
+    assert_int64("-123456789012345678", SF_STATUS_SUCCESS, -123456789012345678LL);
+    assert_int64("9223372036854775807", SF_STATUS_SUCCESS, SF_INT64_MAX);
+    assert_int64("-9223372036854775808", SF_STATUS_SUCCESS, SF_INT64_MIN);
+    assert_int64("9223372036854775808", SF_STATUS_ERROR_OUT_OF_RANGE, SF_INT64_MAX);
+    assert_int64("-9223372036854775809", SF_STATUS_ERROR_OUT_OF_RANGE, SF_INT64_MIN);
+    assert_int64("99999999999999999999", SF_STATUS_ERROR_OUT_OF_RANGE, SF_INT64_MAX);
+    assert_int64("00000000000000000000042", SF_STATUS_SUCCESS, 42);
+    // Like strtoll, the number at the start of the text counts
+    assert_int64("12.50", SF_STATUS_SUCCESS, 12);
+    assert_int64("1e5", SF_STATUS_SUCCESS, 1);
+    assert_int64(" 42", SF_STATUS_SUCCESS, 42);
+    assert_int64("", SF_STATUS_ERROR_CONVERSION_FAILURE, 0);
+    assert_int64("-", SF_STATUS_ERROR_CONVERSION_FAILURE, 0);
+    assert_int64("abc", SF_STATUS_ERROR_CONVERSION_FAILURE, 0);
+
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        // All lengths, not just 19 digits
+        value = (int64) (next_random(&state) >> (next_random(&state) % 64));
+        if (i % 2) {
+            value = -value;
+        }
+        snprintf(str, sizeof(str), "%lld", (long long) value);
+        assert_int_equal(sf_parse_int64(str, strlen(str), &parsed), SF_STATUS_SUCCESS);
+        assert_true(parsed == value);
+    }
+}
+
+void test_number_parser_uint64(void **unused) {
+    char str[32];
+    uint64 state = 2463534242ULL;
+    uint64 value;
+    uint64 parsed;
+    int i;
+
+    assert_uint64("0", SF_STATUS_SUCCESS, 0);
+    assert_uint64("+12345678", SF_STATUS_SUCCESS, 12345678);
+    assert_uint64("18446744073709551615", SF_STATUS_SUCCESS, SF_UINT64_MAX);
+    assert_uint64("18446744073709551616", SF_STATUS_ERROR_OUT_OF_RANGE, SF_UINT64_MAX);
+    // Like strtoull, negative numbers wrap around
+    assert_uint64("-1", SF_STATUS_SUCCESS, SF_UINT64_MAX);
+    assert_uint64("x", SF_STATUS_ERROR_CONVERSION_FAILURE, 0);
+
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        value = next_random(&state) >> (next_random(&state) % 64);
+        snprintf(str, sizeof(str), "%llu", (unsigned long long) value);
+        assert_int_equal(sf_parse_uint64(str, strlen(str), &parsed), SF_STATUS_SUCCESS);
+        assert_true(parsed == value);
+    }
+}
+
+/**
+ * The fast path rounds like strtod. Values it doesn't take go to strtod.
+ */
+void test_number_parser_float64(void **unused) {
+    const char *cases[] = {
+        "0", "-0", "10.01", "0.1", "-1.5", ".5", "5.", "1e", "1e+", "1.e5", "2e3", "1E-3", "123456789.123456789",
+        "9007199254740993", "9007199254740992.5", "1e22", "1e23", "1e-22", "1e-23", "4.9e-324", "1e-400",
+        "1e400", "-1e400", "1.7976931348623157e308", "inf", "-Infinity", "nan", "0x10", "0x1p3", " 1.5",
+        "", "-", ".", "e5", "0.000000000000000000000000001", "12345678901234567890",
+        "1.00000000000000000000000000001",
+    };
+    char str[64];
+    uint64 state = 1234567ULL;
+    float64 value;
+    size_t i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        assert_float64_like_libc(cases[i]);
+    }
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        random_decimal(&state, 19, str, sizeof(str));
+        assert_float64_like_libc(str);
+        memcpy(&value, &state, sizeof(value));
+        if (!isnan(value)) {
+            snprintf(str, sizeof(str), "%.17g", value);
+            assert_float64_like_libc(str);
+        }
+    }
+}
+
+void test_number_parser_float32(void **unused) {
+    const char *cases[] = {
+        "0", "-0", "10.01", "0.1", "16777216", "16777217", "3.4028235e38", "1e39", "1e-50", "1e10", "1e11",
+        "1e-10", "1e-11", "nan", "abc",
+    };
+    char str[64];
+    uint64 state = 7654321ULL;
+    size_t i;
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        assert_float32_like_libc(cases[i]);
+    }
+    for (i = 0; i < RANDOM_VALUES; i++) {
+        random_decimal(&state, 9, str, sizeof(str));
+        assert_float32_like_libc(str);
+    }
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_number_parser_int64),
+        cmocka_unit_test(test_number_parser_uint64),
+        cmocka_unit_test(test_number_parser_float64),
+        cmocka_unit_test(test_number_parser_float32),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <string.h>
+#include "utils/test_setup.h"
+#include "rowset_parser.h"
+#include "rowset.h"
+#include "memory.h"
+
+static const char *ROWSET =
+    "[\"1\",\"abc\",null,\"\"],\n"
+    "[\"2\",\"quote \\\" backslash \\\\ slash \\/\",\"\\b\\f\\n\\r\\t\",null]  ,\n"
+    "[\"3\",\"\\u00e9\\u4e2d\",\"\\ud83d\\ude00\",\"\\u0041BC\"],"
+    "[],"
+    "[ null , \"x\" ,12.5,true,false ]";
+
+/**
+ * Parses the rowset fed in pieces of at most step bytes
+ */
+static SF_ROWSET *parse_in_steps(const char *rowset, size_t step, const char **error_msg) {
+    SF_ROWSET_SINK sink;
+    SF_ROWSET_PARSER parser;
+    size_t len = strlen(rowset);
+    size_t i;
+    sf_bool ok = SF_BOOLEAN_TRUE;
+    SF_ROWSET *rows = rowset_init();
+
+    assert_non_null(rows);
+    rowset_init_sink(rows, &sink);
+    rowset_parser_init(&parser, &sink);
+    for (i = 0; i < len && ok; i += step) {
+        ok = rowset_parser_feed(&parser, rowset + i, len - i < step ? len - i : step);
+    }
+    if (!ok || !rowset_parser_finish(&parser)) {
+        rowset_term(rows);
+        rows = NULL;
+    }
+    *error_msg = parser.error_msg;
+    rowset_parser_term(&parser);
+    return rows;
+}
+
+static void assert_rowset_equal(const SF_ROWSET *expected, const SF_ROWSET *rows) {
+    const SF_ROWSET_CELL *expected_cell;
+    const SF_ROWSET_CELL *cell;
+    int64 row;
+    size_t column;
+
+    assert_int_equal(expected->row_count, rows->row_count);
+    for (row = 0; row < rows->row_count; row++) {
+        assert_int_equal(rowset_row_size(expected, row), rowset_row_size(rows, row));
+        for (column = 0; column < rowset_row_size(rows, row); column++) {
+            expected_cell = rowset_cell(expected, row, column);
+            cell = rowset_cell(rows, row, column);
+            assert_int_equal(expected_cell->is_null, cell->is_null);
+            assert_int_equal(expected_cell->len, cell->len);
+            assert_memory_equal(rowset_cell_value(expected, expected_cell), rowset_cell_value(rows, cell),
+                                cell->len + 1);
+        }
+    }
+}
+
+static cJSON *parse_with_cjson(const char *rowset) {
+    size_t len = strlen(rowset);
+    char *text = (char *) SF_CALLOC(1, len + 3);
+    cJSON *rows;
+
+    text[0] = '[';
+    memcpy(text + 1, rowset, len);
+    text[len + 1] = ']';
+    rows = snowflake_cJSON_Parse(text);
+    SF_FREE(text);
+    return rows;
+}
+
+/**
+ * The rows are the same as parsing the bracketed rowset with cJSON, no matter where the input is split
+ */
+void test_rowset_parser_matches_cjson(void **unused) {
+    cJSON *json = parse_with_cjson(ROWSET);
+    SF_ROWSET *expected = rowset_from_cjson(json);
+    SF_ROWSET *rows;
+    const char *error_msg;
+    size_t step;
+
+    assert_non_null(expected);
+    for (step = 1; step <= strlen(ROWSET); step++) {
+        rows = parse_in_steps(ROWSET, step, &error_msg);
+        assert_null(error_msg);
+        assert_non_null(rows);
+        assert_rowset_equal(expected, rows);
+        rowset_term(rows);
+    }
+    rowset_term(expected);
+    snowflake_cJSON_Delete(json);
+}
+
+void test_rowset_parser_decodes_unicode(void **unused) {
+    const char *error_msg;
+    SF_ROWSET *rows = parse_in_steps("[\"\\u00e9\",\"\\ud83d\\ude00\"]", 1, &error_msg);
+
+    assert_non_null(rows);
+    assert_string_equal(rowset_cell_value(rows, rowset_cell(rows, 0, 0)), "\xc3\xa9");
+    assert_string_equal(rowset_cell_value(rows, rowset_cell(rows, 0, 1)), "\xf0\x9f\x98\x80");
+    rowset_term(rows);
+}
+
+void test_rowset_parser_empty(void **unused) {
+    const char *error_msg;
+    SF_ROWSET *rows = parse_in_steps("", 1, &error_msg);
+
+    assert_non_null(rows);
+    assert_int_equal(rows->row_count, 0);
+    rowset_term(rows);
+}
+
+void test_rowset_parser_rejects_malformed(void **unused) {
+    const char *malformed[] = {
+        "[\"a\"",
+        "[\"a\"],",
+        "[\"a\" \"b\"]",
+        "[\"a\"][\"b\"]",
+        "[[\"a\"]]",
+        "[{\"a\":1}]",
+        "[\"\\x\"]",
+        "[\"\\u12g4\"]",
+        "[\"\\ude00\"]",
+        "[\"\\ud83d\"]",
+        "[\"\\ud83dx\"]",
+        "[\"unterminated]",
+        "[nul]",
+        "[\"a\",]",
+        "x",
+    };
+    const char *error_msg;
+    size_t i;
+
+    for (i = 0; i < sizeof(malformed) / sizeof(malformed[0]); i++) {
+        assert_null(parse_in_steps(malformed[i], 1, &error_msg));
+        assert_non_null(error_msg);
+        assert_null(parse_in_steps(malformed[i], strlen(malformed[i]), &error_msg));
+        assert_non_null(error_msg);
+    }
+}
+
+/**
+ * A retried download starts over from a clean state
+ */
+void test_rowset_parser_reset(void **unused) {
+    SF_ROWSET *rows = rowset_init();
+    SF_ROWSET_SINK sink;
+    SF_ROWSET_PARSER parser;
+
+    rowset_init_sink(rows, &sink);
+    rowset_parser_init(&parser, &sink);
+    assert_true(rowset_parser_feed(&parser, "[\"1\"],[\"2\",\"trunc", 16));
+    assert_int_equal(parser.row_count, 1);
+
+    rowset_parser_reset(&parser);
+    assert_true(rowset_parser_feed(&parser, "[\"3\"]", 5));
+    assert_true(rowset_parser_finish(&parser));
+    assert_int_equal(parser.row_count, 1);
+    assert_int_equal(rows->row_count, 1);
+    assert_string_equal(rowset_cell_value(rows, rowset_cell(rows, 0, 0)), "3");
+
+    rowset_parser_term(&parser);
+    rowset_term(rows);
+}
+
+/**
+ * Null and empty cells take no room in the arena and missing columns are out of range
+ */
+void test_rowset_cells(void **unused) {
+    cJSON *json = parse_with_cjson("[\"abc\",null,\"\",42],[]");
+    SF_ROWSET *rows = rowset_from_cjson(json);
+    const SF_ROWSET_CELL *cell;
+
+    assert_non_null(rows);
+    assert_int_equal(rows->row_count, 2);
+    assert_int_equal(rowset_row_size(rows, 0), 4);
+    assert_int_equal(rowset_row_size(rows, 1), 0);
+
+    cell = rowset_cell(rows, 0, 0);
+    assert_false(cell->is_null);
+    assert_int_equal(cell->len, 3);
+    assert_string_equal(rowset_cell_value(rows, cell), "abc");
+    cell = rowset_cell(rows, 0, 1);
+    assert_true(cell->is_null);
+    assert_string_equal(rowset_cell_value(rows, cell), "");
+    cell = rowset_cell(rows, 0, 2);
+    assert_false(cell->is_null);
+    assert_int_equal(cell->offset, rowset_cell(rows, 0, 1)->offset);
+    assert_string_equal(rowset_cell_value(rows, rowset_cell(rows, 0, 3)), "42");
+    // "abc" and "42" plus the shared empty string
+    assert_int_equal(rows->arena_used, 8);
+
+    assert_null(rowset_cell(rows, 0, 4));
+    assert_null(rowset_cell(rows, 1, 0));
+    assert_null(rowset_cell(rows, 2, 0));
+    assert_int_equal(rowset_footprint(rows), sizeof(SF_ROWSET) + rows->arena_size +
+                                             rows->cell_capacity * sizeof(SF_ROWSET_CELL) +
+                                             rows->row_capacity * sizeof(size_t));
+
+    rowset_term(rows);
+    snowflake_cJSON_Delete(json);
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_rowset_parser_matches_cjson),
+        cmocka_unit_test(test_rowset_parser_decodes_unicode),
+        cmocka_unit_test(test_rowset_parser_empty),
+        cmocka_unit_test(test_rowset_parser_rejects_malformed),
+        cmocka_unit_test(test_rowset_parser_reset),
+        cmocka_unit_test(test_rowset_cells),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "utils/test_setup.h"
+#include "time_zone.h"
+
+#define RANDOM_TIMES 20000
+#define PARALLEL_TIMES 200000
+#define MAX_THREADS 8
+
+// 1900-01-01 and 2100-01-01
+#define MIN_TIME (-2208988800LL)
+#define MAX_TIME 4102444800LL
+// glibc places the changes of a TZ string rule before 1973 as if the year started on 1970-01-01
+#define MIN_RULE_TIME 94694400LL
+
+static const char *ZONES[] = {
+    "America/New_York", "Europe/London", "Australia/Sydney", "Asia/Kolkata", "America/St_Johns",
+    "Pacific/Chatham", "America/Sao_Paulo", "UTC", "UTC+05:00", "UTC-05:30", "EST5EDT", "<+0330>-3:30",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3", "CET-1CEST,M3.5.0,M10.5.0/3",
+};
+
+static void set_tz(const char *name) {
+    if (name) {
+        sf_setenv("TZ", name);
+    } else {
+        sf_unsetenv("TZ");
+    }
+    sf_tzset();
+}
+
+/**
+ * The offsets are the ones libc's localtime finds with TZ set to the zone
+ */
+void test_time_zone_matches_libc(void **unused) {
+#if defined(__linux__) || defined(__APPLE__)
+    const SF_TIME_ZONE *zone;
+    const char *prev_tz = sf_getenv("TZ");
+    char *saved_tz = prev_tz ? strdup(prev_tz) : NULL;
+    uint64 state = 88172645463325252ULL;
+    struct tm tm_obj;
+    time_t utc;
+    sf_bool is_dst;
+    int32 offset;
+    int64 min_time;
+    size_t i;
+    int j;
+
+    for (i = 0; i < sizeof(ZONES) / sizeof(ZONES[0]); i++) {
+        zone = sf_time_zone_get(ZONES[i]);
+        if (!zone) {
+            log_info("Skipping the time zone %s, there is no tz database entry for it", ZONES[i]);
+            continue;
+        }
+        min_time = zone->transition_count > 0 ? MIN_TIME : MIN_RULE_TIME;
+        set_tz(ZONES[i]);
+        for (j = 0; j < RANDOM_TIMES; j++) {
+            utc = (time_t) (min_time + (int64) (next_random(&state) % (uint64) (MAX_TIME - min_time)));
+            assert_non_null(localtime_r(&utc, &tm_obj));
+            offset = sf_time_zone_offset(zone, (int64) utc, &is_dst);
+            if (offset != tm_obj.tm_gmtoff || is_dst != (tm_obj.tm_isdst > 0)) {
+                set_tz(saved_tz);
+                fail_msg("%s at %lld has offset %d and dst %d instead of %ld and %d", ZONES[i], (long long) utc,
+                         offset, is_dst, (long) tm_obj.tm_gmtoff, tm_obj.tm_isdst);
+            }
+        }
+    }
+    set_tz(saved_tz);
+    free(saved_tz);
+#endif
+}
+
+void test_time_zone_strings(void **unused) {
+    const SF_TIME_ZONE *zone;
+    sf_bool is_dst;
+
+    zone = sf_time_zone_get("UTC+05:00");
+    assert_non_null(zone);
+    assert_int_equal(sf_time_zone_offset(zone, 0, &is_dst), -5 * 3600);
+    assert_false(is_dst);
+    // Cached
+    assert_ptr_equal(sf_time_zone_get("UTC+05:00"), zone);
+
+    zone = sf_time_zone_get("<+0330>-3:30");
+    assert_non_null(zone);
+    assert_int_equal(sf_time_zone_offset(zone, 0, NULL), 3 * 3600 + 1800);
+
+    // 2021-01-15 and 2021-07-15 at noon UTC, summer is in January in the southern hemisphere
+    zone = sf_time_zone_get("AEST-10AEDT,M10.1.0,M4.1.0/3");
+    assert_non_null(zone);
+    assert_int_equal(sf_time_zone_offset(zone, 1610712000LL, &is_dst), 11 * 3600);
+    assert_true(is_dst);
+    assert_int_equal(sf_time_zone_offset(zone, 1626350400LL, &is_dst), 10 * 3600);
+    assert_false(is_dst);
+
+    // Without rules daylight saving time follows the US ones, 2021-03-14 07:00 UTC is 2:00 EST
+    zone = sf_time_zone_get("EST5EDT");
+    assert_non_null(zone);
+    assert_int_equal(sf_time_zone_offset(zone, 1615705199LL, NULL), -5 * 3600);
+    assert_int_equal(sf_time_zone_offset(zone, 1615705200LL, NULL), -4 * 3600);
+
+    assert_int_equal(sf_time_zone_offset(sf_time_zone_get(""), 1615705200LL, NULL), 0);
+    assert_null(sf_time_zone_get(NULL));
+    assert_null(sf_time_zone_get("Not/A_Zone"));
+    assert_null(sf_time_zone_get("../../etc/passwd"));
+    assert_null(sf_time_zone_get("EST5EDT,M3.2.0"));
+    assert_null(sf_time_zone_get("UTC+25"));
+}
+
+static void assert_timestamp(const char *value, const char *timezone, SF_DB_TYPE type, int hour, int minute,
+                             int32 tzoffset) {
+    SF_TIMESTAMP ts;
+
+    assert_int_equal(snowflake_timestamp_from_epoch_seconds(&ts, value, timezone, 9, type), SF_STATUS_SUCCESS);
+    assert_int_equal(ts.tm_obj.tm_hour, hour);
+    assert_int_equal(ts.tm_obj.tm_min, minute);
+    assert_int_equal(ts.tzoffset, tzoffset);
+}
+
+void test_time_zone_timestamps(void **unused) {
+    // TIMESTAMP_TZ values carry their offset in minutes plus 1440, offsets under an hour included
+    assert_timestamp("0.000000000 1470", NULL, SF_DB_TYPE_TIMESTAMP_TZ, 0, 30, 30);
+    assert_timestamp("0.000000000 1410", NULL, SF_DB_TYPE_TIMESTAMP_TZ, 23, 30, -30);
+    assert_timestamp("0.000000000 1770", NULL, SF_DB_TYPE_TIMESTAMP_TZ, 5, 30, 330);
+    assert_timestamp("0.000000000 1140", NULL, SF_DB_TYPE_TIMESTAMP_TZ, 19, 0, -300);
+
+    assert_timestamp("1615705200.000000000", "UTC+05:00", SF_DB_TYPE_TIMESTAMP_LTZ, 2, 0, -300);
+    if (sf_time_zone_get("America/New_York")) {
+        // 2021-03-14 07:00 UTC is 3:00 EDT, one second earlier is 1:59:59 EST
+        assert_timestamp("1615705200.000000000", "America/New_York", SF_DB_TYPE_TIMESTAMP_LTZ, 3, 0, -240);
+        assert_timestamp("1615705199.000000000", "America/New_York", SF_DB_TYPE_TIMESTAMP_LTZ, 1, 59, -300);
+    }
+    assert_timestamp("1615705200.000000000", NULL, SF_DB_TYPE_TIMESTAMP_NTZ, 7, 0, 0);
+}
+
+typedef struct TIME_ZONE_READER {
+    uint64 state;
+    int count;
+    sf_bool failed;
+} TIME_ZONE_READER;
+
+static void *convert_timestamps(void *arg) {
+    TIME_ZONE_READER *reader = (TIME_ZONE_READER *) arg;
+    SF_TIMESTAMP ts;
+    char value[64];
+    int i;
+
+    for (i = 0; i < reader->count; i++) {
+        snprintf(value, sizeof(value), "%lld.123456789",
+                 (long long) (next_random(&reader->state) % (uint64) MAX_TIME));
+        if (snowflake_timestamp_from_epoch_seconds(&ts, value, "America/Los_Angeles", 9,
+                                                   SF_DB_TYPE_TIMESTAMP_LTZ) != SF_STATUS_SUCCESS) {
+            reader->failed = SF_BOOLEAN_TRUE;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Converting LTZ values takes no lock, so the throughput grows with the threads. Logged, not asserted,
+ * since the machine may have fewer cores.
+ */
+void test_time_zone_parallel_conversion(void **unused) {
+    TIME_ZONE_READER readers[MAX_THREADS];
+    SF_THREAD_HANDLE threads[MAX_THREADS];
+    uint64 start_usec;
+    uint64 elapsed_usec;
+    int thread_count;
+    int i;
+
+    for (thread_count = 1; thread_count <= MAX_THREADS; thread_count *= 2) {
+        start_usec = sf_get_monotonic_time_usec();
+        for (i = 0; i < thread_count; i++) {
+            readers[i].state = 2463534242ULL + (uint64) i;
+            readers[i].count = PARALLEL_TIMES;
+            readers[i].failed = SF_BOOLEAN_FALSE;
+            assert_int_equal(_thread_init(&threads[i], convert_timestamps, &readers[i]), 0);
+        }
+        for (i = 0; i < thread_count; i++) {
+            _thread_join(threads[i]);
+            assert_false(readers[i].failed);
+        }
+        elapsed_usec = sf_get_monotonic_time_usec() - start_usec + 1;
+        log_info("Converted %llu timestamps per second with %d threads",
+                 (uint64) thread_count * PARALLEL_TIMES * 1000000 / elapsed_usec, thread_count);
+    }
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_time_zone_matches_libc),
+        cmocka_unit_test(test_time_zone_strings),
+        cmocka_unit_test(test_time_zone_timestamps),
+        cmocka_unit_test(test_time_zone_parallel_conversion),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "utils/test_setup.h"
+#include "timestamp_format.h"
+
+static void assert_formatted(const char *value, int32 scale, SF_DB_TYPE type, const char *format,
+                             const char *expected) {
+    SF_TIMESTAMP ts;
+    SF_TIMESTAMP_FORMAT compiled;
+    char buffer[256];
+
+    assert_int_equal(snowflake_timestamp_from_epoch_seconds(&ts, value, "UTC", scale, type), SF_STATUS_SUCCESS);
+    assert_int_equal(sf_timestamp_format_compile(format, &compiled), SF_STATUS_SUCCESS);
+    assert_true(compiled.max_len >= strlen(expected));
+    assert_int_equal(sf_timestamp_format_apply(&compiled, &ts, buffer, sizeof(buffer)), strlen(expected));
+    assert_string_equal(buffer, expected);
+}
+
+void test_timestamp_format_elements(void **unused) {
+    // 2019-04-14 12:34:56.123456789 UTC was a Sunday
+    const char *ntz = "1555245296.123456789";
+
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "YYYY-MM-DD HH24:MI:SS.FF3", "2019-04-14 12:34:56.123");
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "yyyy-mm-dd hh24:mi:ss.ff", "2019-04-14 12:34:56.123456789");
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "DY, DD MON YY HH12:MI AM", "Sun, 14 Apr 19 12:34 PM");
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "MMMM DD, YYYY", "April 14, 2019");
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "YYYY-MM-DD\"T\"HH:MI:SS.FF0", "2019-04-14T12:34:56.");
+    assert_formatted(ntz, 9, SF_DB_TYPE_TIMESTAMP_NTZ, "FF1/FF6/FF9", "1/123456/123456789");
+    assert_formatted("0.5", 1, SF_DB_TYPE_TIMESTAMP_NTZ, "HH12 PM FF2", "12 AM 50");
+    assert_formatted("45296.010", 3, SF_DB_TYPE_TIME, "HH24:MI:SS.FF3", "12:34:56.010");
+    assert_formatted("18000", 0, SF_DB_TYPE_DATE, "DD/MM/YYYY", "14/04/2019");
+    assert_formatted("-62135596800.0", 1, SF_DB_TYPE_TIMESTAMP_NTZ, "YYYY-MM-DD", "0001-01-01");
+    assert_formatted("1555245296.000 1770", 3, SF_DB_TYPE_TIMESTAMP_TZ, "HH24:MI TZH:TZM", "18:04 +05:30");
+    assert_formatted("1555245296.000 1410", 3, SF_DB_TYPE_TIMESTAMP_TZ, "HH24:MI TZHTZM", "12:04 -0030");
+}
+
+void test_timestamp_format_errors(void **unused) {
+    SF_TIMESTAMP_FORMAT compiled;
+    SF_TIMESTAMP ts;
+    char buffer[32];
+    char *small_buffer = buffer;
+    char long_format[300];
+
+    assert_int_equal(sf_timestamp_format_compile("YYYY-MM-DD X", &compiled), SF_STATUS_ERROR_STRING_FORMATTING);
+    assert_int_equal(sf_timestamp_format_compile("YYYY\"T", &compiled), SF_STATUS_ERROR_STRING_FORMATTING);
+    memset(long_format, '-', sizeof(long_format) - 1);
+    long_format[sizeof(long_format) - 1] = '\0';
+    assert_int_equal(sf_timestamp_format_compile(long_format, &compiled), SF_STATUS_ERROR_STRING_FORMATTING);
+
+    // The buffer must fit the longest string of the format
+    assert_int_equal(snowflake_timestamp_from_epoch_seconds(&ts, "0.0", NULL, 1, SF_DB_TYPE_TIMESTAMP_NTZ),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(sf_timestamp_format_compile("YYYY-MM-DD", &compiled), SF_STATUS_SUCCESS);
+    assert_int_equal(sf_timestamp_format_apply(&compiled, &ts, buffer, 10), 0);
+    assert_int_equal(sf_timestamp_format_apply(&compiled, &ts, buffer, sizeof(buffer)), 10);
+
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "MON", &small_buffer, 3, NULL, SF_BOOLEAN_FALSE),
+                     SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "MON", &small_buffer, 4, NULL, SF_BOOLEAN_FALSE),
+                     SF_STATUS_SUCCESS);
+    assert_string_equal(small_buffer, "Jan");
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "Q", &small_buffer, sizeof(buffer), NULL, SF_BOOLEAN_FALSE),
+                     SF_STATUS_ERROR_STRING_FORMATTING);
+}
+
+void test_timestamp_format_long_year(void **unused) {
+    SF_TIMESTAMP ts;
+    char buffer[32];
+    char *small_buffer = buffer;
+    char *grown_buffer = (char *) malloc(11);
+    size_t len = 0;
+
+    // 10000-01-01 doesn't fit the 11 bytes the format asks for
+    assert_int_equal(snowflake_timestamp_from_epoch_seconds(&ts, "253402300800.0", NULL, 1, SF_DB_TYPE_TIMESTAMP_NTZ),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "YYYY-MM-DD", &small_buffer, 11, &len, SF_BOOLEAN_FALSE),
+                     SF_STATUS_ERROR_BUFFER_TOO_SMALL);
+    assert_int_equal(len, 0);
+    assert_int_equal(snowflake_timestamp_to_string(&ts, "YYYY-MM-DD", &grown_buffer, 11, &len, SF_BOOLEAN_TRUE),
+                     SF_STATUS_SUCCESS);
+    assert_int_equal(len, 11);
+    assert_string_equal(grown_buffer, "10000-01-01");
+    free(grown_buffer);
+}
+
+void test_timestamp_format_session_parameters(void **unused) {
+    SF_OUTPUT_FORMATS *formats = output_formats_init();
+    const SF_TIMESTAMP_FORMAT *format;
+
+    assert_non_null(formats);
+    assert_null(output_formats_get(formats, SF_DB_TYPE_TIMESTAMP_NTZ));
+    assert_int_equal(output_format_parameter("TIMESTAMP_LTZ_OUTPUT_FORMAT"), SF_OUTPUT_FORMAT_TIMESTAMP_LTZ);
+    assert_int_equal(output_format_parameter("TIMEZONE"), SF_OUTPUT_FORMAT_PARAMETER_COUNT);
+
+    // The type specific format is empty by default, so TIMESTAMP_OUTPUT_FORMAT applies
+    output_formats_set(formats, SF_OUTPUT_FORMAT_TIMESTAMP, "YYYY-MM-DD HH24:MI:SS.FF3 TZHTZM");
+    output_formats_set(formats, SF_OUTPUT_FORMAT_TIMESTAMP_LTZ, "");
+    output_formats_set(formats, SF_OUTPUT_FORMAT_TIMESTAMP_NTZ, "YYYY-MM-DD HH24:MI:SS.FF3");
+    format = output_formats_get(formats, SF_DB_TYPE_TIMESTAMP_LTZ);
+    assert_non_null(format);
+    assert_ptr_equal(output_formats_get(formats, SF_DB_TYPE_TIMESTAMP_TZ), format);
+    assert_ptr_not_equal(output_formats_get(formats, SF_DB_TYPE_TIMESTAMP_NTZ), format);
+    assert_null(output_formats_get(formats, SF_DB_TYPE_DATE));
+    assert_null(output_formats_get(formats, SF_DB_TYPE_FIXED));
+
+    // Compiled once per text in the session
+    output_formats_set(formats, SF_OUTPUT_FORMAT_TIMESTAMP_TZ, "YYYY-MM-DD HH24:MI:SS.FF3 TZHTZM");
+    assert_ptr_equal(output_formats_get(formats, SF_DB_TYPE_TIMESTAMP_TZ), format);
+
+    // An unsupported format leaves the values to the default layout
+    output_formats_set(formats, SF_OUTPUT_FORMAT_DATE, "YYYY-MM-DD");
+    assert_non_null(output_formats_get(formats, SF_DB_TYPE_DATE));
+    output_formats_set(formats, SF_OUTPUT_FORMAT_DATE, "YYYY-WW");
+    assert_null(output_formats_get(formats, SF_DB_TYPE_DATE));
+
+    output_formats_term(formats);
+}
+
+int main(void) {
+    initialize_test(SF_BOOLEAN_FALSE);
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_timestamp_format_elements),
+        cmocka_unit_test(test_timestamp_format_errors),
+        cmocka_unit_test(test_timestamp_format_long_year),
+        cmocka_unit_test(test_timestamp_format_session_parameters),
+    };
+    int ret = cmocka_run_group_tests(tests, NULL, NULL);
+    snowflake_global_term();
+    return ret;
+}
@@ -0,0 +1,524 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_http_server.h"
+
+#ifndef _WIN32
+
+#include <pthread.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#include <openssl/pem.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define TEST_HTTP_MAX_CONNECTIONS 256
+#define TEST_HTTP_MAX_REQUEST 8192
+
+typedef struct TEST_HTTP_CONNECTION {
+    TEST_HTTP_SERVER *server;
+    int fd;
+    // NULL unless the server speaks TLS
+    SSL *ssl;
+    pthread_t thread;
+} TEST_HTTP_CONNECTION;
+
+struct TEST_HTTP_SERVER {
+    TEST_HTTP_RESOURCE *resources;
+    size_t resource_count;
+    int listen_fd;
+    int port;
+    int stopped;
+    int requests;
+    pthread_t accept_thread;
+    pthread_mutex_t lock;
+    TEST_HTTP_CONNECTION connections[TEST_HTTP_MAX_CONNECTIONS];
+    int connection_count;
+    // TLS only
+    SSL_CTX *ssl_ctx;
+    char ca_file[64];
+    int handshakes;
+    int resumed_handshakes;
+};
+
+static int send_all(TEST_HTTP_CONNECTION *connection, const char *data, size_t len) {
+    ssize_t sent;
+    while (len > 0) {
+        if (connection->ssl) {
+            sent = SSL_write(connection->ssl, data, (int) len);
+        } else {
+            sent = send(connection->fd, data, len, MSG_NOSIGNAL);
+        }
+        if (sent <= 0) {
+            return -1;
+        }
+        data += sent;
+        len -= (size_t) sent;
+    }
+    return 0;
+}
+
+static ssize_t recv_some(TEST_HTTP_CONNECTION *connection, char *buf, size_t len) {
+    if (connection->ssl) {
+        return SSL_read(connection->ssl, buf, (int) len);
+    }
+    return recv(connection->fd, buf, len, 0);
+}
+
+static int send_status(TEST_HTTP_CONNECTION *connection, int status) {
+    char header[256];
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 %d Error\r\nContent-Length: 0\r\n\r\n", status);
+    return send_all(connection, header, strlen(header));
+}
+
+/**
+ * Parses "Range: bytes=<first>-[<last>]". Returns 0 if there is no usable range.
+ */
+static int parse_range(const char *request, size_t body_len, size_t *first, size_t *last) {
+    const char *range = strcasestr(request, "\r\nRange: bytes=");
+    char *end;
+    if (!range || body_len == 0) {
+        return 0;
+    }
+    range += strlen("\r\nRange: bytes=");
+    *first = (size_t) strtoull(range, &end, 10);
+    if (*end != '-') {
+        return 0;
+    }
+    end++;
+    if (*end >= '0' && *end <= '9') {
+        *last = (size_t) strtoull(end, NULL, 10);
+    } else {
+        *last = body_len - 1;
+    }
+    if (*last >= body_len) {
+        *last = body_len - 1;
+    }
+    return *first <= *last;
+}
+
+static int handle_request(TEST_HTTP_CONNECTION *connection, const char *request) {
+    TEST_HTTP_SERVER *server = connection->server;
+    char path[1024];
+    char header[512];
+    char encoding[64] = "";
+    char *query;
+    size_t i;
+    size_t first = 0;
+    size_t last = 0;
+    size_t len;
+    int status = 0;
+    int truncate = 0;
+    int delay = 0;
+    int partial;
+    TEST_HTTP_RESOURCE *resource = NULL;
+
+    if (sscanf(request, "GET %1023s", path) != 1) {
+        return send_status(connection, 405);
+    }
+    if ((query = strchr(path, '?')) != NULL) {
+        *query = '\0';
+    }
+
+    pthread_mutex_lock(&server->lock);
+    server->requests++;
+    for (i = 0; i < server->resource_count; i++) {
+        if (strcmp(server->resources[i].path, path) == 0) {
+            resource = &server->resources[i];
+            resource->requests++;
+            delay = resource->delay_count == 0 || resource->requests <= resource->delay_count;
+            if (resource->requests <= resource->error_count) {
+                status = resource->error_status;
+            } else if (resource->requests - resource->error_count <= resource->truncate_count) {
+                truncate = 1;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    if (!resource) {
+        return send_status(connection, 404);
+    }
+    if (resource->delay_ms && delay) {
+        usleep(resource->delay_ms * 1000);
+    }
+    if (status) {
+        return send_status(connection, status);
+    }
+
+    partial = parse_range(request, resource->body_len, &first, &last);
+    if (partial) {
+        pthread_mutex_lock(&server->lock);
+        resource->range_requests++;
+        pthread_mutex_unlock(&server->lock);
+        partial = !resource->ignore_range;
+    }
+    if (!partial) {
+        first = 0;
+        last = resource->body_len ? resource->body_len - 1 : 0;
+    }
+    len = resource->body_len ? last - first + 1 : 0;
+    if (resource->content_encoding) {
+        snprintf(encoding, sizeof(encoding), "Content-Encoding: %s\r\n", resource->content_encoding);
+    }
+    if (partial) {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 206 Partial Content\r\nContent-Length: %zu\r\n%s"
+                 "Content-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                 len, encoding, first, last, resource->body_len);
+    } else {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n%sAccept-Ranges: bytes\r\n\r\n", len, encoding);
+    }
+    if (send_all(connection, header, strlen(header))) {
+        return -1;
+    }
+    if (truncate) {
+        send_all(connection, resource->body + first, resource->truncate_bytes < len ? resource->truncate_bytes : len);
+        return -1;
+    }
+    return send_all(connection, resource->body + first, len);
+}
+
+static void *connection_thread(void *arg) {
+    TEST_HTTP_CONNECTION *connection = (TEST_HTTP_CONNECTION *) arg;
+    char request[TEST_HTTP_MAX_REQUEST];
+    size_t used = 0;
+    ssize_t received;
+    char *end;
+    size_t request_len;
+
+    if (connection->ssl) {
+        if (SSL_accept(connection->ssl) != 1) {
+            goto done;
+        }
+        pthread_mutex_lock(&connection->server->lock);
+        connection->server->handshakes++;
+        if (SSL_session_reused(connection->ssl)) {
+            connection->server->resumed_handshakes++;
+        }
+        pthread_mutex_unlock(&connection->server->lock);
+    }
+
+    while (1) {
+        request[used] = '\0';
+        end = strstr(request, "\r\n\r\n");
+        if (!end) {
+            if (used >= sizeof(request) - 1) {
+                break;
+            }
+            received = recv_some(connection, request + used, sizeof(request) - 1 - used);
+            if (received <= 0) {
+                break;
+            }
+            used += (size_t) received;
+            continue;
+        }
+        end[2] = '\0';
+        request_len = (size_t) (end - request) + 4;
+        if (handle_request(connection, request) ||
+            strcasestr(request, "\r\nConnection: close")) {
+            break;
+        }
+        memmove(request, request + request_len, used - request_len);
+        used -= request_len;
+    }
+
+done:
+    shutdown(connection->fd, SHUT_RDWR);
+    return NULL;
+}
+
+static void *accept_thread(void *arg) {
+    TEST_HTTP_SERVER *server = (TEST_HTTP_SERVER *) arg;
+    TEST_HTTP_CONNECTION *connection;
+    int fd;
+    int one = 1;
+
+    while (1) {
+        fd = accept(server->listen_fd, NULL, NULL);
+        pthread_mutex_lock(&server->lock);
+        if (server->stopped || fd < 0 || server->connection_count >= TEST_HTTP_MAX_CONNECTIONS) {
+            pthread_mutex_unlock(&server->lock);
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (server->stopped) {
+                break;
+            }
+            continue;
+        }
+        // Headers and body are sent separately, don't let Nagle delay the body
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        connection = &server->connections[server->connection_count];
+        connection->server = server;
+        connection->fd = fd;
+        connection->ssl = NULL;
+        if (server->ssl_ctx) {
+            connection->ssl = SSL_new(server->ssl_ctx);
+            if (!connection->ssl || !SSL_set_fd(connection->ssl, fd)) {
+                SSL_free(connection->ssl);
+                pthread_mutex_unlock(&server->lock);
+                close(fd);
+                continue;
+            }
+        }
+        if (pthread_create(&connection->thread, NULL, connection_thread, connection) == 0) {
+            server->connection_count++;
+        } else {
+            SSL_free(connection->ssl);
+            close(fd);
+        }
+        pthread_mutex_unlock(&server->lock);
+    }
+    return NULL;
+}
+
+/**
+ * Creates a self-signed certificate for 127.0.0.1 and writes it to a temporary file that clients can use
+ * as their CA bundle.
+ */
+static int tls_setup(TEST_HTTP_SERVER *server) {
+    EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+    EVP_PKEY *key = NULL;
+    X509 *cert = NULL;
+    X509_NAME *name;
+    X509_EXTENSION *ext;
+    FILE *file;
+    int fd;
+    int ret = -1;
+
+    if (!key_ctx ||
+        EVP_PKEY_keygen_init(key_ctx) <= 0 ||
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx, NID_X9_62_prime256v1) <= 0 ||
+        EVP_PKEY_keygen(key_ctx, &key) <= 0) {
+        goto cleanup;
+    }
+
+    cert = X509_new();
+    if (!cert) {
+        goto cleanup;
+    }
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+    X509_set_pubkey(cert, key);
+    name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *) "127.0.0.1", -1, -1, 0);
+    X509_set_issuer_name(cert, name);
+    ext = X509V3_EXT_conf_nid(NULL, NULL, NID_subject_alt_name, (char *) "IP:127.0.0.1");
+    if (!ext || !X509_add_ext(cert, ext, -1)) {
+        X509_EXTENSION_free(ext);
+        goto cleanup;
+    }
+    X509_EXTENSION_free(ext);
+    if (!X509_sign(cert, key, EVP_sha256())) {
+        goto cleanup;
+    }
+
+    server->ssl_ctx = SSL_CTX_new(TLS_server_method());
+    if (!server->ssl_ctx ||
+        SSL_CTX_use_certificate(server->ssl_ctx, cert) != 1 ||
+        SSL_CTX_use_PrivateKey(server->ssl_ctx, key) != 1 ||
+        SSL_CTX_set_session_id_context(server->ssl_ctx, (const unsigned char *) "sf_test", 7) != 1) {
+        goto cleanup;
+    }
+
+    snprintf(server->ca_file, sizeof(server->ca_file), "/tmp/sf_test_ca_XXXXXX");
+    fd = mkstemp(server->ca_file);
+    if (fd < 0) {
+        server->ca_file[0] = '\0';
+        goto cleanup;
+    }
+    file = fdopen(fd, "w");
+    if (!file) {
+        close(fd);
+        goto cleanup;
+    }
+    ret = PEM_write_X509(file, cert) == 1 ? 0 : -1;
+    fclose(file);
+
+cleanup:
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    EVP_PKEY_CTX_free(key_ctx);
+    return ret;
+}
+
+static void tls_teardown(TEST_HTTP_SERVER *server) {
+    if (server->ca_file[0]) {
+        unlink(server->ca_file);
+    }
+    SSL_CTX_free(server->ssl_ctx);
+}
+
+static TEST_HTTP_SERVER *server_start(TEST_HTTP_RESOURCE *resources, size_t count, int tls) {
+    TEST_HTTP_SERVER *server = (TEST_HTTP_SERVER *) calloc(1, sizeof(TEST_HTTP_SERVER));
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int one = 1;
+
+    if (!server) {
+        return NULL;
+    }
+    server->resources = resources;
+    server->resource_count = count;
+    server->listen_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+
+    if (tls && tls_setup(server)) {
+        goto error;
+    }
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server->listen_fd < 0) {
+        goto error;
+    }
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(server->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(server->listen_fd, 64) ||
+        getsockname(server->listen_fd, (struct sockaddr *) &addr, &addr_len)) {
+        goto error;
+    }
+    server->port = ntohs(addr.sin_port);
+
+    if (pthread_create(&server->accept_thread, NULL, accept_thread, server)) {
+        goto error;
+    }
+    return server;
+
+error:
+    if (server->listen_fd >= 0) {
+        close(server->listen_fd);
+    }
+    tls_teardown(server);
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+    return NULL;
+}
+
+TEST_HTTP_SERVER *test_http_server_start(TEST_HTTP_RESOURCE *resources, size_t count) {
+    return server_start(resources, count, 0);
+}
+
+TEST_HTTP_SERVER *test_https_server_start(TEST_HTTP_RESOURCE *resources, size_t count) {
+    return server_start(resources, count, 1);
+}
+
+void test_http_server_url(TEST_HTTP_SERVER *server, const char *path, char *buf, size_t buf_size) {
+    snprintf(buf, buf_size, "%s://127.0.0.1:%d%s", server->ssl_ctx ? "https" : "http", server->port, path);
+}
+
+const char *test_http_server_ca_file(TEST_HTTP_SERVER *server) {
+    return server->ssl_ctx ? server->ca_file : NULL;
+}
+
+int test_http_server_handshakes(TEST_HTTP_SERVER *server, int *resumed) {
+    int ret;
+    pthread_mutex_lock(&server->lock);
+    ret = server->handshakes;
+    if (resumed) {
+        *resumed = server->resumed_handshakes;
+    }
+    pthread_mutex_unlock(&server->lock);
+    return ret;
+}
+
+int test_http_server_connections(TEST_HTTP_SERVER *server) {
+    int ret;
+    pthread_mutex_lock(&server->lock);
+    ret = server->connection_count;
+    pthread_mutex_unlock(&server->lock);
+    return ret;
+}
+
+int test_http_server_requests(TEST_HTTP_SERVER *server) {
+    int ret;
+    pthread_mutex_lock(&server->lock);
+    ret = server->requests;
+    pthread_mutex_unlock(&server->lock);
+    return ret;
+}
+
+void test_http_server_stop(TEST_HTTP_SERVER *server) {
+    int i;
+    if (!server) {
+        return;
+    }
+    pthread_mutex_lock(&server->lock);
+    server->stopped = 1;
+    pthread_mutex_unlock(&server->lock);
+
+    // Unblock accept()
+    shutdown(server->listen_fd, SHUT_RDWR);
+    pthread_join(server->accept_thread, NULL);
+    close(server->listen_fd);
+
+    for (i = 0; i < server->connection_count; i++) {
+        shutdown(server->connections[i].fd, SHUT_RDWR);
+        pthread_join(server->connections[i].thread, NULL);
+        SSL_free(server->connections[i].ssl);
+        close(server->connections[i].fd);
+    }
+    tls_teardown(server);
+    pthread_mutex_destroy(&server->lock);
+    free(server);
+}
+
+#else
+
+TEST_HTTP_SERVER *test_http_server_start(TEST_HTTP_RESOURCE *resources, size_t count) {
+    return NULL;
+}
+
+TEST_HTTP_SERVER *test_https_server_start(TEST_HTTP_RESOURCE *resources, size_t count) {
+    return NULL;
+}
+
+const char *test_http_server_ca_file(TEST_HTTP_SERVER *server) {
+    return NULL;
+}
+
+int test_http_server_handshakes(TEST_HTTP_SERVER *server, int *resumed) {
+    return 0;
+}
+
+void test_http_server_url(TEST_HTTP_SERVER *server, const char *path, char *buf, size_t buf_size) {
+    buf[0] = '\0';
+}
+
+int test_http_server_connections(TEST_HTTP_SERVER *server) {
+    return 0;
+}
+
+int test_http_server_requests(TEST_HTTP_SERVER *server) {
+    return 0;
+}
+
+void test_http_server_stop(TEST_HTTP_SERVER *server) {
+}
+
+#endif
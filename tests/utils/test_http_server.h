@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2018-2019 Snowflake Computing, Inc. All rights reserved.
+ */
+
+#ifndef SNOWFLAKE_TEST_HTTP_SERVER_H
+#define SNOWFLAKE_TEST_HTTP_SERVER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * A static resource served by the local test HTTP server
+ */
+typedef struct TEST_HTTP_RESOURCE {
+    const char *path;
+    const char *body;
+    size_t body_len;
+    // Delay before responding
+    unsigned int delay_ms;
+    // Only delay the first delay_count requests, all of them if 0
+    int delay_count;
+    // Respond with error_status for the first error_count requests
+    int error_status;
+    int error_count;
+    // Close the connection after sending truncate_bytes of the body for the first truncate_count requests
+    size_t truncate_bytes;
+    int truncate_count;
+    // Answer range requests with the whole body
+    int ignore_range;
+    // Sent as the Content-Encoding of the body if set. The body has to be encoded accordingly.
+    const char *content_encoding;
+    // Number of requests, and range requests, served for this resource. Updated by the server
+    int requests;
+    int range_requests;
+} TEST_HTTP_RESOURCE;
+
+typedef struct TEST_HTTP_SERVER TEST_HTTP_SERVER;
+
+/**
+ * Starts a HTTP/1.1 server on a random port of the loopback interface. Supports keep-alive and
+ * single "Range: bytes=" requests, which is all the chunk downloader needs.
+ *
+ * @param resources resources to serve. Must outlive the server.
+ * @param count number of resources
+ * @return server or NULL if the platform is not supported or the server failed to start
+ */
+TEST_HTTP_SERVER *test_http_server_start(TEST_HTTP_RESOURCE *resources, size_t count);
+
+/**
+ * Same as test_http_server_start but speaks TLS with a self-signed certificate for 127.0.0.1.
+ * Use test_http_server_ca_file as the CA bundle of the client.
+ */
+TEST_HTTP_SERVER *test_https_server_start(TEST_HTTP_RESOURCE *resources, size_t count);
+
+/**
+ * Formats http(s)://127.0.0.1:<port><path> into buf
+ */
+void test_http_server_url(TEST_HTTP_SERVER *server, const char *path, char *buf, size_t buf_size);
+
+/**
+ * Number of TCP connections accepted so far
+ */
+int test_http_server_connections(TEST_HTTP_SERVER *server);
+
+/**
+ * PEM file with the certificate of a TLS server, NULL for a plain HTTP server
+ */
+const char *test_http_server_ca_file(TEST_HTTP_SERVER *server);
+
+/**
+ * Number of TLS handshakes completed so far
+ *
+ * @param resumed set to the number of handshakes that resumed a TLS session. Optional
+ */
+int test_http_server_handshakes(TEST_HTTP_SERVER *server, int *resumed);
+
+/**
+ * Number of requests served so far
+ */
+int test_http_server_requests(TEST_HTTP_SERVER *server);
+
+/**
+ * Stops the server and closes all connections
+ */
+void test_http_server_stop(TEST_HTTP_SERVER *server);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SNOWFLAKE_TEST_HTTP_SERVER_H
@@ -71,6 +71,32 @@ SF_CONNECT *setup_snowflake_connection_with_autocommit(
     return sf;
 }
 
+void get_data_dir(char *dir, size_t dir_size) {
+#ifdef _WIN32
+    const char *build_dir = getenv("APPVEYOR_BUILD_FOLDER");
+#else
+    const char *build_dir = getenv("TRAVIS_BUILD_DIR");
+#endif
+    const char *current_file = __FILE__;
+    const char *util_dir_end = strrchr(current_file, PATH_SEP);
+
+    if (build_dir) {
+        snprintf(dir, dir_size, "%s%ctests%cdata%c", build_dir, PATH_SEP, PATH_SEP, PATH_SEP);
+    } else if (util_dir_end) {
+        snprintf(dir, dir_size, "%.*s%c..%cdata%c", (int) (util_dir_end - current_file), current_file,
+                 PATH_SEP, PATH_SEP, PATH_SEP);
+    } else {
+        snprintf(dir, dir_size, "..%cdata%c", PATH_SEP, PATH_SEP);
+    }
+}
+
+uint64 next_random(uint64 *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
 void dump_error(SF_ERROR_STRUCT *error) {
     fprintf(stderr, "Error code: %d, message: %s\nIn File, %s, Line, %d\n",
             error->error_code,
@@ -31,6 +31,16 @@ void setup_and_run_query(SF_CONNECT **sfp, SF_STMT **sfstmtp, const char *query)
 
 void process_results(struct timespec begin, struct timespec end, int num_iterations, const char *label);
 
+/**
+ * Gets the <workspace>/tests/data/ directory with a trailing separator
+ */
+void get_data_dir(char *dir, size_t dir_size);
+
+/**
+ * Deterministic 64 bit random numbers, so a failure can be reproduced. The state must not be 0.
+ */
+uint64 next_random(uint64 *state);
+
 /**
  * Dump error
  * @param error SF_ERROR_STRUCT